@@ -0,0 +1,58 @@
+# Used to quickly run benchmark under RSpec as part of the usual test suite, to validate it didn't bitrot
+VALIDATE_BENCHMARK_MODE = ENV['VALIDATE_BENCHMARK'] == 'true'
+
+return unless __FILE__ == $PROGRAM_NAME || VALIDATE_BENCHMARK_MODE
+
+require_relative 'benchmarks_helper'
+require 'datadog/core/ddsketch'
+
+# This benchmark measures the cost of adding points to a DDSketch one by one vs in batches
+
+class CoreDDSketchBenchmark
+  POINTS_PER_BATCH = 1000
+
+  def initialize
+    random = Random.new(42)
+    # Latencies in seconds, with microsecond resolution, so some of them repeat
+    @points = Array.new(POINTS_PER_BATCH) { (random.rand(0.05) * 1_000_000).round / 1_000_000.0 }
+    @packed_points = @points.pack('d*')
+    # Latencies in seconds, with millisecond resolution, so most of them repeat
+    @coarse_points = @points.map { |point| point.round(3) }
+  end
+
+  def run_benchmark
+    sketch = Datadog::Core::DDSketch.new
+
+    Benchmark.ips do |x|
+      benchmark_time = VALIDATE_BENCHMARK_MODE ? {time: 0.01, warmup: 0} : {time: 10, warmup: 2}
+      x.config(
+        **benchmark_time,
+      )
+
+      x.report("add #{POINTS_PER_BATCH} points one by one") do
+        @points.each { |point| sketch.add(point) }
+      end
+
+      x.report("add_many #{POINTS_PER_BATCH} points (Array)") do
+        sketch.add_many(@points)
+      end
+
+      x.report("add_many #{POINTS_PER_BATCH} points (packed String)") do
+        sketch.add_many(@packed_points)
+      end
+
+      x.report("add_many #{POINTS_PER_BATCH} points (Array, mostly repeated values)") do
+        sketch.add_many(@coarse_points)
+      end
+
+      x.save! "#{File.basename(__FILE__, '.rb')}-results.json" unless VALIDATE_BENCHMARK_MODE
+      x.compare!
+    end
+  end
+end
+
+puts "Current pid is #{Process.pid}"
+
+CoreDDSketchBenchmark.new.instance_exec do
+  run_benchmark
+end
@@ -0,0 +1,100 @@
+# Used to quickly run benchmark under RSpec as part of the usual test suite, to validate it didn't bitrot
+VALIDATE_BENCHMARK_MODE = ENV['VALIDATE_BENCHMARK'] == 'true'
+
+return unless __FILE__ == $PROGRAM_NAME || VALIDATE_BENCHMARK_MODE
+
+require_relative 'benchmarks_helper'
+require 'datadog/core/feature_flags'
+require 'json'
+
+# This benchmark measures the cost of evaluating many feature flags for the same context, one by one vs all at once
+
+class CoreFeatureFlagsBenchmark
+  FLAG_COUNT = VALIDATE_BENCHMARK_MODE ? 10 : 1000
+  CONTEXT_COUNT = VALIDATE_BENCHMARK_MODE ? 10 : 10_000
+
+  def initialize
+    @configuration = Datadog::Core::FeatureFlags::Configuration.new(flags_json)
+    @flag_keys = Array.new(FLAG_COUNT) { |i| "flag-#{i}" }
+    @contexts = Array.new(CONTEXT_COUNT) do |i|
+      domain = i.even? ? 'example.com' : 'other.com'
+      {'targeting_key' => "user-#{i}", 'email' => "user-#{i}@#{domain}", 'age' => i % 100}
+    end
+    @evaluation_contexts = @contexts.map { |context| Datadog::Core::FeatureFlags::EvaluationContext.new(context) }
+  end
+
+  def run_benchmark
+    Benchmark.ips do |x|
+      benchmark_time = VALIDATE_BENCHMARK_MODE ? {time: 0.01, warmup: 0} : {time: 10, warmup: 2}
+      x.config(
+        **benchmark_time,
+      )
+
+      context_index = 0
+
+      x.report("get_assignment #{FLAG_COUNT} flags one by one (Hash context)") do
+        context = @contexts[context_index = (context_index + 1) % CONTEXT_COUNT]
+        @flag_keys.each { |flag_key| @configuration.get_assignment(flag_key, :string, context).variant }
+      end
+
+      x.report("get_assignment #{FLAG_COUNT} flags one by one (EvaluationContext)") do
+        context = @evaluation_contexts[context_index = (context_index + 1) % CONTEXT_COUNT]
+        @flag_keys.each { |flag_key| @configuration.get_assignment(flag_key, :string, context).variant }
+      end
+
+      x.report("get_assignments #{FLAG_COUNT} flags at once (EvaluationContext)") do
+        context = @evaluation_contexts[context_index = (context_index + 1) % CONTEXT_COUNT]
+        @configuration.get_assignments(@flag_keys, :string, context).each(&:variant)
+      end
+
+      x.save! "#{File.basename(__FILE__, '.rb')}-results.json" unless VALIDATE_BENCHMARK_MODE
+      x.compare!
+    end
+  end
+
+  private
+
+  def flags_json
+    flags = Array.new(FLAG_COUNT) do |i|
+      flag_key = "flag-#{i}"
+      flag = {
+        key: flag_key,
+        enabled: true,
+        variationType: 'STRING',
+        variations: {
+          control: {key: 'control', value: 'control'},
+          treatment: {key: 'treatment', value: 'treatment'},
+        },
+        allocations: [
+          {
+            key: "#{flag_key}-targeted",
+            rules: [{conditions: [{attribute: 'email', operator: 'MATCHES', value: '@example\\.com$'}]}],
+            splits: [{variationKey: 'treatment', shards: []}],
+            doLog: true,
+          },
+          {
+            key: "#{flag_key}-default",
+            splits: [{variationKey: 'control', shards: []}],
+            doLog: false,
+          },
+        ],
+      }
+
+      [flag_key, flag]
+    end
+
+    JSON.generate(
+      id: '1',
+      createdAt: '2024-04-17T19:40:53.716Z',
+      format: 'SERVER',
+      environment: {name: 'Benchmark'},
+      flags: flags.to_h,
+    )
+  end
+end
+
+puts "Current pid is #{Process.pid}"
+
+CoreFeatureFlagsBenchmark.new.instance_exec do
+  run_benchmark
+end
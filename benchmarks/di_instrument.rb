@@ -12,6 +12,11 @@
 # line instrumentation - targeted:   128848.6 i/s - 4.58x  slower
 # line instrumentation:    10771.7 i/s - 54.73x  slower
 #
+# Hits of targeted line probes are counted and rate limited natively (see
+# DI::LineProbeHook), so once a probe's rate limit is exhausted
+# ("line instrumentation - targeted, rate limited") its overhead is only that
+# of the VM invoking the trace point hook, without any Ruby code running.
+#
 # Targeted line and method instrumentations have similar performance at
 # about 25% of baseline. Note that the instrumented method is fairly
 # small and probably runs very quickly by itself, so while this is not the
@@ -243,6 +248,44 @@ class DIInstrumentBenchmark
       raise "Expected at least 1000 calls to the method, got #{calls}"
     end
 
+    instrumenter.unhook(probe)
+
+    # A probe whose rate limit is exhausted should cost close to nothing,
+    # since its hits are dropped before any Ruby code is invoked.
+    calls = 0
+    probe = Datadog::DI::Probe.new(id: 1, type: :log,
+      file: targeted_file, line_no: targeted_line + 1, rate_limit: 0)
+    rv = if defined?(Datadog::DI::ProcResponder)
+      instrumenter.hook_line(probe, responder)
+    else
+      instrumenter.hook_line(probe, &executed_proc)
+    end
+    unless rv
+      raise "Line probe (targeted, rate limited) was not successfully installed"
+    end
+
+    Benchmark.ips do |x|
+      benchmark_time = VALIDATE_BENCHMARK_MODE ? {time: 0.01, warmup: 0} : {time: 10, warmup: 2}
+      x.config(
+        **benchmark_time,
+      )
+
+      x.report('line instrumentation - targeted, rate limited') do
+        DITarget.new.test_method_for_line_probe
+      end
+
+      x.save! "#{File.basename(__FILE__, '.rb')}-results.json" unless VALIDATE_BENCHMARK_MODE
+      x.compare!
+    end
+
+    if calls != 0
+      raise "Rate limited line instrumentation invoked the callback (#{calls} calls recorded)"
+    end
+
+    if probe.respond_to?(:drop_count) && probe.drop_count < 1
+      raise "Rate limited line instrumentation did not record any dropped hits"
+    end
+
     # Now, remove all installed hooks and check that the performance of
     # target code is approximately what it was prior to hook installation.
 
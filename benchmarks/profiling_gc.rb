@@ -42,10 +42,10 @@ class ProfilerGcBenchmark
         **benchmark_time,
       )
 
-      # We cap the number of minor GC samples to not happen more often than TIME_BETWEEN_GC_EVENTS_NS (10)
-      minor_gc_per_second_upper_bound = 100
+      # Minor GCs get batched and only flushed every GC_EVENT_RING_FLUSH_THRESHOLD GC cycles (or when serializing)...
+      minor_gc_flushes_per_second_upper_bound = 100
       # ...but every major GC triggers a flush. Here we consider what would happen if we had 1000 major GCs per second
-      pessimistic_number_of_gcs_per_second = minor_gc_per_second_upper_bound * 10
+      pessimistic_number_of_gcs_per_second = minor_gc_flushes_per_second_upper_bound * 10
       estimated_gc_per_minute = pessimistic_number_of_gcs_per_second * 60
 
       x.report("estimated profiler gc per minute (sample #{estimated_gc_per_minute} times + serialize result)") do
@@ -0,0 +1,73 @@
+# Used to quickly run benchmark under RSpec as part of the usual test suite, to validate it didn't bitrot
+VALIDATE_BENCHMARK_MODE = ENV['VALIDATE_BENCHMARK'] == 'true'
+
+return unless __FILE__ == $PROGRAM_NAME || VALIDATE_BENCHMARK_MODE
+
+require_relative 'benchmarks_helper'
+
+# This benchmark compares the cost of sampling processes with a varying number of threads (which reads the cpu-time for
+# every thread separately, via its cpu clock) with the cost of a single pass over /proc/self/task/*/schedstat, which is
+# the alternative "bulk" way of getting the cpu-time for every thread on Linux.
+#
+# At the time of writing, a native version of the schedstat pass was ~10x slower than the per-thread cpu clocks (it
+# still needs an openat/read/close per thread), which is why the profiler does not use it.
+
+class ProfilerThreadCpuTimeBenchmark
+  # This is needed because we're directly invoking the collector through a testing interface; in normal
+  # use a profiler thread is automatically used.
+  PROFILER_OVERHEAD_STACK_THREAD = Thread.new { sleep }
+
+  SCHEDSTAT_AVAILABLE = File.exist?("/proc/self/task/#{Process.pid}/schedstat")
+
+  def create_profiler
+    @recorder = Datadog::Profiling::StackRecorder.for_testing
+    @collector = Datadog::Profiling::Collectors::ThreadContext.for_testing(recorder: @recorder)
+  end
+
+  def run_benchmark(thread_count:)
+    threads = Array.new(thread_count) { Thread.new { sleep } }
+
+    Benchmark.ips do |x|
+      benchmark_time = VALIDATE_BENCHMARK_MODE ? {time: 0.01, warmup: 0} : {time: 10, warmup: 2}
+      x.config(
+        **benchmark_time,
+      )
+
+      x.report("sample #{thread_count} threads (per-thread cpu clock) #{ENV["CONFIG"]}") { sample }
+      if SCHEDSTAT_AVAILABLE
+        x.report("read schedstat for #{thread_count} threads #{ENV["CONFIG"]}") { read_schedstat }
+      end
+
+      x.save! "#{File.basename(__FILE__, '.rb')}-#{thread_count}-results.json" unless VALIDATE_BENCHMARK_MODE
+      x.compare!
+    end
+
+    threads.map(&:kill).each(&:join)
+    @recorder.serialize!
+  end
+
+  def sample
+    Datadog::Profiling::Collectors::ThreadContext::Testing._native_sample(
+      @collector,
+      PROFILER_OVERHEAD_STACK_THREAD,
+      false
+    )
+  end
+
+  def read_schedstat
+    Dir.each_child("/proc/self/task").sum do |tid|
+      File.read("/proc/self/task/#{tid}/schedstat").to_i
+    rescue SystemCallError
+      0 # Thread exited while we were reading
+    end
+  end
+end
+
+puts "Current pid is #{Process.pid}"
+
+ProfilerThreadCpuTimeBenchmark.new.instance_exec do
+  create_profiler
+  (VALIDATE_BENCHMARK_MODE ? [10] : [10, 100, 1000]).each do |thread_count|
+    run_benchmark(thread_count: thread_count)
+  end
+end
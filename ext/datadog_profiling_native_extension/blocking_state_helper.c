@@ -0,0 +1,215 @@
+#ifndef _GNU_SOURCE
+  #define _GNU_SOURCE // Needed for process_vm_readv
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "blocking_state_helper.h"
+
+// See blocking_state_helper.h for details
+
+#ifdef __linux__
+
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#define STARTS_WITH(prefix, string) (strncmp(prefix, string, sizeof(prefix) - 1) == 0)
+#define FINAL_RESULT(state_slice) ((blocking_state_result) {.state = (state_slice), .is_final = true})
+#define NOT_FINAL_RESULT ((blocking_state_result) {.state = DDOG_CHARSLICE_C(""), .is_final = false})
+
+// Lookups only happen while holding the GVL, so these don't need to be atomic.
+//
+// Set once we find out we're not allowed to read /proc/self/task/<tid>/syscall, in which case we stop trying
+static bool syscall_lookup_disabled = false;
+// Set once process_vm_readv is not allowed (e.g. the default Docker/Kubernetes seccomp profile blocks it, unless the
+// container has CAP_SYS_PTRACE), in which case we read the pollfd via /proc/self/mem instead
+static bool process_vm_readv_disabled = false;
+// Set once neither of the above ways of reading the pollfd is allowed
+static bool poll_fd_lookup_disabled = false;
+
+static bool is_not_allowed_error(int error) {
+  return error == EPERM || error == EACCES || error == ENOSYS;
+}
+
+static bool is_fd_based_syscall(long syscall_number) {
+  switch (syscall_number) {
+    case SYS_read:
+    case SYS_write:
+    case SYS_readv:
+    case SYS_writev:
+    case SYS_pread64:
+    case SYS_pwrite64:
+    case SYS_fsync:
+    case SYS_fdatasync:
+    case SYS_recvfrom:
+    case SYS_recvmsg:
+    case SYS_sendto:
+    case SYS_sendmsg:
+    case SYS_accept:
+    case SYS_accept4:
+    case SYS_connect:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool is_sleep_syscall(long syscall_number) {
+  switch (syscall_number) {
+    #ifdef SYS_nanosleep // Not available on all architectures
+      case SYS_nanosleep:
+    #endif
+    case SYS_clock_nanosleep:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool is_poll_syscall(long syscall_number) {
+  switch (syscall_number) {
+    #ifdef SYS_poll // Not available on all architectures
+      case SYS_poll:
+    #endif
+    case SYS_ppoll:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Ruby waits for sockets (which it sets as non-blocking) to become ready using poll/ppoll on a single fd (see
+// `rb_thread_wait_for_single_fd`), so for those we need to look into the pollfd to find out what fd is being waited on.
+//
+// The pollfd lives in the stack of the blocked thread and thus in our own memory, but that thread may wake up
+// at any time, so we read it using process_vm_readv (or /proc/self/mem), which fails gracefully (rather than crashing)
+// if the memory is no longer there. (If the thread woke up, the worst that can happen is that we report the wrong
+// state for this sample.)
+static long fd_for_poll_syscall(unsigned long pollfds_address, unsigned long pollfds_count) {
+  if (pollfds_count != 1 || poll_fd_lookup_disabled) return -1;
+
+  struct pollfd pollfd;
+
+  if (!process_vm_readv_disabled) {
+    struct iovec local = {.iov_base = &pollfd, .iov_len = sizeof(pollfd)};
+    struct iovec remote = {.iov_base = (void *) pollfds_address, .iov_len = sizeof(pollfd)};
+
+    ssize_t bytes_read = process_vm_readv(getpid(), &local, 1, &remote, 1, 0);
+    if (bytes_read == (ssize_t) sizeof(pollfd)) return pollfd.fd;
+    if (bytes_read != -1 || !is_not_allowed_error(errno)) return -1;
+
+    process_vm_readv_disabled = true;
+  }
+
+  // Reading our own memory this way only needs regular file system calls, so it's usually allowed when
+  // process_vm_readv is not
+  int mem_fd = open("/proc/self/mem", O_RDONLY | O_CLOEXEC);
+  if (mem_fd == -1) {
+    if (is_not_allowed_error(errno)) poll_fd_lookup_disabled = true;
+    return -1;
+  }
+
+  ssize_t bytes_read = pread(mem_fd, &pollfd, sizeof(pollfd), (off_t) pollfds_address);
+  int pread_error = errno;
+  close(mem_fd);
+
+  if (bytes_read == -1 && is_not_allowed_error(pread_error)) poll_fd_lookup_disabled = true;
+
+  return bytes_read == (ssize_t) sizeof(pollfd) ? pollfd.fd : -1;
+}
+
+static ddog_CharSlice state_for_fd(long fd) {
+  char path[64];
+  if (fd < 0 || snprintf(path, sizeof(path), "/proc/self/fd/%ld", fd) >= (int) sizeof(path)) return DDOG_CHARSLICE_C("");
+
+  char target[64];
+  ssize_t target_length = readlink(path, target, sizeof(target) - 1);
+  if (target_length <= 0) return DDOG_CHARSLICE_C(""); // The fd may have just been closed
+  target[target_length] = '\0';
+
+  if (STARTS_WITH("socket:", target)) return DDOG_CHARSLICE_C("network");
+  if (STARTS_WITH("pipe:", target)) return DDOG_CHARSLICE_C("waiting");
+  // Reading from a terminal or similar device is not disk I/O
+  if (target[0] == '/' && !STARTS_WITH("/dev/", target)) return DDOG_CHARSLICE_C("disk");
+
+  return DDOG_CHARSLICE_C("");
+}
+
+blocking_state_result blocking_state_for_native_thread(uint64_t tid) {
+  if (syscall_lookup_disabled) return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+
+  char path[64];
+  if (snprintf(path, sizeof(path), "/proc/self/task/%lu/syscall", (unsigned long) tid) >= (int) sizeof(path)) {
+    return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+  }
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    if (is_not_allowed_error(errno)) syscall_lookup_disabled = true;
+    return FINAL_RESULT(DDOG_CHARSLICE_C("")); // Otherwise, the thread may have just finished
+  }
+
+  // Format is "<syscall number> <arg1> ... <arg6> <stack pointer> <program counter>", with args in hex; or "running"
+  // if the thread is on the cpu; or "-1 <stack pointer> <program counter>" if the thread is blocked but not in a syscall
+  char buffer[256];
+  ssize_t bytes_read = read(fd, buffer, sizeof(buffer) - 1);
+  int read_error = errno;
+  close(fd);
+
+  if (bytes_read <= 0) {
+    if (bytes_read == -1 && is_not_allowed_error(read_error)) syscall_lookup_disabled = true;
+    return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+  }
+  buffer[bytes_read] = '\0';
+
+  // The thread released the GVL but has not (yet?) blocked, so looking it up again later may tell us more
+  if (STARTS_WITH("running", buffer)) return NOT_FINAL_RESULT;
+
+  char *end = NULL;
+  long syscall_number = strtol(buffer, &end, 10);
+  if (end == buffer) return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+  if (syscall_number < 0) return NOT_FINAL_RESULT;
+
+  if (is_sleep_syscall(syscall_number)) return FINAL_RESULT(DDOG_CHARSLICE_C("sleeping"));
+
+  if (!is_fd_based_syscall(syscall_number) && !is_poll_syscall(syscall_number)) {
+    // Other syscalls (such as futex) are used for many different kinds of waiting, so we can't tell from the syscall
+    // alone.
+    return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+  }
+
+  char *first_argument = end;
+  unsigned long first_argument_value = strtoul(first_argument, &end, 16);
+  if (end == first_argument) return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+
+  if (is_fd_based_syscall(syscall_number)) return FINAL_RESULT(state_for_fd((long) first_argument_value));
+
+  char *second_argument = end;
+  unsigned long second_argument_value = strtoul(second_argument, &end, 16);
+  if (end == second_argument) return FINAL_RESULT(DDOG_CHARSLICE_C(""));
+
+  return FINAL_RESULT(state_for_fd(fd_for_poll_syscall(first_argument_value, second_argument_value)));
+}
+
+bool blocking_state_lookup_available(void) {
+  return !syscall_lookup_disabled;
+}
+
+#else // !__linux__
+
+blocking_state_result blocking_state_for_native_thread(__attribute__((unused)) uint64_t tid) {
+  return (blocking_state_result) {.state = DDOG_CHARSLICE_C(""), .is_final = true};
+}
+
+bool blocking_state_lookup_available(void) {
+  return false;
+}
+
+#endif
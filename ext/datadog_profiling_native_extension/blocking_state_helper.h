@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <datadog/profiling.h>
+
+// Classifies what a thread that released the GVL is blocked on, based on the system call it's currently in (as reported
+// by `/proc/self/task/<tid>/syscall`) and, for file descriptor-based system calls, on what kind of file descriptor it
+// is (as reported by `/proc/self/fd/<fd>`).
+//
+// Returns one of the "state" label values also used by `Collectors::Stack` ("network", "disk", "sleeping", "waiting"),
+// or an empty slice if the thread is not blocked in a system call, or if the system call is not conclusive by itself
+// (e.g. futex, which is used for both mutexes and sleeping) -- in which case callers should fall back to other
+// heuristics.
+//
+// This is only supported on Linux; elsewhere this always returns an empty slice.
+//
+// If we find out that we're not allowed to do these lookups (e.g. because of a seccomp profile), further lookups get
+// skipped, see `blocking_state_lookup_available`.
+//
+// Safety: This function is assumed never to raise exceptions by callers. It does not allocate.
+typedef struct {
+  ddog_CharSlice state;
+  // Set when looking up the same thread again, while it stays blocked, is not expected to give a different result.
+  // Not set if e.g. the thread had not yet reached the blocking system call.
+  bool is_final;
+} blocking_state_result;
+
+blocking_state_result blocking_state_for_native_thread(uint64_t tid);
+bool blocking_state_lookup_available(void);
@@ -88,6 +88,9 @@ unsigned int MAX_ALLOC_WEIGHT = 10000;
   static rb_postponed_job_handle_t after_gc_from_postponed_job_handle;
   static rb_postponed_job_handle_t after_gvl_running_from_postponed_job_handle;
   static rb_postponed_job_handle_t after_allocation_from_postponed_job_handle;
+  #ifndef NO_RACTOR_SAMPLING
+    static rb_postponed_job_handle_t sample_current_ractor_from_postponed_job_handle;
+  #endif
 #endif
 
 // Contains state for a single CpuAndWallTimeWorker instance
@@ -100,6 +103,7 @@ typedef struct {
   bool allocation_profiling_enabled;
   bool allocation_counting_enabled;
   bool gvl_profiling_enabled;
+  bool ractor_profiling_enabled;
   bool skip_idle_samples_for_testing;
   bool sighandler_sampling_enabled;
   uint32_t cpu_sampling_interval_ms;
@@ -136,6 +140,14 @@ typedef struct {
   rb_internal_thread_event_hook_t *gvl_profiling_hook;
   #endif
 
+  #ifndef NO_RACTOR_SAMPLING
+  // Only set when sampling is active (gets created at start and cleaned on stop)
+  rb_internal_thread_event_hook_t *ractor_profiling_hook;
+  // See "Note on sampling non-main Ractors" below
+  atomic_bool main_ractor_sample_pending;
+  atomic_bool main_ractor_sample_needs_retrigger;
+  #endif
+
   struct stats {
     // # Generic stats
     // How many times we tried to trigger a sample
@@ -154,6 +166,10 @@ typedef struct {
     unsigned int signal_handler_wrong_thread;
     // How many times we actually tried to interrupt a thread for sampling
     unsigned int interrupt_thread_attempts;
+    // How many times we tried to interrupt a thread running on a non-main Ractor for sampling
+    unsigned int interrupt_ractor_thread_attempts;
+    // How many times a sample for the main Ractor got picked up by another Ractor and had to be triggered again
+    unsigned int main_ractor_sample_retriggers;
 
     // # CPU/Walltime sampling stats
     // How many times we actually CPU/wall sampled
@@ -224,6 +240,7 @@ static VALUE _native_reset_after_fork(DDTRACE_UNUSED VALUE self, VALUE instance)
 static VALUE _native_is_sigprof_blocked_in_current_thread(DDTRACE_UNUSED VALUE self);
 static VALUE _native_stats(DDTRACE_UNUSED VALUE self, VALUE instance);
 static VALUE _native_stats_reset_not_thread_safe(DDTRACE_UNUSED VALUE self, VALUE instance);
+static VALUE _native_flush_gc_events(DDTRACE_UNUSED VALUE self, VALUE instance);
 void *simulate_sampling_signal_delivery(DDTRACE_UNUSED void *_unused);
 static void grab_gvl_and_sample(void);
 static void reset_stats_not_thread_safe(cpu_and_wall_time_worker_state *state);
@@ -244,6 +261,7 @@ static VALUE _native_resume_signals(DDTRACE_UNUSED VALUE self);
   static void after_gvl_running_from_postponed_job(DDTRACE_UNUSED void *_unused);
   static VALUE rescued_after_gvl_running_from_postponed_job(VALUE self_instance);
   static VALUE handle_sampling_failure_rescued_after_gvl_running_from_postponed_job(VALUE self_instance, VALUE exception);
+  static long gvl_wait_duration_ns(intptr_t gvl_waiting_at, long resumed_at_ns);
 #endif
 static VALUE _native_gvl_profiling_hook_active(DDTRACE_UNUSED VALUE self, VALUE instance);
 static VALUE handle_sampling_failure_rescued_sample_from_postponed_job(VALUE self_instance, VALUE exception);
@@ -253,6 +271,20 @@ static VALUE handle_sampling_failure_rescued_after_allocation(VALUE self_instanc
 static inline void during_sample_enter(cpu_and_wall_time_worker_state* state);
 static inline void during_sample_exit(cpu_and_wall_time_worker_state* state);
 static void after_allocation_from_postponed_job(DDTRACE_UNUSED void *_unused);
+static void on_fiber_switch_event(
+  DDTRACE_UNUSED rb_event_flag_t _event,
+  DDTRACE_UNUSED VALUE _data,
+  DDTRACE_UNUSED VALUE _self,
+  DDTRACE_UNUSED ID _id,
+  DDTRACE_UNUSED VALUE _klass
+);
+#ifndef NO_RACTOR_SAMPLING
+  static void on_ractor_thread_event(rb_event_flag_t event_id, DDTRACE_UNUSED const rb_internal_thread_event_data_t *event_data, DDTRACE_UNUSED void *_unused);
+  static void ractor_thread_slots_reset(void);
+  static void interrupt_running_ractor_threads(cpu_and_wall_time_worker_state *state);
+  static void sample_current_ractor_from_postponed_job(DDTRACE_UNUSED void *_unused);
+  static VALUE rescued_sample_current_ractor(VALUE thread_context_collector_instance);
+#endif
 
 // We're using `on_newobj_event` function with `rb_add_event_hook2`, which requires in its public signature a function
 // with signature `rb_event_hook_func_t` which doesn't match `on_newobj_event`.
@@ -285,6 +317,41 @@ static VALUE clock_failure_exception_class = Qnil;
   static void *gc_finalize_deferred_workaround;
 #endif
 
+#ifndef NO_RACTOR_SAMPLING
+  // Note on sampling non-main Ractors:
+  //
+  // Every Ractor has its own GVL, so `gvl_owner` (which only looks at the main Ractor) can't tell us which threads to
+  // interrupt. Instead, when Ractor profiling is enabled, `on_ractor_thread_event` keeps track of which threads are
+  // currently holding the GVL of a non-main Ractor, and `run_sampling_trigger_loop` sends each of them a SIGPROF as well.
+  //
+  // Each thread claims a slot when it starts running (RUBY_INTERNAL_THREAD_EVENT_RESUMED) and releases it when it stops
+  // (RUBY_INTERNAL_THREAD_EVENT_SUSPENDED). If there's more Ractors than slots, the extra ones don't get sampled.
+  //
+  // As with `gvl_owner`, reading a slot and then signaling its owner is racy, so the signal may land on a thread that
+  // just released its GVL; the signal handler checks for this.
+  //
+  // The signaled threads then sample themselves from `sample_current_ractor_from_postponed_job`. Note that postponed
+  // jobs are tracked by the VM in a single process-wide bitset, and whichever Ractor flushes it first runs (and clears)
+  // every job that's been triggered so far, including the main Ractor's `sample_from_postponed_job`. To keep the
+  // main Ractor from losing samples because of this:
+  // * Ractor samples use their own postponed job, so they never get confused with a main Ractor sample
+  // * Other Ractors don't trigger their job while a main Ractor sample is pending, which avoids most such races
+  // * If the main Ractor sample still gets run by another Ractor, `run_sampling_trigger_loop` triggers it again. As the
+  //   sampling trigger loop is not a Ruby thread, the VM will then interrupt the main Ractor to run it.
+  #define MAX_SAMPLED_RACTOR_THREADS 16
+
+  #define RACTOR_THREAD_SLOT_FREE 0
+  #define RACTOR_THREAD_SLOT_CLAIMED 1 // Owner is being written
+  #define RACTOR_THREAD_SLOT_RUNNING 2
+
+  typedef struct {
+    atomic_uint status;
+    pthread_t owner;
+  } ractor_thread_slot;
+
+  static ractor_thread_slot ractor_thread_slots[MAX_SAMPLED_RACTOR_THREADS];
+#endif
+
 // Used to implement CpuAndWallTimeWorker._native_allocation_count . To be able to use cheap thread-local variables
 // (here with `__thread`, see https://gcc.gnu.org/onlinedocs/gcc/Thread-Local.html), this needs to be global.
 //
@@ -310,6 +377,15 @@ void collectors_cpu_and_wall_time_worker_init(VALUE profiling_module) {
     ) {
       raise_error(rb_eRuntimeError, "Failed to register profiler postponed jobs (got POSTPONED_JOB_HANDLE_INVALID)");
     }
+
+    #ifndef NO_RACTOR_SAMPLING
+      sample_current_ractor_from_postponed_job_handle =
+        rb_postponed_job_preregister(unused_flags, sample_current_ractor_from_postponed_job, NULL);
+
+      if (sample_current_ractor_from_postponed_job_handle == POSTPONED_JOB_HANDLE_INVALID) {
+        raise_error(rb_eRuntimeError, "Failed to register profiler postponed jobs (got POSTPONED_JOB_HANDLE_INVALID)");
+      }
+    #endif
   #else
     gc_finalize_deferred_workaround = objspace_ptr_for_gc_finalize_deferred_workaround();
   #endif
@@ -337,6 +413,7 @@ void collectors_cpu_and_wall_time_worker_init(VALUE profiling_module) {
   rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_reset_after_fork", _native_reset_after_fork, 1);
   rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_stats", _native_stats, 1);
   rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_stats_reset_not_thread_safe", _native_stats_reset_not_thread_safe, 1);
+  rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_flush_gc_events", _native_flush_gc_events, 1);
   rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_allocation_count", _native_allocation_count, 0);
   rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_is_running?", _native_is_running, 1);
   rb_define_singleton_method(collectors_cpu_and_wall_time_worker_class, "_native_failure_exception_during_operation", _native_failure_exception_during_operation, 1);
@@ -382,6 +459,7 @@ static VALUE _native_new(VALUE klass) {
   state->allocation_profiling_enabled = false;
   state->allocation_counting_enabled = false;
   state->gvl_profiling_enabled = false;
+  state->ractor_profiling_enabled = false;
   state->skip_idle_samples_for_testing = false;
   state->sighandler_sampling_enabled = false;
   state->cpu_sampling_interval_ms = 10;
@@ -402,6 +480,12 @@ static VALUE _native_new(VALUE klass) {
     state->gvl_profiling_hook = NULL;
   #endif
 
+  #ifndef NO_RACTOR_SAMPLING
+    state->ractor_profiling_hook = NULL;
+    atomic_init(&state->main_ractor_sample_pending, false);
+    atomic_init(&state->main_ractor_sample_needs_retrigger, false);
+  #endif
+
   reset_stats_not_thread_safe(state);
   discrete_dynamic_sampler_init(&state->allocation_sampler, "allocation", now);
 
@@ -427,6 +511,7 @@ static VALUE _native_initialize(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _sel
   VALUE allocation_profiling_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("allocation_profiling_enabled")));
   VALUE allocation_counting_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("allocation_counting_enabled")));
   VALUE gvl_profiling_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("gvl_profiling_enabled")));
+  VALUE ractor_profiling_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("ractor_profiling_enabled")));
   VALUE skip_idle_samples_for_testing = rb_hash_fetch(options, ID2SYM(rb_intern("skip_idle_samples_for_testing")));
   VALUE sighandler_sampling_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("sighandler_sampling_enabled")));
   VALUE cpu_sampling_interval_ms = rb_hash_fetch(options, ID2SYM(rb_intern("cpu_sampling_interval_ms")));
@@ -438,6 +523,7 @@ static VALUE _native_initialize(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _sel
   ENFORCE_BOOLEAN(allocation_profiling_enabled);
   ENFORCE_BOOLEAN(allocation_counting_enabled);
   ENFORCE_BOOLEAN(gvl_profiling_enabled);
+  ENFORCE_BOOLEAN(ractor_profiling_enabled);
   ENFORCE_BOOLEAN(skip_idle_samples_for_testing)
   ENFORCE_BOOLEAN(sighandler_sampling_enabled)
   ENFORCE_TYPE(cpu_sampling_interval_ms, T_FIXNUM);
@@ -451,6 +537,7 @@ static VALUE _native_initialize(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _sel
   state->allocation_profiling_enabled = (allocation_profiling_enabled == Qtrue);
   state->allocation_counting_enabled = (allocation_counting_enabled == Qtrue);
   state->gvl_profiling_enabled = (gvl_profiling_enabled == Qtrue);
+  state->ractor_profiling_enabled = (ractor_profiling_enabled == Qtrue);
   state->skip_idle_samples_for_testing = (skip_idle_samples_for_testing == Qtrue);
   state->sighandler_sampling_enabled = (sighandler_sampling_enabled == Qtrue);
   state->cpu_sampling_interval_ms = NUM2INT(cpu_sampling_interval_ms);
@@ -526,6 +613,12 @@ static VALUE _native_sampling_loop(DDTRACE_UNUSED VALUE _self, VALUE instance) {
   active_sampler_instance = instance;
   state->owner_thread = rb_thread_current();
 
+  #ifndef NO_RACTOR_SAMPLING
+    // Any leftovers from a previous run are no longer relevant
+    atomic_store(&state->main_ractor_sample_pending, false);
+    atomic_store(&state->main_ractor_sample_needs_retrigger, false);
+  #endif
+
   atomic_store(&state->should_run, true);
 
   block_sigprof_signal_handler_from_running_in_current_thread(); // We want to interrupt the thread with the global VM lock, never this one
@@ -612,13 +705,26 @@ static void handle_sampling_signal(DDTRACE_UNUSED int _signal, DDTRACE_UNUSED si
 
   if (
     !ruby_native_thread_p() || // Not a Ruby thread
-    !is_current_thread_holding_the_gvl() || // Not safe to enqueue a sample from this thread
-    !ddtrace_rb_ractor_main_p() // We're not on the main Ractor; we currently don't support profiling non-main Ractors
+    !is_current_thread_holding_the_gvl() // Not safe to enqueue a sample from this thread
   ) {
     state->stats.signal_handler_wrong_thread++;
     return;
   }
 
+  if (!ddtrace_rb_ractor_main_p()) {
+    #ifndef NO_RACTOR_SAMPLING // Ruby 3.3+
+      // We're on a non-main Ractor, and thus running concurrently with the main Ractor; we must not touch the
+      // sampler state (including the stats) from here. See "Note on sampling non-main Ractors" above.
+      //
+      // Note that postponed jobs are process-wide, so if several Ractors get signaled at the same time, only one of
+      // them may end up running the postponed job. This is fine -- it just means we get fewer samples.
+      if (state->ractor_profiling_enabled && !atomic_load(&state->main_ractor_sample_pending)) {
+        rb_postponed_job_trigger(sample_current_ractor_from_postponed_job_handle);
+      }
+    #endif
+    return;
+  }
+
   // We assume there can be no concurrent nor nested calls to handle_sampling_signal because
   // a) we get triggered using SIGPROF, and the docs state a second SIGPROF will not interrupt an existing one (see sigaction docs on sa_mask)
   // b) we validate we are in the thread that has the global VM lock; if a different thread gets a signal, it will return early
@@ -640,6 +746,9 @@ static void handle_sampling_signal(DDTRACE_UNUSED int _signal, DDTRACE_UNUSED si
   }
 
   #ifndef NO_POSTPONED_TRIGGER // Ruby 3.3+
+    #ifndef NO_RACTOR_SAMPLING
+      atomic_store(&state->main_ractor_sample_pending, true);
+    #endif
     rb_postponed_job_trigger(sample_from_postponed_job_handle);
   #else
     // Passing in `gc_finalize_deferred_workaround` is a workaround for https://bugs.ruby-lang.org/issues/19991 (for Ruby < 3.3)
@@ -719,6 +828,16 @@ static void *run_sampling_trigger_loop(void *state_ptr) {
       }
     }
 
+    #ifndef NO_RACTOR_SAMPLING
+      // See "Note on sampling non-main Ractors" above
+      if (atomic_exchange(&state->main_ractor_sample_needs_retrigger, false)) {
+        state->stats.main_ractor_sample_retriggers++;
+        rb_postponed_job_trigger(sample_from_postponed_job_handle);
+      }
+
+      if (state->ractor_profiling_enabled && !state->no_signals_workaround_enabled) interrupt_running_ractor_threads(state);
+    #endif
+
     sleep_for(minimum_time_between_signals);
 
     // The dynamic sampling rate module keeps track of how long samples are taking, and in here we extend our sleep time
@@ -751,12 +870,19 @@ static void sample_from_postponed_job(DDTRACE_UNUSED void *_unused) {
   // This can potentially happen if the CpuAndWallTimeWorker was stopped while the postponed job was waiting to be executed; nothing to do
   if (state == NULL) return;
 
-  // @ivoanjo: I'm not sure this can ever happen because `handle_sampling_signal` only enqueues this callback if
-  // it's running on the main Ractor, but just in case...
   if (!ddtrace_rb_ractor_main_p()) {
-    return; // We're not on the main Ractor; we currently don't support profiling non-main Ractors
+    #ifndef NO_RACTOR_SAMPLING
+      // Another Ractor flushed the postponed jobs before the main Ractor did, and thus the sample for the main Ractor
+      // would be lost. See "Note on sampling non-main Ractors" above.
+      if (atomic_load(&state->main_ractor_sample_pending)) atomic_store(&state->main_ractor_sample_needs_retrigger, true);
+    #endif
+    return;
   }
 
+  #ifndef NO_RACTOR_SAMPLING
+    atomic_store(&state->main_ractor_sample_pending, false);
+  #endif
+
   during_sample_enter(state);
 
   // Rescue against any exceptions that happen during sampling
@@ -850,7 +976,8 @@ static VALUE release_gvl_and_run_sampling_trigger_loop(VALUE instance) {
           // For now we're only asking for these events, even though there's more
           // (e.g. check docs or gvl-tracing gem)
           RUBY_INTERNAL_THREAD_EVENT_READY /* waiting for gvl */ |
-          RUBY_INTERNAL_THREAD_EVENT_RESUMED /* running/runnable */
+          RUBY_INTERNAL_THREAD_EVENT_RESUMED /* running/runnable */ |
+          RUBY_INTERNAL_THREAD_EVENT_SUSPENDED /* about to release the gvl, used to track how long threads hold it */
         ),
         NULL
       );
@@ -859,6 +986,25 @@ static VALUE release_gvl_and_run_sampling_trigger_loop(VALUE instance) {
     #endif
   }
 
+  if (thread_context_collector_fiber_profiling_enabled(state->thread_context_collector_instance)) {
+    rb_add_event_hook2(on_fiber_switch_event, RUBY_EVENT_FIBER_SWITCH, state->self_instance, RUBY_EVENT_HOOK_FLAG_SAFE);
+  }
+
+  if (state->ractor_profiling_enabled) {
+    #ifndef NO_RACTOR_SAMPLING
+      // Discard any leftovers from a previous run (or from the parent process, if we forked)
+      ractor_thread_slots_reset();
+
+      state->ractor_profiling_hook = rb_internal_thread_add_event_hook(
+        on_ractor_thread_event,
+        RUBY_INTERNAL_THREAD_EVENT_RESUMED | RUBY_INTERNAL_THREAD_EVENT_SUSPENDED | RUBY_INTERNAL_THREAD_EVENT_EXITED,
+        NULL
+      );
+    #else
+      raise_error(rb_eArgError, "Ractor profiling is not supported in this Ruby version");
+    #endif
+  }
+
   // Flag the profiler as running before we release the GVL, in case anyone's waiting to know about it
   rb_funcall(instance, rb_intern("signal_running"), 0);
 
@@ -954,7 +1100,8 @@ static void on_gc_event(VALUE tracepoint_data, DDTRACE_UNUSED void *unused) {
     bool should_flush = thread_context_collector_on_gc_finish(state->thread_context_collector_instance);
 
     // We use rb_postponed_job_register_one to ask Ruby to run thread_context_collector_sample_after_gc when the
-    // thread collector flags it's time to flush.
+    // thread collector flags it's time to flush. Otherwise, GC events stay batched inside the thread collector until
+    // the next flush (at the latest, right before the profile gets serialized; see _native_flush_gc_events).
     if (should_flush) {
       #ifndef NO_POSTPONED_TRIGGER // Ruby 3.3+
         rb_postponed_job_trigger(after_gc_from_postponed_job_handle);
@@ -1018,6 +1165,14 @@ static VALUE _native_simulate_handle_sampling_signal(DDTRACE_UNUSED VALUE self)
 // This method exists only to enable testing Datadog::Profiling::Collectors::CpuAndWallTimeWorker behavior using RSpec.
 // It SHOULD NOT be used for other purposes.
 static VALUE _native_simulate_sample_from_postponed_job(DDTRACE_UNUSED VALUE self) {
+  #ifndef NO_RACTOR_SAMPLING
+    // Non-main Ractors use their own postponed job, see "Note on sampling non-main Ractors" above
+    if (!ddtrace_rb_ractor_main_p()) {
+      sample_current_ractor_from_postponed_job(NULL);
+      return Qtrue;
+    }
+  #endif
+
   sample_from_postponed_job(NULL);
   return Qtrue;
 }
@@ -1073,6 +1228,8 @@ static VALUE _native_stats(DDTRACE_UNUSED VALUE self, VALUE instance) {
     ID2SYM(rb_intern("signal_handler_prepared_sample")),             /* => */ UINT2NUM(state->stats.signal_handler_prepared_sample),
     ID2SYM(rb_intern("signal_handler_wrong_thread")),                /* => */ UINT2NUM(state->stats.signal_handler_wrong_thread),
     ID2SYM(rb_intern("interrupt_thread_attempts")),                  /* => */ UINT2NUM(state->stats.interrupt_thread_attempts),
+    ID2SYM(rb_intern("interrupt_ractor_thread_attempts")),           /* => */ UINT2NUM(state->stats.interrupt_ractor_thread_attempts),
+    ID2SYM(rb_intern("main_ractor_sample_retriggers")),              /* => */ UINT2NUM(state->stats.main_ractor_sample_retriggers),
 
     // CPU Stats
     ID2SYM(rb_intern("cpu_sampled")),                /* => */ UINT2NUM(state->stats.cpu_sampled),
@@ -1113,6 +1270,28 @@ static VALUE _native_stats_reset_not_thread_safe(DDTRACE_UNUSED VALUE self, VALU
   return Qnil;
 }
 
+// Flushes any GC events that the thread collector is still holding on to; called right before the profile gets
+// serialized, so that the serialized profile includes all GCs that happened until then.
+static VALUE _native_flush_gc_events(DDTRACE_UNUSED VALUE self, VALUE instance) {
+  cpu_and_wall_time_worker_state *state;
+  TypedData_Get_Struct(instance, cpu_and_wall_time_worker_state, &cpu_and_wall_time_worker_typed_data, state);
+
+  if (!state->gc_profiling_enabled) return Qfalse;
+
+  during_sample_enter(state);
+
+  safely_call(
+    thread_context_collector_sample_after_gc,
+    state->thread_context_collector_instance,
+    state->self_instance,
+    handle_sampling_failure_thread_context_collector_sample_after_gc
+  );
+
+  during_sample_exit(state);
+
+  return Qtrue;
+}
+
 void *simulate_sampling_signal_delivery(DDTRACE_UNUSED void *_unused) {
   cpu_and_wall_time_worker_state *state = active_sampler_instance_state; // Read from global variable, see "sampler global state safety" note above
 
@@ -1289,6 +1468,7 @@ static void disable_tracepoints(cpu_and_wall_time_worker_state *state) {
   }
 
   rb_remove_event_hook_with_data(on_newobj_event_as_hook, state->self_instance);
+  rb_remove_event_hook_with_data(on_fiber_switch_event, state->self_instance);
 
   #ifndef NO_GVL_INSTRUMENTATION
     if (state->gvl_profiling_hook) {
@@ -1296,8 +1476,110 @@ static void disable_tracepoints(cpu_and_wall_time_worker_state *state) {
       state->gvl_profiling_hook = NULL;
     }
   #endif
+
+  #ifndef NO_RACTOR_SAMPLING
+    if (state->ractor_profiling_hook) {
+      rb_internal_thread_remove_event_hook(state->ractor_profiling_hook);
+      state->ractor_profiling_hook = NULL;
+    }
+  #endif
 }
 
+// Called by Ruby on every fiber switch, from the fiber that is starting to run, when fiber profiling is enabled.
+// See `thread_context_collector_on_fiber_switch` for details.
+static void on_fiber_switch_event(
+  DDTRACE_UNUSED rb_event_flag_t _event,
+  DDTRACE_UNUSED VALUE _data,
+  DDTRACE_UNUSED VALUE _self,
+  DDTRACE_UNUSED ID _id,
+  DDTRACE_UNUSED VALUE _klass
+) {
+  cpu_and_wall_time_worker_state *state = active_sampler_instance_state; // Read from global variable, see "sampler global state safety" note above
+
+  // This should not happen in a normal situation because the hook is always enabled after the instance is set
+  // and disabled before it is cleared, but just in case...
+  if (state == NULL) return;
+
+  // The thread context collector is not safe to use from other Ractors
+  if (!ddtrace_rb_ractor_main_p()) return;
+
+  thread_context_collector_on_fiber_switch(state->thread_context_collector_instance);
+}
+
+#ifndef NO_RACTOR_SAMPLING
+  // Called by Ruby whenever a thread acquires/releases its Ractor's GVL, when Ractor profiling is enabled.
+  // See "Note on sampling non-main Ractors" above.
+  //
+  // NOTE: This is called from any Ractor, concurrently. It MUST NOT touch the sampler state.
+  static void on_ractor_thread_event(rb_event_flag_t event_id, DDTRACE_UNUSED const rb_internal_thread_event_data_t *event_data, DDTRACE_UNUSED void *_unused) {
+    // Threads on the main Ractor get sampled via `gvl_owner` instead
+    if (ddtrace_rb_ractor_main_p()) return;
+
+    pthread_t current_thread = pthread_self();
+
+    if (event_id == RUBY_INTERNAL_THREAD_EVENT_RESUMED) {
+      for (int i = 0; i < MAX_SAMPLED_RACTOR_THREADS; i++) {
+        unsigned int expected = RACTOR_THREAD_SLOT_FREE;
+        if (atomic_compare_exchange_strong(&ractor_thread_slots[i].status, &expected, RACTOR_THREAD_SLOT_CLAIMED)) {
+          ractor_thread_slots[i].owner = current_thread;
+          atomic_store(&ractor_thread_slots[i].status, RACTOR_THREAD_SLOT_RUNNING);
+          return;
+        }
+      }
+    } else { // RUBY_INTERNAL_THREAD_EVENT_SUSPENDED or RUBY_INTERNAL_THREAD_EVENT_EXITED
+      for (int i = 0; i < MAX_SAMPLED_RACTOR_THREADS; i++) {
+        if (
+          atomic_load(&ractor_thread_slots[i].status) == RACTOR_THREAD_SLOT_RUNNING &&
+          pthread_equal(ractor_thread_slots[i].owner, current_thread)
+        ) {
+          atomic_store(&ractor_thread_slots[i].status, RACTOR_THREAD_SLOT_FREE);
+          return;
+        }
+      }
+    }
+  }
+
+  static void ractor_thread_slots_reset(void) {
+    for (int i = 0; i < MAX_SAMPLED_RACTOR_THREADS; i++) atomic_store(&ractor_thread_slots[i].status, RACTOR_THREAD_SLOT_FREE);
+  }
+
+  // The actual sampling happens in `sample_from_postponed_job`, on each of the interrupted threads
+  static void interrupt_running_ractor_threads(cpu_and_wall_time_worker_state *state) {
+    for (int i = 0; i < MAX_SAMPLED_RACTOR_THREADS; i++) {
+      if (atomic_load(&ractor_thread_slots[i].status) != RACTOR_THREAD_SLOT_RUNNING) continue;
+
+      // Pick up any last-minute attempts to stop before we send the signal
+      if (!atomic_load(&state->should_run)) return;
+
+      state->stats.interrupt_ractor_thread_attempts++;
+      pthread_kill(ractor_thread_slots[i].owner, SIGPROF);
+    }
+  }
+
+  static void sample_current_ractor_from_postponed_job(DDTRACE_UNUSED void *_unused) {
+    cpu_and_wall_time_worker_state *state = active_sampler_instance_state; // Read from global variable, see "sampler global state safety" note above
+
+    // If the main Ractor flushed this job, the sample for the Ractor that triggered it is lost, which is fine: it just
+    // means we get fewer samples for it. (The main Ractor gets sampled by `sample_from_postponed_job`.)
+    if (state == NULL || !state->ractor_profiling_enabled || ddtrace_rb_ractor_main_p()) return;
+
+    // Because we're running concurrently with the main Ractor, we can't use `during_sample` nor `safely_call` (which
+    // would stop the profiler from this Ractor on failure) here. Failing to sample a non-main Ractor is not a big
+    // deal, so we just ignore any exceptions.
+    int exception_state;
+    rb_protect(rescued_sample_current_ractor, state->thread_context_collector_instance, &exception_state);
+    if (exception_state) rb_set_errinfo(Qnil);
+  }
+
+  static VALUE rescued_sample_current_ractor(VALUE thread_context_collector_instance) {
+    long now = monotonic_wall_time_now_ns(RAISE_ON_FAILURE);
+    thread_context_collector_sample_current_ractor(thread_context_collector_instance, now);
+
+    // Return a dummy VALUE because we're called from rb_protect which requires it
+    return Qnil;
+  }
+#endif
+
 static VALUE _native_with_blocked_sigprof(DDTRACE_UNUSED VALUE self) {
   block_sigprof_signal_handler_from_running_in_current_thread();
   int exception_state;
@@ -1407,21 +1689,47 @@ static VALUE _native_resume_signals(DDTRACE_UNUSED VALUE self) {
         target_thread = gvl_profiling_state_maybe_initialize();
       #endif
 
+      // Read before `thread_context_collector_on_gvl_running` updates it, so we can record how long the wait took
+      intptr_t gvl_waiting_at = gvl_profiling_state_get(target_thread);
+
       on_gvl_running_result result = thread_context_collector_on_gvl_running(target_thread);
 
+      if (result == ON_GVL_RUNNING_UNKNOWN) return;
+
+      cpu_and_wall_time_worker_state *state = active_sampler_instance_state; // Read from global variable, see "sampler global state safety" note above
+
+      if (state == NULL) return; // This should not happen, but just in case...
+
+      long resumed_at_ns = monotonic_wall_time_now_ns(DO_NOT_RAISE_ON_FAILURE);
+      long waiting_for_gvl_duration_ns = gvl_wait_duration_ns(gvl_waiting_at, resumed_at_ns);
+      VALUE thread = thread_object_from_thread(target_thread);
+
+      thread_context_collector_on_gvl_acquired(state->thread_context_collector_instance, thread, waiting_for_gvl_duration_ns, resumed_at_ns);
+
       if (result == ON_GVL_RUNNING_SAMPLE) {
         #ifndef NO_POSTPONED_TRIGGER
           rb_postponed_job_trigger(after_gvl_running_from_postponed_job_handle);
         #else
           rb_postponed_job_register_one(0, after_gvl_running_from_postponed_job, NULL);
         #endif
-      } else if (result == ON_GVL_RUNNING_DONT_SAMPLE) {
-        cpu_and_wall_time_worker_state *state = active_sampler_instance_state; // Read from global variable, see "sampler global state safety" note above
-
-        if (state == NULL) return; // This should not happen, but just in case...
-
+      } else {
         state->stats.gvl_dont_sample++;
       }
+    } else if (event_id == RUBY_INTERNAL_THREAD_EVENT_SUSPENDED) { /* about to release the gvl */
+      // This event gets called on the thread that is releasing the GVL, while it still holds it.
+      // As with RESUMED, we only touch threads that the thread context collector is tracking, which means they belong to
+      // the main Ractor.
+      if (gvl_profiling_state_get(target_thread) == 0) return;
+
+      cpu_and_wall_time_worker_state *state = active_sampler_instance_state; // Read from global variable, see "sampler global state safety" note above
+
+      if (state == NULL) return; // This should not happen, but just in case...
+
+      thread_context_collector_on_gvl_released(
+        state->thread_context_collector_instance,
+        thread_object_from_thread(target_thread),
+        monotonic_wall_time_now_ns(DO_NOT_RAISE_ON_FAILURE)
+      );
     } else {
       // This is a very delicate time and it's hard for us to raise an exception so let's at least complain to stderr
       fprintf(stderr, "[ddtrace] Unexpected value in on_gvl_event (%d)\n", event_id);
@@ -1469,6 +1777,14 @@ static VALUE _native_resume_signals(DDTRACE_UNUSED VALUE self) {
     return Qnil;
   }
 
+  // Returns INVALID_TIME if the duration is not known
+  static long gvl_wait_duration_ns(intptr_t gvl_waiting_at, long resumed_at_ns) {
+    // A negative value means we already recorded the end of this wait; other values mean the thread was not waiting
+    if (gvl_waiting_at <= 0 || gvl_waiting_at == GVL_WAITING_ENABLED_EMPTY || resumed_at_ns < gvl_waiting_at) return INVALID_TIME;
+
+    return resumed_at_ns - gvl_waiting_at;
+  }
+
   static VALUE _native_gvl_profiling_hook_active(DDTRACE_UNUSED VALUE self, VALUE instance) {
     cpu_and_wall_time_worker_state *state;
     TypedData_Get_Struct(instance, cpu_and_wall_time_worker_state, &cpu_and_wall_time_worker_typed_data, state);
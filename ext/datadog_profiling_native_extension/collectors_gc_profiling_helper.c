@@ -26,6 +26,8 @@ static VALUE oldgen_sym;
 static VALUE shady_sym;
 static VALUE force_sym;
 static VALUE oldmalloc_sym;
+static VALUE heap_live_slots_sym;
+static VALUE heap_free_slots_sym;
 
 static ddog_CharSlice major_gc_reason_pretty(VALUE major_gc_reason);
 static ddog_CharSlice gc_cause_pretty(VALUE gc_cause);
@@ -35,6 +37,7 @@ void gc_profiling_init(void) {
   // This function lazy-interns a few constants, which may trigger allocations. Since we want to call it during GC as
   // well, when allocations are not allowed, we call it once here so that the constants get defined ahead of time.
   rb_gc_latest_gc_info(rb_hash_new());
+  rb_gc_stat(rb_hash_new());
 
   // Used to query and look up the results of GC information
   state_sym     = ID2SYM(rb_intern_const("state"));
@@ -55,13 +58,25 @@ void gc_profiling_init(void) {
   oldmalloc_sym = ID2SYM(rb_intern_const("oldmalloc"));
   state_sym     = ID2SYM(rb_intern_const("state"));
   none_sym      = ID2SYM(rb_intern_const("none"));
+  heap_live_slots_sym = ID2SYM(rb_intern_const("heap_live_slots"));
+  heap_free_slots_sym = ID2SYM(rb_intern_const("heap_free_slots"));
 }
 
 bool gc_profiling_has_major_gc_finished(void) {
   return rb_gc_latest_gc_info(state_sym) == none_sym && rb_gc_latest_gc_info(major_by_sym) != Qnil;
 }
 
-uint8_t gc_profiling_set_metadata(ddog_prof_Label *labels, int labels_length) {
+gc_profiling_info gc_profiling_latest_info(void) {
+  return (gc_profiling_info) {
+    .major_by = rb_gc_latest_gc_info(major_by_sym),
+    .gc_by = rb_gc_latest_gc_info(gc_by_sym),
+    .state = rb_gc_latest_gc_info(state_sym),
+    .heap_live_slots = rb_gc_stat(heap_live_slots_sym),
+    .heap_free_slots = rb_gc_stat(heap_free_slots_sym),
+  };
+}
+
+uint8_t gc_profiling_set_metadata(ddog_prof_Label *labels, int labels_length, const gc_profiling_info *info, bool include_heap_stats) {
   uint8_t max_label_count =
     1 + // thread id
     1 + // thread name
@@ -69,7 +84,8 @@ uint8_t gc_profiling_set_metadata(ddog_prof_Label *labels, int labels_length) {
     1 + // event
     1 + // gc reason
     1 + // gc cause
-    1;  // gc type
+    1 + // gc type
+    2;  // heap live slots + heap free slots (optional)
 
   if (max_label_count > labels_length) {
     raise_error(rb_eArgError, "BUG: gc_profiling_set_metadata invalid labels_length (%d) < max_label_count (%d)", labels_length, max_label_count);
@@ -101,24 +117,35 @@ uint8_t gc_profiling_set_metadata(ddog_prof_Label *labels, int labels_length) {
     .num = 0, // Workaround, same as above
   };
 
-  VALUE major_by = rb_gc_latest_gc_info(major_by_sym);
-  if (major_by != Qnil) {
+  if (info->major_by != Qnil) {
     labels[label_pos++] = (ddog_prof_Label) {
       .key = DDOG_CHARSLICE_C("gc reason"),
-      .str = major_gc_reason_pretty(major_by),
+      .str = major_gc_reason_pretty(info->major_by),
     };
   }
 
   labels[label_pos++] = (ddog_prof_Label) {
     .key = DDOG_CHARSLICE_C("gc cause"),
-    .str = gc_cause_pretty(rb_gc_latest_gc_info(gc_by_sym)),
+    .str = gc_cause_pretty(info->gc_by),
   };
 
   labels[label_pos++] = (ddog_prof_Label) {
     .key = DDOG_CHARSLICE_C("gc type"),
-    .str = gc_type_pretty(major_by, rb_gc_latest_gc_info(state_sym)),
+    .str = gc_type_pretty(info->major_by, info->state),
   };
 
+  if (include_heap_stats) {
+    labels[label_pos++] = (ddog_prof_Label) {
+      .key = DDOG_CHARSLICE_C("gc heap live slots"),
+      .num = (int64_t) info->heap_live_slots,
+    };
+
+    labels[label_pos++] = (ddog_prof_Label) {
+      .key = DDOG_CHARSLICE_C("gc heap free slots"),
+      .num = (int64_t) info->heap_free_slots,
+    };
+  }
+
   if (label_pos > max_label_count) {
     raise_error(rb_eRuntimeError, "BUG: gc_profiling_set_metadata unexpected label_pos (%d) > max_label_count (%d)", label_pos, max_label_count);
   }
@@ -1,5 +1,17 @@
 #pragma once
 
+// Snapshot of the `rb_gc_latest_gc_info` data (and a few heap stats) we use to describe a GC event.
+// All VALUEs here are interned symbols (or nil), so they don't need to be marked.
+typedef struct {
+  VALUE major_by;
+  VALUE gc_by;
+  VALUE state;
+  size_t heap_live_slots;
+  size_t heap_free_slots;
+} gc_profiling_info;
+
 void gc_profiling_init(void);
 bool gc_profiling_has_major_gc_finished(void);
-uint8_t gc_profiling_set_metadata(ddog_prof_Label *labels, int labels_length);
+// Safe to call during GC: does not allocate
+gc_profiling_info gc_profiling_latest_info(void);
+uint8_t gc_profiling_set_metadata(ddog_prof_Label *labels, int labels_length, const gc_profiling_info *info, bool include_heap_stats);
@@ -43,6 +43,7 @@ static const char *get_or_compute_native_filename(void *function, st_table *nati
 static void add_truncated_frames_placeholder(sampling_buffer* buffer);
 static void record_placeholder_stack_in_native_code(VALUE recorder_instance, sample_values values, sample_labels labels);
 static void maybe_trim_template_random_ids(ddog_CharSlice *name_slice, ddog_CharSlice *filename_slice);
+static ddog_CharSlice state_for_native_top_frame(ddog_CharSlice name_slice);
 
 // These two functions are exposed as symbols by the VM but are not in any header.
 // Their signatures actually take a `const rb_iseq_t *iseq` but it gets casted back and forth between VALUE.
@@ -124,6 +125,8 @@ static VALUE _native_sample(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _self) {
   VALUE in_gc = rb_hash_lookup2(options, ID2SYM(rb_intern("in_gc")), Qfalse);
   VALUE is_gvl_waiting_state = rb_hash_lookup2(options, ID2SYM(rb_intern("is_gvl_waiting_state")), Qfalse);
   VALUE native_filenames_enabled = rb_hash_lookup2(options, ID2SYM(rb_intern("native_filenames_enabled")), Qfalse);
+  VALUE endpoint_local_root_span_id = rb_hash_lookup2(options, ID2SYM(rb_intern("endpoint_local_root_span_id")), INT2NUM(0));
+  VALUE endpoint = rb_hash_lookup2(options, ID2SYM(rb_intern("endpoint")), rb_str_new_cstr(""));
 
   ENFORCE_TYPE(metric_values_hash, T_HASH);
   ENFORCE_TYPE(labels_array, T_ARRAY);
@@ -132,6 +135,8 @@ static VALUE _native_sample(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _self) {
   ENFORCE_BOOLEAN(in_gc);
   ENFORCE_BOOLEAN(is_gvl_waiting_state);
   ENFORCE_BOOLEAN(native_filenames_enabled);
+  ENFORCE_TYPE(endpoint_local_root_span_id, T_FIXNUM);
+  ENFORCE_TYPE(endpoint, T_STRING);
 
   VALUE zero = INT2NUM(0);
   VALUE heap_sample = rb_hash_lookup2(metric_values_hash, rb_str_new_cstr("heap_sample"), Qfalse);
@@ -183,7 +188,13 @@ static VALUE _native_sample(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _self) {
     .in_gc = in_gc,
     .recorder_instance = recorder_instance,
     .values = values,
-    .labels = (sample_labels) {.labels = slice_labels, .state_label = state_label, .is_gvl_waiting_state = is_gvl_waiting_state == Qtrue},
+    .labels = (sample_labels) {
+      .labels = slice_labels,
+      .state_label = state_label,
+      .is_gvl_waiting_state = is_gvl_waiting_state == Qtrue,
+      .endpoint_local_root_span_id = NUM2ULL(endpoint_local_root_span_id),
+      .endpoint = char_slice_from_ruby_string(endpoint),
+    },
     .thread = thread,
     .locations = locations,
     .buffer = &buffer,
@@ -256,7 +267,8 @@ void sample_thread(
   int captured_frames = buffer->pending_sample_result;
 
   if (captured_frames == PLACEHOLDER_STACK_IN_NATIVE_CODE) {
-    record_placeholder_stack_in_native_code(recorder_instance, values, labels);
+    // Samples from other Ractors are always for the thread that's running, so we don't expect to get here for them
+    if (!buffer->enqueue_samples) record_placeholder_stack_in_native_code(recorder_instance, values, labels);
     return;
   }
 
@@ -334,39 +346,25 @@ void sample_thread(
       if (labels.is_gvl_waiting_state) {
         state_label->str = DDOG_CHARSLICE_C("waiting for gvl");
 
+      // Or did the caller already figure out what the thread was blocked on (see `blocking_state_helper.c`)?
+      } else if (labels.is_blocking_state_known) {
+        // Nothing to do, state_label was already set by the caller
+
       // Otherwise, we try to categorize what the thread was doing based on what we observe at the top of the stack. This is a very rough
-      // approximation, and in the future we hope to replace this with a more accurate approach (such as using the
-      // GVL instrumentation API.)
+      // approximation, used when the more precise approaches above are not available or not conclusive.
       } else if (!buffer->stack_buffer[i].is_ruby_frame) {
-        // We know that known versions of Ruby implement these using native code; thus if we find a method with the
-        // same name that is not native code, we ignore it, as it's probably a user method that coincidentally
-        // has the same name. Thus, even though "matching just by method name" is kinda weak,
-        // "matching by method name" + is native code seems actually to be good enough for a lot of cases.
-
-        if (CHARSLICE_EQUALS("sleep", name_slice)) { // Expected to be Kernel.sleep
-          state_label->str  = DDOG_CHARSLICE_C("sleeping");
-        } else if (CHARSLICE_EQUALS("select", name_slice)) { // Expected to be Kernel.select
-          state_label->str  = DDOG_CHARSLICE_C("waiting");
-        } else if (
-            CHARSLICE_EQUALS("synchronize", name_slice) || // Expected to be Monitor/Mutex#synchronize on Ruby 2 & 3, and Monitor#synchronize on 4 (Mutex becomes <internal:thread_sync>)
-            #ifdef NO_PRIMITIVE_MUTEX_AND_CONDITION_VARIABLE // Ruby < 4
-              CHARSLICE_EQUALS("lock", name_slice) ||        // Expected to be Mutex#lock
-            #endif
-            CHARSLICE_EQUALS("join", name_slice)           // Expected to be Thread#join
-        ) {
-          state_label->str  = DDOG_CHARSLICE_C("blocked");
-        } else if (CHARSLICE_EQUALS("wait_readable", name_slice)) { // Expected to be IO#wait_readable
-          state_label->str  = DDOG_CHARSLICE_C("network");
-        } else if (CHARSLICE_EQUALS("_native_idle_sampling_loop", name_slice)) { // Expected to be Datadog::Profiler::Collectors::IdleSamplingHelper#_native_idle_sampling_loop
-          state_label->str  = DDOG_CHARSLICE_C("waiting");
-        } else if (CHARSLICE_EQUALS("_native_sampling_loop", name_slice)) { // Expected to be Datadog::Profiler::Collectors::CpuAndWallTimeWorker#_native_sampling_loop
-          state_label->str  = DDOG_CHARSLICE_C("sleeping");
+        void *function = buffer->stack_buffer[i].as.native_frame.function;
+        ID method_id = buffer->stack_buffer[i].as.native_frame.method_id;
+
+        // Native functions don't get unloaded, so the cache can be keyed on the function + method name (since aliases
+        // share the same function) without needing to be invalidated
+        if (function == NULL || function != buffer->top_native_function || method_id != buffer->top_native_method_id) {
+          buffer->top_native_function = function;
+          buffer->top_native_method_id = method_id;
+          buffer->top_native_function_state = state_for_native_top_frame(name_slice);
         }
-        #ifdef NO_PRIMITIVE_POP // Ruby < 3.2
-          else if (CHARSLICE_EQUALS("pop", name_slice)) { // Expected to be Queue/SizedQueue#pop
-            state_label->str  = DDOG_CHARSLICE_C("waiting");
-          }
-        #endif
+
+        if (buffer->top_native_function_state.len > 0) state_label->str = buffer->top_native_function_state;
       } else {
         #ifndef NO_PRIMITIVE_POP // Ruby >= 3.2
           if (CHARSLICE_EQUALS("<internal:thread_sync>", filename_slice)) {
@@ -402,7 +400,7 @@ void sample_thread(
     add_truncated_frames_placeholder(buffer);
   }
 
-  record_sample(
+  (buffer->enqueue_samples ? enqueue_sample : record_sample)(
     recorder_instance,
     (ddog_prof_Slice_Location) {.ptr = buffer->locations, .len = captured_frames},
     values,
@@ -538,6 +536,41 @@ static void maybe_trim_template_random_ids(ddog_CharSlice *name_slice, ddog_Char
   name_slice->len = pos;
 }
 
+// Returns an empty slice if the method is not one we know about
+static ddog_CharSlice state_for_native_top_frame(ddog_CharSlice name_slice) {
+  // We know that known versions of Ruby implement these using native code; thus if we find a method with the
+  // same name that is not native code, we ignore it, as it's probably a user method that coincidentally
+  // has the same name. Thus, even though "matching just by method name" is kinda weak,
+  // "matching by method name" + is native code seems actually to be good enough for a lot of cases.
+
+  if (CHARSLICE_EQUALS("sleep", name_slice)) { // Expected to be Kernel.sleep
+    return DDOG_CHARSLICE_C("sleeping");
+  } else if (CHARSLICE_EQUALS("select", name_slice)) { // Expected to be Kernel.select
+    return DDOG_CHARSLICE_C("waiting");
+  } else if (
+      CHARSLICE_EQUALS("synchronize", name_slice) || // Expected to be Monitor/Mutex#synchronize on Ruby 2 & 3, and Monitor#synchronize on 4 (Mutex becomes <internal:thread_sync>)
+      #ifdef NO_PRIMITIVE_MUTEX_AND_CONDITION_VARIABLE // Ruby < 4
+        CHARSLICE_EQUALS("lock", name_slice) ||        // Expected to be Mutex#lock
+      #endif
+      CHARSLICE_EQUALS("join", name_slice)           // Expected to be Thread#join
+  ) {
+    return DDOG_CHARSLICE_C("blocked");
+  } else if (CHARSLICE_EQUALS("wait_readable", name_slice)) { // Expected to be IO#wait_readable
+    return DDOG_CHARSLICE_C("network");
+  } else if (CHARSLICE_EQUALS("_native_idle_sampling_loop", name_slice)) { // Expected to be Datadog::Profiler::Collectors::IdleSamplingHelper#_native_idle_sampling_loop
+    return DDOG_CHARSLICE_C("waiting");
+  } else if (CHARSLICE_EQUALS("_native_sampling_loop", name_slice)) { // Expected to be Datadog::Profiler::Collectors::CpuAndWallTimeWorker#_native_sampling_loop
+    return DDOG_CHARSLICE_C("sleeping");
+  }
+  #ifdef NO_PRIMITIVE_POP // Ruby < 3.2
+    else if (CHARSLICE_EQUALS("pop", name_slice)) { // Expected to be Queue/SizedQueue#pop
+      return DDOG_CHARSLICE_C("waiting");
+    }
+  #endif
+
+  return DDOG_CHARSLICE_C("");
+}
+
 static void add_truncated_frames_placeholder(sampling_buffer* buffer) {
   // Important note: The strings below are static so we don't need to worry about their lifetime. If we ever want to change
   // this to non-static strings, don't forget to check that lifetimes are properly respected.
@@ -612,6 +645,21 @@ bool prepare_sample_thread(VALUE thread, sampling_buffer *buffer) {
   return true;
 }
 
+// Same as `prepare_sample_thread`, but for a fiber that is not running (see `ddtrace_rb_profile_suspended_fiber_frames`).
+// The sample then gets recorded by calling `sample_thread` with the thread the fiber belongs to.
+//
+// Unlike for threads, returns false if there's nothing to sample (e.g. the fiber has terminated).
+bool prepare_sample_suspended_fiber(VALUE fiber, sampling_buffer *buffer) {
+  if (buffer->is_marking) return false;
+
+  int captured_frames = ddtrace_rb_profile_suspended_fiber_frames(fiber, buffer->max_frames, buffer->stack_buffer);
+  if (captured_frames <= 0) return false;
+
+  buffer->pending_sample = true;
+  buffer->pending_sample_result = captured_frames;
+  return true;
+}
+
 uint16_t sampling_buffer_check_max_frames(int max_frames) {
   if (max_frames < 5) raise_error(rb_eArgError, "Invalid max_frames: value must be >= 5");
   if (max_frames > MAX_FRAMES_LIMIT) raise_error(rb_eArgError, "Invalid max_frames: value must be <= " MAX_FRAMES_LIMIT_AS_STRING);
@@ -626,7 +674,11 @@ void sampling_buffer_initialize(sampling_buffer *buffer, uint16_t max_frames, dd
   buffer->stack_buffer = ruby_xcalloc(max_frames, sizeof(frame_info));
   buffer->pending_sample = false;
   buffer->is_marking = false;
+  buffer->enqueue_samples = false;
   buffer->pending_sample_result = 0;
+  buffer->top_native_function = NULL;
+  buffer->top_native_method_id = 0;
+  buffer->top_native_function_state = DDOG_CHARSLICE_C("");
 }
 
 void sampling_buffer_free(sampling_buffer *buffer) {
@@ -643,6 +695,9 @@ void sampling_buffer_free(sampling_buffer *buffer) {
   buffer->pending_sample = false;
   buffer->is_marking = false;
   buffer->pending_sample_result = 0;
+  buffer->top_native_function = NULL;
+  buffer->top_native_method_id = 0;
+  buffer->top_native_function_state = DDOG_CHARSLICE_C("");
 }
 
 void sampling_buffer_mark(sampling_buffer *buffer) {
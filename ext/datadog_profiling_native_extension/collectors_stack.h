@@ -15,7 +15,13 @@ typedef struct {
   frame_info *stack_buffer;
   bool pending_sample;
   bool is_marking; // Used to avoid recording a sample when marking
+  bool enqueue_samples; // Set for buffers used outside the main Ractor; see `enqueue_sample` in stack_recorder.c
   int pending_sample_result;
+  // Caches the state classification for the last native method seen at the top of the stack, so that threads that stay
+  // blocked on the same method (the common case) don't need to go through the method name comparisons on every sample.
+  void *top_native_function;
+  ID top_native_method_id;
+  ddog_CharSlice top_native_function_state;
 } sampling_buffer;
 
 void sample_thread(
@@ -34,6 +40,7 @@ void record_placeholder_stack(
   ddog_CharSlice placeholder_stack
 );
 bool prepare_sample_thread(VALUE thread, sampling_buffer *buffer);
+bool prepare_sample_suspended_fiber(VALUE fiber, sampling_buffer *buffer);
 
 uint16_t sampling_buffer_check_max_frames(int max_frames);
 void sampling_buffer_initialize(sampling_buffer *buffer, uint16_t max_frames, ddog_prof_Location *locations);
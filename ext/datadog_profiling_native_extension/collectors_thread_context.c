@@ -2,11 +2,14 @@
 
 #include "datadog_ruby_common.h"
 #include "collectors_thread_context.h"
+#include "blocking_state_helper.h"
 #include "clock_id.h"
 #include "collectors_stack.h"
 #include "collectors_gc_profiling_helper.h"
+#include "custom_labels.h"
 #include "helpers.h"
 #include "libdatadog_helpers.h"
+#include "log_histogram.h"
 #include "private_vm_api_access.h"
 #include "ruby_helpers.h"
 #include "stack_recorder.h"
@@ -14,6 +17,10 @@
 #include "unsafe_api_calls_check.h"
 #include "extconf.h"
 
+#ifndef NO_RACTOR_SAMPLING
+  #include <ruby/ractor.h>
+#endif
+
 // Used to trigger sampling of threads, based on external "events", such as:
 // * periodic timer for cpu-time and wall-time
 // * VM garbage collection events
@@ -61,10 +68,20 @@
 // so that the application can keep doing user work in between GC steps.
 // The `on_gc_start` / `on_gc_finish` will trigger each time the VM executes these smaller steps, and on a benchmark
 // that executes `Object.new` in a loop, I measured more than 50k of this steps per second (!!).
-// Creating these many events for every GC step is a lot of overhead, so instead `on_gc_finish` coalesces time
-// spent in GC and only flushes it at most every 10 ms/every complete GC collection. This reduces the amount of
-// individual GC events we need to record. We use the latest GC metadata for this event, reflecting the last GC that
-// happened in the coalesced period.
+// Creating these many events for every GC step is a lot of overhead, so instead `on_gc_finish` coalesces the time
+// spent in all steps belonging to the same GC cycle (as identified by `rb_gc_count()`) into a single GC event. We use
+// the latest GC metadata observed for that cycle for this event.
+//
+// Once a new GC cycle starts, the previous event is appended to a fixed-size ring (`gc_events`) inside the collector
+// state. This is cheap and allocation-free, so it's fine to do during GC. Pending events then get flushed in a batch
+// by `thread_context_collector_sample_after_gc`, either:
+// * ...when the ring reaches GC_EVENT_RING_FLUSH_THRESHOLD, or a major GC finishes (the heap recorder relies on
+//   `recorder_after_gc_step` getting called shortly after a major GC to clean up young objects), or
+// * ...right before the profile gets serialized (see `CpuAndWallTimeWorker#flush_gc_events`).
+// This means that for most GCs, we don't need to trigger a postponed job (and `record_placeholder_stack`) at all.
+//
+// If the ring fills up before a flush happens, we keep coalescing new GC cycles into the latest event instead, so no
+// GC time is ever lost, at the cost of less accurate metadata/timeline placement.
 //
 // In an earlier attempt at implementing this functionality (https://github.com/DataDog/dd-trace-rb/pull/2308), we
 // discovered that we needed to factor the sampling work away from `thread_context_collector_on_gc_finish` and into a
@@ -78,12 +95,8 @@
 #define IS_WALL_TIME true
 #define IS_NOT_WALL_TIME false
 #define MISSING_TRACER_CONTEXT_KEY 0
-#define TIME_BETWEEN_GC_EVENTS_NS MILLIS_AS_NS(10)
-
-// This is used as a placeholder to mark threads that are allowed to be profiled (enabled)
-// (e.g. to avoid trying to gvl profile threads that are not from the main Ractor)
-// and for which there's no data yet
-#define GVL_WAITING_ENABLED_EMPTY RUBY_FIXNUM_MAX
+#define GC_EVENT_RING_CAPACITY 512
+#define GC_EVENT_RING_FLUSH_THRESHOLD (GC_EVENT_RING_CAPACITY * 3 / 4)
 
 static ID at_active_span_id;  // id of :@active_span in Ruby
 static ID at_active_trace_id; // id of :@active_trace in Ruby
@@ -107,6 +120,12 @@ static ID server_id;      // id of :server in Ruby
 static ID otel_context_storage_id; // id of :__opentelemetry_context_storage__ in Ruby
 static ID otel_fiber_context_storage_id; // id of :@opentelemetry_context in Ruby
 
+// Used to keep track of suspended fibers, see `track_suspended_fiber`
+static VALUE weak_map_class = Qnil; // ObjectSpace::WeakMap
+static ID aref_id;                  // id of :[] in Ruby
+static ID aset_id;                  // id of :[]= in Ruby
+static ID each_id;                  // id of :each in Ruby
+
 // This is used by `thread_context_collector_on_gvl_running`. Because when that method gets called we're not sure if
 // it's safe to access the state of the thread context collector, we store this setting as a global value. This does
 // mean this setting is shared among all thread context collectors, and thus it's "last writer wins".
@@ -114,9 +133,45 @@ static ID otel_fiber_context_storage_id; // id of :@opentelemetry_context in Rub
 // and that'll be the one that last wrote this setting.
 static uint32_t global_waiting_for_gvl_threshold_ns = MILLIS_AS_NS(10);
 
+// When fiber profiling is enabled, suspended fibers get sampled once every this many regular samples; their wall-time
+// still gets fully accounted for, it's just that it gets reported in fewer, bigger, samples.
+#define SUSPENDED_FIBERS_SAMPLING_INTERVAL 10
+// Fibers suspended beyond this (per thread) don't get sampled
+#define MAX_SUSPENDED_FIBERS_PER_THREAD 256
+// Fiber switches to fibers beyond this many (per thread, between two samples) don't get tracked
+#define MAX_FIBER_SWITCHES_PER_SAMPLE 1024
+// Fibers that don't get resumed for longer than this stop being sampled. This is mostly to avoid reporting ever-growing
+// wall-time for fibers that are never going to be resumed, such as an `Enumerator#next` that was abandoned midway.
+#define MAX_SUSPENDED_FIBER_WALL_TIME_NS SECONDS_AS_NS(60)
+// How many times we look up what a thread that released the GVL is blocked on, if we keep finding that it's not blocked
+// yet (see `blocking_state_for`)
+#define MAX_BLOCKING_STATE_LOOKUPS_PER_RELEASE 3
+
 typedef enum { OTEL_CONTEXT_ENABLED_FALSE, OTEL_CONTEXT_ENABLED_ONLY, OTEL_CONTEXT_ENABLED_BOTH } otel_context_enabled;
 typedef enum { OTEL_CONTEXT_SOURCE_UNKNOWN, OTEL_CONTEXT_SOURCE_FIBER_IVAR, OTEL_CONTEXT_SOURCE_FIBER_LOCAL } otel_context_source;
 
+typedef struct {
+  unsigned long cpu_time_ns;
+  unsigned long wall_time_ns;
+  long wall_time_at_finish_ns;
+  gc_profiling_info info;
+} gc_event;
+
+// Distributions of how long threads waited for/held the GVL, only used when GVL profiling is enabled
+typedef struct {
+  log_histogram wait;
+  log_histogram hold;
+} gvl_contention_histograms;
+
+// Caps how many threads `_native_gvl_contention_stats_and_reset` reports individually, so that the stats don't grow
+// with the number of threads in the app. Threads over the limit are still included in the "all threads" histograms.
+#define MAX_GVL_CONTENTION_STATS_THREADS 32
+
+typedef struct {
+  VALUE per_thread;
+  unsigned int omitted_threads;
+} gvl_contention_stats_result;
+
 // Contains state for a single ThreadContext instance
 typedef struct {
   // Note: Places in this file that usually need to be changed when this struct is changed are tagged with
@@ -140,6 +195,8 @@ typedef struct {
   unsigned int sample_count;
   // Reusable array to get list of threads
   VALUE thread_list_buffer;
+  // Reusable array to get list of suspended fibers for a thread (see `sample_suspended_fibers`)
+  VALUE suspended_fibers_buffer;
   // Used to omit endpoint names (retrieved from tracer) from collected data
   bool endpoint_collection_enabled;
   // Used to omit timestamps / timeline events from collected data
@@ -160,21 +217,55 @@ typedef struct {
   bool native_filenames_enabled;
   // Used to cache native filename lookup results (Map[void *function_pointer, char *filename])
   st_table *native_filenames_cache;
+  // When enabled, fibers that are suspended (e.g. waiting on the `async` gem's event loop) also get sampled.
+  // See `thread_context_collector_on_fiber_switch` for details.
+  bool fiber_profiling_enabled;
+  unsigned int samples_until_suspended_fibers; // Counts down to the next sample that includes suspended fibers
+  // Used for sampling suspended fibers, so that doing so does not overwrite a stack that may be pending in the thread's
+  // own `sampling_buffer`. Only initialized when fiber profiling is enabled.
+  sampling_buffer suspended_fibers_sampling_buffer;
 
   struct stats {
     // Track how many garbage collection samples we've taken.
     unsigned int gc_samples;
     // See thread_context_collector_on_gc_start for details
     unsigned int gc_samples_missed_due_to_missing_context;
+    // See "Tracking of cpu-time and wall-time spent during garbage collection" note at the top of this file
+    unsigned int gc_events_coalesced_due_to_full_ring;
+    // How many times we looked up what a thread that released the GVL was blocked on (see blocking_state_helper.h)
+    unsigned int blocking_state_lookups;
+    // How much wall-time those lookups took
+    uint64_t blocking_state_lookup_time_ns_total;
+    // How many samples we took of suspended fibers (see `sample_suspended_fibers`)
+    unsigned int suspended_fiber_samples;
+    // How many times a fiber got suspended but we could not track it, as there were too many suspended fibers already
+    unsigned int suspended_fibers_dropped;
+    // How many suspended fibers we stopped sampling as they were not resumed for MAX_SUSPENDED_FIBER_WALL_TIME_NS
+    unsigned int suspended_fibers_expired;
   } stats;
 
+  // The GC event currently being accumulated (e.g. the GC cycle that's still ongoing)
   struct {
     unsigned long accumulated_cpu_time_ns;
     unsigned long accumulated_wall_time_ns;
 
     long wall_time_at_previous_gc_ns; // Will be INVALID_TIME unless there's accumulated time above
     long wall_time_at_last_flushed_gc_event_ns; // Starts at 0 and then will always be valid
+    size_t gc_count; // Value of rb_gc_count() for the accumulated time above
+    gc_profiling_info info; // Latest metadata observed for the accumulated time above
   } gc_tracking;
+
+  // GC events that are complete and waiting to be flushed by thread_context_collector_sample_after_gc.
+  // Only touched while holding the GVL, so `head`/`tail` don't need to be atomic.
+  struct {
+    gc_event events[GC_EVENT_RING_CAPACITY];
+    unsigned int head; // Next position to be written
+    unsigned int tail; // Next position to be flushed
+  } gc_events;
+
+  // Aggregated over all threads (including threads that have since died) since the last
+  // `_native_gvl_contention_stats_and_reset`. See also `per_thread_context.gvl_contention`.
+  gvl_contention_histograms gvl_contention;
 } thread_context_collector_state;
 
 // Tracks per-thread state
@@ -194,8 +285,81 @@ typedef struct {
     long cpu_time_at_start_ns;
     long wall_time_at_start_ns;
   } gc_tracking;
+
+  // Only used when GVL profiling is enabled, see `thread_context_collector_on_gvl_acquired` and
+  // `thread_context_collector_on_gvl_released`
+  struct {
+    long acquired_at_ns; // INVALID_TIME unless the thread is known to be holding the GVL
+    // Allocated on first use (see `gvl_contention_histograms_for`), so that threads only pay for it when GVL profiling
+    // is enabled
+    gvl_contention_histograms *histograms;
+  } gvl_contention;
+
+  // Only used when GVL profiling is enabled, see `blocking_state_for`
+  struct {
+    bool off_gvl; // Set while the thread has released the GVL (e.g. to do blocking I/O)
+    bool is_classified; // Set once `state` was computed for the current off_gvl period
+    uint8_t lookups; // How many times we looked up `state` for the current off_gvl period
+    ddog_CharSlice state; // Empty if we could not tell what the thread was blocked on
+  } blocking;
+
+  // Caches the identifiers for the span that was active the last time this thread was sampled, see
+  // `trace_identifiers_for` for details
+  struct {
+    VALUE active_span; // For caching validation only (does not need marking)
+    VALUE active_span_id; // For caching validation only (does not need marking); always a Fixnum or Qnil
+    uint64_t local_root_span_id;
+    uint64_t span_id;
+    bool should_collect_resource;
+  } trace_identifiers_cache;
+
+  // Same as above, but for `otel_without_ddtrace_trace_identifiers_for`
+  struct {
+    uint64_t span_id; // 0 when empty
+    uint64_t local_root_span_id;
+    long active_context_index; // Position of the active span's context in the otel context storage
+    long local_root_context_index; // Position of the local root span's context in the otel context storage
+  } otel_trace_identifiers_cache;
+
+  // Only used when fiber profiling is enabled, see `thread_context_collector_on_fiber_switch`
+  struct {
+    VALUE current_fiber; // Fiber that was running when the last fiber switch happened; Qnil if not known
+    // Fiber switches since the last sample, as Fiber => time it got suspended at, or 0 if it got resumed. These get
+    // recorded natively, as they happen inside a VM hook, and get moved to `suspended` at sample time (see
+    // `apply_fiber_switches`). Fibers in here are marked, but only until then. NULL if fiber profiling is disabled.
+    st_table *switches;
+    // ObjectSpace::WeakMap of Fiber => time it got suspended at (Fixnum), or false once it gets resumed; Qnil until
+    // first needed. Being weak means that suspended fibers that are never resumed can still get garbage collected.
+    VALUE suspended;
+    uint16_t suspended_count; // Approximate, as it does not account for fibers that got garbage collected until the next sample
+    long wall_time_at_previous_sample_ns; // When `sample_suspended_fibers` last ran for this thread
+  } fibers;
 } per_thread_context;
 
+#ifndef NO_RACTOR_SAMPLING
+  // Each Ractor other than the main one gets one of these, stored in Ractor-local storage.
+  // See `thread_context_collector_sample_current_ractor` for details.
+  typedef struct {
+    sampling_buffer sampling_buffer;
+    ddog_prof_Location *locations;
+    uint32_t ractor_id;
+    VALUE thread; // Last thread sampled on this Ractor
+    char thread_id[THREAD_ID_LIMIT_CHARS];
+    thread_cpu_time_id thread_cpu_time_id;
+    long cpu_time_at_previous_sample_ns;  // Can be INVALID_TIME until initialized or if getting it fails for another reason
+    long wall_time_at_previous_sample_ns; // Can be INVALID_TIME until initialized
+  } ractor_sampling_state;
+
+  static void ractor_sampling_state_mark(void *state_ptr);
+  static void ractor_sampling_state_free(void *state_ptr);
+
+  static const struct rb_ractor_local_storage_type ractor_sampling_state_type = {
+    .mark = ractor_sampling_state_mark,
+    .free = ractor_sampling_state_free,
+  };
+  static rb_ractor_local_key_t ractor_sampling_state_key;
+#endif
+
 // Used to correlate profiles with traces
 typedef struct {
   bool valid;
@@ -252,17 +416,40 @@ static VALUE per_thread_context_st_table_as_ruby_hash(thread_context_collector_s
 static int per_thread_context_as_ruby_hash(st_data_t key_thread, st_data_t value_context, st_data_t result_hash);
 static VALUE stats_as_ruby_hash(thread_context_collector_state *state);
 static VALUE gc_tracking_as_ruby_hash(thread_context_collector_state *state);
+static unsigned int pending_gc_events(thread_context_collector_state *state);
+static void close_gc_event(thread_context_collector_state *state);
+static void record_gc_event(thread_context_collector_state *state, gc_event *event);
 static void remove_context_for_dead_threads(thread_context_collector_state *state);
 static int remove_if_dead_thread(st_data_t key_thread, st_data_t value_context, st_data_t _argument);
 static VALUE _native_per_thread_context(VALUE self, VALUE collector_instance);
 static long update_time_since_previous_sample(long *time_at_previous_sample_ns, long current_time_ns, long gc_start_time_ns, bool is_wall_time);
 static long cpu_time_now_ns(per_thread_context *thread_context);
+static ddog_CharSlice blocking_state_for(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context);
 static long thread_id_for(VALUE thread);
+static ddog_CharSlice thread_name_label_for(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context);
+static void trace_identifiers_from_context(
+  thread_context_collector_state *state,
+  VALUE current_context,
+  per_thread_context *thread_context,
+  trace_identifiers *trace_identifiers_result,
+  bool is_safe_to_allocate_objects
+);
+static void record_fiber_switch(thread_context_collector_state *state, per_thread_context *thread_context, VALUE fiber, long suspended_at_ns);
+static int collect_fiber_switch(st_data_t key_fiber, st_data_t value_suspended_at_ns, st_data_t fiber_switches_buffer);
+static void apply_fiber_switches(thread_context_collector_state *state, per_thread_context *thread_context);
+static void track_suspended_fiber(thread_context_collector_state *state, per_thread_context *thread_context, VALUE fiber, long suspended_at_ns);
+static void untrack_suspended_fiber(per_thread_context *thread_context, VALUE fiber);
+static VALUE collect_suspended_fiber(RB_BLOCK_CALL_FUNC_ARGLIST(_unused, suspended_fibers_buffer));
+static void sample_suspended_fibers(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context, long current_monotonic_wall_time_ns);
+static void sample_suspended_fiber(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context, VALUE fiber, long wall_time_elapsed_ns, long current_monotonic_wall_time_ns);
+static VALUE _native_on_fiber_switch(DDTRACE_UNUSED VALUE self, VALUE collector_instance);
+static VALUE _native_fiber_profiling_supported(DDTRACE_UNUSED VALUE self);
 static VALUE _native_stats(VALUE self, VALUE collector_instance);
 static VALUE _native_gc_tracking(VALUE self, VALUE collector_instance);
 static void trace_identifiers_for(
   thread_context_collector_state *state,
   VALUE thread,
+  per_thread_context *thread_context,
   trace_identifiers *trace_identifiers_result,
   bool is_safe_to_allocate_objects
 );
@@ -296,10 +483,13 @@ static bool handle_gvl_waiting(
   static VALUE _native_on_gvl_running(DDTRACE_UNUSED VALUE self, VALUE thread);
   static VALUE _native_sample_after_gvl_running(DDTRACE_UNUSED VALUE self, VALUE collector_instance, VALUE thread, VALUE allow_exception);
   static VALUE _native_apply_delta_to_cpu_time_at_previous_sample_ns(DDTRACE_UNUSED VALUE self, VALUE collector_instance, VALUE thread, VALUE delta_ns);
+  static VALUE _native_on_gvl_acquired(DDTRACE_UNUSED VALUE self, VALUE collector_instance, VALUE thread, VALUE waiting_for_gvl_duration_ns, VALUE current_monotonic_wall_time_ns);
+  static VALUE _native_on_gvl_released(DDTRACE_UNUSED VALUE self, VALUE collector_instance, VALUE thread, VALUE current_monotonic_wall_time_ns);
 #endif
 static void otel_without_ddtrace_trace_identifiers_for(
   thread_context_collector_state *state,
   VALUE thread,
+  per_thread_context *thread_context,
   trace_identifiers *trace_identifiers_result,
   bool is_safe_to_allocate_objects
 );
@@ -308,6 +498,8 @@ static uint64_t otel_span_id_to_uint(VALUE otel_span_id);
 static VALUE safely_lookup_hash_without_going_into_ruby_code(VALUE hash, VALUE key);
 static VALUE _native_system_epoch_time_now_ns(DDTRACE_UNUSED VALUE self, VALUE collector_instance);
 static VALUE _native_prepare_sample_inside_signal_handler(DDTRACE_UNUSED VALUE self, VALUE collector_instance);
+static VALUE _native_gvl_contention_stats_and_reset(DDTRACE_UNUSED VALUE self, VALUE collector_instance);
+static int per_thread_gvl_contention_as_ruby_hash_and_reset(st_data_t key_thread, st_data_t value_context, st_data_t result_hash);
 
 void collectors_thread_context_init(VALUE profiling_module) {
   VALUE collectors_module = rb_define_module_under(profiling_module, "Collectors");
@@ -328,6 +520,8 @@ void collectors_thread_context_init(VALUE profiling_module) {
   rb_define_singleton_method(collectors_thread_context_class, "_native_initialize", _native_initialize, -1);
   rb_define_singleton_method(collectors_thread_context_class, "_native_inspect", _native_inspect, 1);
   rb_define_singleton_method(collectors_thread_context_class, "_native_reset_after_fork", _native_reset_after_fork, 1);
+  rb_define_singleton_method(collectors_thread_context_class, "_native_gvl_contention_stats_and_reset", _native_gvl_contention_stats_and_reset, 1);
+  rb_define_singleton_method(collectors_thread_context_class, "_native_fiber_profiling_supported?", _native_fiber_profiling_supported, 0);
   rb_define_singleton_method(testing_module, "_native_sample", _native_sample, 3);
   rb_define_singleton_method(testing_module, "_native_sample_allocation", _native_sample_allocation, 3);
   rb_define_singleton_method(testing_module, "_native_on_gc_start", _native_on_gc_start, 1);
@@ -341,12 +535,15 @@ void collectors_thread_context_init(VALUE profiling_module) {
   rb_define_singleton_method(testing_module, "_native_sample_skipped_allocation_samples", _native_sample_skipped_allocation_samples, 2);
   rb_define_singleton_method(testing_module, "_native_system_epoch_time_now_ns", _native_system_epoch_time_now_ns, 1);
   rb_define_singleton_method(testing_module, "_native_prepare_sample_inside_signal_handler", _native_prepare_sample_inside_signal_handler, 1);
+  rb_define_singleton_method(testing_module, "_native_on_fiber_switch", _native_on_fiber_switch, 1);
   #ifndef NO_GVL_INSTRUMENTATION
     rb_define_singleton_method(testing_module, "_native_on_gvl_waiting", _native_on_gvl_waiting, 1);
     rb_define_singleton_method(testing_module, "_native_gvl_waiting_at_for", _native_gvl_waiting_at_for, 1);
     rb_define_singleton_method(testing_module, "_native_on_gvl_running", _native_on_gvl_running, 1);
     rb_define_singleton_method(testing_module, "_native_sample_after_gvl_running", _native_sample_after_gvl_running, 3);
     rb_define_singleton_method(testing_module, "_native_apply_delta_to_cpu_time_at_previous_sample_ns", _native_apply_delta_to_cpu_time_at_previous_sample_ns, 3);
+    rb_define_singleton_method(testing_module, "_native_on_gvl_acquired", _native_on_gvl_acquired, 4);
+    rb_define_singleton_method(testing_module, "_native_on_gvl_released", _native_on_gvl_released, 3);
   #endif
 
   at_active_span_id = rb_intern_const("@active_span");
@@ -367,6 +564,16 @@ void collectors_thread_context_init(VALUE profiling_module) {
   server_id = rb_intern_const("server");
   otel_context_storage_id = rb_intern_const("__opentelemetry_context_storage__");
   otel_fiber_context_storage_id = rb_intern_const("@opentelemetry_context");
+  aref_id = rb_intern_const("[]");
+  aset_id = rb_intern_const("[]=");
+  each_id = rb_intern_const("each");
+
+  weak_map_class = rb_path2class("ObjectSpace::WeakMap");
+  rb_global_variable(&weak_map_class);
+
+  #ifndef NO_RACTOR_SAMPLING
+    ractor_sampling_state_key = rb_ractor_local_storage_ptr_newkey(&ractor_sampling_state_type);
+  #endif
 
   #ifndef NO_GVL_INSTRUMENTATION
     // This will raise if Ruby already ran out of thread-local keys
@@ -398,8 +605,12 @@ static void thread_context_collector_typed_data_mark(void *state_ptr) {
   rb_gc_mark(state->recorder_instance);
   st_foreach(state->hash_map_per_thread_context, hash_map_per_thread_context_mark, 0 /* unused */);
   rb_gc_mark(state->thread_list_buffer);
+  rb_gc_mark(state->suspended_fibers_buffer);
   rb_gc_mark(state->main_thread);
   rb_gc_mark(state->otel_current_span_key);
+  if (sampling_buffer_needs_marking(&state->suspended_fibers_sampling_buffer)) {
+    sampling_buffer_mark(&state->suspended_fibers_sampling_buffer);
+  }
 }
 
 static void thread_context_collector_typed_data_free(void *state_ptr) {
@@ -410,6 +621,7 @@ static void thread_context_collector_typed_data_free(void *state_ptr) {
   // Important: Remember that we're only guaranteed to see here what's been set in _native_new, aka
   // pointers that have been set NULL there may still be NULL here.
   if (state->locations != NULL) ruby_xfree(state->locations);
+  if (state->suspended_fibers_sampling_buffer.stack_buffer != NULL) sampling_buffer_free(&state->suspended_fibers_sampling_buffer);
 
   // Free each entry in the map
   st_foreach(state->hash_map_per_thread_context, hash_map_per_thread_context_free_values, 0 /* unused */);
@@ -427,6 +639,9 @@ static int hash_map_per_thread_context_mark(st_data_t key_thread, st_data_t valu
   per_thread_context *thread_context = (per_thread_context *) value_thread_context;
 
   rb_gc_mark(thread);
+  rb_gc_mark(thread_context->fibers.current_fiber);
+  if (thread_context->fibers.switches != NULL) rb_mark_set(thread_context->fibers.switches);
+  rb_gc_mark(thread_context->fibers.suspended); // The fibers themselves are NOT marked, see `track_suspended_fiber`
   if (sampling_buffer_needs_marking(&thread_context->sampling_buffer)) {
     sampling_buffer_mark(&thread_context->sampling_buffer);
   }
@@ -457,10 +672,14 @@ static VALUE _native_new(VALUE klass) {
   state->tracer_context_key = MISSING_TRACER_CONTEXT_KEY;
   VALUE thread_list_buffer = rb_ary_new();
   state->thread_list_buffer = thread_list_buffer;
+  VALUE suspended_fibers_buffer = rb_ary_new();
+  state->suspended_fibers_buffer = suspended_fibers_buffer;
   state->endpoint_collection_enabled = true;
   state->timeline_enabled = true;
   state->native_filenames_enabled = false;
   state->native_filenames_cache = st_init_numtable();
+  state->fiber_profiling_enabled = false;
+  state->samples_until_suspended_fibers = 0;
   state->otel_context_enabled = OTEL_CONTEXT_ENABLED_FALSE;
   state->otel_context_source = OTEL_CONTEXT_SOURCE_UNKNOWN;
   state->time_converter_state = (monotonic_to_system_epoch_state) MONOTONIC_TO_SYSTEM_EPOCH_INITIALIZER;
@@ -477,6 +696,7 @@ static VALUE _native_new(VALUE klass) {
   VALUE instance = TypedData_Wrap_Struct(klass, &thread_context_collector_typed_data, state);
 
   RB_GC_GUARD(thread_list_buffer);
+  RB_GC_GUARD(suspended_fibers_buffer);
   RB_GC_GUARD(main_thread); // Arguably not needed, but perhaps can be move in some future Ruby release?
 
   return instance;
@@ -496,12 +716,14 @@ static VALUE _native_initialize(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _sel
   VALUE waiting_for_gvl_threshold_ns = rb_hash_fetch(options, ID2SYM(rb_intern("waiting_for_gvl_threshold_ns")));
   VALUE otel_context_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("otel_context_enabled")));
   VALUE native_filenames_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("native_filenames_enabled")));
+  VALUE fiber_profiling_enabled = rb_hash_fetch(options, ID2SYM(rb_intern("fiber_profiling_enabled")));
 
   ENFORCE_TYPE(max_frames, T_FIXNUM);
   ENFORCE_BOOLEAN(endpoint_collection_enabled);
   ENFORCE_BOOLEAN(timeline_enabled);
   ENFORCE_TYPE(waiting_for_gvl_threshold_ns, T_FIXNUM);
   ENFORCE_BOOLEAN(native_filenames_enabled);
+  ENFORCE_BOOLEAN(fiber_profiling_enabled);
 
   thread_context_collector_state *state;
   TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
@@ -514,6 +736,13 @@ static VALUE _native_initialize(int argc, VALUE *argv, DDTRACE_UNUSED VALUE _sel
   state->endpoint_collection_enabled = (endpoint_collection_enabled == Qtrue);
   state->timeline_enabled = (timeline_enabled == Qtrue);
   state->native_filenames_enabled = (native_filenames_enabled == Qtrue);
+  state->fiber_profiling_enabled = (fiber_profiling_enabled == Qtrue);
+  if (state->fiber_profiling_enabled && !suspended_fiber_sampling_supported()) {
+    raise_error(rb_eArgError, "Fiber profiling is not supported on this Ruby version");
+  }
+  if (state->fiber_profiling_enabled) {
+    sampling_buffer_initialize(&state->suspended_fibers_sampling_buffer, state->max_frames, state->locations);
+  }
   if (otel_context_enabled == Qfalse || otel_context_enabled == Qnil) {
     state->otel_context_enabled = OTEL_CONTEXT_ENABLED_FALSE;
   } else if (otel_context_enabled == ID2SYM(rb_intern("only"))) {
@@ -609,6 +838,12 @@ void thread_context_collector_sample(VALUE self_instance, long current_monotonic
 
   VALUE threads = thread_list(state);
 
+  bool should_sample_suspended_fibers = state->fiber_profiling_enabled && state->samples_until_suspended_fibers == 0;
+  if (state->fiber_profiling_enabled) {
+    state->samples_until_suspended_fibers =
+      should_sample_suspended_fibers ? SUSPENDED_FIBERS_SAMPLING_INTERVAL - 1 : state->samples_until_suspended_fibers - 1;
+  }
+
   const long thread_count = RARRAY_LEN(threads);
   for (long i = 0; i < thread_count; i++) {
     VALUE thread = RARRAY_AREF(threads, i);
@@ -627,6 +862,9 @@ void thread_context_collector_sample(VALUE self_instance, long current_monotonic
       current_cpu_time_ns,
       current_monotonic_wall_time_ns
     );
+
+    if (state->fiber_profiling_enabled) apply_fiber_switches(state, thread_context);
+    if (should_sample_suspended_fibers) sample_suspended_fibers(state, thread, thread_context, current_monotonic_wall_time_ns);
   }
 
   state->sample_count++;
@@ -792,6 +1030,13 @@ bool thread_context_collector_on_gc_finish(VALUE self_instance) {
   gc_cpu_time_elapsed_ns = long_max_of(gc_cpu_time_elapsed_ns, 0);
   gc_wall_time_elapsed_ns = long_max_of(gc_wall_time_elapsed_ns, 0);
 
+  size_t gc_count = rb_gc_count();
+
+  // A new GC cycle started since we last accumulated time, so the previous cycle is done and can be queued for flushing
+  if (state->gc_tracking.wall_time_at_previous_gc_ns != INVALID_TIME && state->gc_tracking.gc_count != gc_count) {
+    close_gc_event(state);
+  }
+
   if (state->gc_tracking.wall_time_at_previous_gc_ns == INVALID_TIME) {
     state->gc_tracking.accumulated_cpu_time_ns = 0;
     state->gc_tracking.accumulated_wall_time_ns = 0;
@@ -800,6 +1045,8 @@ bool thread_context_collector_on_gc_finish(VALUE self_instance) {
   state->gc_tracking.accumulated_cpu_time_ns += gc_cpu_time_elapsed_ns;
   state->gc_tracking.accumulated_wall_time_ns += gc_wall_time_elapsed_ns;
   state->gc_tracking.wall_time_at_previous_gc_ns = wall_time_at_finish_ns;
+  state->gc_tracking.gc_count = gc_count;
+  state->gc_tracking.info = gc_profiling_latest_info();
 
   // Update cpu-time accounting so it doesn't include the cpu-time spent in GC during the next sample
   // We don't update the wall-time because we don't subtract the wall-time spent in GC (see call to
@@ -809,21 +1056,40 @@ bool thread_context_collector_on_gc_finish(VALUE self_instance) {
   }
 
   // Let the caller know if it should schedule a flush or not. Returning true every time would cause a lot of overhead
-  // on the application (see GC tracking introduction at the top of the file), so instead we try to accumulate a few
-  // samples first.
-  bool over_flush_time_treshold =
-    (wall_time_at_finish_ns - state->gc_tracking.wall_time_at_last_flushed_gc_event_ns) >= TIME_BETWEEN_GC_EVENTS_NS;
+  // on the application (see GC tracking introduction at the top of the file), so instead we only ask for a flush when
+  // the ring is getting full or a major GC just finished.
+  return pending_gc_events(state) >= GC_EVENT_RING_FLUSH_THRESHOLD || gc_profiling_has_major_gc_finished();
+}
 
-  if (over_flush_time_treshold) {
-    return true;
-  } else {
-    return gc_profiling_has_major_gc_finished();
+static unsigned int pending_gc_events(thread_context_collector_state *state) {
+  return state->gc_events.head - state->gc_events.tail;
+}
+
+// Moves the GC event being accumulated in `state->gc_tracking` into the ring, so that a new one can start.
+//
+// Safety: Called during GC, so this must not allocate.
+static void close_gc_event(thread_context_collector_state *state) {
+  if (pending_gc_events(state) >= GC_EVENT_RING_CAPACITY) {
+    // No space left: keep accumulating into the current event instead; it'll be closed when there's space again.
+    state->stats.gc_events_coalesced_due_to_full_ring++;
+    return;
   }
+
+  state->gc_events.events[state->gc_events.head % GC_EVENT_RING_CAPACITY] = (gc_event) {
+    .cpu_time_ns = state->gc_tracking.accumulated_cpu_time_ns,
+    .wall_time_ns = state->gc_tracking.accumulated_wall_time_ns,
+    .wall_time_at_finish_ns = state->gc_tracking.wall_time_at_previous_gc_ns,
+    .info = state->gc_tracking.info,
+  };
+  state->gc_events.head++;
+
+  state->gc_tracking.wall_time_at_previous_gc_ns = INVALID_TIME;
 }
 
-// This function gets called after one or more GC work steps (calls to on_gc_start/on_gc_finish).
-// It creates a new sample including the cpu and wall-time spent by the garbage collector work, and resets any
-// GC-related tracking.
+// This function gets called after one or more GC work steps (calls to on_gc_start/on_gc_finish), as well as right
+// before the profile gets serialized.
+// It creates a new sample for every pending GC event, including the cpu and wall-time spent by the garbage collector
+// work, and resets any GC-related tracking. If there are no pending GC events, it does nothing.
 //
 // Assumption 1: This function is called in a thread that is holding the Global VM Lock. Caller is responsible for enforcing this.
 // Assumption 2: This function is allowed to raise exceptions. Caller is responsible for handling them, if needed.
@@ -833,13 +1099,38 @@ VALUE thread_context_collector_sample_after_gc(VALUE self_instance) {
   thread_context_collector_state *state;
   TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
 
-  if (state->gc_tracking.wall_time_at_previous_gc_ns == INVALID_TIME) {
-    raise_error(rb_eRuntimeError, "BUG: Unexpected call to sample_after_gc without valid GC information available");
+  bool flushed_any = false;
+
+  // We flush the events in the ring first, and then the one still being accumulated (its GC cycle may still be ongoing;
+  // any further steps will then become a new event). GCs may also happen while we're flushing, adding more events;
+  // that's fine, as they get flushed as well.
+  while (pending_gc_events(state) > 0 || state->gc_tracking.wall_time_at_previous_gc_ns != INVALID_TIME) {
+    if (pending_gc_events(state) == 0) {
+      close_gc_event(state);
+      continue;
+    }
+
+    // We copy the event and consume it before recording, so that if recording raises, we don't flush it again
+    gc_event event = state->gc_events.events[state->gc_events.tail % GC_EVENT_RING_CAPACITY];
+    state->gc_events.tail++;
+
+    record_gc_event(state, &event);
+    flushed_any = true;
   }
 
-  int max_labels_needed_for_gc = 7; // Magic number gets validated inside gc_profiling_set_metadata
+  if (!flushed_any) return Qnil;
+
+  // Let recorder do any cleanup/updates it requires after a GC step.
+  recorder_after_gc_step(state->recorder_instance);
+
+  // Return a VALUE to make it easier to call this function from Ruby APIs that expect a return value (such as rb_rescue2)
+  return Qnil;
+}
+
+static void record_gc_event(thread_context_collector_state *state, gc_event *event) {
+  int max_labels_needed_for_gc = 9; // Magic number gets validated inside gc_profiling_set_metadata
   ddog_prof_Label labels[max_labels_needed_for_gc];
-  uint8_t label_pos = gc_profiling_set_metadata(labels, max_labels_needed_for_gc);
+  uint8_t label_pos = gc_profiling_set_metadata(labels, max_labels_needed_for_gc, &event->info, state->timeline_enabled);
 
   ddog_prof_Slice_Label slice_labels = {.ptr = labels, .len = label_pos};
 
@@ -847,7 +1138,7 @@ VALUE thread_context_collector_sample_after_gc(VALUE self_instance) {
   int64_t end_timestamp_ns = 0;
 
   if (state->timeline_enabled) {
-    end_timestamp_ns = monotonic_to_system_epoch_ns(&state->time_converter_state, state->gc_tracking.wall_time_at_previous_gc_ns);
+    end_timestamp_ns = monotonic_to_system_epoch_ns(&state->time_converter_state, event->wall_time_at_finish_ns);
   }
 
   record_placeholder_stack(
@@ -858,25 +1149,17 @@ VALUE thread_context_collector_sample_after_gc(VALUE self_instance) {
       // This is done to enable two use-cases:
       // * regular cpu/wall-time makes this event show up as a regular stack in the flamegraph
       // * the timeline duration is used when the event shows up in the timeline
-      .cpu_time_ns = state->gc_tracking.accumulated_cpu_time_ns,
+      .cpu_time_ns = event->cpu_time_ns,
       .cpu_or_wall_samples = 1,
-      .wall_time_ns = state->gc_tracking.accumulated_wall_time_ns,
-      .timeline_wall_time_ns = state->gc_tracking.accumulated_wall_time_ns,
+      .wall_time_ns = event->wall_time_ns,
+      .timeline_wall_time_ns = event->wall_time_ns,
     },
     (sample_labels) {.labels = slice_labels, .state_label = NULL, .end_timestamp_ns = end_timestamp_ns},
     DDOG_CHARSLICE_C("Garbage Collection")
   );
 
-  state->gc_tracking.wall_time_at_last_flushed_gc_event_ns = state->gc_tracking.wall_time_at_previous_gc_ns;
-  state->gc_tracking.wall_time_at_previous_gc_ns = INVALID_TIME;
-
+  state->gc_tracking.wall_time_at_last_flushed_gc_event_ns = event->wall_time_at_finish_ns;
   state->stats.gc_samples++;
-
-  // Let recorder do any cleanup/updates it requires after a GC step.
-  recorder_after_gc_step(state->recorder_instance);
-
-  // Return a VALUE to make it easier to call this function from Ruby APIs that expect a return value (such as rb_rescue2)
-  return Qnil;
 }
 
 static void trigger_sample_for_thread(
@@ -901,7 +1184,8 @@ static void trigger_sample_for_thread(
     1 + // profiler overhead
     2 + // ruby vm type and allocation class
     1 + // state (only set for cpu/wall-time samples)
-    2;  // local root span id and span id
+    2 + // local root span id and span id
+    CUSTOM_LABELS_MAX_PER_FIBER;
   ddog_prof_Label labels[max_label_count];
   int label_pos = 0;
 
@@ -909,34 +1193,18 @@ static void trigger_sample_for_thread(
     .key = DDOG_CHARSLICE_C("thread id"),
     .str = thread_context->thread_id_char_slice
   };
-
-  VALUE thread_name = thread_name_for(thread);
-  if (thread_name != Qnil) {
-    labels[label_pos++] = (ddog_prof_Label) {
-      .key = DDOG_CHARSLICE_C("thread name"),
-      .str = char_slice_from_ruby_string(thread_name)
-    };
-  } else if (thread == state->main_thread) { // Threads are often not named, but we can have a nice fallback for this special thread
-    ddog_CharSlice main_thread_name = DDOG_CHARSLICE_C("main");
-    labels[label_pos++] = (ddog_prof_Label) {
-      .key = DDOG_CHARSLICE_C("thread name"),
-      .str = main_thread_name
-    };
-  } else {
-    // For other threads without name, we use the "invoke location" (first file:line of the block used to start the thread), if any.
-    // This is what Ruby shows in `Thread#to_s`.
-    labels[label_pos++] = (ddog_prof_Label) {
-      .key = DDOG_CHARSLICE_C("thread name"),
-      .str = thread_context->thread_invoke_location_char_slice // This is an empty string if no invoke location was available
-    };
-  }
+  labels[label_pos++] = (ddog_prof_Label) {
+    .key = DDOG_CHARSLICE_C("thread name"),
+    .str = thread_name_label_for(state, thread, thread_context)
+  };
 
   trace_identifiers trace_identifiers_result = {.valid = false, .trace_endpoint = Qnil};
-  trace_identifiers_for(state, thread, &trace_identifiers_result, is_safe_to_allocate_objects);
+  ddog_CharSlice endpoint = DDOG_CHARSLICE_C("");
+  trace_identifiers_for(state, thread, thread_context, &trace_identifiers_result, is_safe_to_allocate_objects);
 
   if (!trace_identifiers_result.valid && state->otel_context_enabled != OTEL_CONTEXT_ENABLED_FALSE) {
     // If we couldn't get something with ddtrace, let's see if we can get some trace identifiers from opentelemetry directly
-    otel_without_ddtrace_trace_identifiers_for(state, thread, &trace_identifiers_result, is_safe_to_allocate_objects);
+    otel_without_ddtrace_trace_identifiers_for(state, thread, thread_context, &trace_identifiers_result, is_safe_to_allocate_objects);
   }
 
   if (trace_identifiers_result.valid) {
@@ -952,12 +1220,8 @@ static void trigger_sample_for_thread(
       // endpoint values, and at serialization time the most-recently-seen endpoint is applied to all relevant samples.
       //
       // This is why the endpoint is not directly added in this function to the labels array, although it will later
-      // show up in the array in the output pprof.
-      record_endpoint(
-        state->recorder_instance,
-        trace_identifiers_result.local_root_span_id,
-        char_slice_from_ruby_string(trace_identifiers_result.trace_endpoint)
-      );
+      // show up in the array in the output pprof. (It gets passed along with the sample, see `record_sample`.)
+      endpoint = char_slice_from_ruby_string(trace_identifiers_result.trace_endpoint);
     }
   }
 
@@ -996,6 +1260,18 @@ static void trigger_sample_for_thread(
     };
   }
 
+  // If the thread spent the sampled period blocked outside of the GVL, we may be able to tell exactly on what
+  bool is_blocking_state_known = false;
+  if (state_label != NULL && values.cpu_time_ns == 0 && !is_gvl_waiting_state && thread == stack_from_thread) {
+    ddog_CharSlice blocking_state = blocking_state_for(state, thread, thread_context);
+    if (blocking_state.len > 0) {
+      state_label->str = blocking_state;
+      is_blocking_state_known = true;
+    }
+  }
+
+  label_pos += custom_labels_for_thread(thread, &labels[label_pos]);
+
   // The number of times `label_pos++` shows up in this function needs to match `max_label_count`. To avoid "oops I
   // forgot to update max_label_count" in the future, we've also added this validation.
   // @ivoanjo: I wonder if C compilers are smart enough to statically prove this check never triggers unless someone
@@ -1022,12 +1298,401 @@ static void trigger_sample_for_thread(
       .state_label = state_label,
       .end_timestamp_ns = end_timestamp_ns,
       .is_gvl_waiting_state = is_gvl_waiting_state,
+      .is_blocking_state_known = is_blocking_state_known,
+      .endpoint_local_root_span_id = trace_identifiers_result.local_root_span_id,
+      .endpoint = endpoint,
+    },
+    state->native_filenames_enabled,
+    state->native_filenames_cache
+  );
+}
+
+bool thread_context_collector_fiber_profiling_enabled(VALUE self_instance) {
+  thread_context_collector_state *state;
+  TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+  return state->fiber_profiling_enabled;
+}
+
+// This function gets called (by the CpuAndWallTimeWorker) on every fiber switch, from the fiber that just started
+// running. It's used to keep track of which fibers are suspended, so that `sample_suspended_fibers` can sample them.
+//
+// Note that the sampler only ever samples the fiber currently running on each thread. For `async`-style workloads
+// where many requests are being handled concurrently by fibers on the same thread, this means that where the
+// suspended requests are waiting would not show up in wall-time profiles without this.
+//
+// Because this runs inside a VM hook, and fiber switches can be very frequent (e.g. `Enumerator#next` loops), it MUST
+// NOT call into Ruby code: it only records the switch in the thread's `fibers.switches` table, and everything else
+// (including dropping fibers that have finished) happens at sample time, see `apply_fiber_switches`.
+void thread_context_collector_on_fiber_switch(VALUE self_instance) {
+  thread_context_collector_state *state;
+  TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+  if (!state->fiber_profiling_enabled) return;
+
+  // Creating the context is not something we want to do from inside the hook, so threads that have not yet been sampled
+  // are skipped; they'll get a context on their next sample.
+  per_thread_context *thread_context = get_context_for(rb_thread_current(), state);
+  if (thread_context == NULL || thread_context->fibers.switches == NULL) return;
+
+  VALUE new_fiber = rb_fiber_current();
+  VALUE previous_fiber = thread_context->fibers.current_fiber;
+  thread_context->fibers.current_fiber = new_fiber;
+
+  if (previous_fiber == new_fiber) return;
+
+  record_fiber_switch(state, thread_context, new_fiber, 0 /* resumed */);
+  if (previous_fiber != Qnil) {
+    record_fiber_switch(state, thread_context, previous_fiber, monotonic_wall_time_now_ns(DO_NOT_RAISE_ON_FAILURE));
+  }
+}
+
+// Safety: Called from inside a VM hook, see `thread_context_collector_on_fiber_switch`
+static void record_fiber_switch(thread_context_collector_state *state, per_thread_context *thread_context, VALUE fiber, long suspended_at_ns) {
+  st_table *switches = thread_context->fibers.switches;
+
+  if (switches->num_entries >= MAX_FIBER_SWITCHES_PER_SAMPLE && !st_is_member(switches, (st_data_t) fiber)) {
+    state->stats.suspended_fibers_dropped++;
+    return;
+  }
+
+  st_insert(switches, (st_data_t) fiber, (st_data_t) suspended_at_ns);
+}
+
+static int collect_fiber_switch(st_data_t key_fiber, st_data_t value_suspended_at_ns, st_data_t fiber_switches_buffer) {
+  VALUE fiber_switch[] = {(VALUE) key_fiber, LONG2FIX((long) value_suspended_at_ns)};
+  rb_ary_cat((VALUE) fiber_switches_buffer, fiber_switch, 2);
+  return ST_CONTINUE;
+}
+
+// Moves the fiber switches recorded by `thread_context_collector_on_fiber_switch` since the last sample into the
+// `fibers.suspended` WeakMap
+static void apply_fiber_switches(thread_context_collector_state *state, per_thread_context *thread_context) {
+  st_table *switches = thread_context->fibers.switches;
+  if (switches == NULL || switches->num_entries == 0) return;
+
+  // Updating the WeakMap calls into Ruby code, so we first move the switches out of the table. While the fibers are in
+  // the buffer, they can't be garbage collected.
+  VALUE fiber_switches = state->suspended_fibers_buffer;
+  rb_ary_clear(fiber_switches);
+  st_foreach(switches, collect_fiber_switch, (st_data_t) fiber_switches);
+  st_clear(switches);
+
+  const long switch_count = RARRAY_LEN(fiber_switches) / 2;
+  for (long i = 0; i < switch_count; i++) {
+    VALUE fiber = RARRAY_AREF(fiber_switches, i * 2);
+    long suspended_at_ns = FIX2LONG(RARRAY_AREF(fiber_switches, i * 2 + 1));
+
+    // Fibers that have finished are also switched away from, but there's nothing left to sample for them
+    if (suspended_at_ns == 0 || !RTEST(rb_fiber_alive_p(fiber))) {
+      untrack_suspended_fiber(thread_context, fiber);
+    } else {
+      track_suspended_fiber(state, thread_context, fiber, suspended_at_ns);
+    }
+  }
+
+  rb_ary_clear(fiber_switches);
+}
+
+// Suspended fibers are tracked without being marked, as otherwise fibers that are never resumed (e.g. an
+// `Enumerator#next` that was abandoned midway) would never get garbage collected. Instead, they are kept in a WeakMap,
+// and are only ever referenced from the C side (see `sample_suspended_fibers`) while the map is keeping them alive.
+static void track_suspended_fiber(thread_context_collector_state *state, per_thread_context *thread_context, VALUE fiber, long suspended_at_ns) {
+  if (thread_context->fibers.suspended_count >= MAX_SUSPENDED_FIBERS_PER_THREAD) {
+    state->stats.suspended_fibers_dropped++;
+    return;
+  }
+
+  if (thread_context->fibers.suspended == Qnil) {
+    thread_context->fibers.suspended = rb_class_new_instance(0, NULL, weak_map_class);
+  }
+
+  if (FIXNUM_P(rb_funcall(thread_context->fibers.suspended, aref_id, 1, fiber))) return; // Already being tracked
+
+  rb_funcall(thread_context->fibers.suspended, aset_id, 2, fiber, LONG2FIX(suspended_at_ns));
+  thread_context->fibers.suspended_count++;
+}
+
+static void untrack_suspended_fiber(per_thread_context *thread_context, VALUE fiber) {
+  if (thread_context->fibers.suspended == Qnil) return;
+
+  if (!FIXNUM_P(rb_funcall(thread_context->fibers.suspended, aref_id, 1, fiber))) return; // Not being tracked
+
+  // Note: WeakMap#delete is only available on Ruby 3.3+, so we leave a marker instead; it will go away when the fiber does
+  rb_funcall(thread_context->fibers.suspended, aset_id, 2, fiber, Qfalse);
+  if (thread_context->fibers.suspended_count > 0) thread_context->fibers.suspended_count--;
+}
+
+// Called with each (fiber, suspended at) pair in the WeakMap; they get stored flat in the buffer, to avoid allocating
+static VALUE collect_suspended_fiber(RB_BLOCK_CALL_FUNC_ARGLIST(_unused, suspended_fibers_buffer)) {
+  if (argc == 2 && FIXNUM_P(argv[1])) rb_ary_cat(suspended_fibers_buffer, argv, 2);
+  return Qnil;
+}
+
+static void sample_suspended_fibers(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context, long current_monotonic_wall_time_ns) {
+  if (thread_context->fibers.suspended == Qnil) return;
+
+  // While the fibers are in the buffer, they can't be garbage collected, so it's safe to sample them
+  VALUE suspended_fibers = state->suspended_fibers_buffer;
+  rb_ary_clear(suspended_fibers);
+  rb_block_call(thread_context->fibers.suspended, each_id, 0, NULL, collect_suspended_fiber, suspended_fibers);
+
+  // Fibers that got garbage collected are no longer in the map, so this is a good time to correct the count
+  const long suspended_count = RARRAY_LEN(suspended_fibers) / 2;
+  thread_context->fibers.suspended_count = (uint16_t) suspended_count;
+
+  long wall_time_at_previous_sample_ns = thread_context->fibers.wall_time_at_previous_sample_ns;
+  thread_context->fibers.wall_time_at_previous_sample_ns = current_monotonic_wall_time_ns;
+
+  for (long i = 0; i < suspended_count; i++) {
+    VALUE fiber = RARRAY_AREF(suspended_fibers, i * 2);
+    long suspended_at_ns = FIX2LONG(RARRAY_AREF(suspended_fibers, i * 2 + 1));
+
+    // E.g. we could not record the fiber switch where this fiber got resumed
+    if (fiber == thread_context->fibers.current_fiber) {
+      untrack_suspended_fiber(thread_context, fiber);
+      continue;
+    }
+
+    if (!RTEST(rb_fiber_alive_p(fiber))) {
+      untrack_suspended_fiber(thread_context, fiber);
+      continue;
+    }
+
+    if (current_monotonic_wall_time_ns - suspended_at_ns > MAX_SUSPENDED_FIBER_WALL_TIME_NS) {
+      untrack_suspended_fiber(thread_context, fiber);
+      state->stats.suspended_fibers_expired++;
+      continue;
+    }
+
+    // Every fiber that's still suspended gets sampled every time, so the wall-time for this sample is the time since
+    // whatever happened last: the fiber getting suspended, or the previous time suspended fibers got sampled.
+    long wall_time_at_previous_fiber_sample_ns =
+      wall_time_at_previous_sample_ns > suspended_at_ns ? wall_time_at_previous_sample_ns : suspended_at_ns;
+    long wall_time_elapsed_ns = update_time_since_previous_sample(
+      &wall_time_at_previous_fiber_sample_ns,
+      current_monotonic_wall_time_ns,
+      INVALID_TIME,
+      IS_WALL_TIME
+    );
+
+    sample_suspended_fiber(state, thread, thread_context, fiber, wall_time_elapsed_ns, current_monotonic_wall_time_ns);
+  }
+
+  rb_ary_clear(suspended_fibers);
+}
+
+static void sample_suspended_fiber(
+  thread_context_collector_state *state,
+  VALUE thread,
+  per_thread_context *thread_context,
+  VALUE fiber,
+  long wall_time_elapsed_ns,
+  long current_monotonic_wall_time_ns
+) {
+  if (!prepare_sample_suspended_fiber(fiber, &state->suspended_fibers_sampling_buffer)) return;
+
+  int max_label_count =
+    1 + // thread id
+    1 + // thread name
+    1 + // fiber state
+    1 + // state
+    2 + // local root span id and span id
+    CUSTOM_LABELS_MAX_PER_FIBER;
+  ddog_prof_Label labels[max_label_count];
+  int label_pos = 0;
+
+  labels[label_pos++] = (ddog_prof_Label) {
+    .key = DDOG_CHARSLICE_C("thread id"),
+    .str = thread_context->thread_id_char_slice
+  };
+  labels[label_pos++] = (ddog_prof_Label) {
+    .key = DDOG_CHARSLICE_C("thread name"),
+    .str = thread_name_label_for(state, thread, thread_context)
+  };
+
+  // Makes it possible to tell these samples apart from the ones for the fiber that's running on the thread; otherwise
+  // the wall-time for a thread would add up to more than the time that passed.
+  labels[label_pos++] = (ddog_prof_Label) {.key = DDOG_CHARSLICE_C("fiber state"), .str = DDOG_CHARSLICE_C("suspended")};
+
+  // The `Collectors::Stack` may override this based on the top of the stack, as for threads
+  ddog_prof_Label *state_label = &labels[label_pos++];
+  *state_label = (ddog_prof_Label) {.key = DDOG_CHARSLICE_C("state"), .str = DDOG_CHARSLICE_C("unknown"), .num = 0};
+
+  // Trace identifiers are resolved using the fiber's own fiber-local variables, so that we can see which request
+  // (if any) the fiber belongs to. We only support getting them via ddtrace, not directly via opentelemetry.
+  trace_identifiers trace_identifiers_result = {.valid = false, .trace_endpoint = Qnil};
+  ddog_CharSlice endpoint = DDOG_CHARSLICE_C("");
+  if (state->otel_context_enabled != OTEL_CONTEXT_ENABLED_ONLY && state->tracer_context_key != MISSING_TRACER_CONTEXT_KEY) {
+    trace_identifiers_from_context(
+      state,
+      fiber_local_aref(fiber, state->tracer_context_key),
+      /* thread_context: */ NULL, // The cache is for the fiber running on the thread
+      &trace_identifiers_result,
+      /* is_safe_to_allocate_objects: */ true
+    );
+  }
+
+  if (trace_identifiers_result.valid) {
+    labels[label_pos++] = (ddog_prof_Label) {.key = DDOG_CHARSLICE_C("local root span id"), .num = trace_identifiers_result.local_root_span_id};
+    labels[label_pos++] = (ddog_prof_Label) {.key = DDOG_CHARSLICE_C("span id"), .num = trace_identifiers_result.span_id};
+    if (trace_identifiers_result.trace_endpoint != Qnil) endpoint = char_slice_from_ruby_string(trace_identifiers_result.trace_endpoint);
+  }
+
+  label_pos += custom_labels_for_suspended_fiber(fiber, &labels[label_pos]);
+
+  if (label_pos > max_label_count) {
+    raise_error(rb_eRuntimeError, "BUG: Unexpected label_pos (%d) > max_label_count (%d)", label_pos, max_label_count);
+  }
+
+  int64_t end_timestamp_ns = 0;
+  if (state->timeline_enabled && current_monotonic_wall_time_ns != INVALID_TIME) {
+    end_timestamp_ns = monotonic_to_system_epoch_ns(&state->time_converter_state, current_monotonic_wall_time_ns);
+  }
+
+  state->stats.suspended_fiber_samples++;
+
+  sample_thread(
+    thread,
+    &state->suspended_fibers_sampling_buffer, // Contains the stack prepared by `prepare_sample_suspended_fiber`
+    state->recorder_instance,
+    (sample_values) {
+      .cpu_or_wall_samples = 1,
+      .wall_time_ns = wall_time_elapsed_ns,
+      .timeline_wall_time_ns = wall_time_elapsed_ns,
+    },
+    (sample_labels) {
+      .labels = (ddog_prof_Slice_Label) {.ptr = labels, .len = label_pos},
+      .state_label = state_label,
+      .end_timestamp_ns = end_timestamp_ns,
+      .endpoint_local_root_span_id = trace_identifiers_result.local_root_span_id,
+      .endpoint = endpoint,
     },
     state->native_filenames_enabled,
     state->native_filenames_cache
   );
 }
 
+// This method exists only to enable testing Datadog::Profiling::Collectors::ThreadContext behavior using RSpec.
+// It SHOULD NOT be used for other purposes.
+static VALUE _native_on_fiber_switch(DDTRACE_UNUSED VALUE self, VALUE collector_instance) {
+  thread_context_collector_state *state;
+  TypedData_Get_Struct(collector_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+  // In normal use, threads get their context when they first get sampled; here we create it so that tests don't need
+  // to sample first
+  get_or_create_context_for(rb_thread_current(), state);
+
+  thread_context_collector_on_fiber_switch(collector_instance);
+
+  return Qtrue;
+}
+
+static VALUE _native_fiber_profiling_supported(DDTRACE_UNUSED VALUE self) {
+  return suspended_fiber_sampling_supported() ? Qtrue : Qfalse;
+}
+
+#ifndef NO_RACTOR_SAMPLING
+  // Samples the thread that's running on the current Ractor, which MUST NOT be the main Ractor.
+  //
+  // The sampler can't look into other Ractors, so instead their threads sample themselves when they get the sampling
+  // signal (see `handle_sampling_signal`). Thus, only the running thread of each Ractor gets sampled, and (unlike for
+  // the main Ractor) there are no samples for threads that are waiting.
+  //
+  // Because we're not on the main Ractor, this MUST NOT touch any of the collector state that changes after
+  // initialization (such as the per-thread contexts) nor any Ruby objects from the main Ractor. Instead, each Ractor
+  // gets its own `ractor_sampling_state`, and samples get queued in the StackRecorder (see `enqueue_sample`) rather than
+  // being recorded directly. Trace identifiers, endpoints and custom labels are not supported for these samples.
+  void thread_context_collector_sample_current_ractor(VALUE self_instance, long current_monotonic_wall_time_ns) {
+    thread_context_collector_state *state;
+    TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+    ractor_sampling_state *ractor_state = rb_ractor_local_storage_ptr(ractor_sampling_state_key);
+
+    if (ractor_state == NULL) {
+      // See "note on calloc vs ruby_xcalloc use" in heap_recorder.c
+      ractor_state = calloc(1, sizeof(ractor_sampling_state));
+      if (ractor_state == NULL) return;
+
+      ractor_state->locations = ruby_xcalloc(state->max_frames, sizeof(ddog_prof_Location));
+      sampling_buffer_initialize(&ractor_state->sampling_buffer, state->max_frames, ractor_state->locations);
+      ractor_state->sampling_buffer.enqueue_samples = true;
+      ractor_state->ractor_id = ddtrace_rb_ractor_id();
+      ractor_state->thread = Qnil;
+
+      rb_ractor_local_storage_ptr_set(ractor_sampling_state_key, ractor_state);
+    }
+
+    VALUE thread = rb_thread_current();
+
+    if (thread != ractor_state->thread) {
+      ractor_state->thread = thread;
+      snprintf(ractor_state->thread_id, THREAD_ID_LIMIT_CHARS, "%"PRIu64" (%lu)", native_thread_id_for(thread), (unsigned long) thread_id_for(thread));
+      ractor_state->thread_cpu_time_id = thread_cpu_time_id_for(thread);
+      ractor_state->cpu_time_at_previous_sample_ns = INVALID_TIME;
+      ractor_state->wall_time_at_previous_sample_ns = INVALID_TIME;
+    }
+
+    thread_cpu_time cpu_time = thread_cpu_time_for(ractor_state->thread_cpu_time_id);
+    long cpu_time_elapsed_ns = 0;
+    if (cpu_time.valid) {
+      cpu_time_elapsed_ns =
+        update_time_since_previous_sample(&ractor_state->cpu_time_at_previous_sample_ns, cpu_time.result_ns, INVALID_TIME, IS_NOT_WALL_TIME);
+    } else {
+      ractor_state->cpu_time_at_previous_sample_ns = INVALID_TIME;
+    }
+    long wall_time_elapsed_ns =
+      update_time_since_previous_sample(&ractor_state->wall_time_at_previous_sample_ns, current_monotonic_wall_time_ns, INVALID_TIME, IS_WALL_TIME);
+
+    VALUE thread_name = thread_name_for(thread);
+
+    ddog_prof_Label labels[4] = {
+      {.key = DDOG_CHARSLICE_C("thread id"), .str = {.ptr = ractor_state->thread_id, .len = strlen(ractor_state->thread_id)}},
+      {.key = DDOG_CHARSLICE_C("thread name"), .str = thread_name != Qnil ? char_slice_from_ruby_string(thread_name) : DDOG_CHARSLICE_C("")},
+      {.key = DDOG_CHARSLICE_C("ractor id"), .num = ractor_state->ractor_id},
+      // The `Collectors::Stack` may override this based on the cpu-time and the top of the stack
+      {.key = DDOG_CHARSLICE_C("state"), .str = DDOG_CHARSLICE_C("unknown"), .num = 0},
+    };
+
+    sample_thread(
+      thread,
+      &ractor_state->sampling_buffer,
+      state->recorder_instance,
+      (sample_values) {
+        .cpu_time_ns = cpu_time_elapsed_ns,
+        .cpu_or_wall_samples = 1,
+        .wall_time_ns = wall_time_elapsed_ns,
+        .timeline_wall_time_ns = wall_time_elapsed_ns,
+      },
+      (sample_labels) {
+        .labels = (ddog_prof_Slice_Label) {.ptr = labels, .len = 4},
+        .state_label = &labels[3],
+        // We don't use `monotonic_to_system_epoch_ns` as it's not safe to call concurrently with the main Ractor
+        .end_timestamp_ns = state->timeline_enabled ? system_epoch_time_now_ns(DO_NOT_RAISE_ON_FAILURE) : 0,
+      },
+      /* native_filenames_enabled: */ false, // The native filenames cache is not safe to use from other Ractors
+      /* native_filenames_cache: */ NULL
+    );
+  }
+
+  static void ractor_sampling_state_mark(void *state_ptr) {
+    ractor_sampling_state *ractor_state = (ractor_sampling_state *) state_ptr;
+
+    rb_gc_mark(ractor_state->thread);
+    if (sampling_buffer_needs_marking(&ractor_state->sampling_buffer)) {
+      sampling_buffer_mark(&ractor_state->sampling_buffer);
+    }
+  }
+
+  static void ractor_sampling_state_free(void *state_ptr) {
+    ractor_sampling_state *ractor_state = (ractor_sampling_state *) state_ptr;
+
+    sampling_buffer_free(&ractor_state->sampling_buffer);
+    ruby_xfree(ractor_state->locations);
+    free(ractor_state); // See "note on calloc vs ruby_xcalloc use" in heap_recorder.c
+  }
+#endif
+
 // This method exists only to enable testing Datadog::Profiling::Collectors::ThreadContext behavior using RSpec.
 // It SHOULD NOT be used for other purposes.
 static VALUE _native_thread_list(DDTRACE_UNUSED VALUE _self) {
@@ -1131,6 +1796,27 @@ static void initialize_context(VALUE thread, per_thread_context *thread_context,
   thread_context->gc_tracking.cpu_time_at_start_ns = INVALID_TIME;
   thread_context->gc_tracking.wall_time_at_start_ns = INVALID_TIME;
 
+  // We don't know if the thread is holding the GVL right now, so we only start measuring on the next acquire
+  thread_context->gvl_contention.acquired_at_ns = INVALID_TIME;
+  thread_context->gvl_contention.histograms = NULL;
+
+  // Similarly, we only start tracking blocking on the next release
+  thread_context->blocking.off_gvl = false;
+  thread_context->blocking.is_classified = false;
+  thread_context->blocking.lookups = 0;
+  thread_context->blocking.state = DDOG_CHARSLICE_C("");
+
+  thread_context->trace_identifiers_cache.active_span = Qnil;
+  thread_context->trace_identifiers_cache.active_span_id = Qnil;
+  thread_context->otel_trace_identifiers_cache.span_id = 0;
+
+  // These will only be used when fiber profiling is enabled
+  thread_context->fibers.current_fiber = Qnil;
+  thread_context->fibers.switches = state->fiber_profiling_enabled ? st_init_numtable() : NULL;
+  thread_context->fibers.suspended = Qnil;
+  thread_context->fibers.suspended_count = 0;
+  thread_context->fibers.wall_time_at_previous_sample_ns = INVALID_TIME;
+
   #ifndef NO_GVL_INSTRUMENTATION
     // We use this special location to store data that can be accessed without any
     // kind of synchronization (e.g. by threads without the GVL).
@@ -1148,6 +1834,8 @@ static void initialize_context(VALUE thread, per_thread_context *thread_context,
 
 static void free_context(per_thread_context* thread_context) {
   sampling_buffer_free(&thread_context->sampling_buffer);
+  free(thread_context->gvl_contention.histograms);
+  if (thread_context->fibers.switches != NULL) st_free_table(thread_context->fibers.switches);
   free(thread_context); // See "note on calloc vs ruby_xcalloc use" in heap_recorder.c
 }
 
@@ -1170,6 +1858,7 @@ static VALUE _native_inspect(DDTRACE_UNUSED VALUE _self, VALUE collector_instanc
   rb_str_concat(result, rb_sprintf(" native_filenames_enabled=%"PRIsVALUE, state->native_filenames_enabled ? Qtrue : Qfalse));
   // Note: `st_table_size()` is available from Ruby 3.2+ but not before
   rb_str_concat(result, rb_sprintf(" native_filenames_cache_size=%zu", state->native_filenames_cache->num_entries));
+  rb_str_concat(result, rb_sprintf(" fiber_profiling_enabled=%"PRIsVALUE, state->fiber_profiling_enabled ? Qtrue : Qfalse));
   rb_str_concat(result, rb_sprintf(" otel_context_enabled=%d", state->otel_context_enabled));
   rb_str_concat(result, rb_sprintf(
     " time_converter_state={.system_epoch_ns_reference=%ld, .delta_to_epoch_ns=%ld}",
@@ -1180,6 +1869,11 @@ static VALUE _native_inspect(DDTRACE_UNUSED VALUE _self, VALUE collector_instanc
   rb_str_concat(result, rb_sprintf(" gc_tracking=%"PRIsVALUE, gc_tracking_as_ruby_hash(state)));
   rb_str_concat(result, rb_sprintf(" otel_current_span_key=%"PRIsVALUE, state->otel_current_span_key));
   rb_str_concat(result, rb_sprintf(" global_waiting_for_gvl_threshold_ns=%u", global_waiting_for_gvl_threshold_ns));
+  rb_str_concat(result, rb_sprintf(
+    " gvl_contention={.wait.count=%"PRIu64", .hold.count=%"PRIu64"}",
+    state->gvl_contention.wait.count,
+    state->gvl_contention.hold.count
+  ));
 
   return result;
 }
@@ -1208,6 +1902,8 @@ static int per_thread_context_as_ruby_hash(st_data_t key_thread, st_data_t value
     ID2SYM(rb_intern("gc_tracking.cpu_time_at_start_ns")),   /* => */ LONG2NUM(thread_context->gc_tracking.cpu_time_at_start_ns),
     ID2SYM(rb_intern("gc_tracking.wall_time_at_start_ns")),  /* => */ LONG2NUM(thread_context->gc_tracking.wall_time_at_start_ns),
 
+    ID2SYM(rb_intern("fibers.suspended_count")), /* => */ UINT2NUM(thread_context->fibers.suspended_count),
+
     #ifndef NO_GVL_INSTRUMENTATION
       ID2SYM(rb_intern("gvl_waiting_at")), /* => */ LONG2NUM(gvl_profiling_state_thread_object_get(thread)),
     #endif
@@ -1223,6 +1919,12 @@ static VALUE stats_as_ruby_hash(thread_context_collector_state *state) {
   VALUE arguments[] = {
     ID2SYM(rb_intern("gc_samples")),                               /* => */ UINT2NUM(state->stats.gc_samples),
     ID2SYM(rb_intern("gc_samples_missed_due_to_missing_context")), /* => */ UINT2NUM(state->stats.gc_samples_missed_due_to_missing_context),
+    ID2SYM(rb_intern("gc_events_coalesced_due_to_full_ring")),     /* => */ UINT2NUM(state->stats.gc_events_coalesced_due_to_full_ring),
+    ID2SYM(rb_intern("blocking_state_lookups")),                   /* => */ UINT2NUM(state->stats.blocking_state_lookups),
+    ID2SYM(rb_intern("blocking_state_lookup_time_ns_total")),      /* => */ ULL2NUM(state->stats.blocking_state_lookup_time_ns_total),
+    ID2SYM(rb_intern("suspended_fiber_samples")),                  /* => */ UINT2NUM(state->stats.suspended_fiber_samples),
+    ID2SYM(rb_intern("suspended_fibers_dropped")),                 /* => */ UINT2NUM(state->stats.suspended_fibers_dropped),
+    ID2SYM(rb_intern("suspended_fibers_expired")),                 /* => */ UINT2NUM(state->stats.suspended_fibers_expired),
   };
   for (long unsigned int i = 0; i < VALUE_COUNT(arguments); i += 2) rb_hash_aset(stats_as_hash, arguments[i], arguments[i+1]);
   return stats_as_hash;
@@ -1236,6 +1938,7 @@ static VALUE gc_tracking_as_ruby_hash(thread_context_collector_state *state) {
     ID2SYM(rb_intern("accumulated_wall_time_ns")),              /* => */ ULONG2NUM(state->gc_tracking.accumulated_wall_time_ns),
     ID2SYM(rb_intern("wall_time_at_previous_gc_ns")),           /* => */ LONG2NUM(state->gc_tracking.wall_time_at_previous_gc_ns),
     ID2SYM(rb_intern("wall_time_at_last_flushed_gc_event_ns")), /* => */ LONG2NUM(state->gc_tracking.wall_time_at_last_flushed_gc_event_ns),
+    ID2SYM(rb_intern("pending_gc_events")),                     /* => */ UINT2NUM(pending_gc_events(state)),
   };
   for (long unsigned int i = 0; i < VALUE_COUNT(arguments); i += 2) rb_hash_aset(result, arguments[i], arguments[i+1]);
   return result;
@@ -1319,6 +2022,62 @@ static long cpu_time_now_ns(per_thread_context *thread_context) {
   return cpu_time.result_ns;
 }
 
+// Threads that are blocked (e.g. on I/O) release the GVL, and we get told about it by the GVL instrumentation API (see
+// `thread_context_collector_on_gvl_released`). For such threads, rather than guessing what they're doing from the
+// method at the top of the stack, we ask the OS what they're blocked on.
+//
+// To keep the overhead down, we stop looking once we get an answer for a GVL release: threads that stay blocked get
+// sampled many times, and a thread can only start blocking on something else after reacquiring the GVL. The exception
+// is when the thread had released the GVL but was not yet blocked, in which case we try again on the next few samples.
+// We also stop looking altogether if the OS does not allow us to do it (see `blocking_state_lookup_available`).
+//
+// Returns an empty slice if GVL profiling is not enabled, the thread is holding the GVL, or we could not tell.
+// Safety: This function is assumed never to raise exceptions by callers
+static ddog_CharSlice blocking_state_for(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context) {
+  if (!thread_context->blocking.off_gvl) return DDOG_CHARSLICE_C("");
+
+  if (
+    !thread_context->blocking.is_classified &&
+    thread_context->blocking.lookups < MAX_BLOCKING_STATE_LOOKUPS_PER_RELEASE &&
+    blocking_state_lookup_available()
+  ) {
+    // Note: We don't cache the native thread id as it may change (e.g. with Ruby's M:N threading)
+    uint64_t tid = native_thread_id_for(thread);
+    if (tid == 0) {
+      thread_context->blocking.is_classified = true;
+      return thread_context->blocking.state;
+    }
+
+    long lookup_start_ns = monotonic_wall_time_now_ns(DO_NOT_RAISE_ON_FAILURE);
+    blocking_state_result result = blocking_state_for_native_thread(tid);
+    long lookup_finish_ns = monotonic_wall_time_now_ns(DO_NOT_RAISE_ON_FAILURE);
+
+    thread_context->blocking.state = result.state;
+    thread_context->blocking.is_classified = result.is_final;
+    thread_context->blocking.lookups++;
+    state->stats.blocking_state_lookups++;
+    if (lookup_start_ns > 0 && lookup_finish_ns >= lookup_start_ns) {
+      state->stats.blocking_state_lookup_time_ns_total += lookup_finish_ns - lookup_start_ns;
+    }
+  }
+
+  return thread_context->blocking.state;
+}
+
+static ddog_CharSlice thread_name_label_for(thread_context_collector_state *state, VALUE thread, per_thread_context *thread_context) {
+  VALUE thread_name = thread_name_for(thread);
+
+  if (thread_name != Qnil) {
+    return char_slice_from_ruby_string(thread_name);
+  } else if (thread == state->main_thread) { // Threads are often not named, but we can have a nice fallback for this special thread
+    return DDOG_CHARSLICE_C("main");
+  } else {
+    // For other threads without name, we use the "invoke location" (first file:line of the block used to start the thread), if any.
+    // This is what Ruby shows in `Thread#to_s`.
+    return thread_context->thread_invoke_location_char_slice; // This is an empty string if no invoke location was available
+  }
+}
+
 static long thread_id_for(VALUE thread) {
   VALUE object_id = rb_obj_id(thread);
 
@@ -1370,9 +2129,16 @@ static VALUE _native_gc_tracking(DDTRACE_UNUSED VALUE _self, VALUE collector_ins
 }
 
 // Assumption 1: This function is called in a thread that is holding the Global VM Lock. Caller is responsible for enforcing this.
+//
+// Threads usually stay on the same span for many samples (and allocation samples), so we cache the identifiers
+// (and the `should_collect_resource` decision) for the last span we've seen for each thread. Rather than keeping the
+// span alive, we check the cache is still valid by comparing both the span object and its id: a new span allocated
+// in the same memory location as the cached one would need to get the same (random 62-bit) id to be confused with it.
+// The endpoint is still read on every sample, as it can change at any point during a request.
 static void trace_identifiers_for(
   thread_context_collector_state *state,
   VALUE thread,
+  per_thread_context *thread_context,
   trace_identifiers *trace_identifiers_result,
   bool is_safe_to_allocate_objects
 ) {
@@ -1380,12 +2146,24 @@ static void trace_identifiers_for(
   if (state->tracer_context_key == MISSING_TRACER_CONTEXT_KEY) return;
 
   VALUE current_context = rb_thread_local_aref(thread, state->tracer_context_key);
+  trace_identifiers_from_context(state, current_context, thread_context, trace_identifiers_result, is_safe_to_allocate_objects);
+}
+
+// Extracts the trace identifiers from a tracer context (e.g. a `Datadog::Tracing::Context`).
+// `thread_context` is used for caching, and can be NULL if the context does not belong to the thread's current fiber.
+static void trace_identifiers_from_context(
+  thread_context_collector_state *state,
+  VALUE current_context,
+  per_thread_context *thread_context,
+  trace_identifiers *trace_identifiers_result,
+  bool is_safe_to_allocate_objects
+) {
   if (current_context == Qnil) return;
 
   VALUE active_trace = rb_ivar_get(current_context, at_active_trace_id /* @active_trace */);
   if (active_trace == Qnil) return;
 
-  VALUE root_span = rb_ivar_get(active_trace, at_root_span_id /* @root_span */);
+  VALUE root_span = Qnil; // Only looked up if needed
   VALUE active_span = rb_ivar_get(active_trace, at_active_span_id /* @active_span */);
   // Note: On Ruby 3.x `rb_attr_get` is exactly the same as `rb_ivar_get`. For Ruby 2.x, the difference is that
   // `rb_ivar_get` can trigger "warning: instance variable @otel_values not initialized" if warnings are enabled and
@@ -1393,30 +2171,62 @@ static void trace_identifiers_for(
   VALUE otel_values = rb_attr_get(active_trace, at_otel_values_id /* @otel_values */);
 
   VALUE numeric_span_id = Qnil;
+  bool collect_resource;
 
-  if (otel_values != Qnil) {
-    ddtrace_otel_trace_identifiers_for(state, &active_trace, &root_span, &numeric_span_id, active_span, otel_values, is_safe_to_allocate_objects);
+  if (
+    thread_context != NULL && otel_values == Qnil && active_span != Qnil &&
+    active_span == thread_context->trace_identifiers_cache.active_span
+  ) {
+    numeric_span_id = rb_ivar_get(active_span, at_id_id /* @id */);
   }
 
-  if (root_span == Qnil || (active_span == Qnil && numeric_span_id == Qnil)) return;
+  if (numeric_span_id != Qnil && numeric_span_id == thread_context->trace_identifiers_cache.active_span_id) {
+    // Cache hit: A span always belongs to the same root span, so we don't need to look at it
+    trace_identifiers_result->local_root_span_id = thread_context->trace_identifiers_cache.local_root_span_id;
+    trace_identifiers_result->span_id = thread_context->trace_identifiers_cache.span_id;
+    trace_identifiers_result->valid = true;
+    collect_resource = thread_context->trace_identifiers_cache.should_collect_resource;
+  } else {
+    numeric_span_id = Qnil;
+    root_span = rb_ivar_get(active_trace, at_root_span_id /* @root_span */);
+
+    if (otel_values != Qnil) {
+      ddtrace_otel_trace_identifiers_for(state, &active_trace, &root_span, &numeric_span_id, active_span, otel_values, is_safe_to_allocate_objects);
+    }
 
-  VALUE numeric_local_root_span_id = rb_ivar_get(root_span, at_id_id /* @id */);
-  if (active_span != Qnil && numeric_span_id == Qnil) numeric_span_id = rb_ivar_get(active_span, at_id_id /* @id */);
-  if (numeric_local_root_span_id == Qnil || numeric_span_id == Qnil) return;
+    if (root_span == Qnil || (active_span == Qnil && numeric_span_id == Qnil)) return;
 
-  trace_identifiers_result->local_root_span_id = NUM2ULL(numeric_local_root_span_id);
-  trace_identifiers_result->span_id = NUM2ULL(numeric_span_id);
+    VALUE numeric_local_root_span_id = rb_ivar_get(root_span, at_id_id /* @id */);
+    if (active_span != Qnil && numeric_span_id == Qnil) numeric_span_id = rb_ivar_get(active_span, at_id_id /* @id */);
+    if (numeric_local_root_span_id == Qnil || numeric_span_id == Qnil) return;
 
-  trace_identifiers_result->valid = true;
+    trace_identifiers_result->local_root_span_id = NUM2ULL(numeric_local_root_span_id);
+    trace_identifiers_result->span_id = NUM2ULL(numeric_span_id);
 
-  if (!state->endpoint_collection_enabled || !should_collect_resource(root_span)) return;
+    trace_identifiers_result->valid = true;
+
+    collect_resource = state->endpoint_collection_enabled && should_collect_resource(root_span);
+
+    // Only ids that are Fixnums can be safely compared by identity (see above). The otel path may swap out the active
+    // span so we skip caching it too.
+    if (thread_context != NULL && otel_values == Qnil && FIXNUM_P(numeric_span_id)) {
+      thread_context->trace_identifiers_cache.active_span = active_span;
+      thread_context->trace_identifiers_cache.active_span_id = numeric_span_id;
+      thread_context->trace_identifiers_cache.local_root_span_id = trace_identifiers_result->local_root_span_id;
+      thread_context->trace_identifiers_cache.span_id = trace_identifiers_result->span_id;
+      thread_context->trace_identifiers_cache.should_collect_resource = collect_resource;
+    }
+  }
+
+  if (!state->endpoint_collection_enabled || !collect_resource) return;
 
   VALUE trace_resource = rb_ivar_get(active_trace, at_resource_id /* @resource */);
   if (RB_TYPE_P(trace_resource, T_STRING)) {
     trace_identifiers_result->trace_endpoint = trace_resource;
   } else if (trace_resource == Qnil) {
     // Fall back to resource from span, if any
-    trace_identifiers_result->trace_endpoint = rb_ivar_get(root_span, at_resource_id /* @resource */);
+    if (root_span == Qnil) root_span = rb_ivar_get(active_trace, at_root_span_id /* @root_span */);
+    if (root_span != Qnil) trace_identifiers_result->trace_endpoint = rb_ivar_get(root_span, at_resource_id /* @resource */);
   }
 }
 
@@ -1462,12 +2272,63 @@ static VALUE _native_reset_after_fork(DDTRACE_UNUSED VALUE self, VALUE collector
   st_clear(state->hash_map_per_thread_context);
 
   state->stats = (struct stats) {}; // Resets all stats back to zero
+  // Any GC time accumulated so far belongs to the parent process
+  state->gc_tracking.wall_time_at_previous_gc_ns = INVALID_TIME;
+  state->gc_events.tail = state->gc_events.head;
+  log_histogram_reset(&state->gvl_contention.wait);
+  log_histogram_reset(&state->gvl_contention.hold);
 
   rb_funcall(state->recorder_instance, rb_intern("reset_after_fork"), 0);
 
   return Qtrue;
 }
 
+// Returns the distribution of how long threads waited for/held the GVL since the last call, both per-thread and aggregated
+// over all threads. This is used to report GVL contention alongside the profile.
+static VALUE _native_gvl_contention_stats_and_reset(DDTRACE_UNUSED VALUE self, VALUE collector_instance) {
+  thread_context_collector_state *state;
+  TypedData_Get_Struct(collector_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+  gvl_contention_stats_result per_thread = {.per_thread = rb_hash_new(), .omitted_threads = 0};
+  st_foreach(state->hash_map_per_thread_context, per_thread_gvl_contention_as_ruby_hash_and_reset, (st_data_t) &per_thread);
+
+  VALUE all_threads = rb_hash_new();
+  rb_hash_aset(all_threads, ID2SYM(rb_intern("gvl_wait")), log_histogram_as_ruby_hash(&state->gvl_contention.wait));
+  rb_hash_aset(all_threads, ID2SYM(rb_intern("gvl_hold")), log_histogram_as_ruby_hash(&state->gvl_contention.hold));
+  log_histogram_reset(&state->gvl_contention.wait);
+  log_histogram_reset(&state->gvl_contention.hold);
+
+  VALUE result = rb_hash_new();
+  rb_hash_aset(result, ID2SYM(rb_intern("all_threads")), all_threads);
+  rb_hash_aset(result, ID2SYM(rb_intern("per_thread")), per_thread.per_thread);
+  rb_hash_aset(result, ID2SYM(rb_intern("per_thread_omitted")), UINT2NUM(per_thread.omitted_threads));
+  return result;
+}
+
+static int per_thread_gvl_contention_as_ruby_hash_and_reset(DDTRACE_UNUSED st_data_t _thread, st_data_t value_context, st_data_t result_ptr) {
+  per_thread_context *thread_context = (per_thread_context*) value_context;
+  gvl_contention_stats_result *result = (gvl_contention_stats_result*) result_ptr;
+
+  gvl_contention_histograms *histograms = thread_context->gvl_contention.histograms;
+
+  // Skip threads that did not interact with the GVL (or when GVL profiling is off)
+  if (histograms == NULL || (histograms->wait.count == 0 && histograms->hold.count == 0)) return ST_CONTINUE;
+
+  if (RHASH_SIZE(result->per_thread) < MAX_GVL_CONTENTION_STATS_THREADS) {
+    VALUE thread_stats = rb_hash_new();
+    rb_hash_aset(thread_stats, ID2SYM(rb_intern("gvl_wait")), log_histogram_as_ruby_hash(&histograms->wait));
+    rb_hash_aset(thread_stats, ID2SYM(rb_intern("gvl_hold")), log_histogram_as_ruby_hash(&histograms->hold));
+    rb_hash_aset(result->per_thread, rb_str_new2(thread_context->thread_id), thread_stats);
+  } else {
+    result->omitted_threads++;
+  }
+
+  log_histogram_reset(&histograms->wait);
+  log_histogram_reset(&histograms->hold);
+
+  return ST_CONTINUE;
+}
+
 static VALUE thread_list(thread_context_collector_state *state) {
   VALUE result = state->thread_list_buffer;
   rb_ary_clear(result);
@@ -1809,6 +2670,7 @@ static VALUE _native_sample_skipped_allocation_samples(DDTRACE_UNUSED VALUE self
 static void otel_without_ddtrace_trace_identifiers_for(
   thread_context_collector_state *state,
   VALUE thread,
+  per_thread_context *thread_context,
   trace_identifiers *trace_identifiers_result,
   bool is_safe_to_allocate_objects
 ) {
@@ -1826,21 +2688,50 @@ static void otel_without_ddtrace_trace_identifiers_for(
   otel_span active_span = otel_span_from(rb_ary_entry(context_storage, active_context_index), otel_current_span_key);
   if (active_span.span == Qnil) return;
 
-  otel_span local_root_span = active_span;
+  // Convert the span ids into uint64_t to match what the Datadog tracer does
+  uint64_t active_span_id = otel_span_id_to_uint(active_span.span_id);
+  otel_span local_root_span = {.span = Qnil, .span_id = Qnil, .trace_id = Qnil};
+
+  // Finding the local root span means going through the context storage, which can get expensive for deep stacks. Since
+  // threads usually stay on the same span for many samples, we remember where we found the local root span last time,
+  // and just double-check it's still there.
+  if (active_span_id != 0 &&
+    active_span_id == thread_context->otel_trace_identifiers_cache.span_id &&
+    active_context_index == thread_context->otel_trace_identifiers_cache.active_context_index
+  ) {
+    long local_root_context_index = thread_context->otel_trace_identifiers_cache.local_root_context_index;
+    otel_span cached_local_root_span = local_root_context_index == active_context_index ?
+      active_span : otel_span_from(rb_ary_entry(context_storage, local_root_context_index), otel_current_span_key);
+
+    if (cached_local_root_span.span != Qnil &&
+      otel_span_id_to_uint(cached_local_root_span.span_id) == thread_context->otel_trace_identifiers_cache.local_root_span_id) {
+      local_root_span = cached_local_root_span;
+    }
+  }
+
+  if (local_root_span.span == Qnil) {
+    local_root_span = active_span;
+    long local_root_context_index = active_context_index;
 
-  // Now find the oldest span starting from the active span that still has the same trace id as the active span
-  for (long i = active_context_index - 1; i >= 0; i--) {
-    otel_span checking_span = otel_span_from(rb_ary_entry(context_storage, i), otel_current_span_key);
-    if (checking_span.span == Qnil) return;
+    // Now find the oldest span starting from the active span that still has the same trace id as the active span
+    for (long i = active_context_index - 1; i >= 0; i--) {
+      otel_span checking_span = otel_span_from(rb_ary_entry(context_storage, i), otel_current_span_key);
+      if (checking_span.span == Qnil) return;
 
-    if (rb_str_equal(active_span.trace_id, checking_span.trace_id) == Qfalse) break;
+      if (rb_str_equal(active_span.trace_id, checking_span.trace_id) == Qfalse) break;
 
-    local_root_span = checking_span;
+      local_root_span = checking_span;
+      local_root_context_index = i;
+    }
+
+    thread_context->otel_trace_identifiers_cache.span_id = active_span_id;
+    thread_context->otel_trace_identifiers_cache.local_root_span_id = otel_span_id_to_uint(local_root_span.span_id);
+    thread_context->otel_trace_identifiers_cache.active_context_index = active_context_index;
+    thread_context->otel_trace_identifiers_cache.local_root_context_index = local_root_context_index;
   }
 
-  // Convert the span ids into uint64_t to match what the Datadog tracer does
-  trace_identifiers_result->span_id = otel_span_id_to_uint(active_span.span_id);
-  trace_identifiers_result->local_root_span_id = otel_span_id_to_uint(local_root_span.span_id);
+  trace_identifiers_result->span_id = active_span_id;
+  trace_identifiers_result->local_root_span_id = thread_context->otel_trace_identifiers_cache.local_root_span_id;
 
   if (trace_identifiers_result->span_id == 0 || trace_identifiers_result->local_root_span_id == 0) return;
 
@@ -1951,6 +2842,61 @@ static uint64_t otel_span_id_to_uint(VALUE otel_span_id) {
     return thread_context_collector_on_gvl_running_with_threshold(thread, global_waiting_for_gvl_threshold_ns);
   }
 
+  // The per-thread histograms are only allocated once a thread actually interacts with the GVL, so that
+  // per_thread_context stays small when GVL profiling is disabled. Returns NULL if allocation fails.
+  static gvl_contention_histograms *gvl_contention_histograms_for(per_thread_context *thread_context) {
+    if (thread_context->gvl_contention.histograms == NULL) {
+      thread_context->gvl_contention.histograms = calloc(1, sizeof(gvl_contention_histograms)); // See "note on calloc vs ruby_xcalloc use" in heap_recorder.c
+    }
+    return thread_context->gvl_contention.histograms;
+  }
+
+  // This function MUST only be called while holding the GVL, for threads of the main Ractor (e.g. after
+  // `thread_context_collector_on_gvl_running` returned something other than ON_GVL_RUNNING_UNKNOWN).
+  //
+  // `waiting_for_gvl_duration_ns` can be INVALID_TIME if the duration of the wait is not known.
+  void thread_context_collector_on_gvl_acquired(VALUE self_instance, VALUE thread, long waiting_for_gvl_duration_ns, long current_monotonic_wall_time_ns) {
+    thread_context_collector_state *state;
+    TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+    per_thread_context *thread_context = get_context_for(thread, state);
+    if (thread_context == NULL) return;
+
+    if (waiting_for_gvl_duration_ns >= 0) {
+      gvl_contention_histograms *histograms = gvl_contention_histograms_for(thread_context);
+      if (histograms != NULL) log_histogram_add(&histograms->wait, waiting_for_gvl_duration_ns);
+      log_histogram_add(&state->gvl_contention.wait, waiting_for_gvl_duration_ns);
+    }
+
+    thread_context->gvl_contention.acquired_at_ns = current_monotonic_wall_time_ns > 0 ? current_monotonic_wall_time_ns : INVALID_TIME;
+    thread_context->blocking.off_gvl = false;
+  }
+
+  // This function MUST only be called while holding the GVL (e.g. from RUBY_INTERNAL_THREAD_EVENT_SUSPENDED, which gets
+  // called just before a thread releases it), for threads of the main Ractor.
+  void thread_context_collector_on_gvl_released(VALUE self_instance, VALUE thread, long current_monotonic_wall_time_ns) {
+    thread_context_collector_state *state;
+    TypedData_Get_Struct(self_instance, thread_context_collector_state, &thread_context_collector_typed_data, state);
+
+    per_thread_context *thread_context = get_context_for(thread, state);
+    if (thread_context == NULL) return;
+
+    thread_context->blocking.off_gvl = true;
+    thread_context->blocking.is_classified = false;
+    thread_context->blocking.lookups = 0;
+    thread_context->blocking.state = DDOG_CHARSLICE_C("");
+
+    long acquired_at_ns = thread_context->gvl_contention.acquired_at_ns;
+    thread_context->gvl_contention.acquired_at_ns = INVALID_TIME;
+
+    if (acquired_at_ns == INVALID_TIME || current_monotonic_wall_time_ns < acquired_at_ns) return;
+
+    long holding_gvl_duration_ns = current_monotonic_wall_time_ns - acquired_at_ns;
+    gvl_contention_histograms *histograms = gvl_contention_histograms_for(thread_context);
+    if (histograms != NULL) log_histogram_add(&histograms->hold, holding_gvl_duration_ns);
+    log_histogram_add(&state->gvl_contention.hold, holding_gvl_duration_ns);
+  }
+
   // Why does this method need to exist?
   //
   // You may be surprised to see that if we never call this function (from cpu_and_wall_time_worker), Waiting for GVL
@@ -1962,9 +2908,9 @@ static uint64_t otel_span_id_to_uint(VALUE otel_span_id) {
   // returning true is to ensure accuracy of both the timing and stack for the Waiting for GVL sample.
   //
   // Timing:
-  // Because we currently only record the timestamp when the Waiting for GVL started and not when the Waiting for GVL ended,
-  // we rely on pushing a sample as soon as possible when the Waiting for GVL ends so that the timestamp of the sample
-  // actually matches when we stopped waiting.
+  // The thread-specific GVL state only records the timestamp when the Waiting for GVL started and not when the Waiting for
+  // GVL ended, so we rely on the caller passing in the time at which the thread resumed, so that the timestamp of the
+  // sample actually matches when we stopped waiting.
   //
   // Stack:
   // If the thread starts working without the end of the Waiting for GVL sample, then by the time the thread is sampled
@@ -2186,6 +3132,22 @@ static uint64_t otel_span_id_to_uint(VALUE otel_span_id) {
     return Qtrue;
   }
 
+  static VALUE _native_on_gvl_acquired(DDTRACE_UNUSED VALUE self, VALUE collector_instance, VALUE thread, VALUE waiting_for_gvl_duration_ns, VALUE current_monotonic_wall_time_ns) {
+    ENFORCE_THREAD(thread);
+
+    thread_context_collector_on_gvl_acquired(collector_instance, thread, NUM2LONG(waiting_for_gvl_duration_ns), NUM2LONG(current_monotonic_wall_time_ns));
+
+    return Qtrue;
+  }
+
+  static VALUE _native_on_gvl_released(DDTRACE_UNUSED VALUE self, VALUE collector_instance, VALUE thread, VALUE current_monotonic_wall_time_ns) {
+    ENFORCE_THREAD(thread);
+
+    thread_context_collector_on_gvl_released(collector_instance, thread, NUM2LONG(current_monotonic_wall_time_ns));
+
+    return Qtrue;
+  }
+
 #else
   static bool handle_gvl_waiting(
     DDTRACE_UNUSED thread_context_collector_state *state,
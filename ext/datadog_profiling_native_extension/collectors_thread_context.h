@@ -17,6 +17,11 @@ void thread_context_collector_sample_skipped_allocation_samples(VALUE self_insta
 VALUE thread_context_collector_sample_after_gc(VALUE self_instance);
 void thread_context_collector_on_gc_start(VALUE self_instance);
 __attribute__((warn_unused_result)) bool thread_context_collector_on_gc_finish(VALUE self_instance);
+bool thread_context_collector_fiber_profiling_enabled(VALUE self_instance);
+void thread_context_collector_on_fiber_switch(VALUE self_instance);
+#ifndef NO_RACTOR_SAMPLING
+  void thread_context_collector_sample_current_ractor(VALUE self_instance, long current_monotonic_wall_time_ns);
+#endif
 VALUE enforce_thread_context_collector_instance(VALUE object);
 
 
@@ -30,4 +35,6 @@ VALUE enforce_thread_context_collector_instance(VALUE object);
   void thread_context_collector_on_gvl_waiting(gvl_profiling_thread thread);
   __attribute__((warn_unused_result)) on_gvl_running_result thread_context_collector_on_gvl_running(gvl_profiling_thread thread);
   VALUE thread_context_collector_sample_after_gvl_running(VALUE self_instance, VALUE current_thread, long current_monotonic_wall_time_ns);
+  void thread_context_collector_on_gvl_acquired(VALUE self_instance, VALUE thread, long waiting_for_gvl_duration_ns, long current_monotonic_wall_time_ns);
+  void thread_context_collector_on_gvl_released(VALUE self_instance, VALUE thread, long current_monotonic_wall_time_ns);
 #endif
@@ -0,0 +1,241 @@
+#include <ruby.h>
+#include <string.h>
+
+#include "custom_labels.h"
+#include "datadog_ruby_common.h"
+#include "private_vm_api_access.h"
+#include "ruby_helpers.h"
+
+// This file implements the native bits of the Datadog::Profiling::CustomLabels module. See custom_labels.h for details.
+
+// Keys and values share the same table. Once it's full, new keys get dropped and new values get reported as
+// OVERFLOW_VALUE, so this is also the maximum number of distinct custom labels that can show up in profiles.
+#define MAX_INTERNED_STRINGS 1024
+#define MAX_STRING_LENGTH 128
+#define OVERFLOW_VALUE_ID MAX_INTERNED_STRINGS
+#define OVERFLOW_VALUE "other"
+
+// Labels set by the profiler itself; allowing custom labels with these keys would mean having duplicate keys in a sample
+static const char *reserved_keys[] = {
+  "thread id", "thread name", "local root span id", "span id", "trace endpoint", "profiler overhead", "ruby vm type",
+  "allocation class", "state", "gc cause", "gc type", "gc reason", "event", "fiber state", "ractor id",
+};
+
+typedef struct {
+  uint16_t key_id;
+  uint16_t value_id;
+} custom_label;
+
+// Every fiber that uses custom labels gets one of these, stored in a fiber-local variable
+typedef struct {
+  uint8_t count;
+  custom_label labels[CUSTOM_LABELS_MAX_PER_FIBER];
+} custom_labels_context;
+
+// Process-wide table of interned keys and values. Interned strings are never freed, as samples may point at them.
+//
+// Since Ruby code is only allowed to push labels from the main Ractor (while holding the GVL), and samples are also
+// taken while holding the GVL, this table doesn't need any extra synchronization.
+static struct {
+  st_table *ids_by_string;
+  ddog_CharSlice strings[MAX_INTERNED_STRINGS];
+  uint16_t count;
+  // Stats
+  unsigned long dropped_labels;
+  unsigned long overflowed_values;
+} interned;
+
+static ID custom_labels_context_id; // id of :__datadog_profiling_custom_labels__ in Ruby
+
+static VALUE _native_push(DDTRACE_UNUSED VALUE _self, VALUE key, VALUE value);
+static VALUE _native_pop(DDTRACE_UNUSED VALUE _self, VALUE count);
+static VALUE _native_stats(DDTRACE_UNUSED VALUE _self);
+static VALUE _native_reset_interned_strings(DDTRACE_UNUSED VALUE _self);
+static custom_labels_context *custom_labels_context_for(VALUE thread, bool create_if_missing);
+static uint16_t intern_string(VALUE string);
+static ddog_CharSlice interned_string_for(uint16_t id);
+static bool is_reserved_key(const char *key);
+static uint8_t write_labels(custom_labels_context *context, ddog_prof_Label *labels);
+static bool is_shadowed(custom_labels_context *context, uint8_t index);
+
+void custom_labels_init(VALUE profiling_module) {
+  VALUE custom_labels_module = rb_define_module_under(profiling_module, "CustomLabels");
+  // Hosts methods used for testing the native code using RSpec
+  VALUE testing_module = rb_define_module_under(custom_labels_module, "Testing");
+
+  rb_define_singleton_method(custom_labels_module, "_native_push", _native_push, 2);
+  rb_define_singleton_method(custom_labels_module, "_native_pop", _native_pop, 1);
+  rb_define_singleton_method(custom_labels_module, "_native_stats", _native_stats, 0);
+  rb_define_singleton_method(testing_module, "_native_reset_interned_strings", _native_reset_interned_strings, 0);
+
+  custom_labels_context_id = rb_intern_const("__datadog_profiling_custom_labels__");
+  interned.ids_by_string = st_init_strtable();
+}
+
+static const rb_data_type_t custom_labels_context_typed_data = {
+  .wrap_struct_name = "Datadog::Profiling::CustomLabels::Context",
+  .function = {
+    .dmark = NULL, // We don't store references to Ruby objects so we don't need to mark any of them
+    .dfree = RUBY_DEFAULT_FREE,
+    .dsize = NULL, // We don't track memory usage (although it'd be cool if we did!)
+    //.dcompact = NULL, // Not needed -- we don't store references to Ruby objects
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+// Returns true if the label was pushed, or false if it was dropped (and thus should not be popped)
+static VALUE _native_push(DDTRACE_UNUSED VALUE _self, VALUE key, VALUE value) {
+  ENFORCE_TYPE(key, T_STRING);
+  ENFORCE_TYPE(value, T_STRING);
+
+  if (RSTRING_LEN(key) > MAX_STRING_LENGTH || RSTRING_LEN(value) > MAX_STRING_LENGTH) {
+    raise_error(rb_eArgError, "Custom label keys and values must be at most %d bytes long", MAX_STRING_LENGTH);
+  }
+  if (is_reserved_key(StringValueCStr(key))) {
+    raise_error(rb_eArgError, "Custom label key %"PRIsVALUE" is reserved for use by the profiler", key);
+  }
+  StringValueCStr(value); // Validate there's no embedded NUL bytes
+
+  // See comment on `interned` for why we don't support other Ractors
+  if (!ddtrace_rb_ractor_main_p()) return Qfalse;
+
+  custom_labels_context *context = custom_labels_context_for(rb_thread_current(), true);
+
+  uint16_t key_id = context->count < CUSTOM_LABELS_MAX_PER_FIBER ? intern_string(key) : OVERFLOW_VALUE_ID;
+  if (key_id == OVERFLOW_VALUE_ID) {
+    interned.dropped_labels++;
+    return Qfalse;
+  }
+
+  uint16_t value_id = intern_string(value);
+  if (value_id == OVERFLOW_VALUE_ID) interned.overflowed_values++;
+
+  context->labels[context->count++] = (custom_label) {.key_id = key_id, .value_id = value_id};
+  return Qtrue;
+}
+
+static VALUE _native_pop(DDTRACE_UNUSED VALUE _self, VALUE count) {
+  ENFORCE_TYPE(count, T_FIXNUM);
+
+  if (!ddtrace_rb_ractor_main_p()) return Qnil;
+
+  custom_labels_context *context = custom_labels_context_for(rb_thread_current(), false);
+  if (context == NULL) return Qnil;
+
+  long to_pop = FIX2LONG(count);
+  context->count = to_pop >= context->count ? 0 : context->count - to_pop;
+
+  return Qnil;
+}
+
+static VALUE _native_stats(DDTRACE_UNUSED VALUE _self) {
+  VALUE stats_as_hash = rb_hash_new();
+  VALUE arguments[] = {
+    ID2SYM(rb_intern("interned_strings")),  /* => */ UINT2NUM(interned.count),
+    ID2SYM(rb_intern("dropped_labels")),    /* => */ ULONG2NUM(interned.dropped_labels),
+    ID2SYM(rb_intern("overflowed_values")), /* => */ ULONG2NUM(interned.overflowed_values),
+  };
+  for (long unsigned int i = 0; i < VALUE_COUNT(arguments); i += 2) rb_hash_aset(stats_as_hash, arguments[i], arguments[i+1]);
+  return stats_as_hash;
+}
+
+// This method exists only to enable testing Datadog::Profiling::CustomLabels behavior using RSpec.
+// It SHOULD NOT be used for other purposes.
+//
+// Any labels still active will be reported with whatever strings get interned next, so make sure to pop them first.
+static VALUE _native_reset_interned_strings(DDTRACE_UNUSED VALUE _self) {
+  st_clear(interned.ids_by_string);
+  for (uint16_t i = 0; i < interned.count; i++) {
+    ruby_xfree((void *) interned.strings[i].ptr);
+    interned.strings[i] = (ddog_CharSlice) {0};
+  }
+  interned.count = 0;
+  interned.dropped_labels = 0;
+  interned.overflowed_values = 0;
+
+  return Qtrue;
+}
+
+uint8_t custom_labels_for_thread(VALUE thread, ddog_prof_Label *labels) {
+  return write_labels(custom_labels_context_for(thread, false), labels);
+}
+
+uint8_t custom_labels_for_suspended_fiber(VALUE fiber, ddog_prof_Label *labels) {
+  VALUE context = fiber_local_aref(fiber, custom_labels_context_id);
+  if (context == Qnil || !rb_typeddata_is_kind_of(context, &custom_labels_context_typed_data)) return 0;
+
+  return write_labels((custom_labels_context *) RTYPEDDATA_DATA(context), labels);
+}
+
+// Nested `with_labels` calls may push the same key more than once; only the innermost (latest) value is reported, since
+// samples must not have duplicate label keys. The outer value is kept on the stack so it's back in effect after the pop.
+static uint8_t write_labels(custom_labels_context *context, ddog_prof_Label *labels) {
+  if (context == NULL) return 0;
+
+  uint8_t written = 0;
+  for (uint8_t i = 0; i < context->count; i++) {
+    if (is_shadowed(context, i)) continue;
+
+    labels[written++] = (ddog_prof_Label) {
+      .key = interned_string_for(context->labels[i].key_id),
+      .str = interned_string_for(context->labels[i].value_id),
+      .num = 0, // This shouldn't be needed but the tracer-2.7 docker image ships a buggy gcc that complains about this
+    };
+  }
+
+  return written;
+}
+
+static bool is_shadowed(custom_labels_context *context, uint8_t index) {
+  for (uint8_t i = index + 1; i < context->count; i++) {
+    if (context->labels[i].key_id == context->labels[index].key_id) return true;
+  }
+  return false;
+}
+
+// Safety: Does not raise or allocate when `create_if_missing` is false.
+static custom_labels_context *custom_labels_context_for(VALUE thread, bool create_if_missing) {
+  // Note: This returns the variable for the fiber currently running on the thread, which is exactly what we want
+  VALUE context = rb_thread_local_aref(thread, custom_labels_context_id);
+
+  if (context != Qnil && rb_typeddata_is_kind_of(context, &custom_labels_context_typed_data)) {
+    return (custom_labels_context *) RTYPEDDATA_DATA(context);
+  }
+
+  if (!create_if_missing) return NULL;
+
+  custom_labels_context *new_context;
+  context = TypedData_Make_Struct(rb_cObject, custom_labels_context, &custom_labels_context_typed_data, new_context);
+  rb_thread_local_aset(thread, custom_labels_context_id, context);
+  return new_context;
+}
+
+// Returns OVERFLOW_VALUE_ID if the string was not yet interned and there's no more space
+static uint16_t intern_string(VALUE string) {
+  st_data_t id;
+  if (st_lookup(interned.ids_by_string, (st_data_t) RSTRING_PTR(string), &id)) return (uint16_t) id;
+
+  if (interned.count >= MAX_INTERNED_STRINGS) return OVERFLOW_VALUE_ID;
+
+  long length = RSTRING_LEN(string);
+  char *copy = ruby_xmalloc(length + 1);
+  memcpy(copy, RSTRING_PTR(string), length);
+  copy[length] = '\0';
+
+  uint16_t new_id = interned.count++;
+  interned.strings[new_id] = (ddog_CharSlice) {.ptr = copy, .len = length};
+  st_insert(interned.ids_by_string, (st_data_t) copy, (st_data_t) new_id);
+
+  return new_id;
+}
+
+static ddog_CharSlice interned_string_for(uint16_t id) {
+  return id == OVERFLOW_VALUE_ID ? DDOG_CHARSLICE_C(OVERFLOW_VALUE) : interned.strings[id];
+}
+
+static bool is_reserved_key(const char *key) {
+  for (size_t i = 0; i < sizeof(reserved_keys) / sizeof(reserved_keys[0]); i++) {
+    if (strcmp(key, reserved_keys[i]) == 0) return true;
+  }
+  return false;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ruby.h>
+#include <stdint.h>
+#include <datadog/profiling.h>
+
+// Custom labels are application-defined labels (e.g. tenant, feature flag) that get attached to every sample taken
+// while they are active. See `Datadog::Profiling.with_labels` for the Ruby API.
+//
+// They are stored per-fiber, so every fiber starts without any custom labels active.
+//
+// Keys and values get interned into a process-wide table with a fixed capacity; this makes pushing/popping labels
+// cheap, and keeps a hard cap on how many distinct labels the profiler will ever report, so that an application using
+// e.g. request ids as label values can't blow up profile memory.
+
+#define CUSTOM_LABELS_MAX_PER_FIBER 8
+
+// Writes the custom labels active for the fiber currently running on `thread` into `labels`, returning how many were
+// written (at most CUSTOM_LABELS_MAX_PER_FIBER). Keys are unique: if a key was pushed more than once, only the latest
+// value gets written.
+//
+// The returned labels point at interned strings, which are never freed, so they are safe to use after the labels get
+// popped.
+//
+// Safety: This function is assumed never to raise exceptions by callers. It does not allocate.
+uint8_t custom_labels_for_thread(VALUE thread, ddog_prof_Label *labels);
+
+// Same as above, but for a fiber that is not running (see `fiber_local_aref`)
+uint8_t custom_labels_for_suspended_fiber(VALUE fiber, ddog_prof_Label *labels);
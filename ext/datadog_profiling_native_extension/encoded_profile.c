@@ -1,3 +1,8 @@
+#include <ruby.h>
+#include <ruby/thread.h>
+#include <errno.h>
+#include <unistd.h>
+
 #include "encoded_profile.h"
 #include "datadog_ruby_common.h"
 #include "libdatadog_helpers.h"
@@ -6,8 +11,27 @@
 // This class exists to wrap a ddog_prof_EncodedProfile into a Ruby object
 // This file implements the native bits of the Datadog::Profiling::EncodedProfile class
 
+typedef struct {
+  ddog_prof_EncodedProfile profile;
+  // While > 0, the profile bytes are being used without the GVL (see `_native_write_to_fd`), so the profile must not
+  // be handed over to anything that may drop it (such as the exporter)
+  unsigned int writes_in_progress;
+} encoded_profile_state;
+
+typedef struct {
+  encoded_profile_state *state;
+  ddog_ByteSlice bytes;
+  int fd;
+  size_t bytes_written;
+  int error;
+} write_to_fd_arguments;
+
 static void encoded_profile_typed_data_free(void *state_ptr);
 static VALUE _native_bytes(VALUE self);
+static VALUE _native_write_to_fd(VALUE self, VALUE fd);
+static VALUE write_to_fd(VALUE write_args);
+static void *write_to_fd_without_gvl(void *write_args);
+static VALUE write_to_fd_ensure(VALUE write_args);
 
 static VALUE encoded_profile_class = Qnil;
 
@@ -18,6 +42,7 @@ void encoded_profile_init(VALUE profiling_module) {
   rb_global_variable(&encoded_profile_class);
 
   rb_define_method(encoded_profile_class, "_native_bytes", _native_bytes, 0);
+  rb_define_method(encoded_profile_class, "_native_write_to_fd", _native_write_to_fd, 1);
 }
 
 // This structure is used to define a Ruby object that stores a `ddog_prof_EncodedProfile`
@@ -34,8 +59,8 @@ static const rb_data_type_t encoded_profile_typed_data = {
 };
 
 VALUE from_ddog_prof_EncodedProfile(ddog_prof_EncodedProfile profile) {
-  ddog_prof_EncodedProfile *state = ruby_xcalloc(1, sizeof(ddog_prof_EncodedProfile));
-  *state = profile;
+  encoded_profile_state *state = ruby_xcalloc(1, sizeof(encoded_profile_state));
+  state->profile = profile;
   return TypedData_Wrap_Struct(encoded_profile_class, &encoded_profile_typed_data, state);
 }
 
@@ -47,33 +72,96 @@ static ddog_ByteSlice get_bytes(ddog_prof_EncodedProfile *state) {
   return raw_bytes.ok;
 }
 
-static ddog_prof_EncodedProfile *internal_to_ddog_prof_EncodedProfile(VALUE object) {
-  ddog_prof_EncodedProfile *state;
-  TypedData_Get_Struct(object, ddog_prof_EncodedProfile, &encoded_profile_typed_data, state);
+static encoded_profile_state *encoded_profile_state_for(VALUE object) {
+  encoded_profile_state *state;
+  TypedData_Get_Struct(object, encoded_profile_state, &encoded_profile_typed_data, state);
   return state;
 }
 
 ddog_prof_EncodedProfile *to_ddog_prof_EncodedProfile(VALUE object) {
-  ddog_prof_EncodedProfile *state = internal_to_ddog_prof_EncodedProfile(object);
-  get_bytes(state); // Validate profile is still usable -- if it's not, this will raise an exception
-  return state;
+  encoded_profile_state *state = encoded_profile_state_for(object);
+  if (state->writes_in_progress > 0) raise_error(rb_eRuntimeError, "Cannot use profile while it's being written");
+  get_bytes(&state->profile); // Validate profile is still usable -- if it's not, this will raise an exception
+  return &state->profile;
+}
+
+ddog_prof_EncodedProfile take_ddog_prof_EncodedProfile(VALUE object) {
+  ddog_prof_EncodedProfile *profile = to_ddog_prof_EncodedProfile(object);
+  ddog_prof_EncodedProfile taken = *profile;
+  *profile = (ddog_prof_EncodedProfile) {0};
+  return taken;
 }
 
 static void encoded_profile_typed_data_free(void *state_ptr) {
-  ddog_prof_EncodedProfile *state = (ddog_prof_EncodedProfile *) state_ptr;
+  encoded_profile_state *state = (encoded_profile_state *) state_ptr;
 
   // This drops the profile itself
-  ddog_prof_EncodedProfile_drop(state);
+  ddog_prof_EncodedProfile_drop(&state->profile);
 
-  // This drops the tiny bit of memory we allocated to contain the ` ddog_prof_EncodedProfile` struct
+  // This drops the tiny bit of memory we allocated to contain the `encoded_profile_state` struct
   ruby_xfree(state);
 }
 
 static VALUE _native_bytes(VALUE self) {
-  ddog_ByteSlice bytes = get_bytes(internal_to_ddog_prof_EncodedProfile(self));
+  ddog_ByteSlice bytes = get_bytes(&encoded_profile_state_for(self)->profile);
   return rb_str_new((const char *) bytes.ptr, bytes.len);
 }
 
+// Writes the profile bytes directly to the given file descriptor, without copying them into a Ruby string first.
+// Returns the number of bytes written.
+static VALUE _native_write_to_fd(VALUE self, VALUE fd) {
+  ENFORCE_TYPE(fd, T_FIXNUM);
+
+  encoded_profile_state *state = encoded_profile_state_for(self);
+  write_to_fd_arguments args = {.state = state, .bytes = get_bytes(&state->profile), .fd = FIX2INT(fd)};
+
+  state->writes_in_progress++;
+  return rb_ensure(write_to_fd, (VALUE) &args, write_to_fd_ensure, (VALUE) &args);
+}
+
+static VALUE write_to_fd(VALUE write_args) {
+  write_to_fd_arguments *args = (write_to_fd_arguments *) write_args;
+
+  while (args->bytes_written < args->bytes.len) {
+    rb_thread_call_without_gvl(write_to_fd_without_gvl, args, RUBY_UBF_IO, NULL);
+
+    if (args->error == EINTR) {
+      // We got interrupted by Ruby (or a signal): let Ruby process any pending interrupts (which may raise, e.g. if the
+      // thread got killed) and then continue where we left off
+      args->error = 0;
+      rb_thread_check_ints();
+    } else if (args->error == EAGAIN || args->error == EWOULDBLOCK) {
+      // Ruby sets sockets and pipes as non-blocking, so we need to wait for them to be ready
+      args->error = 0;
+      rb_thread_fd_writable(args->fd);
+    } else if (args->error != 0) {
+      rb_syserr_fail(args->error, "Failed to write profile");
+    }
+  }
+
+  return SIZET2NUM(args->bytes_written);
+}
+
+static void *write_to_fd_without_gvl(void *write_args) {
+  write_to_fd_arguments *args = (write_to_fd_arguments *) write_args;
+
+  while (args->bytes_written < args->bytes.len) {
+    ssize_t result = write(args->fd, args->bytes.ptr + args->bytes_written, args->bytes.len - args->bytes_written);
+    if (result < 0) {
+      args->error = errno;
+      break;
+    }
+    args->bytes_written += result;
+  }
+
+  return NULL; // Unused
+}
+
+static VALUE write_to_fd_ensure(VALUE write_args) {
+  ((write_to_fd_arguments *) write_args)->state->writes_in_progress--;
+  return Qnil;
+}
+
 VALUE enforce_encoded_profile_instance(VALUE object) {
   ENFORCE_TYPED_DATA(object, &encoded_profile_typed_data);
   return object;
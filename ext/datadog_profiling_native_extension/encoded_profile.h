@@ -6,3 +6,5 @@
 VALUE from_ddog_prof_EncodedProfile(ddog_prof_EncodedProfile profile);
 VALUE enforce_encoded_profile_instance(VALUE object);
 ddog_prof_EncodedProfile *to_ddog_prof_EncodedProfile(VALUE object);
+// Moves the profile out of the Ruby object, which can't be used afterwards (same as after it gets sent)
+ddog_prof_EncodedProfile take_ddog_prof_EncodedProfile(VALUE object);
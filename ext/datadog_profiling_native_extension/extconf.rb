@@ -167,6 +167,12 @@ $defs << "-DNO_RACTOR_HEADER_INCLUDE" if RUBY_VERSION < "3.3"
 # On older Rubies, some of the Ractor internal APIs were directly accessible
 $defs << "-DUSE_RACTOR_INTERNAL_APIS_DIRECTLY" if RUBY_VERSION < "3.3"
 
+# Sampling non-main Ractors relies on the `rb_postponed_job_preregister`/`rb_postponed_job_trigger` APIs (which don't
+# guarantee the job runs on the Ractor that triggered it; see "Note on sampling non-main Ractors" in
+# collectors_cpu_and_wall_time_worker.c for how we deal with that), as well as on the GVL instrumentation API firing
+# for threads of every Ractor, so we only support it on 3.3+
+$defs << "-DNO_RACTOR_SAMPLING" if RUBY_VERSION < "3.3"
+
 # On older Rubies, there was no GVL instrumentation API and APIs created to support it
 $defs << "-DNO_GVL_INSTRUMENTATION" if RUBY_VERSION < "3.2"
 
@@ -189,6 +195,10 @@ $defs << "-DNO_PRIMITIVE_POP" if RUBY_VERSION < "3.2"
 # use-case is only for 3.1+, we didn't bother supporting it farther back yet.
 $defs << "-DNO_CURRENT_FIBER_FOR" if RUBY_VERSION < "3.1"
 
+# Reading the fiber-local variables of suspended fibers relies on copying the VM's id_table struct, which we've only
+# checked up to Ruby 3.4 (see `fiber_local_aref` in private_vm_api_access.c)
+$defs << "-DNO_SUSPENDED_FIBER_LOCALS" if RUBY_VERSION < "3.1" || RUBY_VERSION >= "3.5"
+
 # On older Rubies, there was no tid member in the internal thread structure
 $defs << "-DNO_THREAD_TID" if RUBY_VERSION < "3.1"
 
@@ -24,6 +24,10 @@
     return thread_from_thread_object(event_data->thread);
   }
 
+  static inline VALUE thread_object_from_thread(gvl_profiling_thread thread) {
+    return thread.thread;
+  }
+
   static inline intptr_t gvl_profiling_state_get(gvl_profiling_thread thread) {
     return (intptr_t) rb_internal_thread_specific_get(thread.thread, gvl_waiting_tls_key);
   }
@@ -52,11 +56,17 @@
   // Implementing these on Ruby 3.2 requires access to private VM things, so the following methods are
   // implemented in `private_vm_api_access.c`
   gvl_profiling_thread thread_from_thread_object(VALUE thread);
+  VALUE thread_object_from_thread(gvl_profiling_thread thread);
   intptr_t gvl_profiling_state_get(gvl_profiling_thread thread);
   void gvl_profiling_state_set(gvl_profiling_thread thread, intptr_t value);
 #endif
 
 #ifndef NO_GVL_INSTRUMENTATION // For all Rubies supporting GVL profiling (3.2+)
+  // This is used as a placeholder to mark threads that are allowed to be profiled (enabled)
+  // (e.g. to avoid trying to gvl profile threads that are not from the main Ractor)
+  // and for which there's no data yet
+  #define GVL_WAITING_ENABLED_EMPTY RUBY_FIXNUM_MAX
+
   static inline intptr_t gvl_profiling_state_thread_object_get(VALUE thread) {
     return gvl_profiling_state_get(thread_from_thread_object(thread));
   }
@@ -1,6 +1,17 @@
 #include <ruby.h>
 #include <ruby/thread.h>
 #include <datadog/profiling.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 #include "helpers.h"
 #include "libdatadog_helpers.h"
 #include "ruby_helpers.h"
@@ -14,6 +25,82 @@ static VALUE error_symbol = Qnil; // :error in Ruby
 
 static VALUE library_version_string = Qnil;
 
+static VALUE async_exporter_class = Qnil;
+
+// Async export: Instead of creating an exporter and blocking on every export, `HttpTransport` can instead keep a
+// single exporter around, and hand over profiles to a native background thread that reports them.
+//
+// The queue is bounded: if profiles are coming in faster than they can be reported, new ones get dropped. After a
+// failed export, the background thread waits before reporting the next profile, doubling the wait on every consecutive
+// failure (up to a maximum). The failed profile itself is not retried: libdatadog consumes profiles when sending them.
+//
+// For that reason, when reporting to the agent, after a failed export the background thread checks that the agent is
+// accepting connections before handing it the next profile. While it isn't (e.g. it's being restarted), profiles are
+// held in the queue (rather than lost to failed exports) and then reported in order once the agent is back.
+// This check is only done after failures, so that the happy path doesn't pay for an extra connection (and a
+// possibly-blocking hostname lookup) on every export.
+//
+// The background thread gets stopped by `HttpTransport#stop`. If the async exporter gets garbage collected while the
+// thread is still running, we don't wait for it (it may be stuck resolving the agent hostname, which can't be
+// cancelled); instead, the thread takes ownership of the state and frees it when it finishes.
+#define ASYNC_EXPORT_INITIAL_BACKOFF_MS 1000
+#define ASYNC_EXPORT_MAXIMUM_BACKOFF_MS (60 * 1000)
+#define ASYNC_EXPORT_FAILURE_MESSAGE_SIZE 256
+#define ASYNC_EXPORT_AGENT_CHECK_TIMEOUT_MS 1000
+
+// A copy of everything needed to report a `Flush`. The strings are copied to the end of the same memory block.
+typedef struct {
+  ddog_prof_EncodedProfile profile;
+  ddog_Vec_Tag tags;
+  bool have_code_provenance;
+  ddog_prof_Exporter_File code_provenance;
+  ddog_CharSlice internal_metadata;
+  ddog_CharSlice info;
+  ddog_CharSlice process_tags;
+  char strings[];
+} async_export_job;
+
+typedef struct {
+  // These are immutable after initialization (unless we forked, see `async_exporter_restart_after_fork`)
+  VALUE exporter_configuration;
+  ddog_prof_ProfileExporter exporter;
+  pid_t pid; // Process that started the background thread
+  pthread_t thread;
+  bool thread_started; // And not yet joined
+  int queue_capacity;
+  // Where to check if the agent is reachable before exporting; empty when not reporting to the agent
+  char agent_host[256];
+  char agent_port[16];
+  char agent_uds_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+  // Everything below is protected by the mutex
+  pthread_mutex_t mutex;
+  pthread_cond_t changed; // Signaled whenever the queue, `sending` or `stop_requested` change
+  async_export_job **queue;
+  int queue_head;
+  int queue_length;
+  bool sending;
+  bool stop_requested;
+  bool thread_finished;
+  bool owned_by_thread; // Set when the async exporter got garbage collected before the thread finished
+  ddog_CancellationToken cancel_token; // Only valid while `sending`
+  unsigned int consecutive_failures;
+  bool check_agent_before_sending;
+  bool agent_unreachable;
+  bool backing_off;
+  struct timespec backoff_until;
+  // Reported back to Ruby (and reset) by `_native_async_take_failures`
+  unsigned int failures;
+  char last_failure[ASYNC_EXPORT_FAILURE_MESSAGE_SIZE];
+} async_exporter_state;
+
+typedef struct {
+  async_exporter_state *state;
+  struct timespec deadline;
+  bool interrupted;
+  bool drained;
+} async_wait_arguments;
+
 typedef struct {
   ddog_prof_ProfileExporter *exporter;
   ddog_prof_EncodedProfile *profile;
@@ -37,12 +124,48 @@ static VALUE _native_do_export(
 );
 static void *call_exporter_without_gvl(void *call_args);
 static void interrupt_exporter_call(void *cancel_token);
+static VALUE _native_async_exporter_new(
+  DDTRACE_UNUSED VALUE _self,
+  VALUE exporter_configuration,
+  VALUE max_pending_profiles,
+  VALUE agent_address
+);
+static VALUE _native_async_export(DDTRACE_UNUSED VALUE _self, VALUE async_exporter, VALUE flush);
+static VALUE _native_async_wait(DDTRACE_UNUSED VALUE _self, VALUE async_exporter, VALUE timeout_ms);
+static VALUE _native_async_take_failures(DDTRACE_UNUSED VALUE _self, VALUE async_exporter);
+static VALUE _native_async_stop(DDTRACE_UNUSED VALUE _self, VALUE async_exporter, VALUE timeout_ms);
+static void async_exporter_typed_data_mark(void *state_ptr);
+static void async_exporter_typed_data_free(void *state_ptr);
+static async_exporter_state *async_exporter_state_for(VALUE async_exporter);
+static VALUE async_exporter_start(async_exporter_state *state);
+static void async_exporter_restart_after_fork(async_exporter_state *state);
+static void async_exporter_request_stop(async_exporter_state *state);
+static void async_exporter_state_free(async_exporter_state *state, bool same_process);
+static void *async_stop_without_gvl(void *wait_args);
+static void *async_export_loop(void *state_ptr);
+static void async_export_start_backoff(async_exporter_state *state);
+static bool agent_is_reachable(async_exporter_state *state, char *failure);
+static bool can_connect(const struct sockaddr *address, socklen_t address_length, char *failure);
+static void async_export_job_free(async_export_job *job);
+static void *async_wait_without_gvl(void *wait_args);
+static void interrupt_async_wait(void *wait_args);
+static struct timespec deadline_after_ms(uint64_t timeout_ms);
+static ddog_CharSlice copy_to(char **destination, ddog_CharSlice slice);
 
 void http_transport_init(VALUE profiling_module) {
   VALUE http_transport_class = rb_define_class_under(profiling_module, "HttpTransport", rb_cObject);
 
   rb_define_singleton_method(http_transport_class, "_native_validate_exporter",  _native_validate_exporter, 1);
   rb_define_singleton_method(http_transport_class, "_native_do_export",  _native_do_export, 2);
+  rb_define_singleton_method(http_transport_class, "_native_async_exporter_new",  _native_async_exporter_new, 3);
+  rb_define_singleton_method(http_transport_class, "_native_async_export",  _native_async_export, 2);
+  rb_define_singleton_method(http_transport_class, "_native_async_wait",  _native_async_wait, 2);
+  rb_define_singleton_method(http_transport_class, "_native_async_take_failures",  _native_async_take_failures, 1);
+  rb_define_singleton_method(http_transport_class, "_native_async_stop",  _native_async_stop, 2);
+
+  async_exporter_class = rb_define_class_under(http_transport_class, "AsyncExporter", rb_cObject);
+  rb_undef_alloc_func(async_exporter_class); // Class cannot be created from Ruby code
+  rb_global_variable(&async_exporter_class);
 
   ok_symbol = ID2SYM(rb_intern_const("ok"));
   error_symbol = ID2SYM(rb_intern_const("error"));
@@ -271,3 +394,586 @@ static void interrupt_exporter_call(void *cancel_token) {
   // Would be nice to change libdatadog to be able to distinguish between them...
   ddog_CancellationToken_cancel((ddog_CancellationToken *) cancel_token);
 }
+
+static const rb_data_type_t async_exporter_typed_data = {
+  .wrap_struct_name = "Datadog::Profiling::HttpTransport::AsyncExporter",
+  .function = {
+    .dmark = async_exporter_typed_data_mark,
+    .dfree = async_exporter_typed_data_free,
+    .dsize = NULL, // We don't track memory usage (although it'd be cool if we did!)
+    //.dcompact = NULL, // FIXME: Add support for compaction
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+// `agent_address` is either nil (don't check if the agent is reachable before exporting), [:tcp, hostname, port] or
+// [:unix, path].
+static VALUE _native_async_exporter_new(
+  DDTRACE_UNUSED VALUE _self,
+  VALUE exporter_configuration,
+  VALUE max_pending_profiles,
+  VALUE agent_address
+) {
+  ENFORCE_TYPE(exporter_configuration, T_ARRAY);
+  ENFORCE_TYPE(max_pending_profiles, T_FIXNUM);
+
+  int queue_capacity = NUM2INT(max_pending_profiles);
+  if (queue_capacity < 1) raise_error(rb_eArgError, "Expected max_pending_profiles to be >= 1, got %d", queue_capacity);
+
+  char agent_host[256] = {0};
+  char agent_port[16] = {0};
+  char agent_uds_path[sizeof(((struct sockaddr_un *) 0)->sun_path)] = {0};
+
+  if (!NIL_P(agent_address)) {
+    ENFORCE_TYPE(agent_address, T_ARRAY);
+    VALUE kind = rb_ary_entry(agent_address, 0);
+    ENFORCE_TYPE(kind, T_SYMBOL);
+
+    if (SYM2ID(kind) == rb_intern("tcp")) {
+      VALUE hostname = rb_ary_entry(agent_address, 1);
+      VALUE port = rb_ary_entry(agent_address, 2);
+      ENFORCE_TYPE(hostname, T_STRING);
+      ENFORCE_TYPE(port, T_FIXNUM);
+
+      // If the hostname doesn't fit, we just skip the check
+      if (RSTRING_LEN(hostname) < (long) sizeof(agent_host)) {
+        snprintf(agent_host, sizeof(agent_host), "%s", StringValueCStr(hostname));
+        snprintf(agent_port, sizeof(agent_port), "%ld", FIX2LONG(port));
+      }
+    } else if (SYM2ID(kind) == rb_intern("unix")) {
+      VALUE path = rb_ary_entry(agent_address, 1);
+      ENFORCE_TYPE(path, T_STRING);
+
+      // Same as above: if the path doesn't fit, we just skip the check
+      if (RSTRING_LEN(path) < (long) sizeof(agent_uds_path)) {
+        snprintf(agent_uds_path, sizeof(agent_uds_path), "%s", StringValueCStr(path));
+      }
+    } else {
+      raise_error(rb_eArgError, "Unexpected agent address kind, expected :tcp or :unix");
+    }
+  }
+
+  // Tags change on every flush (e.g. the profile sequence number), so they get passed in on every export instead
+  ddog_prof_ProfileExporter_Result exporter_result = create_exporter(exporter_configuration, rb_ary_new());
+
+  VALUE failure_tuple = handle_exporter_failure(exporter_result);
+  if (!NIL_P(failure_tuple)) return failure_tuple;
+
+  // Note: Any exceptions raised from this note until the TypedData_Wrap_Struct call will lead to the exporter
+  // being leaked.
+
+  // The state may end up being freed by the background thread (see `async_exporter_typed_data_free`), which can't use
+  // the Ruby allocation APIs; see also "note on calloc vs ruby_xcalloc use" in heap_recorder.c
+  async_exporter_state *state = calloc(1, sizeof(async_exporter_state));
+  async_export_job **queue = calloc(queue_capacity, sizeof(async_export_job *));
+  if (state == NULL || queue == NULL) {
+    free(state);
+    free(queue);
+    ddog_prof_Exporter_drop(&exporter_result.ok);
+    raise_error(rb_eNoMemError, "Failed to allocate memory for async exporter");
+  }
+
+  state->exporter_configuration = exporter_configuration;
+  state->queue_capacity = queue_capacity;
+  state->queue = queue;
+  memcpy(state->agent_host, agent_host, sizeof(agent_host));
+  memcpy(state->agent_port, agent_port, sizeof(agent_port));
+  memcpy(state->agent_uds_path, agent_uds_path, sizeof(agent_uds_path));
+  state->exporter = exporter_result.ok;
+  state->pid = getpid();
+  state->mutex = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+  state->changed = (pthread_cond_t) PTHREAD_COND_INITIALIZER;
+
+  VALUE async_exporter = TypedData_Wrap_Struct(async_exporter_class, &async_exporter_typed_data, state);
+
+  failure_tuple = async_exporter_start(state);
+  if (!NIL_P(failure_tuple)) return failure_tuple;
+
+  return rb_ary_new_from_args(2, ok_symbol, async_exporter);
+}
+
+static void async_exporter_typed_data_mark(void *state_ptr) {
+  async_exporter_state *state = (async_exporter_state *) state_ptr;
+
+  rb_gc_mark(state->exporter_configuration);
+}
+
+static void async_exporter_typed_data_free(void *state_ptr) {
+  async_exporter_state *state = (async_exporter_state *) state_ptr;
+
+  // The background thread, and thus the exporter it may be using, only exist in the process that started it; in any
+  // other process, we just leak the exporter (see also `async_exporter_restart_after_fork`)
+  bool same_process = state->pid == getpid();
+
+  if (same_process && state->thread_started) {
+    // We're in the middle of GC, so we can't wait for the background thread to finish (see comment at the top)
+    pthread_mutex_lock(&state->mutex);
+    async_exporter_request_stop(state);
+    bool thread_finished = state->thread_finished;
+    if (!thread_finished) state->owned_by_thread = true;
+    pthread_t thread = state->thread;
+    pthread_mutex_unlock(&state->mutex);
+
+    if (!thread_finished) {
+      pthread_detach(thread);
+      return;
+    }
+
+    pthread_join(thread, NULL); // The thread is done, so this doesn't block
+  }
+
+  async_exporter_state_free(state, same_process);
+}
+
+// Called with the GVL from `async_exporter_typed_data_free`, or without it from the background thread
+static void async_exporter_state_free(async_exporter_state *state, bool same_process) {
+  for (int i = 0; i < state->queue_length; i++) {
+    async_export_job_free(state->queue[(state->queue_head + i) % state->queue_capacity]);
+  }
+
+  if (same_process) {
+    ddog_prof_Exporter_drop(&state->exporter);
+    pthread_mutex_destroy(&state->mutex);
+    pthread_cond_destroy(&state->changed);
+  }
+
+  free(state->queue);
+  free(state);
+}
+
+static async_exporter_state *async_exporter_state_for(VALUE async_exporter) {
+  async_exporter_state *state;
+  TypedData_Get_Struct(async_exporter, async_exporter_state, &async_exporter_typed_data, state);
+  return state;
+}
+
+// Returns nil on success, or an [:error, message] tuple otherwise
+static VALUE async_exporter_start(async_exporter_state *state) {
+  int error = pthread_create(&state->thread, NULL, async_export_loop, state);
+  if (error) {
+    return rb_ary_new_from_args(2, error_symbol, rb_sprintf("Failed to start async export thread: %s", strerror(error)));
+  }
+
+  state->pid = getpid();
+  state->thread_started = true;
+  return Qnil;
+}
+
+// The background thread doesn't survive a fork, so the first export in the child process starts a new one.
+//
+// Profiles that were queued (and the exporter) belong to the parent process. We discard the profiles, and leak the
+// exporter rather than risk dropping it while the parent's (now gone) background thread was using it.
+static void async_exporter_restart_after_fork(async_exporter_state *state) {
+  for (int i = 0; i < state->queue_length; i++) {
+    async_export_job_free(state->queue[(state->queue_head + i) % state->queue_capacity]);
+  }
+  state->queue_head = 0;
+  state->queue_length = 0;
+  state->sending = false;
+  state->stop_requested = false;
+  state->thread_finished = false;
+  state->consecutive_failures = 0;
+  state->check_agent_before_sending = false;
+  state->agent_unreachable = false;
+  state->backing_off = false;
+  state->failures = 0;
+  state->thread_started = false;
+  // The fork may have happened while the background thread was holding the mutex
+  state->mutex = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+  state->changed = (pthread_cond_t) PTHREAD_COND_INITIALIZER;
+
+  ddog_prof_ProfileExporter_Result exporter_result = create_exporter(state->exporter_configuration, rb_ary_new());
+  if (exporter_result.tag != DDOG_PROF_PROFILE_EXPORTER_RESULT_OK_HANDLE_PROFILE_EXPORTER) {
+    raise_error(rb_eRuntimeError, "Failed to restart async export after fork: %"PRIsVALUE, get_error_details_and_drop(&exporter_result.err));
+  }
+  state->exporter = exporter_result.ok;
+
+  VALUE failure_tuple = async_exporter_start(state);
+  if (!NIL_P(failure_tuple)) raise_error(rb_eRuntimeError, "%"PRIsVALUE, rb_ary_entry(failure_tuple, 1));
+}
+
+// Assumes the mutex is held
+static void async_exporter_request_stop(async_exporter_state *state) {
+  state->stop_requested = true;
+  if (state->sending) ddog_CancellationToken_cancel(&state->cancel_token);
+  pthread_cond_broadcast(&state->changed);
+}
+
+// Returns true if the profile was queued for reporting, or false if it was dropped because the queue was full.
+//
+// Failures to report profiles happen later, in the background thread; see `_native_async_take_failures`.
+static VALUE _native_async_export(DDTRACE_UNUSED VALUE _self, VALUE async_exporter, VALUE flush) {
+  async_exporter_state *state = async_exporter_state_for(async_exporter);
+
+  VALUE encoded_profile = rb_funcall(flush, rb_intern("encoded_profile"), 0);
+  VALUE code_provenance_file_name = rb_funcall(flush, rb_intern("code_provenance_file_name"), 0);
+  VALUE code_provenance_data = rb_funcall(flush, rb_intern("code_provenance_data"), 0);
+  VALUE tags_as_array = rb_funcall(flush, rb_intern("tags_as_array"), 0);
+  VALUE internal_metadata_json = rb_funcall(flush, rb_intern("internal_metadata_json"), 0);
+  VALUE info_json = rb_funcall(flush, rb_intern("info_json"), 0);
+  VALUE process_tags = rb_funcall(flush, rb_intern("process_tags"), 0);
+
+  enforce_encoded_profile_instance(encoded_profile);
+  to_ddog_prof_EncodedProfile(encoded_profile); // Validate profile is still usable -- raises otherwise
+  ENFORCE_TYPE(code_provenance_file_name, T_STRING);
+  ENFORCE_TYPE(tags_as_array, T_ARRAY);
+  ENFORCE_TYPE(internal_metadata_json, T_STRING);
+  ENFORCE_TYPE(info_json, T_STRING);
+  ENFORCE_TYPE(process_tags, T_STRING);
+
+  // Code provenance can be disabled and in that case will be set to nil
+  bool have_code_provenance = !NIL_P(code_provenance_data);
+  if (have_code_provenance) ENFORCE_TYPE(code_provenance_data, T_STRING);
+
+  if (state->pid != getpid()) async_exporter_restart_after_fork(state);
+
+  size_t strings_size =
+    (have_code_provenance ? RSTRING_LEN(code_provenance_file_name) + RSTRING_LEN(code_provenance_data) : 0) +
+    RSTRING_LEN(internal_metadata_json) +
+    RSTRING_LEN(info_json) +
+    RSTRING_LEN(process_tags);
+
+  ddog_Vec_Tag tags = convert_tags(tags_as_array);
+  // Note: Do not add anything that can raise exceptions after this line, as otherwise the tags memory will leak
+
+  // Jobs get freed by the background thread, which can't use the Ruby allocation APIs;
+  // see also "note on calloc vs ruby_xcalloc use" in heap_recorder.c
+  async_export_job *job = malloc(sizeof(async_export_job) + strings_size);
+  if (job == NULL) {
+    ddog_Vec_Tag_drop(tags);
+    return Qfalse;
+  }
+
+  job->tags = tags;
+
+  char *strings = job->strings;
+  job->have_code_provenance = have_code_provenance;
+  if (have_code_provenance) {
+    ddog_CharSlice code_provenance = copy_to(&strings, char_slice_from_ruby_string(code_provenance_data));
+    job->code_provenance = (ddog_prof_Exporter_File) {
+      .name = copy_to(&strings, char_slice_from_ruby_string(code_provenance_file_name)),
+      .file = {.ptr = (const uint8_t *) code_provenance.ptr, .len = code_provenance.len},
+    };
+  }
+  job->internal_metadata = copy_to(&strings, char_slice_from_ruby_string(internal_metadata_json));
+  job->info = copy_to(&strings, char_slice_from_ruby_string(info_json));
+  job->process_tags = copy_to(&strings, char_slice_from_ruby_string(process_tags));
+  job->profile = take_ddog_prof_EncodedProfile(encoded_profile);
+
+  ENFORCE_SUCCESS_GVL(pthread_mutex_lock(&state->mutex));
+  bool enqueued = !state->stop_requested && state->queue_length < state->queue_capacity;
+  if (enqueued) {
+    state->queue[(state->queue_head + state->queue_length) % state->queue_capacity] = job;
+    state->queue_length++;
+    pthread_cond_broadcast(&state->changed);
+  }
+  ENFORCE_SUCCESS_GVL(pthread_mutex_unlock(&state->mutex));
+
+  if (!enqueued) async_export_job_free(job);
+
+  return enqueued ? Qtrue : Qfalse;
+}
+
+static ddog_CharSlice copy_to(char **destination, ddog_CharSlice slice) {
+  memcpy(*destination, slice.ptr, slice.len);
+  ddog_CharSlice copy = {.ptr = *destination, .len = slice.len};
+  *destination += slice.len;
+  return copy;
+}
+
+// Waits until all queued profiles have been reported (or failed to), or until `timeout_ms` elapses.
+// Returns true if there's nothing left to report.
+//
+// This is expected to be used before shutting down, so we also skip any pending backoff.
+static VALUE _native_async_wait(DDTRACE_UNUSED VALUE _self, VALUE async_exporter, VALUE timeout_ms) {
+  ENFORCE_TYPE(timeout_ms, T_FIXNUM);
+
+  async_exporter_state *state = async_exporter_state_for(async_exporter);
+
+  // Anything left in the queue belongs to the parent process (see `async_exporter_restart_after_fork`)
+  if (state->pid != getpid()) return Qtrue;
+
+  async_wait_arguments args = {.state = state, .deadline = deadline_after_ms(NUM2ULONG(timeout_ms))};
+
+  rb_thread_call_without_gvl(async_wait_without_gvl, &args, interrupt_async_wait, &args);
+
+  return args.drained ? Qtrue : Qfalse;
+}
+
+static void *async_wait_without_gvl(void *wait_args) {
+  async_wait_arguments *args = (async_wait_arguments *) wait_args;
+  async_exporter_state *state = args->state;
+
+  ENFORCE_SUCCESS_NO_GVL(pthread_mutex_lock(&state->mutex));
+
+  state->backing_off = false;
+  pthread_cond_broadcast(&state->changed);
+
+  while (!args->interrupted && (state->queue_length > 0 || state->sending)) {
+    int error = pthread_cond_timedwait(&state->changed, &state->mutex, &args->deadline);
+    if (error == ETIMEDOUT) break;
+  }
+  args->drained = state->queue_length == 0 && !state->sending;
+
+  ENFORCE_SUCCESS_NO_GVL(pthread_mutex_unlock(&state->mutex));
+
+  return NULL; // Unused
+}
+
+// Called by Ruby when it wants to interrupt async_wait_without_gvl above, e.g. when the app wants to exit cleanly
+static void interrupt_async_wait(void *wait_args) {
+  async_wait_arguments *args = (async_wait_arguments *) wait_args;
+
+  pthread_mutex_lock(&args->state->mutex);
+  args->interrupted = true;
+  pthread_cond_broadcast(&args->state->changed);
+  pthread_mutex_unlock(&args->state->mutex);
+}
+
+// Returns [failure_count, last_failure_message], and resets the failure count
+static VALUE _native_async_take_failures(DDTRACE_UNUSED VALUE _self, VALUE async_exporter) {
+  async_exporter_state *state = async_exporter_state_for(async_exporter);
+
+  ENFORCE_SUCCESS_GVL(pthread_mutex_lock(&state->mutex));
+  unsigned int failures = state->failures;
+  state->failures = 0;
+  VALUE last_failure = failures > 0 ? rb_str_new_cstr(state->last_failure) : Qnil;
+  ENFORCE_SUCCESS_GVL(pthread_mutex_unlock(&state->mutex));
+
+  return rb_ary_new_from_args(2, UINT2NUM(failures), last_failure);
+}
+
+// Stops the background thread, cancelling any in-progress export and dropping any queued profiles. Waits for up to
+// `timeout_ms` for the thread to finish. Returns true if it did (or was not running).
+static VALUE _native_async_stop(DDTRACE_UNUSED VALUE _self, VALUE async_exporter, VALUE timeout_ms) {
+  ENFORCE_TYPE(timeout_ms, T_FIXNUM);
+
+  async_exporter_state *state = async_exporter_state_for(async_exporter);
+
+  // The thread only exists in the process that started it (see `async_exporter_restart_after_fork`)
+  if (state->pid != getpid() || !state->thread_started) return Qtrue;
+
+  async_wait_arguments args = {.state = state, .deadline = deadline_after_ms(NUM2ULONG(timeout_ms))};
+
+  rb_thread_call_without_gvl(async_stop_without_gvl, &args, interrupt_async_wait, &args);
+
+  // If we gave up waiting, the thread will still finish on its own; `async_exporter_typed_data_free` takes care of it
+  if (!args.drained) return Qfalse;
+
+  pthread_join(state->thread, NULL); // The thread is done, so this doesn't block
+  state->thread_started = false;
+
+  return Qtrue;
+}
+
+static void *async_stop_without_gvl(void *wait_args) {
+  async_wait_arguments *args = (async_wait_arguments *) wait_args;
+  async_exporter_state *state = args->state;
+
+  ENFORCE_SUCCESS_NO_GVL(pthread_mutex_lock(&state->mutex));
+
+  async_exporter_request_stop(state);
+
+  while (!args->interrupted && !state->thread_finished) {
+    int error = pthread_cond_timedwait(&state->changed, &state->mutex, &args->deadline);
+    if (error == ETIMEDOUT) break;
+  }
+  args->drained = state->thread_finished;
+
+  ENFORCE_SUCCESS_NO_GVL(pthread_mutex_unlock(&state->mutex));
+
+  return NULL; // Unused
+}
+
+// Runs on a native (non-Ruby) thread, and thus MUST NOT use any Ruby APIs.
+static void *async_export_loop(void *state_ptr) {
+  async_exporter_state *state = (async_exporter_state *) state_ptr;
+
+  // Signals (such as the profiler's SIGPROF) are meant for Ruby threads, not this one
+  sigset_t signals;
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  pthread_mutex_lock(&state->mutex);
+
+  while (!state->stop_requested) {
+    if (state->backing_off) {
+      int error = pthread_cond_timedwait(&state->changed, &state->mutex, &state->backoff_until);
+      if (error == ETIMEDOUT) state->backing_off = false;
+      continue;
+    }
+
+    if (state->queue_length == 0) {
+      pthread_cond_wait(&state->changed, &state->mutex);
+      continue;
+    }
+
+    if (state->check_agent_before_sending) {
+      char failure[ASYNC_EXPORT_FAILURE_MESSAGE_SIZE];
+
+      pthread_mutex_unlock(&state->mutex);
+      bool reachable = agent_is_reachable(state, failure);
+      pthread_mutex_lock(&state->mutex);
+
+      if (state->stop_requested) break;
+
+      if (!reachable) {
+        // Only reported once per outage, as the profiles are not lost (unless the queue fills up)
+        if (!state->agent_unreachable) {
+          snprintf(state->last_failure, ASYNC_EXPORT_FAILURE_MESSAGE_SIZE, "agent is not reachable (%s), holding profiles until it is", failure);
+          state->failures++;
+          state->agent_unreachable = true;
+        }
+        async_export_start_backoff(state);
+        pthread_cond_broadcast(&state->changed);
+        continue;
+      }
+
+      state->check_agent_before_sending = false;
+      state->agent_unreachable = false;
+    }
+
+    async_export_job *job = state->queue[state->queue_head];
+    state->queue_head = (state->queue_head + 1) % state->queue_capacity;
+    state->queue_length--;
+    state->sending = true;
+    state->cancel_token = ddog_CancellationToken_new();
+    ddog_CancellationToken send_cancel_token = ddog_CancellationToken_clone(&state->cancel_token);
+
+    pthread_mutex_unlock(&state->mutex);
+
+    ddog_prof_Result_HttpStatus result = ddog_prof_Exporter_send_blocking(
+      &state->exporter,
+      &job->profile,
+      (ddog_prof_Exporter_Slice_File) {.ptr = &job->code_provenance, .len = job->have_code_provenance ? 1 : 0},
+      /* optional_additional_tags: */ &job->tags,
+      /* optional_process_tags: */ &job->process_tags,
+      &job->internal_metadata,
+      &job->info,
+      &send_cancel_token
+    );
+    ddog_CancellationToken_drop(&send_cancel_token);
+    async_export_job_free(job);
+
+    pthread_mutex_lock(&state->mutex);
+
+    ddog_CancellationToken_drop(&state->cancel_token);
+    state->sending = false;
+
+    bool success = result.tag == DDOG_PROF_RESULT_HTTP_STATUS_OK_HTTP_STATUS && result.ok.code >= 200 && result.ok.code <= 299;
+    if (success) {
+      state->consecutive_failures = 0;
+    } else {
+      if (result.tag == DDOG_PROF_RESULT_HTTP_STATUS_OK_HTTP_STATUS) {
+        snprintf(state->last_failure, ASYNC_EXPORT_FAILURE_MESSAGE_SIZE, "server returned unexpected HTTP %d status code", (int) result.ok.code);
+      } else {
+        read_ddogerr_string_and_drop(&result.err, state->last_failure, ASYNC_EXPORT_FAILURE_MESSAGE_SIZE);
+      }
+      state->failures++;
+      async_export_start_backoff(state);
+      state->check_agent_before_sending = state->agent_host[0] != '\0' || state->agent_uds_path[0] != '\0';
+    }
+
+    pthread_cond_broadcast(&state->changed);
+  }
+
+  state->thread_finished = true;
+  pthread_cond_broadcast(&state->changed);
+  bool owned_by_thread = state->owned_by_thread;
+
+  pthread_mutex_unlock(&state->mutex);
+
+  // The async exporter got garbage collected while we were running, so it's up to us to clean up
+  if (owned_by_thread) async_exporter_state_free(state, true);
+
+  return NULL; // Unused
+}
+
+// Assumes the mutex is held
+static void async_export_start_backoff(async_exporter_state *state) {
+  unsigned int backoff_exponent = state->consecutive_failures < 16 ? state->consecutive_failures : 16;
+  uint64_t backoff_ms = ASYNC_EXPORT_INITIAL_BACKOFF_MS << backoff_exponent;
+  state->consecutive_failures++;
+  state->backing_off = true;
+  state->backoff_until = deadline_after_ms(backoff_ms < ASYNC_EXPORT_MAXIMUM_BACKOFF_MS ? backoff_ms : ASYNC_EXPORT_MAXIMUM_BACKOFF_MS);
+}
+
+// Runs on the background thread, without holding the mutex (the agent address never changes after initialization).
+// On failure, writes the reason into `failure` (which must be ASYNC_EXPORT_FAILURE_MESSAGE_SIZE bytes long).
+static bool agent_is_reachable(async_exporter_state *state, char *failure) {
+  if (state->agent_uds_path[0] != '\0') {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    memcpy(address.sun_path, state->agent_uds_path, sizeof(address.sun_path));
+    return can_connect((const struct sockaddr *) &address, sizeof(address), failure);
+  }
+
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_NUMERICSERV};
+  struct addrinfo *addresses = NULL;
+  int error = getaddrinfo(state->agent_host, state->agent_port, &hints, &addresses);
+  if (error) {
+    snprintf(failure, ASYNC_EXPORT_FAILURE_MESSAGE_SIZE, "failed to resolve %s: %s", state->agent_host, gai_strerror(error));
+    return false;
+  }
+
+  bool reachable = false;
+  for (struct addrinfo *address = addresses; address != NULL && !reachable; address = address->ai_next) {
+    reachable = can_connect(address->ai_addr, address->ai_addrlen, failure);
+  }
+  freeaddrinfo(addresses);
+
+  return reachable;
+}
+
+static bool can_connect(const struct sockaddr *address, socklen_t address_length, char *failure) {
+  int fd = socket(address->sa_family, SOCK_STREAM, 0);
+  if (fd == -1) {
+    snprintf(failure, ASYNC_EXPORT_FAILURE_MESSAGE_SIZE, "failed to create socket: %s", strerror(errno));
+    return false;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  int error = 0;
+  if (connect(fd, address, address_length) == -1) {
+    error = errno;
+
+    if (error == EINPROGRESS) {
+      struct pollfd pollfd = {.fd = fd, .events = POLLOUT};
+      int ready = poll(&pollfd, 1, ASYNC_EXPORT_AGENT_CHECK_TIMEOUT_MS);
+      socklen_t error_length = sizeof(error);
+
+      if (ready == 1) {
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length) == -1) error = errno;
+      } else {
+        error = ready == 0 ? ETIMEDOUT : errno;
+      }
+    }
+  }
+
+  close(fd);
+
+  if (error) snprintf(failure, ASYNC_EXPORT_FAILURE_MESSAGE_SIZE, "failed to connect: %s", strerror(error));
+  return error == 0;
+}
+
+static void async_export_job_free(async_export_job *job) {
+  // If the profile was sent, this is a no-op
+  ddog_prof_EncodedProfile_drop(&job->profile);
+  ddog_Vec_Tag_drop(job->tags);
+  free(job);
+}
+
+// pthread_cond_timedwait takes a wall-clock deadline, rather than a timeout
+static struct timespec deadline_after_ms(uint64_t timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
+  if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000 * 1000 * 1000;
+  }
+
+  return deadline;
+}
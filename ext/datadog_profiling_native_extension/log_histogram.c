@@ -0,0 +1,74 @@
+#include "log_histogram.h"
+#include "helpers.h"
+#include "ruby_helpers.h"
+
+#define SUB_BUCKETS (1 << LOG_HISTOGRAM_SUB_BUCKET_BITS)
+
+// Bucket 0 contains values < 2^LOG_HISTOGRAM_MIN_EXPONENT. Every other bucket covers 1/SUB_BUCKETS of a power of two:
+// for a value with its highest set bit at position `exponent`, the bucket is picked by the LOG_HISTOGRAM_SUB_BUCKET_BITS
+// bits right below that one.
+static inline unsigned int bucket_for(uint64_t value_ns) {
+  if (value_ns < (1ULL << LOG_HISTOGRAM_MIN_EXPONENT)) return 0;
+  if (value_ns >= (1ULL << LOG_HISTOGRAM_MAX_EXPONENT)) return LOG_HISTOGRAM_BUCKETS - 1;
+
+  unsigned int exponent = 63 - __builtin_clzll(value_ns);
+  unsigned int sub_bucket = (value_ns >> (exponent - LOG_HISTOGRAM_SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+  return 1 + ((exponent - LOG_HISTOGRAM_MIN_EXPONENT) << LOG_HISTOGRAM_SUB_BUCKET_BITS) + sub_bucket;
+}
+
+// Returns the middle of the bucket, which is within 2^-(LOG_HISTOGRAM_SUB_BUCKET_BITS + 1) of every value in it
+static inline uint64_t value_for(unsigned int bucket) {
+  if (bucket == 0) return 1ULL << LOG_HISTOGRAM_MIN_EXPONENT;
+
+  unsigned int exponent = LOG_HISTOGRAM_MIN_EXPONENT + ((bucket - 1) >> LOG_HISTOGRAM_SUB_BUCKET_BITS);
+  uint64_t sub_bucket = (bucket - 1) & (SUB_BUCKETS - 1);
+  uint64_t bucket_width = 1ULL << (exponent - LOG_HISTOGRAM_SUB_BUCKET_BITS);
+
+  return (1ULL << exponent) + sub_bucket * bucket_width + bucket_width / 2;
+}
+
+void log_histogram_add(log_histogram *histogram, uint64_t value_ns) {
+  histogram->buckets[bucket_for(value_ns)]++;
+  histogram->count++;
+  histogram->total_ns += value_ns;
+  histogram->max_ns = uint64_max_of(histogram->max_ns, value_ns);
+}
+
+void log_histogram_merge(log_histogram *into, const log_histogram *from) {
+  if (from->count == 0) return;
+
+  for (int i = 0; i < LOG_HISTOGRAM_BUCKETS; i++) into->buckets[i] += from->buckets[i];
+  into->count += from->count;
+  into->total_ns += from->total_ns;
+  into->max_ns = uint64_max_of(into->max_ns, from->max_ns);
+}
+
+uint64_t log_histogram_quantile(const log_histogram *histogram, double quantile) {
+  if (histogram->count == 0) return 0;
+
+  uint64_t rank = (uint64_t) (quantile * (histogram->count - 1));
+  uint64_t seen = 0;
+
+  for (unsigned int i = 0; i < LOG_HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    // Because the last bucket also includes clamped values, the max can be lower than the bucket value
+    if (seen > rank) return uint64_min_of(value_for(i), histogram->max_ns);
+  }
+
+  return histogram->max_ns; // Should not be reached
+}
+
+VALUE log_histogram_as_ruby_hash(const log_histogram *histogram) {
+  VALUE result = rb_hash_new();
+  VALUE arguments[] = {
+    ID2SYM(rb_intern("count")),    /* => */ ULL2NUM(histogram->count),
+    ID2SYM(rb_intern("total_ns")), /* => */ ULL2NUM(histogram->total_ns),
+    ID2SYM(rb_intern("max_ns")),   /* => */ ULL2NUM(histogram->max_ns),
+    ID2SYM(rb_intern("p50_ns")),   /* => */ ULL2NUM(log_histogram_quantile(histogram, 0.50)),
+    ID2SYM(rb_intern("p90_ns")),   /* => */ ULL2NUM(log_histogram_quantile(histogram, 0.90)),
+    ID2SYM(rb_intern("p99_ns")),   /* => */ ULL2NUM(log_histogram_quantile(histogram, 0.99)),
+  };
+  for (long unsigned int i = 0; i < VALUE_COUNT(arguments); i += 2) rb_hash_aset(result, arguments[i], arguments[i+1]);
+  return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ruby.h>
+#include <stdint.h>
+
+// A DDSketch-style histogram for durations, used e.g. to keep track of how long threads wait for/hold the GVL.
+//
+// Values are mapped into log-linear buckets: each power of two gets split into 2^LOG_HISTOGRAM_SUB_BUCKET_BITS
+// equally-sized buckets, so that any quantile we report is within 2^-(LOG_HISTOGRAM_SUB_BUCKET_BITS + 1) (~1.6%) of the
+// real value. Unlike a full DDSketch, the number of buckets is fixed, so values below 2^LOG_HISTOGRAM_MIN_EXPONENT or
+// at/above 2^LOG_HISTOGRAM_MAX_EXPONENT get clamped to the first and last bucket respectively.
+//
+// The bucket for a value is computed using only integer operations (the position of its highest set bit, plus the
+// next few bits below it), so recording a value is allocation-free and cheap enough to do from VM hooks.
+//
+// Why not use libdatadog's ddsketch? Recording values happens on very hot paths (e.g. every GVL release) and we need
+// to compute quantiles in-process, which the ddsketch FFI doesn't support (it only encodes the sketch).
+
+#define LOG_HISTOGRAM_SUB_BUCKET_BITS 5
+#define LOG_HISTOGRAM_MIN_EXPONENT 10 // ~1 microsecond
+#define LOG_HISTOGRAM_MAX_EXPONENT 37 // ~137 seconds
+#define LOG_HISTOGRAM_BUCKETS (1 + ((LOG_HISTOGRAM_MAX_EXPONENT - LOG_HISTOGRAM_MIN_EXPONENT) << LOG_HISTOGRAM_SUB_BUCKET_BITS))
+
+typedef struct {
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint32_t buckets[LOG_HISTOGRAM_BUCKETS];
+} log_histogram;
+
+void log_histogram_add(log_histogram *histogram, uint64_t value_ns);
+void log_histogram_merge(log_histogram *into, const log_histogram *from);
+// Returns 0 if the histogram is empty
+uint64_t log_histogram_quantile(const log_histogram *histogram, double quantile);
+VALUE log_histogram_as_ruby_hash(const log_histogram *histogram);
+
+static inline void log_histogram_reset(log_histogram *histogram) { *histogram = (log_histogram) {0}; }
@@ -444,8 +444,9 @@ calc_lineno(const rb_iseq_t *iseq, const VALUE *pc)
 //    and friends). We've found quite a few situations where the data from rb_profile_frames and the reference APIs
 //    disagree, and quite a few of them seem oversights/bugs (speculation from my part) rather than deliberate
 //    decisions.
+static int profile_frames_for_execution_context(const rb_execution_context_t *ec, int start, int limit, frame_info *stack_buffer);
+
 int ddtrace_rb_profile_frames(VALUE thread, int start, int limit, frame_info *stack_buffer) {
-    int i;
     // Modified from upstream: Instead of using `GET_EC` to collect info from the current thread,
     // support sampling any thread (including the current) passed as an argument
     rb_thread_t *th = thread_struct_from_object(thread);
@@ -459,6 +460,13 @@ int ddtrace_rb_profile_frames(VALUE thread, int start, int limit, frame_info *st
     // Avoid sampling dead threads
     if (th->status == THREAD_KILLED) return 0;
 
+    return profile_frames_for_execution_context(ec, start, limit, stack_buffer);
+}
+
+// Modified from upstream: Split from `ddtrace_rb_profile_frames` so that we can also sample fibers that are not running
+// (see `ddtrace_rb_profile_suspended_fiber_frames`)
+static int profile_frames_for_execution_context(const rb_execution_context_t *ec, int start, int limit, frame_info *stack_buffer) {
+    int i;
     const rb_control_frame_t *cfp = ec->cfp;
 
     // This happens on newly-created threads (we even had a flaky test because of it)
@@ -712,6 +720,12 @@ rb_vm_frame_method_entry(const rb_control_frame_t *cfp)
   bool ddtrace_rb_ractor_main_p(void) { return true; }
 #endif // NO_RACTORS
 
+#ifndef NO_RACTOR_SAMPLING
+  uint32_t ddtrace_rb_ractor_id(void) { return rb_ractor_id(ddtrace_get_ractor()); }
+#else
+  uint32_t ddtrace_rb_ractor_id(void) { return 0; }
+#endif
+
 // This is a tweaked and inlined version of
 // threadptr_invoke_proc_location + rb_proc_location + iseq_location .
 //
@@ -797,6 +811,10 @@ static inline int ddtrace_imemo_type(VALUE imemo) {
     return (gvl_profiling_thread) {.thread = thread_struct_from_object(thread)};
   }
 
+  VALUE thread_object_from_thread(gvl_profiling_thread thread) {
+    return thread.thread == NULL ? Qnil : ((rb_thread_t *)thread.thread)->self;
+  }
+
   // Hack: In Ruby 3.3+ we attach gvl profiling state to Ruby threads using the
   // rb_internal_thread_specific_* APIs. These APIs did not exist on Ruby 3.2. On Ruby 3.2 we instead store the
   // needed data inside the `rb_thread_t` structure, specifically in `stat_insn_usage` as a Ruby FIXNUM.
@@ -869,6 +887,8 @@ bool is_raised_flag_set(VALUE thread) { return thread_struct_from_object(thread)
     rb_context_t cont;
   };
 
+  static void self_test_suspended_fiber_access(void);
+
   VALUE current_fiber_for(VALUE thread) {
     VALUE self = thread_struct_from_object(thread)->ec->fiber_ptr->cont.self;
     return self == 0 ? Qnil : self;
@@ -885,10 +905,122 @@ bool is_raised_flag_set(VALUE thread) { return thread_struct_from_object(thread)
     }
 
     if (expected_current_fiber != actual_current_fiber) rb_raise(rb_eRuntimeError, "current_fiber_for() self-test failed");
+
+    self_test_suspended_fiber_access();
+  }
+
+  // Where the execution context lives inside the fiber struct (e.g. `cont.saved_ec`). Rather than copying the rest of
+  // `rb_context_t` (which has changed quite a bit between Ruby versions), we find this out at startup from the current
+  // thread: the execution context of a thread is always the execution context of its current fiber.
+  // Negative if not known/supported.
+  static ptrdiff_t fiber_execution_context_offset = -1;
+
+  static const rb_execution_context_t *execution_context_for_fiber(VALUE fiber) {
+    if (fiber_execution_context_offset < 0 || !rb_obj_is_fiber(fiber)) return NULL;
+
+    struct rb_fiber_struct *fiber_struct = RTYPEDDATA_DATA(fiber);
+    if (fiber_struct == NULL) return NULL;
+
+    const rb_execution_context_t *ec = (const rb_execution_context_t *) (((char *) fiber_struct) + fiber_execution_context_offset);
+    return ec->fiber_ptr == fiber_struct ? ec : NULL;
+  }
+
+  int ddtrace_rb_profile_suspended_fiber_frames(VALUE fiber, int limit, frame_info *stack_buffer) {
+    const rb_execution_context_t *ec = execution_context_for_fiber(fiber);
+
+    // Fibers that were not started yet or that have terminated don't have a vm stack
+    if (ec == NULL || ec->vm_stack == NULL) return 0;
+
+    // We can't safely look at the stack of a fiber that is running (on another thread)
+    if (ec->thread_ptr != NULL && ec->thread_ptr->ec == ec) return 0;
+
+    return profile_frames_for_execution_context(ec, 0, limit, stack_buffer);
+  }
+
+  #ifndef NO_SUSPENDED_FIBER_LOCALS
+    // The following two declarations are
+    // taken from upstream id_table.c at commit d97884a58be32e829fd03a80cd521f4733d65c79 (February 2025, master branch)
+    // (See the Ruby project copyright and license above)
+    // to enable building `fiber_local_aref`.
+    //
+    // We needed to copy them because there's no VM API for reading the fiber-local variables of a fiber that is not
+    // the current fiber of its thread. This layout is only correct for 64-bit platforms, see below.
+    // (Renamed item_t => id_table_item to avoid any clashes)
+    typedef struct rb_id_item {
+      uint32_t key; // rb_id_serial_t
+      int collision;
+      VALUE val;
+    } id_table_item;
+
+    struct rb_id_table {
+      int capa;
+      int num;
+      int used;
+      id_table_item *items;
+    };
+
+    #define DDTRACE_ID_SCOPE_SHIFT 4 // RUBY_ID_SCOPE_SHIFT in id.h
+
+    // The id_table is keyed on the serial of the ID (see `rb_id_to_serial` in symbol.h). All IDs we use for lookups
+    // are for regular identifiers (and not operators), so the serial is the ID shifted by DDTRACE_ID_SCOPE_SHIFT.
+    //
+    // Rather than replicating the hashing, we scan the table: it's small (it only has the fiber-local variables for
+    // a single fiber) and this way we don't depend on the hash function.
+    VALUE fiber_local_aref(VALUE fiber, ID key) {
+      if (SIZEOF_VALUE != 8) return Qnil;
+
+      const rb_execution_context_t *ec = execution_context_for_fiber(fiber);
+      if (ec == NULL || ec->local_storage == NULL) return Qnil;
+
+      const struct rb_id_table *table = ec->local_storage;
+      if (table->items == NULL) return Qnil;
+
+      uint32_t serial = (uint32_t) (key >> DDTRACE_ID_SCOPE_SHIFT);
+      for (int i = 0; i < table->capa; i++) {
+        if (table->items[i].key == serial) return table->items[i].val ? table->items[i].val : Qnil;
+      }
+
+      return Qnil;
+    }
+  #else
+    VALUE fiber_local_aref(DDTRACE_UNUSED VALUE fiber, DDTRACE_UNUSED ID key) { return Qnil; }
+  #endif
+
+  bool suspended_fiber_sampling_supported(void) { return fiber_execution_context_offset >= 0; }
+
+  // If any of these checks fails we leave suspended fiber sampling disabled, rather than failing, as it's an optional
+  // feature.
+  static void self_test_suspended_fiber_access(void) {
+    const rb_execution_context_t *current_ec = thread_struct_from_object(rb_thread_current())->ec;
+    ptrdiff_t offset = ((char *) current_ec) - ((char *) current_ec->fiber_ptr);
+
+    // The execution context is embedded in the fiber struct, and not that far off from its start
+    if (offset <= 0 || offset > 4096) return;
+
+    fiber_execution_context_offset = offset;
+
+    if (execution_context_for_fiber(rb_fiber_current()) != current_ec) {
+      fiber_execution_context_offset = -1;
+      return;
+    }
+
+    #ifndef NO_SUSPENDED_FIBER_LOCALS
+      ID test_key = rb_intern("__datadog_profiling_fiber_local_aref_self_test__");
+      VALUE test_value = rb_str_new_cstr("test value");
+      rb_thread_local_aset(rb_thread_current(), test_key, test_value);
+      bool fiber_local_aref_works = fiber_local_aref(rb_fiber_current(), test_key) == test_value;
+      rb_thread_local_aset(rb_thread_current(), test_key, Qnil);
+      RB_GC_GUARD(test_value);
+
+      if (!fiber_local_aref_works) fiber_execution_context_offset = -1;
+    #endif
   }
 #else
   NORETURN(VALUE current_fiber_for(DDTRACE_UNUSED VALUE thread));
 
   VALUE current_fiber_for(DDTRACE_UNUSED VALUE thread) { rb_raise(rb_eRuntimeError, "Not implemented for Ruby < 3.1"); }
   void self_test_current_fiber_for(void) { } // Nothing to do
+  int ddtrace_rb_profile_suspended_fiber_frames(DDTRACE_UNUSED VALUE fiber, DDTRACE_UNUSED int limit, DDTRACE_UNUSED frame_info *stack_buffer) { return 0; }
+  VALUE fiber_local_aref(DDTRACE_UNUSED VALUE fiber, DDTRACE_UNUSED ID key) { return Qnil; }
+  bool suspended_fiber_sampling_supported(void) { return false; }
 #endif
@@ -54,6 +54,9 @@ VALUE ddtrace_iseq_path(const void *iseq);
 // Returns true if the current thread belongs to the main Ractor or if Ruby has no Ractor support
 bool ddtrace_rb_ractor_main_p(void);
 
+// Returns the id of the current Ractor (the same one shown by `Ractor#inspect`), or 0 if not supported in this Ruby
+uint32_t ddtrace_rb_ractor_id(void);
+
 // See comment on `record_placeholder_stack_in_native_code` for a full explanation of what this means (and why we don't just return 0)
 #define PLACEHOLDER_STACK_IN_NATIVE_CODE -1
 
@@ -83,3 +86,19 @@ bool is_raised_flag_set(VALUE thread);
 VALUE current_fiber_for(VALUE thread);
 
 void self_test_current_fiber_for(void);
+
+// Samples the stack of a fiber that is not currently running (e.g. one that called `Fiber.yield`, or that is waiting
+// on a fiber scheduler). Returns 0 if the fiber has not started or has terminated, if it's running on another thread,
+// or if `suspended_fiber_sampling_supported()` is false.
+// Only implemented for Ruby 3.1+
+int ddtrace_rb_profile_suspended_fiber_frames(VALUE fiber, int limit, frame_info *stack_buffer);
+
+// Returns the value of a fiber-local variable (e.g. what `Thread#[]` returns when called from inside that fiber) for
+// any fiber, even if it's not the current fiber for its thread. Returns nil if not set or not supported.
+// Only implemented for Ruby 3.1 to 3.4
+//
+// Safety: This function does not raise or allocate.
+VALUE fiber_local_aref(VALUE fiber, ID key);
+
+// Validated by `self_test_current_fiber_for`
+bool suspended_fiber_sampling_supported(void);
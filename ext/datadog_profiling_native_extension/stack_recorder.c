@@ -2,6 +2,7 @@
 #include <ruby/thread.h>
 #include <pthread.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include "helpers.h"
 #include "stack_recorder.h"
 #include "libdatadog_helpers.h"
@@ -163,12 +164,40 @@ static const uint8_t all_value_types_positions[] =
 typedef struct {
   // How many individual samples were recorded into this slot (un-weighted)
   uint64_t recorded_samples;
+  // How many times we told libdatadog about an endpoint for this slot (see `record_endpoint_if_changed`)
+  uint64_t recorded_endpoints;
 } stats_slot;
 
+// Small direct-mapped cache of the endpoints already recorded into a profile slot, so we don't need to tell libdatadog
+// about the same endpoint on every sample. Endpoints longer than ENDPOINT_CACHE_MAX_LENGTH are never cached.
+#define ENDPOINT_CACHE_SIZE 64
+#define ENDPOINT_CACHE_MAX_LENGTH 128
+
+typedef struct {
+  uint64_t local_root_span_id; // 0 means the entry is empty
+  uint8_t endpoint_length;
+  char endpoint[ENDPOINT_CACHE_MAX_LENGTH];
+} endpoint_cache_entry;
+
+// Samples taken outside the main Ractor, waiting to be recorded (see `enqueue_sample`). Once the queue is full, new
+// samples get dropped.
+#define MAX_QUEUED_SAMPLES 64
+
+// A copy of a sample, including all the strings its locations and labels point at. It's allocated as a single block of
+// memory: the location and label arrays, and then the strings, get placed right after the struct.
+typedef struct {
+  sample_values values;
+  int64_t end_timestamp_ns;
+  ddog_prof_Slice_Location locations;
+  ddog_prof_Slice_Label labels;
+} queued_sample;
+
 typedef struct {
   ddog_prof_Profile profile;
   stats_slot stats;
   ddog_Timespec start_timestamp;
+  // Only accessed while holding the slot's mutex, and reset together with the profile
+  endpoint_cache_entry endpoint_cache[ENDPOINT_CACHE_SIZE];
 } profile_slot;
 
 // Contains native state for each instance
@@ -188,6 +217,11 @@ typedef struct {
 
   short active_slot; // MUST NEVER BE ACCESSED FROM record_sample; this is NOT for the sampler thread to use.
 
+  // See `enqueue_sample`. `queued_samples_count` can be read without holding the mutex, but only as a hint.
+  pthread_mutex_t queued_samples_mutex;
+  queued_sample *queued_samples[MAX_QUEUED_SAMPLES];
+  atomic_int queued_samples_count;
+
   uint8_t position_for[ALL_VALUE_TYPES_COUNT];
   uint8_t enabled_values_count;
 
@@ -201,6 +235,9 @@ typedef struct {
     long serialization_time_ns_min;
     long serialization_time_ns_max;
     uint64_t serialization_time_ns_total;
+    // Samples taken outside the main Ractor that got recorded/dropped (see `enqueue_sample`); protected by queued_samples_mutex
+    uint64_t queued_samples_recorded;
+    uint64_t queued_samples_dropped;
   } stats_lifetime;
 } stack_recorder_state;
 
@@ -243,10 +280,16 @@ static VALUE _native_is_slot_one_mutex_locked(DDTRACE_UNUSED VALUE _self, VALUE
 static VALUE _native_is_slot_two_mutex_locked(DDTRACE_UNUSED VALUE _self, VALUE recorder_instance);
 static VALUE test_slot_mutex_state(VALUE recorder_instance, int slot);
 static ddog_Timespec system_epoch_now_timespec(void);
+static void metric_values_for(stack_recorder_state *state, sample_values values, int64_t *metric_values);
+static void record_queued_samples(stack_recorder_state *state, profile_slot *slot);
+static void record_queued_samples_now(stack_recorder_state *state);
+static void discard_queued_samples(stack_recorder_state *state);
+static ddog_CharSlice copy_char_slice(char **destination, ddog_CharSlice slice);
 static VALUE _native_reset_after_fork(DDTRACE_UNUSED VALUE self, VALUE recorder_instance);
 static void serializer_set_start_timestamp_for_next_profile(stack_recorder_state *state, ddog_Timespec start_time);
 static VALUE _native_record_endpoint(DDTRACE_UNUSED VALUE _self, VALUE recorder_instance, VALUE local_root_span_id, VALUE endpoint);
 static void reset_profile_slot(profile_slot *slot, ddog_Timespec start_timestamp);
+static ddog_prof_Profile_Result record_endpoint_if_changed(profile_slot *slot, uint64_t local_root_span_id, ddog_CharSlice endpoint);
 static VALUE _native_track_object(DDTRACE_UNUSED VALUE _self, VALUE recorder_instance, VALUE new_obj, VALUE weight, VALUE alloc_class);
 static VALUE _native_start_fake_slow_heap_serialization(DDTRACE_UNUSED VALUE _self, VALUE recorder_instance);
 static VALUE _native_end_fake_slow_heap_serialization(DDTRACE_UNUSED VALUE _self, VALUE recorder_instance);
@@ -324,6 +367,7 @@ static VALUE _native_new(VALUE klass) {
   ddog_prof_Slice_SampleType sample_types = {.ptr = all_sample_types, .len = ALL_VALUE_TYPES_COUNT};
 
   initialize_slot_concurrency_control(state);
+  state->queued_samples_mutex = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
   for (uint8_t i = 0; i < ALL_VALUE_TYPES_COUNT; i++) { state->position_for[i] = all_value_types_positions[i]; }
   state->enabled_values_count = ALL_VALUE_TYPES_COUNT;
   state->stats_lifetime = (struct lifetime_stats) {
@@ -405,6 +449,9 @@ static void stack_recorder_typed_data_free(void *state_ptr) {
 
   heap_recorder_free(state->heap_recorder);
 
+  discard_queued_samples(state);
+  pthread_mutex_destroy(&state->queued_samples_mutex);
+
   ddog_prof_ManagedStringStorage_drop(state->string_storage);
 
   ruby_xfree(state);
@@ -526,6 +573,9 @@ static VALUE _native_serialize(DDTRACE_UNUSED VALUE _self, VALUE recorder_instan
   stack_recorder_state *state;
   TypedData_Get_Struct(recorder_instance, stack_recorder_state, &stack_recorder_typed_data, state);
 
+  // Make sure samples taken outside the main Ractor since the last `record_sample` make it into this profile
+  record_queued_samples_now(state);
+
   ddog_Timespec finish_timestamp = system_epoch_now_timespec();
   // Need to do this while still holding on to the Global VM Lock; see comments on method for why
   serializer_set_start_timestamp_for_next_profile(state, finish_timestamp);
@@ -608,19 +658,10 @@ void record_sample(VALUE recorder_instance, ddog_prof_Slice_Location locations,
 
   locked_profile_slot active_slot = sampler_lock_active_profile(state);
 
-  // Note: We initialize this array to have ALL_VALUE_TYPES_COUNT but only tell libdatadog to use the first
-  // state->enabled_values_count values. This simplifies handling disabled value types -- we still put them on the
-  // array, but in _native_initialize we arrange so their position starts from state->enabled_values_count and thus
-  // libdatadog doesn't touch them.
-  int64_t metric_values[ALL_VALUE_TYPES_COUNT] = {0};
-  uint8_t *position_for = state->position_for;
+  if (atomic_load(&state->queued_samples_count) > 0) record_queued_samples(state, active_slot.data);
 
-  metric_values[position_for[CPU_TIME_VALUE_ID]]      = values.cpu_time_ns;
-  metric_values[position_for[CPU_SAMPLES_VALUE_ID]]   = values.cpu_or_wall_samples;
-  metric_values[position_for[WALL_TIME_VALUE_ID]]     = values.wall_time_ns;
-  metric_values[position_for[ALLOC_SAMPLES_VALUE_ID]] = values.alloc_samples;
-  metric_values[position_for[ALLOC_SAMPLES_UNSCALED_VALUE_ID]] = values.alloc_samples_unscaled;
-  metric_values[position_for[TIMELINE_VALUE_ID]]      = values.timeline_wall_time_ns;
+  int64_t metric_values[ALL_VALUE_TYPES_COUNT];
+  metric_values_for(state, values, metric_values);
 
   if (values.heap_sample) {
     // If we got an allocation sample end the heap allocation recording to commit the heap sample.
@@ -638,6 +679,16 @@ void record_sample(VALUE recorder_instance, ddog_prof_Slice_Location locations,
     }
   }
 
+  if (labels.endpoint.len > 0) {
+    ddog_prof_Profile_Result endpoint_result =
+      record_endpoint_if_changed(active_slot.data, labels.endpoint_local_root_span_id, labels.endpoint);
+
+    if (endpoint_result.tag == DDOG_PROF_PROFILE_RESULT_ERR) {
+      sampler_unlock_active_profile(active_slot);
+      raise_error(rb_eArgError, "Failed to record endpoint: %"PRIsVALUE, get_error_details_and_drop(&endpoint_result.err));
+    }
+  }
+
   ddog_prof_Profile_Result result = ddog_prof_Profile_add(
     &active_slot.data->profile,
     (ddog_prof_Sample) {
@@ -657,6 +708,163 @@ void record_sample(VALUE recorder_instance, ddog_prof_Slice_Location locations,
   }
 }
 
+static void metric_values_for(stack_recorder_state *state, sample_values values, int64_t *metric_values) {
+  // Note: The metric_values array has ALL_VALUE_TYPES_COUNT entries but we only tell libdatadog to use the first
+  // state->enabled_values_count values. This simplifies handling disabled value types -- we still put them on the
+  // array, but in _native_initialize we arrange so their position starts from state->enabled_values_count and thus
+  // libdatadog doesn't touch them.
+  uint8_t *position_for = state->position_for;
+
+  for (uint8_t i = 0; i < ALL_VALUE_TYPES_COUNT; i++) metric_values[i] = 0;
+
+  metric_values[position_for[CPU_TIME_VALUE_ID]]      = values.cpu_time_ns;
+  metric_values[position_for[CPU_SAMPLES_VALUE_ID]]   = values.cpu_or_wall_samples;
+  metric_values[position_for[WALL_TIME_VALUE_ID]]     = values.wall_time_ns;
+  metric_values[position_for[ALLOC_SAMPLES_VALUE_ID]] = values.alloc_samples;
+  metric_values[position_for[ALLOC_SAMPLES_UNSCALED_VALUE_ID]] = values.alloc_samples_unscaled;
+  metric_values[position_for[TIMELINE_VALUE_ID]]      = values.timeline_wall_time_ns;
+}
+
+// Samples taken outside the main Ractor can't be recorded directly: `record_sample` relies on there only ever being
+// one sampler at a time (see "Locking protocol" at the top of this file), and each Ractor has its own Global VM Lock.
+// Instead, they get copied into a queue, and get recorded by the next `record_sample` (or serialization).
+//
+// Only cpu/wall-time samples are supported here: no heap samples, and no endpoints.
+//
+// Safety: This function is assumed never to raise exceptions by callers. It does not allocate Ruby objects, and can
+// be called from any Ractor.
+void enqueue_sample(VALUE recorder_instance, ddog_prof_Slice_Location locations, sample_values values, sample_labels labels) {
+  stack_recorder_state *state;
+  TypedData_Get_Struct(recorder_instance, stack_recorder_state, &stack_recorder_typed_data, state);
+
+  if (atomic_load(&state->queued_samples_count) >= MAX_QUEUED_SAMPLES) {
+    // Not worth copying a sample we're going to drop anyway; the count below is just for stats, so we don't mind if
+    // a concurrent `record_queued_samples` makes it slightly inaccurate
+    pthread_mutex_lock(&state->queued_samples_mutex);
+    state->stats_lifetime.queued_samples_dropped++;
+    pthread_mutex_unlock(&state->queued_samples_mutex);
+    return;
+  }
+
+  size_t strings_size = 0;
+  for (uintptr_t i = 0; i < locations.len; i++) {
+    strings_size += locations.ptr[i].function.name.len + locations.ptr[i].function.filename.len;
+  }
+  for (uintptr_t i = 0; i < labels.labels.len; i++) {
+    strings_size += labels.labels.ptr[i].key.len + labels.labels.ptr[i].str.len;
+  }
+
+  queued_sample *sample = malloc(
+    sizeof(queued_sample) +
+    locations.len * sizeof(ddog_prof_Location) +
+    labels.labels.len * sizeof(ddog_prof_Label) +
+    strings_size
+  );
+  if (sample == NULL) return;
+
+  ddog_prof_Location *sample_locations = (ddog_prof_Location *) (sample + 1);
+  ddog_prof_Label *sample_labels = (ddog_prof_Label *) (sample_locations + locations.len);
+  char *strings = (char *) (sample_labels + labels.labels.len);
+
+  for (uintptr_t i = 0; i < locations.len; i++) {
+    sample_locations[i] = (ddog_prof_Location) {
+      .mapping = {.filename = DDOG_CHARSLICE_C(""), .build_id = DDOG_CHARSLICE_C(""), .build_id_id = {}},
+      .function = {
+        .name = copy_char_slice(&strings, locations.ptr[i].function.name),
+        .filename = copy_char_slice(&strings, locations.ptr[i].function.filename),
+      },
+      .line = locations.ptr[i].line,
+    };
+  }
+  for (uintptr_t i = 0; i < labels.labels.len; i++) {
+    sample_labels[i] = (ddog_prof_Label) {
+      .key = copy_char_slice(&strings, labels.labels.ptr[i].key),
+      .str = copy_char_slice(&strings, labels.labels.ptr[i].str),
+      .num = labels.labels.ptr[i].num,
+    };
+  }
+
+  *sample = (queued_sample) {
+    .values = values,
+    .end_timestamp_ns = labels.end_timestamp_ns,
+    .locations = {.ptr = sample_locations, .len = locations.len},
+    .labels = {.ptr = sample_labels, .len = labels.labels.len},
+  };
+
+  pthread_mutex_lock(&state->queued_samples_mutex);
+  int queued_samples_count = atomic_load(&state->queued_samples_count);
+  if (queued_samples_count < MAX_QUEUED_SAMPLES) {
+    state->queued_samples[queued_samples_count] = sample;
+    atomic_store(&state->queued_samples_count, queued_samples_count + 1);
+    sample = NULL;
+  } else {
+    state->stats_lifetime.queued_samples_dropped++;
+  }
+  pthread_mutex_unlock(&state->queued_samples_mutex);
+
+  free(sample); // Only if it didn't fit
+}
+
+static ddog_CharSlice copy_char_slice(char **destination, ddog_CharSlice slice) {
+  if (slice.len == 0) return DDOG_CHARSLICE_C("");
+
+  memcpy(*destination, slice.ptr, slice.len);
+  ddog_CharSlice copy = {.ptr = *destination, .len = slice.len};
+  *destination += slice.len;
+  return copy;
+}
+
+// Assumption: The caller is holding the slot's mutex.
+static void record_queued_samples(stack_recorder_state *state, profile_slot *slot) {
+  queued_sample *samples[MAX_QUEUED_SAMPLES];
+
+  // We don't keep the queue locked while recording, so that other Ractors don't have to wait for us
+  pthread_mutex_lock(&state->queued_samples_mutex);
+  int samples_count = atomic_load(&state->queued_samples_count);
+  memcpy(samples, state->queued_samples, samples_count * sizeof(queued_sample *));
+  atomic_store(&state->queued_samples_count, 0);
+  state->stats_lifetime.queued_samples_recorded += samples_count;
+  pthread_mutex_unlock(&state->queued_samples_mutex);
+
+  for (int i = 0; i < samples_count; i++) {
+    int64_t metric_values[ALL_VALUE_TYPES_COUNT];
+    metric_values_for(state, samples[i]->values, metric_values);
+
+    ddog_prof_Profile_Result result = ddog_prof_Profile_add(
+      &slot->profile,
+      (ddog_prof_Sample) {
+        .locations = samples[i]->locations,
+        .values = (ddog_Slice_I64) {.ptr = metric_values, .len = state->enabled_values_count},
+        .labels = samples[i]->labels
+      },
+      samples[i]->end_timestamp_ns
+    );
+
+    // We can't raise here as we're holding the slot's mutex, and there's no one to report the error to anyway
+    if (result.tag == DDOG_PROF_PROFILE_RESULT_ERR) {
+      ddog_Error_drop(&result.err);
+    } else {
+      slot->stats.recorded_samples++;
+    }
+
+    free(samples[i]);
+  }
+}
+
+static void record_queued_samples_now(stack_recorder_state *state) {
+  if (atomic_load(&state->queued_samples_count) == 0) return;
+
+  locked_profile_slot active_slot = sampler_lock_active_profile(state);
+  record_queued_samples(state, active_slot.data);
+  sampler_unlock_active_profile(active_slot);
+}
+
+static void discard_queued_samples(stack_recorder_state *state) {
+  int samples_count = atomic_load(&state->queued_samples_count);
+  for (int i = 0; i < samples_count; i++) free(state->queued_samples[i]);
+  atomic_store(&state->queued_samples_count, 0);
+}
+
 // Returns needs_after_allocation: true whenever an after_sample callback is required
 bool track_object(VALUE recorder_instance, VALUE new_object, unsigned int sample_weight, ddog_CharSlice alloc_class) {
   stack_recorder_state *state;
@@ -667,13 +875,44 @@ bool track_object(VALUE recorder_instance, VALUE new_object, unsigned int sample
   return start_heap_allocation_recording(state->heap_recorder, new_object, sample_weight, alloc_class);
 }
 
+// Since libdatadog keeps the most-recently-seen endpoint for each local_root_span_id, telling it again about an endpoint
+// it already has is a no-op; we use the slot's endpoint cache to skip these calls.
+//
+// Assumption: The caller is holding the slot's mutex.
+static ddog_prof_Profile_Result record_endpoint_if_changed(profile_slot *slot, uint64_t local_root_span_id, ddog_CharSlice endpoint) {
+  endpoint_cache_entry *entry = &slot->endpoint_cache[local_root_span_id % ENDPOINT_CACHE_SIZE];
+  bool cacheable = local_root_span_id != 0 && endpoint.len <= ENDPOINT_CACHE_MAX_LENGTH;
+
+  if (cacheable &&
+    entry->local_root_span_id == local_root_span_id &&
+    entry->endpoint_length == endpoint.len &&
+    memcmp(entry->endpoint, endpoint.ptr, endpoint.len) == 0) {
+    return (ddog_prof_Profile_Result) {.tag = DDOG_PROF_PROFILE_RESULT_OK};
+  }
+
+  ddog_prof_Profile_Result result = ddog_prof_Profile_set_endpoint(&slot->profile, local_root_span_id, endpoint);
+  if (result.tag == DDOG_PROF_PROFILE_RESULT_ERR) return result;
+
+  slot->stats.recorded_endpoints++;
+
+  if (cacheable) {
+    entry->local_root_span_id = local_root_span_id;
+    entry->endpoint_length = (uint8_t) endpoint.len;
+    memcpy(entry->endpoint, endpoint.ptr, endpoint.len);
+  } else if (entry->local_root_span_id == local_root_span_id) {
+    entry->local_root_span_id = 0; // The cached endpoint is now stale
+  }
+
+  return result;
+}
+
 void record_endpoint(VALUE recorder_instance, uint64_t local_root_span_id, ddog_CharSlice endpoint) {
   stack_recorder_state *state;
   TypedData_Get_Struct(recorder_instance, stack_recorder_state, &stack_recorder_typed_data, state);
 
   locked_profile_slot active_slot = sampler_lock_active_profile(state);
 
-  ddog_prof_Profile_Result result = ddog_prof_Profile_set_endpoint(&active_slot.data->profile, local_root_span_id, endpoint);
+  ddog_prof_Profile_Result result = record_endpoint_if_changed(active_slot.data, local_root_span_id, endpoint);
 
   sampler_unlock_active_profile(active_slot);
 
@@ -912,6 +1151,10 @@ static VALUE _native_reset_after_fork(DDTRACE_UNUSED VALUE self, VALUE recorder_
   // In case the fork happened halfway through `serializer_flip_active_and_inactive_slots` execution and the
   // resulting state is inconsistent, we make sure to reset it back to the initial state.
   initialize_slot_concurrency_control(state);
+  // Same as above, the fork may have happened while a Ractor was holding this mutex. (Other Ractors don't survive the
+  // fork, so there's no point in recording their samples either.)
+  state->queued_samples_mutex = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+  discard_queued_samples(state);
   ddog_Timespec start_timestamp = system_epoch_now_timespec();
   reset_profile_slot(&state->profile_slot_one, start_timestamp);
   reset_profile_slot(&state->profile_slot_two, start_timestamp);
@@ -951,6 +1194,7 @@ static void reset_profile_slot(profile_slot *slot, ddog_Timespec start_timestamp
   }
   slot->start_timestamp = start_timestamp;
   slot->stats = (stats_slot) {};
+  for (int i = 0; i < ENDPOINT_CACHE_SIZE; i++) slot->endpoint_cache[i].local_root_span_id = 0;
 }
 
 // This method exists only to enable testing Datadog::Profiling::StackRecorder behavior using RSpec.
@@ -1003,6 +1247,9 @@ static VALUE _native_stats(DDTRACE_UNUSED VALUE self, VALUE recorder_instance) {
     ID2SYM(rb_intern("serialization_time_ns_total")), /* => */ RUBY_NUM_OR_NIL(state->stats_lifetime.serialization_time_ns_total, > 0, LONG2NUM),
     ID2SYM(rb_intern("serialization_time_ns_avg")),   /* => */ RUBY_AVG_OR_NIL(state->stats_lifetime.serialization_time_ns_total, total_serializations),
 
+    ID2SYM(rb_intern("queued_samples_recorded")), /* => */ ULL2NUM(state->stats_lifetime.queued_samples_recorded),
+    ID2SYM(rb_intern("queued_samples_dropped")),  /* => */ ULL2NUM(state->stats_lifetime.queued_samples_dropped),
+
     ID2SYM(rb_intern("heap_recorder_snapshot")), /* => */ heap_recorder_snapshot,
   };
   for (long unsigned int i = 0; i < VALUE_COUNT(arguments); i += 2) rb_hash_aset(stats_as_hash, arguments[i], arguments[i+1]);
@@ -1013,6 +1260,7 @@ static VALUE build_profile_stats(profile_slot *slot, long serialization_time_ns,
   VALUE stats_as_hash = rb_hash_new();
   VALUE arguments[] = {
     ID2SYM(rb_intern("recorded_samples")), /* => */ ULL2NUM(slot->stats.recorded_samples),
+    ID2SYM(rb_intern("recorded_endpoints")), /* => */ ULL2NUM(slot->stats.recorded_endpoints),
     ID2SYM(rb_intern("serialization_time_ns")), /* => */ LONG2NUM(serialization_time_ns),
     ID2SYM(rb_intern("heap_iteration_prep_time_ns")), /* => */ LONG2NUM(heap_iteration_prep_time_ns),
     ID2SYM(rb_intern("heap_profile_build_time_ns")), /* => */ LONG2NUM(heap_profile_build_time_ns),
@@ -20,11 +20,20 @@ typedef struct {
   // somewhere inside the labels slice above.
   ddog_prof_Label *state_label;
   bool is_gvl_waiting_state;
+  // Set when the caller already knows what the thread was doing (e.g. from the syscall it's blocked on) and stored it
+  // in state_label; in that case `Collectors::Stack` does not try to guess the state from the top of the stack.
+  bool is_blocking_state_known;
 
   int64_t end_timestamp_ns;
+
+  // If endpoint.len > 0, the endpoint for local_root_span_id gets recorded together with the sample (see
+  // `record_sample`). This is cheaper than calling `record_endpoint` separately.
+  uint64_t endpoint_local_root_span_id;
+  ddog_CharSlice endpoint;
 } sample_labels;
 
 void record_sample(VALUE recorder_instance, ddog_prof_Slice_Location locations, sample_values values, sample_labels labels);
+void enqueue_sample(VALUE recorder_instance, ddog_prof_Slice_Location locations, sample_values values, sample_labels labels);
 void record_endpoint(VALUE recorder_instance, uint64_t local_root_span_id, ddog_CharSlice endpoint);
 __attribute__((warn_unused_result)) bool track_object(VALUE recorder_instance, VALUE new_object, unsigned int sample_weight, ddog_CharSlice alloc_class);
 void recorder_after_sample(VALUE recorder_instance);
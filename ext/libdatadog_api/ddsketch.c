@@ -1,15 +1,111 @@
 #include <ruby.h>
+#include <ruby/thread.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <datadog/ddsketch.h>
 
 #include "datadog_ruby_common.h"
 #include "helpers.h"
 
+typedef struct {
+  int32_t index;
+  double count;
+} sketch_bin;
+
+// The contents of a sketch, as read back from its encoded form (see `decode_sketch`)
+typedef struct {
+  double gamma;
+  double zero_count;
+  sketch_bin *bins;
+  long bins_count;
+  long bins_capacity;
+} decoded_sketch;
+
+// Our own count of the points added to a libdatadog sketch, per bin (see `bin_slot_for_point`)
+typedef struct {
+  double zero_count;
+  sketch_bin *bins; // Sorted by index
+  long bins_count;
+  long bins_capacity;
+} bin_store;
+
+// Where a point goes in a bin store
+typedef struct {
+  enum { BIN_SLOT_NONE, BIN_SLOT_ZERO, BIN_SLOT_EXISTING, BIN_SLOT_NEW } kind;
+  long position;
+  int32_t index;
+} bin_slot;
+
+// Points get added to the active sketch, while `encode` works on the other (inactive) one; see `native_encode`
+typedef struct {
+  ddsketch_Handle_DDSketch sketches[2];
+  int active;
+  bool encoding; // Set while the inactive sketch is being encoded
+  // Bins of each of the sketches, used by `merge` and `quantile`
+  bin_store stores[2];
+} ddsketch_state;
+
+typedef struct {
+  ddsketch_Handle_DDSketch *sketch;
+  ddog_Vec_U8 encoded;
+  bool encode_ran;
+} encode_without_gvl_arguments;
+
+// Minimal protobuf reader, just enough for the DDSketch message (see spec/datadog/core/ddsketch_pprof/ddsketch.proto)
+typedef struct {
+  const uint8_t *position;
+  const uint8_t *end;
+} pb_reader;
+
+// libdatadog exposes neither the bins of a sketch, nor how it maps points to bins. To support merging and quantiles, we
+// keep our own count of points per bin next to each libdatadog sketch (see `bin_store`), which needs us to map points
+// to bins the same way libdatadog does. We figure that out once, when loading, by adding known points to a sketch and
+// reading back its encoded form (see `calibrate_mapping`).
+static struct {
+  bool calibrated;
+  double log_gamma;
+  // A point in the middle of bin `i` is gamma^(i + bin_center_offset)
+  double bin_center_offset;
+} mapping;
+
 static VALUE _native_new(VALUE klass);
 static void ddsketch_free(void *ptr);
+static size_t ddsketch_memsize(const void *ptr);
+static ddsketch_state *ddsketch_state_for(VALUE self);
+static inline ddsketch_Handle_DDSketch *active_sketch(ddsketch_state *state);
+static inline bin_store *active_store(ddsketch_state *state);
 static VALUE native_add(VALUE self, VALUE point);
 static VALUE native_add_with_count(VALUE self, VALUE point, VALUE count);
+static VALUE native_add_many(VALUE self, VALUE points);
+static int compare_points(const void *a, const void *b);
+static VALUE native_merge(VALUE self, VALUE other);
+static VALUE native_quantile(VALUE self, VALUE quantile);
+static int compare_bins(const void *a, const void *b);
 static VALUE native_count(VALUE self);
 static VALUE native_encode(VALUE self);
+static void *encode_without_gvl(void *encode_args);
+static VALUE encode_and_reset(ddsketch_state *state);
+static bin_slot bin_slot_for_point(bin_store *store, double point);
+static bin_slot bin_slot_for_index(bin_store *store, int32_t index);
+static void bin_store_add(bin_store *store, bin_slot slot, double count);
+static void bin_store_reset(bin_store *store);
+static void check_add_result(ddog_VoidResult result, const char *operation);
+static void ensure_mapping_calibrated(const char *operation);
+static double bin_point(int32_t index);
+static int32_t bin_index(double point);
+static void calibrate_mapping(void);
+static bool encode_and_decode_for_calibration(ddsketch_Handle_DDSketch *sketch, decoded_sketch *decoded);
+static bool decode_sketch(const uint8_t *data, size_t length, decoded_sketch *decoded);
+static bool decode_mapping(pb_reader reader, decoded_sketch *decoded);
+static bool decode_store(pb_reader reader, decoded_sketch *decoded);
+static bool push_bin(decoded_sketch *decoded, int32_t index, double count);
+static bool pb_read_varint(pb_reader *reader, uint64_t *value);
+static bool pb_read_double(pb_reader *reader, double *value);
+static bool pb_read_bytes(pb_reader *reader, pb_reader *contents);
+static bool pb_skip(pb_reader *reader, int wire_type);
 
 void ddsketch_init(VALUE core_module) {
   VALUE ddsketch_class = rb_define_class_under(core_module, "DDSketch", rb_cObject);
@@ -17,76 +113,317 @@ void ddsketch_init(VALUE core_module) {
   rb_define_alloc_func(ddsketch_class, _native_new);
   rb_define_method(ddsketch_class, "add", native_add, 1);
   rb_define_method(ddsketch_class, "add_with_count", native_add_with_count, 2);
+  rb_define_method(ddsketch_class, "add_many", native_add_many, 1);
+  rb_define_method(ddsketch_class, "merge", native_merge, 1);
+  rb_define_method(ddsketch_class, "quantile", native_quantile, 1);
   rb_define_method(ddsketch_class, "count", native_count, 0);
   rb_define_method(ddsketch_class, "encode", native_encode, 0);
+
+  calibrate_mapping();
 }
 
-// This structure is used to define a Ruby object that stores a pointer to a ddsketch_Handle_DDSketch
+// This structure is used to define a Ruby object that stores a pair of ddsketch_Handle_DDSketch
 // See also https://github.com/ruby/ruby/blob/master/doc/extension.rdoc for how this works
 static const rb_data_type_t ddsketch_typed_data = {
   .wrap_struct_name = "Datadog::DDSketch",
   .function = {
     .dmark = NULL, // We don't store references to Ruby objects so we don't need to mark any of them
     .dfree = ddsketch_free,
-    .dsize = NULL, // We don't track memory usage (although it'd be cool if we did!)
+    .dsize = ddsketch_memsize,
     //.dcompact = NULL, // Not needed -- we don't store references to Ruby objects
   },
   .flags = RUBY_TYPED_FREE_IMMEDIATELY
 };
 
 static VALUE _native_new(VALUE klass) {
-  ddsketch_Handle_DDSketch *state = ruby_xcalloc(1, sizeof(ddsketch_Handle_DDSketch));
+  ddsketch_state *state = ruby_xcalloc(1, sizeof(ddsketch_state));
 
-  *state = ddog_ddsketch_new();
+  state->sketches[0] = ddog_ddsketch_new();
+  state->sketches[1] = ddog_ddsketch_new();
 
   return TypedData_Wrap_Struct(klass, &ddsketch_typed_data, state);
 }
 
 static void ddsketch_free(void *ptr) {
-  ddsketch_Handle_DDSketch *state = (ddsketch_Handle_DDSketch *) ptr;
-  ddog_ddsketch_drop(state);
+  ddsketch_state *state = (ddsketch_state *) ptr;
+  ddog_ddsketch_drop(&state->sketches[0]);
+  ddog_ddsketch_drop(&state->sketches[1]);
+  ruby_xfree(state->stores[0].bins);
+  ruby_xfree(state->stores[1].bins);
   ruby_xfree(ptr);
 }
 
+// libdatadog doesn't tell us how much memory a sketch uses, so we estimate it by assuming it keeps a count (a double)
+// for every bin between its lowest and highest bins, which we get from the matching bin store. Each sketch gets
+// estimated from its own store, so this also covers points that get added to one sketch while the other gets encoded.
+static size_t ddsketch_memsize(const void *ptr) {
+  const ddsketch_state *state = (const ddsketch_state *) ptr;
+  size_t size = sizeof(ddsketch_state);
+
+  for (int i = 0; i < 2; i++) {
+    const bin_store *store = &state->stores[i];
+    size += store->bins_capacity * sizeof(sketch_bin);
+    if (store->bins_count > 0) {
+      int64_t bins = (int64_t) store->bins[store->bins_count - 1].index - store->bins[0].index + 1;
+      size += bins * sizeof(double);
+    }
+  }
+
+  return size;
+}
+
+static ddsketch_state *ddsketch_state_for(VALUE self) {
+  ddsketch_state *state;
+  TypedData_Get_Struct(self, ddsketch_state, &ddsketch_typed_data, state);
+  return state;
+}
+
+static inline ddsketch_Handle_DDSketch *active_sketch(ddsketch_state *state) {
+  return &state->sketches[state->active];
+}
+
+static inline bin_store *active_store(ddsketch_state *state) {
+  return &state->stores[state->active];
+}
+
 static VALUE native_add(VALUE self, VALUE point) {
-  ddsketch_Handle_DDSketch *state;
-  TypedData_Get_Struct(self, ddsketch_Handle_DDSketch, &ddsketch_typed_data, state);
+  ddsketch_state *state = ddsketch_state_for(self);
 
-  ddog_VoidResult result = ddog_ddsketch_add(state, NUM2DBL(point));
+  double point_value = NUM2DBL(point);
+  bin_slot slot = bin_slot_for_point(active_store(state), point_value);
+  ddog_VoidResult result = ddog_ddsketch_add(active_sketch(state), point_value);
 
   CHECK_VOID_RESULT("DDSketch add failed", result);
+  bin_store_add(active_store(state), slot, 1.0);
 
   return self;
 }
 
 static VALUE native_add_with_count(VALUE self, VALUE point, VALUE count) {
-  ddsketch_Handle_DDSketch *state;
-  TypedData_Get_Struct(self, ddsketch_Handle_DDSketch, &ddsketch_typed_data, state);
+  ddsketch_state *state = ddsketch_state_for(self);
 
-  ddog_VoidResult result = ddog_ddsketch_add_with_count(state, NUM2DBL(point), NUM2DBL(count));
+  double point_value = NUM2DBL(point);
+  double count_value = NUM2DBL(count);
+  bin_slot slot = bin_slot_for_point(active_store(state), point_value);
+  ddog_VoidResult result = ddog_ddsketch_add_with_count(active_sketch(state), point_value, count_value);
 
   CHECK_VOID_RESULT("DDSketch add_with_count failed", result);
+  bin_store_add(active_store(state), slot, count_value);
 
   return self;
 }
 
+// Adds many points to the sketch in a single call. `points` can be either an Array of Numerics, or a String of packed
+// native-endian doubles (e.g. from `Array#pack("d*")`), which avoids creating a Float object per point.
+//
+// The points are sorted first, so that repeated values can be added with a single `add_with_count` each. The order in
+// which points get added doesn't affect the sketch, but this saves a lot of work when values repeat often (e.g.
+// latencies measured with a coarse resolution).
+//
+// Note that if a point is invalid, the points that sort before it will have already been added when the error is raised.
+static VALUE native_add_many(VALUE self, VALUE points) {
+  ddsketch_state *state = ddsketch_state_for(self);
+
+  long count;
+  if (RB_TYPE_P(points, T_STRING)) {
+    if (RSTRING_LEN(points) % sizeof(double) != 0) {
+      raise_error(rb_eArgError, "Expected points String to contain packed doubles, but its length is not a multiple of %d", (int) sizeof(double));
+    }
+    count = RSTRING_LEN(points) / sizeof(double);
+  } else {
+    ENFORCE_TYPE(points, T_ARRAY);
+    count = RARRAY_LEN(points);
+  }
+
+  if (count == 0) return self;
+
+  // ALLOCV uses the stack for small batches, and otherwise a buffer owned by Ruby, so nothing leaks if we raise
+  VALUE buffer_holder;
+  double *buffer = ALLOCV_N(double, buffer_holder, count);
+
+  if (RB_TYPE_P(points, T_STRING)) {
+    memcpy(buffer, RSTRING_PTR(points), count * sizeof(double));
+  } else {
+    for (long i = 0; i < count; i++) buffer[i] = NUM2DBL(RARRAY_AREF(points, i));
+  }
+
+  qsort(buffer, count, sizeof(double), compare_points);
+
+  for (long i = 0; i < count;) {
+    long repeats = 1;
+    while (i + repeats < count && buffer[i + repeats] == buffer[i]) repeats++;
+
+    bin_slot slot = bin_slot_for_point(active_store(state), buffer[i]);
+    ddog_VoidResult result = repeats == 1 ?
+      ddog_ddsketch_add(active_sketch(state), buffer[i]) :
+      ddog_ddsketch_add_with_count(active_sketch(state), buffer[i], (double) repeats);
+
+    CHECK_VOID_RESULT("DDSketch add_many failed", result);
+    bin_store_add(active_store(state), slot, (double) repeats);
+
+    i += repeats;
+  }
+
+  ALLOCV_END(buffer_holder);
+
+  return self;
+}
+
+static int compare_points(const void *a, const void *b) {
+  double point_a = *(const double *) a;
+  double point_b = *(const double *) b;
+  return (point_a > point_b) - (point_a < point_b);
+}
+
+// Adds all points from `other` into this sketch; `other` is left unchanged.
+//
+// This costs one libdatadog call per bin of `other`.
+//
+// Note: There's no need for callers to synchronize when multiple threads add points to the same sketch: all operations
+// on a sketch run while holding the Global VM Lock, and thus can't interleave.
+static VALUE native_merge(VALUE self, VALUE other) {
+  ddsketch_state *state = ddsketch_state_for(self);
+  ddsketch_state *other_state = ddsketch_state_for(other);
+
+  ensure_mapping_calibrated("merge");
+
+  bin_store *store = active_store(state);
+  bin_store *other_store = active_store(other_state);
+
+  // Note: When merging a sketch into itself, `store` and `other_store` are the same. That's fine, as every count gets
+  // read before being updated, and no bins get added (nor is the store reallocated) along the way.
+  double zero_count = other_store->zero_count;
+  if (zero_count > 0) {
+    check_add_result(ddog_ddsketch_add_with_count(active_sketch(state), 0.0, zero_count), "DDSketch merge failed");
+    store->zero_count += zero_count;
+  }
+
+  for (long i = 0; i < other_store->bins_count; i++) {
+    sketch_bin bin = other_store->bins[i];
+    double point = bin_point(bin.index);
+
+    bin_slot slot = bin_slot_for_index(store, bin.index);
+    check_add_result(ddog_ddsketch_add_with_count(active_sketch(state), point, bin.count), "DDSketch merge failed");
+    bin_store_add(store, slot, bin.count);
+  }
+
+  return self;
+}
+
+// Returns an estimate of the given quantile (between 0 and 1) of the points added to the sketch, or nil if the sketch
+// is empty. The estimate is within the sketch's relative accuracy of an actual point.
+//
+// This only walks our own copy of the bins (see `bin_store`), and doesn't call into libdatadog.
+static VALUE native_quantile(VALUE self, VALUE quantile) {
+  ddsketch_state *state = ddsketch_state_for(self);
+
+  double q = NUM2DBL(quantile);
+  if (!(q >= 0.0 && q <= 1.0)) raise_error(rb_eArgError, "Expected quantile to be between 0 and 1, got %f", q);
+
+  ensure_mapping_calibrated("quantile");
+
+  bin_store *store = active_store(state);
+
+  double total = store->zero_count;
+  for (long i = 0; i < store->bins_count; i++) total += store->bins[i].count;
+
+  if (!(total > 0)) return Qnil;
+
+  // Same approach as the reference DDSketch implementations: find the bin holding the point with this rank
+  double rank = q * (total - 1);
+  double seen = store->zero_count;
+  double value = 0.0;
+
+  for (long i = 0; i < store->bins_count && seen <= rank; i++) {
+    seen += store->bins[i].count;
+    value = bin_point(store->bins[i].index);
+  }
+
+  return DBL2NUM(value);
+}
+
+static int compare_bins(const void *a, const void *b) {
+  int32_t index_a = ((const sketch_bin *) a)->index;
+  int32_t index_b = ((const sketch_bin *) b)->index;
+  return (index_a > index_b) - (index_a < index_b);
+}
+
 static VALUE native_count(VALUE self) {
-  ddsketch_Handle_DDSketch *state;
-  TypedData_Get_Struct(self, ddsketch_Handle_DDSketch, &ddsketch_typed_data, state);
+  ddsketch_state *state = ddsketch_state_for(self);
 
   double count_out;
-  ddog_VoidResult result = ddog_ddsketch_count(state, &count_out);
+  ddog_VoidResult result = ddog_ddsketch_count(active_sketch(state), &count_out);
 
   CHECK_VOID_RESULT("DDSketch count failed", result);
 
   return DBL2NUM(count_out);
 }
 
+// Encodes the sketch and resets it.
+//
+// Similar to the StackRecorder's profile slots, we keep two sketches: points always get added to the active one, and
+// encoding flips which one is active and then encodes the now-inactive one without holding the Global VM Lock. This
+// way, other threads can keep adding points while we encode (and the allocations libdatadog does for encoding and
+// then re-creating the sketch don't happen while holding the GVL).
+//
+// Every other operation holds the GVL while working on the active sketch, and flipping also happens while holding the
+// GVL, so no other thread can be touching the inactive sketch while it gets encoded.
 static VALUE native_encode(VALUE self) {
-  ddsketch_Handle_DDSketch *state;
-  TypedData_Get_Struct(self, ddsketch_Handle_DDSketch, &ddsketch_typed_data, state);
+  ddsketch_state *state = ddsketch_state_for(self);
+
+  // If another thread is encoding the inactive sketch, we encode the active one in place instead. Both calls still
+  // return every point exactly once, as they'd do if they had happened one after the other.
+  if (state->encoding) return encode_and_reset(state);
+
+  encode_without_gvl_arguments args = {.encode_ran = false};
+  int encoded_slot = state->active;
+
+  while (!args.encode_ran) {
+    // Give the Ruby VM an opportunity to process any pending interruptions (including raising exceptions), while our
+    // state is still consistent. See also the similar loop in `_native_serialize` in the StackRecorder.
+    rb_thread_check_ints();
+
+    encoded_slot = state->active;
+    args.sketch = active_sketch(state);
+    state->active = 1 - state->active;
+    state->encoding = true;
+
+    // We use rb_thread_call_without_gvl2 here because unlike the regular _gvl variant, gvl2 does not process
+    // interruptions and thus does not raise exceptions after running our code.
+    rb_thread_call_without_gvl2(encode_without_gvl, &args, NULL /* No interruption function needed in this case */, NULL /* Not needed */);
 
-  ddog_Vec_U8 encoded = ddog_ddsketch_encode(state);
+    state->encoding = false;
+    // If there was a pending interruption, our code didn't run, so we undo the flip and try again
+    if (!args.encode_ran) state->active = 1 - state->active;
+  }
+
+  // Only now that the points are gone from the libdatadog sketch can we drop our counts for it; if we had done it at
+  // the flip, an interruption would've left the sketch with points we no longer had counts for
+  bin_store_reset(&state->stores[encoded_slot]);
+
+  // Copy into a Ruby string
+  VALUE bytes = rb_str_new((const char *) args.encoded.ptr, args.encoded.len);
+
+  ddog_Vec_U8_drop(args.encoded);
+
+  return bytes;
+}
+
+static void *encode_without_gvl(void *encode_args) {
+  encode_without_gvl_arguments *args = (encode_without_gvl_arguments *) encode_args;
+
+  args->encoded = ddog_ddsketch_encode(args->sketch);
+  // The sketch is consumed by encode, so we re-create it to be ready for when it becomes active again
+  *args->sketch = ddog_ddsketch_new();
+
+  args->encode_ran = true;
+
+  return NULL; // Unused
+}
+
+// Same as `native_encode`, but encodes the active sketch while holding the GVL
+static VALUE encode_and_reset(ddsketch_state *state) {
+  ddog_Vec_U8 encoded = ddog_ddsketch_encode(active_sketch(state));
 
   // Copy into a Ruby string
   VALUE bytes = rb_str_new((const char *) encoded.ptr, encoded.len);
@@ -96,7 +433,313 @@ static VALUE native_encode(VALUE self) {
   // The sketch is consumed by encode; to make this a bit more user-friendly for
   // a Ruby API (since we can't "kill" the Ruby object), let's re-initialize it so
   // it can be used again.
-  *state = ddog_ddsketch_new();
+  *active_sketch(state) = ddog_ddsketch_new();
+  bin_store_reset(active_store(state));
 
   return bytes;
 }
+
+// Finds where `point` goes in the store, making room for a new bin if needed.
+//
+// This can raise (if we run out of memory), so it gets called before adding the point to the libdatadog sketch, with
+// `bin_store_add` called once the point was added. Points that libdatadog rejects (negative, NaN, ...) don't get
+// counted; neither does anything while the mapping isn't calibrated, as then `merge` and `quantile` are unavailable.
+static bin_slot bin_slot_for_point(bin_store *store, double point) {
+  if (!mapping.calibrated || !(point >= 0) || !isfinite(point)) return (bin_slot) {.kind = BIN_SLOT_NONE};
+  if (point == 0) return (bin_slot) {.kind = BIN_SLOT_ZERO};
+
+  return bin_slot_for_index(store, bin_index(point));
+}
+
+static bin_slot bin_slot_for_index(bin_store *store, int32_t index) {
+  long low = 0;
+  long high = store->bins_count;
+  while (low < high) {
+    long middle = low + (high - low) / 2;
+    if (store->bins[middle].index < index) low = middle + 1; else high = middle;
+  }
+
+  if (low < store->bins_count && store->bins[low].index == index) {
+    return (bin_slot) {.kind = BIN_SLOT_EXISTING, .position = low, .index = index};
+  }
+
+  if (store->bins_count == store->bins_capacity) {
+    long bins_capacity = store->bins_capacity == 0 ? 32 : store->bins_capacity * 2;
+    store->bins = ruby_xrealloc2(store->bins, bins_capacity, sizeof(sketch_bin));
+    store->bins_capacity = bins_capacity;
+  }
+
+  return (bin_slot) {.kind = BIN_SLOT_NEW, .position = low, .index = index};
+}
+
+static void bin_store_add(bin_store *store, bin_slot slot, double count) {
+  switch (slot.kind) {
+    case BIN_SLOT_NONE:
+      return;
+    case BIN_SLOT_ZERO:
+      store->zero_count += count;
+      return;
+    case BIN_SLOT_EXISTING:
+      store->bins[slot.position].count += count;
+      return;
+    case BIN_SLOT_NEW:
+      memmove(&store->bins[slot.position + 1], &store->bins[slot.position], (store->bins_count - slot.position) * sizeof(sketch_bin));
+      store->bins[slot.position] = (sketch_bin) {.index = slot.index, .count = count};
+      store->bins_count++;
+      return;
+  }
+}
+
+// Keeps the memory for the bins around, as the sketch usually gets refilled with similar points
+static void bin_store_reset(bin_store *store) {
+  store->zero_count = 0;
+  store->bins_count = 0;
+}
+
+// Same as CHECK_VOID_RESULT, but for messages that are not string literals
+static void check_add_result(ddog_VoidResult result, const char *operation) {
+  if (result.tag == DDOG_VOID_RESULT_ERR) {
+    char error_msg[MAX_RAISE_MESSAGE_SIZE];
+    read_ddogerr_string_and_drop(&result.err, error_msg, MAX_RAISE_MESSAGE_SIZE);
+    raise_error(rb_eRuntimeError, "%s: %s", operation, error_msg);
+  }
+}
+
+static void ensure_mapping_calibrated(const char *operation) {
+  if (!mapping.calibrated) {
+    raise_error(rb_eRuntimeError, "DDSketch %s is not supported with the current libdatadog version", operation);
+  }
+}
+
+static double bin_point(int32_t index) {
+  return exp(mapping.log_gamma * (index + mapping.bin_center_offset));
+}
+
+// The reverse of `bin_point`: bin `i` holds the points between gamma^(i + bin_center_offset - 0.5) and
+// gamma^(i + bin_center_offset + 0.5).
+//
+// Our log may not exactly match libdatadog's, so a point right at the edge of a bin can get counted in the next bin
+// over; both are still within the sketch's relative accuracy of the point.
+static int32_t bin_index(double point) {
+  return (int32_t) floor(log(point) / mapping.log_gamma - mapping.bin_center_offset + 0.5);
+}
+
+// Figures out how libdatadog maps points to bins, see `mapping` above.
+// If anything doesn't look as expected, `mapping.calibrated` stays false, and `merge`/`quantile` raise when used.
+static void calibrate_mapping(void) {
+  sketch_bin bins[2];
+  decoded_sketch decoded = {.bins = bins, .bins_capacity = 2};
+
+  // 1. Find out gamma
+  ddsketch_Handle_DDSketch sketch = ddog_ddsketch_new();
+  ddog_VoidResult result = ddog_ddsketch_add(&sketch, 1.0);
+  if (result.tag == DDOG_VOID_RESULT_ERR) {
+    ddog_Error_drop(&result.err);
+    ddog_ddsketch_drop(&sketch);
+    return;
+  }
+  if (!encode_and_decode_for_calibration(&sketch, &decoded) || !(decoded.gamma > 1.0)) return;
+  double log_gamma = log(decoded.gamma);
+
+  // 2. Add points a quarter and three quarters of the way between gamma^10 and gamma^11. If both land in the same bin,
+  // libdatadog rounds indexes down (or up); otherwise, it rounds them to the nearest integer.
+  sketch = ddog_ddsketch_new();
+  result = ddog_ddsketch_add(&sketch, exp(log_gamma * 10.25));
+  if (result.tag == DDOG_VOID_RESULT_OK) result = ddog_ddsketch_add(&sketch, exp(log_gamma * 10.75));
+  if (result.tag == DDOG_VOID_RESULT_ERR) {
+    ddog_Error_drop(&result.err);
+    ddog_ddsketch_drop(&sketch);
+    return;
+  }
+  if (!encode_and_decode_for_calibration(&sketch, &decoded) || decoded.bins_count < 1) return;
+
+  int32_t first_index = decoded.bins[0].index;
+  if (decoded.bins_count == 2 && decoded.bins[1].index < first_index) first_index = decoded.bins[1].index;
+
+  mapping.log_gamma = log_gamma;
+  mapping.bin_center_offset = (decoded.bins_count == 1 ? 10.5 : 10.0) - first_index;
+
+  // 3. Check that points we create for bins land in those same bins
+  sketch = ddog_ddsketch_new();
+  result = ddog_ddsketch_add(&sketch, bin_point(first_index));
+  if (result.tag == DDOG_VOID_RESULT_OK) result = ddog_ddsketch_add(&sketch, bin_point(first_index + 300));
+  if (result.tag == DDOG_VOID_RESULT_ERR) {
+    ddog_Error_drop(&result.err);
+    ddog_ddsketch_drop(&sketch);
+    return;
+  }
+  if (!encode_and_decode_for_calibration(&sketch, &decoded) || decoded.bins_count != 2) return;
+
+  qsort(decoded.bins, decoded.bins_count, sizeof(sketch_bin), compare_bins);
+  mapping.calibrated = decoded.bins[0].index == first_index && decoded.bins[1].index == first_index + 300;
+}
+
+// Consumes the sketch
+static bool encode_and_decode_for_calibration(ddsketch_Handle_DDSketch *sketch, decoded_sketch *decoded) {
+  ddog_Vec_U8 encoded = ddog_ddsketch_encode(sketch);
+  bool success = decode_sketch(encoded.ptr, encoded.len, decoded);
+  ddog_Vec_U8_drop(encoded);
+  return success;
+}
+
+static bool decode_sketch(const uint8_t *data, size_t length, decoded_sketch *decoded) {
+  pb_reader reader = {.position = data, .end = data + length};
+  decoded->gamma = 0;
+  decoded->zero_count = 0;
+  decoded->bins_count = 0;
+
+  while (reader.position < reader.end) {
+    uint64_t tag;
+    pb_reader contents;
+    if (!pb_read_varint(&reader, &tag)) return false;
+
+    switch (tag) {
+      case (1 << 3 | 2): // mapping
+        if (!pb_read_bytes(&reader, &contents) || !decode_mapping(contents, decoded)) return false;
+        break;
+      case (2 << 3 | 2): // positiveValues
+        if (!pb_read_bytes(&reader, &contents) || !decode_store(contents, decoded)) return false;
+        break;
+      case (4 << 3 | 1): // zeroCount
+        if (!pb_read_double(&reader, &decoded->zero_count)) return false;
+        break;
+      default:
+        // Note: This includes negativeValues, which are always empty as libdatadog rejects negative points
+        if (!pb_skip(&reader, tag & 7)) return false;
+    }
+  }
+
+  return true;
+}
+
+static bool decode_mapping(pb_reader reader, decoded_sketch *decoded) {
+  while (reader.position < reader.end) {
+    uint64_t tag;
+    uint64_t interpolation;
+    if (!pb_read_varint(&reader, &tag)) return false;
+
+    switch (tag) {
+      case (1 << 3 | 1): // gamma
+        if (!pb_read_double(&reader, &decoded->gamma)) return false;
+        break;
+      case (3 << 3 | 0): // interpolation
+        // We only know how to map points to bins when the log is computed exactly (interpolation NONE)
+        if (!pb_read_varint(&reader, &interpolation) || interpolation != 0) return false;
+        break;
+      default:
+        if (!pb_skip(&reader, tag & 7)) return false;
+    }
+  }
+
+  return true;
+}
+
+static bool decode_store(pb_reader reader, decoded_sketch *decoded) {
+  pb_reader contiguous_bin_counts = {0};
+  int32_t contiguous_bin_index_offset = 0;
+
+  while (reader.position < reader.end) {
+    uint64_t tag;
+    uint64_t value;
+    pb_reader contents;
+    if (!pb_read_varint(&reader, &tag)) return false;
+
+    switch (tag) {
+      case (1 << 3 | 2): { // binCounts map entry
+        if (!pb_read_bytes(&reader, &contents)) return false;
+
+        int32_t index = 0;
+        double count = 0;
+        while (contents.position < contents.end) {
+          if (!pb_read_varint(&contents, &tag)) return false;
+
+          if (tag == (1 << 3 | 0)) {
+            if (!pb_read_varint(&contents, &value)) return false;
+            index = (int32_t) ((value >> 1) ^ -(value & 1)); // sint32 uses zigzag encoding
+          } else if (tag == (2 << 3 | 1)) {
+            if (!pb_read_double(&contents, &count)) return false;
+          } else if (!pb_skip(&contents, tag & 7)) {
+            return false;
+          }
+        }
+        if (!push_bin(decoded, index, count)) return false;
+        break;
+      }
+      case (2 << 3 | 2): // contiguousBinCounts (packed)
+        if (!pb_read_bytes(&reader, &contiguous_bin_counts)) return false;
+        break;
+      case (3 << 3 | 0): // contiguousBinIndexOffset
+        if (!pb_read_varint(&reader, &value)) return false;
+        contiguous_bin_index_offset = (int32_t) ((value >> 1) ^ -(value & 1));
+        break;
+      default:
+        if (!pb_skip(&reader, tag & 7)) return false;
+    }
+  }
+
+  // The offset may come after the counts, so we can only process them at the end
+  for (int32_t i = 0; contiguous_bin_counts.position < contiguous_bin_counts.end; i++) {
+    double count;
+    if (!pb_read_double(&contiguous_bin_counts, &count)) return false;
+    if (!push_bin(decoded, contiguous_bin_index_offset + i, count)) return false;
+  }
+
+  return true;
+}
+
+static bool push_bin(decoded_sketch *decoded, int32_t index, double count) {
+  if (count == 0) return true;
+  if (decoded->bins_count >= decoded->bins_capacity) return false;
+
+  decoded->bins[decoded->bins_count++] = (sketch_bin) {.index = index, .count = count};
+  return true;
+}
+
+static bool pb_read_varint(pb_reader *reader, uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && reader->position < reader->end; shift += 7) {
+    uint8_t byte = *reader->position++;
+    *value |= (uint64_t) (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+static bool pb_read_double(pb_reader *reader, double *value) {
+  if (reader->end - reader->position < 8) return false;
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++) bits |= (uint64_t) reader->position[i] << (8 * i); // Protobuf uses little-endian
+  memcpy(value, &bits, sizeof(double));
+
+  reader->position += 8;
+  return true;
+}
+
+static bool pb_read_bytes(pb_reader *reader, pb_reader *contents) {
+  uint64_t length;
+  if (!pb_read_varint(reader, &length) || length > (uint64_t) (reader->end - reader->position)) return false;
+
+  *contents = (pb_reader) {.position = reader->position, .end = reader->position + length};
+  reader->position += length;
+  return true;
+}
+
+static bool pb_skip(pb_reader *reader, int wire_type) {
+  uint64_t ignored;
+  pb_reader ignored_contents;
+
+  switch (wire_type) {
+    case 0: return pb_read_varint(reader, &ignored);
+    case 1:
+      if (reader->end - reader->position < 8) return false;
+      reader->position += 8;
+      return true;
+    case 2: return pb_read_bytes(reader, &ignored_contents);
+    case 5:
+      if (reader->end - reader->position < 4) return false;
+      reader->position += 4;
+      return true;
+    default: return false;
+  }
+}
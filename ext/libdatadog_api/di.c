@@ -1,9 +1,19 @@
+#include <ruby.h>
+#include <ruby/debug.h>
+#include <ruby/encoding.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "datadog_ruby_common.h"
 
 // Prototypes for Ruby functions declared in internal Ruby headers.
 VALUE rb_iseqw_new(const void *iseq);
+const void *rb_iseqw_to_iseq(VALUE iseqw);
+VALUE rb_iseq_absolute_path(const void *iseq);
+VALUE rb_iseq_first_lineno(const void *iseq);
+void rb_iseq_code_location(const void *iseq, int *first_lineno, int *first_column, int *last_lineno, int *last_column);
 int rb_objspace_internal_object_p(VALUE obj);
 void rb_objspace_each_objects(
     int (*callback)(void *start, void *end, size_t stride, void *data),
@@ -11,6 +21,52 @@ void rb_objspace_each_objects(
 
 #define IMEMO_TYPE_ISEQ 7
 
+// Index from the absolute path of loaded files to the whole-file iseq for their code.
+//
+// The index gets built on first use by walking the heap (see `all_iseqs`), and from then on a :script_compiled
+// tracepoint adds the whole-file iseq of every file that gets loaded. Only whole-file iseqs get indexed, no matter
+// which way they're found: a whole-file iseq covers every line in the file, which is what targeted line trace points
+// need, and the index returns the same results regardless of when a file got loaded. (When the index gets built, the
+// whole-file iseqs of some files may have already been garbage collected, e.g. for files that don't define any
+// methods; those files are missing from the index until they get loaded again.)
+//
+// The index stores iseqs themselves (rather than RubyVM::InstructionSequence wrappers), and only creates wrappers for
+// the iseqs that get returned. Indexed iseqs are kept alive by the index, same as the CodeTracker does for its
+// registry; when a file is loaded again, the iseq from the previous load gets replaced.
+//
+// The index is only accessed while holding the GVL, so it doesn't need any extra synchronization.
+static struct {
+  st_table *iseqs_by_path; // char * (absolute path) => VALUE (iseq); NULL until the index gets built
+  VALUE holder; // Hidden object used to mark the indexed iseqs
+  VALUE script_compiled_tracepoint;
+} iseq_index;
+
+static ID id_eval_script;
+static ID id_instruction_sequence;
+static ID id_line_probe_hook; // Hidden ivar linking a trace point to its LineProbeHook, see `line_probe_hook_initialize`
+
+// State for a Datadog::DI::LineProbeHook, the native trace point callback used for targeted line probes.
+//
+// Hits get filtered and rate limited here, before invoking the Ruby callback, so that hits that don't produce a
+// snapshot don't pay for creating a Ruby frame, a TracePoint binding, etc. The rate limiter is a token bucket that
+// behaves the same as Datadog::Core::TokenBucket.
+//
+// Trace point callbacks always run while holding the GVL, so the state doesn't need any extra synchronization.
+typedef struct {
+  VALUE trace_point;
+  VALUE callback;
+  // Mirrors Probe#enabled?, so that hits of disabled probes don't get counted nor use up rate limiter tokens
+  bool enabled;
+  bool rate_limited;
+  double rate; // Tokens per second; if negative, always allow; if zero, never allow
+  double tokens;
+  long last_refill_ns;
+  // See Instrumenter#line_trace_point_callback for why :return events after a :line event get ignored
+  bool executed_on_line;
+  unsigned long hits;
+  unsigned long drops;
+} line_probe_hook_state;
+
 // The ID value of the string "mesg" which is used in Ruby source as
 // id_mesg or idMesg, and is used to set and retrieve the exception message
 // from standard library exception classes like NameError.
@@ -21,6 +77,42 @@ static bool ddtrace_imemo_iseq_p(VALUE v) {
   return rb_objspace_internal_object_p(v) && RB_TYPE_P(v, T_IMEMO) && ddtrace_imemo_type(v) == IMEMO_TYPE_ISEQ;
 }
 
+static void iseq_index_ensure_built(void);
+static void iseq_index_build(void);
+static void iseq_index_add(const void *iseq);
+static VALUE iseq_index_lookup(VALUE path);
+static void iseq_index_mark(void *ptr);
+static int iseq_index_mark_path(st_data_t key, st_data_t value, st_data_t arg);
+static int iseq_index_push_iseq(st_data_t key, st_data_t value, st_data_t arg);
+static int iseq_index_push_path(st_data_t key, st_data_t value, st_data_t arg);
+static void on_script_compiled(VALUE tracepoint, void *data);
+static VALUE line_probe_hook_alloc(VALUE klass);
+static void line_probe_hook_mark(void *ptr);
+static line_probe_hook_state *line_probe_hook_state_for(VALUE self);
+static void on_line_probe_event(VALUE tracepoint, void *data);
+static bool line_probe_hook_allow(line_probe_hook_state *state);
+static long monotonic_time_ns(void);
+
+static const rb_data_type_t iseq_index_typed_data = {
+  .wrap_struct_name = "Datadog::DI::IseqIndex",
+  .function = {
+    .dmark = iseq_index_mark,
+    .dfree = NULL, // The index lives for as long as the process
+    .dsize = NULL,
+  },
+  .flags = 0,
+};
+
+static const rb_data_type_t line_probe_hook_typed_data = {
+  .wrap_struct_name = "Datadog::DI::LineProbeHook",
+  .function = {
+    .dmark = line_probe_hook_mark,
+    .dfree = RUBY_DEFAULT_FREE,
+    .dsize = NULL,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY
+};
+
 static int ddtrace_di_os_obj_of_i(void *vstart, void *vend, size_t stride, void *data)
 {
   VALUE *array = (VALUE *)data;
@@ -48,6 +140,183 @@ static VALUE all_iseqs(DDTRACE_UNUSED VALUE _self) {
   return array;
 }
 
+/*
+ * call-seq:
+ *   DI.file_iseqs -> Array
+ *
+ * Returns the whole-file RubyVM::InstructionSequence objects for the
+ * loaded files that are in the iseq index (see +iseq_index+ above),
+ * building it first if needed. Eval'd code is not included.
+ *
+ * @return [Array<RubyVM::InstructionSequence>] The iseqs, in no particular order
+ */
+static VALUE file_iseqs(DDTRACE_UNUSED VALUE _self) {
+  iseq_index_ensure_built();
+
+  VALUE array = rb_ary_new_capa(iseq_index.iseqs_by_path->num_entries);
+  st_foreach(iseq_index.iseqs_by_path, iseq_index_push_iseq, (st_data_t) array);
+  return array;
+}
+
+static int iseq_index_push_iseq(DDTRACE_UNUSED st_data_t key, st_data_t value, st_data_t arg) {
+  rb_ary_push((VALUE) arg, rb_iseqw_new((const void *) value));
+  return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *   DI.file_paths -> Array
+ *
+ * Returns the absolute paths of the loaded files that are in the iseq
+ * index (see +iseq_index+ above), building it first if needed.
+ *
+ * Unlike +file_iseqs+, this doesn't create a RubyVM::InstructionSequence
+ * object per file, so it's the cheaper way of looking for a file (e.g. by
+ * suffix); +iseqs_for_path+ then returns the iseq for the matching path.
+ *
+ * @return [Array<String>] The paths, in no particular order
+ */
+static VALUE file_paths(DDTRACE_UNUSED VALUE _self) {
+  iseq_index_ensure_built();
+
+  VALUE array = rb_ary_new_capa(iseq_index.iseqs_by_path->num_entries);
+  st_foreach(iseq_index.iseqs_by_path, iseq_index_push_path, (st_data_t) array);
+  return array;
+}
+
+static int iseq_index_push_path(st_data_t key, DDTRACE_UNUSED st_data_t value, st_data_t arg) {
+  rb_ary_push((VALUE) arg, rb_filesystem_str_new_cstr((const char *) key));
+  return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *   DI.iseqs_for_path(path) -> Array
+ *
+ * Returns the RubyVM::InstructionSequence objects for the code loaded
+ * from the file at +path+, which must be an absolute path. This is
+ * currently either empty, or the whole-file iseq.
+ *
+ * Uses the iseq index (see +iseq_index+ above), building it first if
+ * needed.
+ *
+ * @param path [String] Absolute path of a loaded file
+ * @return [Array<RubyVM::InstructionSequence>] The iseqs
+ */
+static VALUE iseqs_for_path(DDTRACE_UNUSED VALUE _self, VALUE path) {
+  VALUE iseq = iseq_index_lookup(path);
+  if (iseq == Qnil) return rb_ary_new();
+
+  return rb_ary_new_from_args(1, rb_iseqw_new((const void *) iseq));
+}
+
+/*
+ * call-seq:
+ *   DI.iseq_for_line(path, line) -> RubyVM::InstructionSequence | nil
+ *
+ * Returns the RubyVM::InstructionSequence containing +line+ in the file
+ * at +path+, which must be an absolute path, and which can be used as the
+ * target for a line trace point.
+ *
+ * Uses the iseq index (see +iseq_index+ above), building it first if
+ * needed.
+ *
+ * @param path [String] Absolute path of a loaded file
+ * @param line [Integer] Line number
+ * @return [RubyVM::InstructionSequence, nil] The iseq, or nil if no loaded code contains the line
+ */
+static VALUE iseq_for_line(DDTRACE_UNUSED VALUE _self, VALUE path, VALUE line) {
+  ENFORCE_TYPE(line, T_FIXNUM);
+  long lineno = FIX2LONG(line);
+
+  VALUE iseq = iseq_index_lookup(path);
+  if (iseq == Qnil) return Qnil;
+
+  int first_lineno = 0, first_column = 0, last_lineno = 0, last_column = 0;
+  #ifndef NO_RB_ISEQ_CODE_LOCATION
+    rb_iseq_code_location((const void *) iseq, &first_lineno, &first_column, &last_lineno, &last_column);
+  #endif
+
+  return lineno >= 1 && lineno <= last_lineno ? rb_iseqw_new((const void *) iseq) : Qnil;
+}
+
+static void iseq_index_ensure_built(void) {
+  #ifdef NO_RB_ISEQ_CODE_LOCATION
+    raise_error(rb_eNotImpError, "Indexing iseqs requires Ruby 2.6+");
+  #endif
+
+  if (iseq_index.iseqs_by_path == NULL) iseq_index_build();
+}
+
+static VALUE iseq_index_lookup(VALUE path) {
+  ENFORCE_TYPE(path, T_STRING);
+
+  iseq_index_ensure_built();
+
+  st_data_t iseq;
+  if (!st_lookup(iseq_index.iseqs_by_path, (st_data_t) StringValueCStr(path), &iseq)) return Qnil;
+
+  return (VALUE) iseq;
+}
+
+static int index_iseqs_i(void *vstart, void *vend, size_t stride, DDTRACE_UNUSED void *data) {
+  for (VALUE v = (VALUE) vstart; v != (VALUE) vend; v += stride) {
+    if (ddtrace_imemo_iseq_p(v)) iseq_index_add((const void *) v);
+  }
+
+  return 0;
+}
+
+static void iseq_index_build(void) {
+  iseq_index.iseqs_by_path = st_init_strtable();
+  iseq_index.holder = TypedData_Wrap_Struct(0, &iseq_index_typed_data, NULL);
+  rb_gc_register_address(&iseq_index.holder);
+
+  // Note: If a file was loaded more than once, the heap may still contain the whole-file iseqs from earlier loads. We
+  // can't tell which one is the most recent, so we just keep whichever we find last.
+  rb_objspace_each_objects(index_iseqs_i, NULL);
+
+  iseq_index.script_compiled_tracepoint = rb_tracepoint_new(Qnil, RUBY_EVENT_SCRIPT_COMPILED, on_script_compiled, NULL);
+  rb_gc_register_address(&iseq_index.script_compiled_tracepoint);
+  rb_tracepoint_enable(iseq_index.script_compiled_tracepoint);
+}
+
+static void iseq_index_add(const void *iseq) {
+  // Only whole-file iseqs start at line 0; iseqs for methods, blocks, classes, etc. start at the line they're defined on
+  if (rb_iseq_first_lineno(iseq) != INT2FIX(0)) return;
+
+  VALUE path = rb_iseq_absolute_path(iseq);
+  // Eval'd code has no absolute path; there's no way to target it using DI anyway
+  if (!RB_TYPE_P(path, T_STRING)) return;
+
+  if (!st_lookup(iseq_index.iseqs_by_path, (st_data_t) RSTRING_PTR(path), NULL)) {
+    char *path_copy = ruby_xmalloc(RSTRING_LEN(path) + 1);
+    memcpy(path_copy, RSTRING_PTR(path), RSTRING_LEN(path));
+    path_copy[RSTRING_LEN(path)] = '\0';
+    st_insert(iseq_index.iseqs_by_path, (st_data_t) path_copy, (st_data_t) iseq);
+  } else {
+    // Replaces the iseq from a previous load
+    st_insert(iseq_index.iseqs_by_path, (st_data_t) RSTRING_PTR(path), (st_data_t) iseq);
+  }
+}
+
+static void iseq_index_mark(DDTRACE_UNUSED void *ptr) {
+  if (iseq_index.iseqs_by_path != NULL) st_foreach(iseq_index.iseqs_by_path, iseq_index_mark_path, 0);
+}
+
+static int iseq_index_mark_path(DDTRACE_UNUSED st_data_t key, st_data_t value, DDTRACE_UNUSED st_data_t arg) {
+  rb_gc_mark((VALUE) value);
+  return ST_CONTINUE;
+}
+
+// The C API doesn't expose the iseq for :script_compiled events, so we get it the same way a Ruby TracePoint would
+static void on_script_compiled(VALUE tracepoint, DDTRACE_UNUSED void *data) {
+  // Eval'd code can't be targeted using DI
+  if (rb_funcall(tracepoint, id_eval_script, 0) != Qnil) return;
+
+  iseq_index_add(rb_iseqw_to_iseq(rb_funcall(tracepoint, id_instruction_sequence, 0)));
+}
+
 /*
  * call-seq:
  *   DI.exception_message(exception) -> String | Object
@@ -70,10 +339,249 @@ static VALUE exception_message(DDTRACE_UNUSED VALUE _self, VALUE exception) {
   return rb_ivar_get(exception, id_mesg);
 }
 
+typedef struct {
+  VALUE pairs;
+  long limit;
+  long count;
+} capture_instance_variables_state;
+
+static int capture_instance_variable_i(ID name, VALUE value, st_data_t arg) {
+  capture_instance_variables_state *state = (capture_instance_variables_state *) arg;
+
+  // Same as Object#instance_variables, skip the internal variables Ruby and C extensions attach to objects (such as
+  // the message of exceptions, see `id_mesg` above)
+  const char *name_string = rb_id2name(name);
+  if (name_string == NULL || name_string[0] != '@' || name_string[1] == '@' || value == Qundef) return ST_CONTINUE;
+
+  if (state->count < state->limit) {
+    rb_ary_push(state->pairs, ID2SYM(name));
+    rb_ary_push(state->pairs, value);
+  }
+  state->count++;
+
+  return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *   DI.capture_instance_variables(object, limit, pairs) -> Integer
+ *
+ * Appends the names and values of the first +limit+ instance variables
+ * of +object+ to +pairs+, as a flat list of name, value, name, value...,
+ * in the same order as Object#instance_variables.
+ *
+ * This method does not invoke Ruby code and as such will not call
+ * +instance_variables+ or +instance_variable_get+, if the object overrides
+ * them. It also doesn't allocate an array with every instance variable
+ * name, so capturing a few variables of an object that has many of them
+ * is cheap.
+ *
+ * @param object [Object] The object to capture instance variables of
+ * @param limit [Integer] Maximum number of instance variables to capture
+ * @param pairs [Array] Array to append the names and values to
+ * @return [Integer] The total number of instance variables of +object+,
+ *   which is greater than +limit+ when not all of them were captured
+ */
+static VALUE capture_instance_variables(DDTRACE_UNUSED VALUE _self, VALUE object, VALUE limit, VALUE pairs) {
+  ENFORCE_TYPE(limit, T_FIXNUM);
+  ENFORCE_TYPE(pairs, T_ARRAY);
+  rb_check_frozen(pairs);
+
+  capture_instance_variables_state state = {.pairs = pairs, .limit = FIX2LONG(limit), .count = 0};
+  if (!RB_SPECIAL_CONST_P(object)) rb_ivar_foreach(object, capture_instance_variable_i, (st_data_t) &state);
+
+  return LONG2NUM(state.count);
+}
+
+static VALUE line_probe_hook_alloc(VALUE klass) {
+  line_probe_hook_state *state;
+  VALUE self = TypedData_Make_Struct(klass, line_probe_hook_state, &line_probe_hook_typed_data, state);
+  state->trace_point = Qnil;
+  state->callback = Qnil;
+  state->enabled = true;
+  return self;
+}
+
+static void line_probe_hook_mark(void *ptr) {
+  line_probe_hook_state *state = (line_probe_hook_state *) ptr;
+  rb_gc_mark(state->trace_point);
+  rb_gc_mark(state->callback);
+}
+
+static line_probe_hook_state *line_probe_hook_state_for(VALUE self) {
+  line_probe_hook_state *state;
+  TypedData_Get_Struct(self, line_probe_hook_state, &line_probe_hook_typed_data, state);
+  return state;
+}
+
+/*
+ * call-seq:
+ *   LineProbeHook.new(rate_limit, callback) -> LineProbeHook
+ *
+ * Creates a hook that calls +callback+ with the trace point when the
+ * line it gets enabled for (see +trace_point+) is executed, as long as
+ * +rate_limit+ (in calls per second) allows it.
+ *
+ * When +rate_limit+ is nil, every hit calls +callback+; this is used for
+ * probes with conditions, since only hits satisfying the condition should
+ * count against the rate limit.
+ *
+ * @param rate_limit [Numeric, nil] Maximum calls per second
+ * @param callback [Proc] Called with the TracePoint for allowed hits
+ */
+static VALUE line_probe_hook_initialize(VALUE self, VALUE rate_limit, VALUE callback) {
+  line_probe_hook_state *state = line_probe_hook_state_for(self);
+
+  if (state->trace_point != Qnil) raise_error(rb_eRuntimeError, "LineProbeHook is already initialized");
+  if (!rb_obj_is_proc(callback)) raise_error(rb_eArgError, "callback must be a Proc");
+
+  if (rate_limit != Qnil) {
+    if (!rb_obj_is_kind_of(rate_limit, rb_cNumeric)) raise_error(rb_eArgError, "rate_limit must be a number or nil");
+    state->rate_limited = true;
+    state->rate = NUM2DBL(rate_limit);
+    state->tokens = state->rate;
+    state->last_refill_ns = monotonic_time_ns();
+  }
+  state->callback = callback;
+
+  // These are the same events Instrumenter#hook_line uses for targeted trace points
+  VALUE trace_point =
+    rb_tracepoint_new(Qnil, RUBY_EVENT_LINE | RUBY_EVENT_RETURN | RUBY_EVENT_B_RETURN, on_line_probe_event, state);
+  // The trace point only references the state as a raw pointer, so the trace point must keep the hook alive for as
+  // long as it may be invoked. (The hook keeps the trace point alive too, so that `trace_point` always returns it.)
+  rb_ivar_set(trace_point, id_line_probe_hook, self);
+  state->trace_point = trace_point;
+
+  return self;
+}
+
+/*
+ * call-seq:
+ *   hook.trace_point -> TracePoint
+ *
+ * Returns the trace point for this hook. It is not enabled; it should be
+ * enabled with +target:+ and +target_line:+ to instrument a line.
+ */
+static VALUE line_probe_hook_trace_point(VALUE self) {
+  return line_probe_hook_state_for(self)->trace_point;
+}
+
+/*
+ * call-seq:
+ *   hook.hits -> Integer
+ *
+ * Returns how many times the instrumented line was executed, including
+ * the hits that got dropped by the rate limiter.
+ */
+static VALUE line_probe_hook_hits(VALUE self) {
+  return ULONG2NUM(line_probe_hook_state_for(self)->hits);
+}
+
+/*
+ * call-seq:
+ *   hook.drops -> Integer
+ *
+ * Returns how many hits got dropped by the rate limiter, without calling
+ * the callback.
+ */
+static VALUE line_probe_hook_drops(VALUE self) {
+  return ULONG2NUM(line_probe_hook_state_for(self)->drops);
+}
+
+/*
+ * call-seq:
+ *   hook.enabled = enabled
+ *
+ * When +enabled+ is false, hits are ignored: they don't get counted, don't
+ * use up the rate limit, and don't call the callback. Hooks start enabled.
+ *
+ * This is set from Probe#disable!, so that a disabled probe's hits get
+ * rejected before the rate limiter rather than by the callback.
+ *
+ * @param enabled [Boolean] Whether hits should be processed
+ */
+static VALUE line_probe_hook_set_enabled(VALUE self, VALUE enabled) {
+  ENFORCE_BOOLEAN(enabled);
+  line_probe_hook_state_for(self)->enabled = enabled == Qtrue;
+  return enabled;
+}
+
+/*
+ * call-seq:
+ *   hook.enabled? -> true | false
+ *
+ * Returns whether the hook processes hits; see +enabled=+.
+ */
+static VALUE line_probe_hook_enabled_p(VALUE self) {
+  return line_probe_hook_state_for(self)->enabled ? Qtrue : Qfalse;
+}
+
+static void on_line_probe_event(VALUE tracepoint, void *data) {
+  line_probe_hook_state *state = (line_probe_hook_state *) data;
+
+  if (!state->enabled) return;
+
+  if (rb_tracearg_event_flag(rb_tracearg_from_tracepoint(tracepoint)) == RUBY_EVENT_LINE) {
+    state->executed_on_line = true;
+  } else if (state->executed_on_line) {
+    return;
+  }
+
+  state->hits++;
+
+  if (state->rate_limited && !line_probe_hook_allow(state)) {
+    state->drops++;
+    return;
+  }
+
+  // Calling the proc directly (rather than via #call) means it sees the same stack as a TracePoint block would
+  rb_proc_call_with_block(state->callback, 1, &tracepoint, Qnil);
+}
+
+static bool line_probe_hook_allow(line_probe_hook_state *state) {
+  if (state->rate < 0) return true;
+  if (state->rate == 0) return false;
+
+  long now_ns = monotonic_time_ns();
+  if (now_ns > state->last_refill_ns) {
+    state->tokens += state->rate * (now_ns - state->last_refill_ns) / 1e9;
+    if (state->tokens > state->rate) state->tokens = state->rate;
+    state->last_refill_ns = now_ns;
+  }
+
+  if (state->tokens < 1) return false;
+
+  state->tokens -= 1;
+  return true;
+}
+
+static long monotonic_time_ns(void) {
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) return 0;
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
 void di_init(VALUE datadog_module) {
   id_mesg = rb_intern("mesg");
+  id_eval_script = rb_intern("eval_script");
+  id_instruction_sequence = rb_intern("instruction_sequence");
+  id_line_probe_hook = rb_intern("__datadog_line_probe_hook");
 
   VALUE di_module = rb_define_module_under(datadog_module, "DI");
   rb_define_singleton_method(di_module, "all_iseqs", all_iseqs, 0);
+  rb_define_singleton_method(di_module, "file_iseqs", file_iseqs, 0);
+  rb_define_singleton_method(di_module, "file_paths", file_paths, 0);
+  rb_define_singleton_method(di_module, "iseqs_for_path", iseqs_for_path, 1);
+  rb_define_singleton_method(di_module, "iseq_for_line", iseq_for_line, 2);
   rb_define_singleton_method(di_module, "exception_message", exception_message, 1);
+  rb_define_singleton_method(di_module, "capture_instance_variables", capture_instance_variables, 3);
+
+  VALUE line_probe_hook_class = rb_define_class_under(di_module, "LineProbeHook", rb_cObject);
+  rb_define_alloc_func(line_probe_hook_class, line_probe_hook_alloc);
+  rb_define_method(line_probe_hook_class, "initialize", line_probe_hook_initialize, 2);
+  rb_define_method(line_probe_hook_class, "trace_point", line_probe_hook_trace_point, 0);
+  rb_define_method(line_probe_hook_class, "hits", line_probe_hook_hits, 0);
+  rb_define_method(line_probe_hook_class, "drops", line_probe_hook_drops, 0);
+  rb_define_method(line_probe_hook_class, "enabled=", line_probe_hook_set_enabled, 1);
+  rb_define_method(line_probe_hook_class, "enabled?", line_probe_hook_enabled_p, 0);
 }
@@ -83,6 +83,9 @@ end
 
 Datadog::LibdatadogExtconfHelpers.add_libdatadog_version_define
 
+# On older Rubies, `rb_iseq_code_location` is not available, so DI can't index iseqs by line
+$defs << '-DNO_RB_ISEQ_CODE_LOCATION' if RUBY_VERSION < '2.6'
+
 # Tag the native extension library with the Ruby version and Ruby platform.
 # This makes it easier for development (avoids "oops I forgot to rebuild when I switched my Ruby") and ensures that
 # the wrong library is never loaded.
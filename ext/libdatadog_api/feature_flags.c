@@ -1,5 +1,6 @@
 #include "feature_flags.h"
 
+#include <ruby/thread.h>
 #include <stdio.h>
 #include <datadog/ffe.h>
 #include <datadog/common.h>
@@ -10,12 +11,80 @@
 #include <string.h>
 #include <stdlib.h>
 
+// Results of evaluating many flags in one go (see configuration_get_assignments).
+//
+// Each result only gets turned into a ResolutionDetails object when it's accessed. At that point, ownership of the
+// libdatadog handle moves to the new object, and the entry in `results` becomes NULL.
+struct assignments_state {
+  long count;
+  ddog_ffe_Handle_ResolutionDetails *results;
+  VALUE materialized; // Array with the ResolutionDetails created so far, or nil if none was accessed yet
+
+  // Inputs used while evaluating; all of them are released once evaluation finishes. They are copied out of Ruby
+  // objects, as evaluation happens without the GVL, and are kept here so they get released if evaluation raises.
+  ddog_ffe_Handle_Configuration configuration;
+  ddog_ffe_Handle_EvaluationContext context;
+  bool owns_context;
+  char *flag_keys; // NUL-terminated flag keys, one after the other
+  ddog_ffe_ExpectedFlagType *expected_types;
+  bool evaluate_ran;
+};
+
+struct configuration_new_arguments {
+  ddog_ffe_BorrowedStr json;
+  struct ddog_ffe_Result_HandleConfiguration result;
+  bool parse_ran;
+};
+
+// Deduplicates exposure events, see Datadog::OpenFeature::Exposures::Reporter.
+//
+// Remembers the last (allocation key, variant) seen for each (flag key, targeting key) in a fixed-size table, so that
+// checking for a duplicate exposure doesn't need any Ruby allocations. Entries that land on the same slot evict each
+// other, same as entries falling out of an LRU cache.
+//
+// Entries store 64-bit hashes rather than the strings themselves. A hash collision means an exposure that doesn't get
+// reported, which is acceptable since exposures are already best-effort (e.g. they get dropped when the buffer is full).
+struct exposure_cache_entry {
+  uint64_t key_hash; // 0 means the entry is empty
+  uint64_t value_hash;
+};
+
+struct exposure_cache_state {
+  unsigned long capacity; // Always a power of two
+  struct exposure_cache_entry *entries;
+};
+
+#define EXPOSURE_CACHE_MAX_CAPACITY (1L << 20)
+
 // Forward declarations
 static VALUE configuration_new(VALUE klass, VALUE json_str);
+static VALUE configuration_parse(VALUE args_ptr);
+static void *configuration_parse_without_gvl(void *args_ptr);
 static void configuration_free(void *ptr);
 static VALUE configuration_get_assignment(
   VALUE self, VALUE flag_key, VALUE expected_type, VALUE context);
 
+static VALUE configuration_get_assignments(
+  VALUE self, VALUE flag_keys, VALUE expected_types, VALUE context);
+static void *evaluate_assignments_without_gvl(void *state_ptr);
+
+static VALUE evaluation_context_new(VALUE klass, VALUE hash);
+static void evaluation_context_free(void *ptr);
+static ddog_ffe_Handle_EvaluationContext evaluation_context_from_hash(VALUE hash);
+
+static void assignments_mark(void *ptr);
+static void assignments_free(void *ptr);
+static size_t assignments_memsize(const void *ptr);
+static void assignments_release_evaluation_inputs(struct assignments_state *state);
+static VALUE assignments_size(VALUE self);
+static VALUE assignments_aref(VALUE self, VALUE index);
+
+static VALUE exposure_cache_new(VALUE klass, VALUE capacity);
+static void exposure_cache_free(void *ptr);
+static size_t exposure_cache_memsize(const void *ptr);
+static VALUE exposure_cache_duplicate(VALUE self, VALUE resolution_details, VALUE flag_key, VALUE targeting_key);
+static inline uint64_t hash_bytes(uint64_t hash, const uint8_t *bytes, size_t length);
+
 static void resolution_details_free(void *ptr);
 static VALUE resolution_details_get_raw_value(VALUE self);
 static VALUE resolution_details_get_flag_type(VALUE self);
@@ -37,6 +106,36 @@ static const rb_data_type_t configuration_data_type = {
   .flags = RUBY_TYPED_FREE_IMMEDIATELY,
 };
 
+static const rb_data_type_t evaluation_context_typed_data = {
+  .wrap_struct_name = "Datadog::Core::FeatureFlags::EvaluationContext",
+  .function = {
+    .dmark = NULL,
+    .dfree = evaluation_context_free,
+    .dsize = NULL,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static const rb_data_type_t assignments_typed_data = {
+  .wrap_struct_name = "Datadog::Core::FeatureFlags::Assignments",
+  .function = {
+    .dmark = assignments_mark,
+    .dfree = assignments_free,
+    .dsize = assignments_memsize,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static const rb_data_type_t exposure_cache_typed_data = {
+  .wrap_struct_name = "Datadog::Core::FeatureFlags::ExposureCache",
+  .function = {
+    .dmark = NULL,
+    .dfree = exposure_cache_free,
+    .dsize = exposure_cache_memsize,
+  },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 static const rb_data_type_t resolution_details_typed_data = {
   .wrap_struct_name = "Datadog::Core::FeatureFlags::ResolutionDetails",
   .function = {
@@ -50,6 +149,7 @@ static const rb_data_type_t resolution_details_typed_data = {
 // Cached values to use in function later in the code.
 static VALUE feature_flags_error_class = Qnil;
 static VALUE resolution_details_class = Qnil;
+static VALUE assignments_class = Qnil;
 static ID id_boolean;
 static ID id_string;
 static ID id_number;
@@ -93,6 +193,22 @@ void feature_flags_init(VALUE core_module) {
   rb_undef_alloc_func(configuration_class);
   rb_define_singleton_method(configuration_class, "new", configuration_new, 1);
   rb_define_method(configuration_class, "get_assignment", configuration_get_assignment, 3);
+  rb_define_method(configuration_class, "get_assignments", configuration_get_assignments, 3);
+
+  VALUE evaluation_context_class = rb_define_class_under(feature_flags_module, "EvaluationContext", rb_cObject);
+  rb_undef_alloc_func(evaluation_context_class);
+  rb_define_singleton_method(evaluation_context_class, "new", evaluation_context_new, 1);
+
+  rb_gc_register_address(&assignments_class);
+  assignments_class = rb_define_class_under(feature_flags_module, "Assignments", rb_cObject);
+  rb_undef_alloc_func(assignments_class);
+  rb_define_method(assignments_class, "size", assignments_size, 0);
+  rb_define_method(assignments_class, "[]", assignments_aref, 1);
+
+  VALUE exposure_cache_class = rb_define_class_under(feature_flags_module, "ExposureCache", rb_cObject);
+  rb_undef_alloc_func(exposure_cache_class);
+  rb_define_singleton_method(exposure_cache_class, "new", exposure_cache_new, 1);
+  rb_define_method(exposure_cache_class, "duplicate?", exposure_cache_duplicate, 3);
 
   rb_gc_register_address(&resolution_details_class);
   resolution_details_class = rb_define_class_under(feature_flags_module, "ResolutionDetails", rb_cObject);
@@ -123,16 +239,58 @@ void feature_flags_init(VALUE core_module) {
  *
  * Creates a new Configuration from a JSON string.
  *
+ * Configurations with many flags can take a while to parse, so parsing
+ * happens without holding the Global VM Lock. This way, other threads
+ * can keep evaluating flags with the previous configuration until this
+ * one is ready to replace it.
+ *
  * @param json_str [String] The JSON configuration string
  * @return [Configuration] The configuration instance
  * @raise [Datadog::Core::FeatureFlags::Error] If the JSON is invalid
  */
 static VALUE configuration_new(VALUE klass, VALUE json_str) {
-  struct ddog_ffe_Result_HandleConfiguration result = ddog_ffe_configuration_new(borrow_str(json_str));
-  if (result.tag == DDOG_FFE_RESULT_HANDLE_CONFIGURATION_ERR_HANDLE_CONFIGURATION) {
-    raise_error(feature_flags_error_class, "Failed to create configuration from JSON: %"PRIsVALUE, get_error_details_and_drop(&result.err));
+  struct configuration_new_arguments args = {.json = borrow_str(json_str), .parse_ran = false};
+
+  // Other threads may run while we're parsing without the GVL, so we lock the string to make sure they can't change it
+  // (frozen strings can't be changed anyway). Since the string is referenced from our stack, it also won't get moved by
+  // GC compaction.
+  if (OBJ_FROZEN(json_str)) {
+    configuration_parse((VALUE)&args);
+  } else {
+    rb_str_locktmp(json_str);
+    rb_ensure(configuration_parse, (VALUE)&args, rb_str_unlocktmp, json_str);
+  }
+  RB_GC_GUARD(json_str);
+
+  if (args.result.tag == DDOG_FFE_RESULT_HANDLE_CONFIGURATION_ERR_HANDLE_CONFIGURATION) {
+    raise_error(feature_flags_error_class, "Failed to create configuration from JSON: %"PRIsVALUE, get_error_details_and_drop(&args.result.err));
   }
-  return TypedData_Wrap_Struct(klass, &configuration_data_type, result.ok);
+  return TypedData_Wrap_Struct(klass, &configuration_data_type, args.result.ok);
+}
+
+static VALUE configuration_parse(VALUE args_ptr) {
+  struct configuration_new_arguments *args = (struct configuration_new_arguments *)args_ptr;
+
+  while (!args->parse_ran) {
+    // Give the Ruby VM an opportunity to process any pending interruptions (including raising exceptions). Nothing
+    // was parsed yet at this point, so there's nothing to clean up.
+    rb_thread_check_ints();
+
+    // We use rb_thread_call_without_gvl2 here because unlike the regular _gvl variant, gvl2 does not process
+    // interruptions and thus does not raise exceptions after running our code (which would leak the configuration).
+    rb_thread_call_without_gvl2(configuration_parse_without_gvl, args, NULL /* No interruption function needed in this case */, NULL /* Not needed */);
+  }
+
+  return Qnil;
+}
+
+static void *configuration_parse_without_gvl(void *args_ptr) {
+  struct configuration_new_arguments *args = (struct configuration_new_arguments *)args_ptr;
+
+  args->result = ddog_ffe_configuration_new(args->json);
+  args->parse_ran = true;
+
+  return NULL; // Unused
 }
 
 static void configuration_free(void *ptr) {
@@ -285,6 +443,31 @@ static ddog_ffe_Handle_EvaluationContext evaluation_context_from_hash(VALUE hash
   return context;
 }
 
+/*
+ * call-seq:
+ *   EvaluationContext.new(hash) -> EvaluationContext
+ *
+ * Creates a new EvaluationContext from a Hash of attributes (see
+ * evaluation_context_from_hash for how the hash is interpreted).
+ *
+ * Building the context copies all of the attributes, so this is the
+ * most expensive part of an evaluation. When evaluating many flags
+ * for the same context, build it once and pass it to every
+ * Configuration#get_assignment call.
+ *
+ * @param hash [Hash] Evaluation context with targeting_key and other attributes
+ * @return [EvaluationContext] The evaluation context instance
+ */
+static VALUE evaluation_context_new(VALUE klass, VALUE hash) {
+  ddog_ffe_Handle_EvaluationContext context = evaluation_context_from_hash(hash);
+  return TypedData_Wrap_Struct(klass, &evaluation_context_typed_data, context);
+}
+
+static void evaluation_context_free(void *ptr) {
+  ddog_ffe_Handle_EvaluationContext context = (ddog_ffe_Handle_EvaluationContext)ptr;
+  ddog_ffe_evaluation_context_drop(&context);
+}
+
 /*
  * call-seq:
  *   configuration.get_assignment(flag_key, expected_type, context) -> ResolutionDetails
@@ -293,19 +476,23 @@ static ddog_ffe_Handle_EvaluationContext evaluation_context_from_hash(VALUE hash
  *
  * @param flag_key [String] The key of the feature flag
  * @param expected_type [Symbol] Expected type (:boolean, :string, :number, :object, :any, :integer, :float)
- * @param context [Hash] Evaluation context with targeting_key and other attributes
+ * @param context [Hash, EvaluationContext] Evaluation context with targeting_key and other attributes
  * @return [ResolutionDetails] The resolution details
  */
-static VALUE configuration_get_assignment(VALUE self, VALUE flag_key, VALUE expected_type, VALUE context_hash) {
+static VALUE configuration_get_assignment(VALUE self, VALUE flag_key, VALUE expected_type, VALUE context_value) {
   ENFORCE_TYPED_DATA(self, &configuration_data_type);
   ENFORCE_TYPE(flag_key, T_STRING);
   ENFORCE_TYPE(expected_type, T_SYMBOL);
-  ENFORCE_TYPE(context_hash, T_HASH);
 
   const ddog_ffe_Handle_Configuration config =
     (ddog_ffe_Handle_Configuration)rb_check_typeddata(self, &configuration_data_type);
   const ddog_ffe_ExpectedFlagType expected_ty = expected_type_from_value(expected_type);
-  ddog_ffe_Handle_EvaluationContext context = evaluation_context_from_hash(context_hash);
+
+  // A Hash gets turned into a temporary context, while an EvaluationContext is reused as-is
+  const bool owns_context = RB_TYPE_P(context_value, T_HASH);
+  ddog_ffe_Handle_EvaluationContext context = owns_context ?
+    evaluation_context_from_hash(context_value) :
+    (ddog_ffe_Handle_EvaluationContext)rb_check_typeddata(context_value, &evaluation_context_typed_data);
 
   ddog_ffe_Handle_ResolutionDetails resolution_details = ddog_ffe_get_assignment(
     config,
@@ -314,11 +501,184 @@ static VALUE configuration_get_assignment(VALUE self, VALUE flag_key, VALUE expe
     context
   );
 
-  ddog_ffe_evaluation_context_drop(&context);
+  if (owns_context) {
+    ddog_ffe_evaluation_context_drop(&context);
+  }
+  // Make sure the EvaluationContext (and thus its handle) is not collected before we're done with it
+  RB_GC_GUARD(context_value);
 
   return TypedData_Wrap_Struct(resolution_details_class, &resolution_details_typed_data, resolution_details);
 }
 
+/*
+ * call-seq:
+ *   configuration.get_assignments(flag_keys, expected_types, context) -> Assignments
+ *
+ * Get assignments for many feature flags at once, for the same context.
+ *
+ * All flags get evaluated in a single pass without holding the Global VM
+ * Lock, so other threads can keep running meanwhile. Each result only
+ * gets turned into a ResolutionDetails when it's accessed.
+ *
+ * @param flag_keys [Array<String>] The keys of the feature flags
+ * @param expected_types [Symbol, Array<Symbol>] Expected type for all flags, or one expected type per flag
+ * @param context [Hash, EvaluationContext] Evaluation context with targeting_key and other attributes
+ * @return [Assignments] The resolution details for each flag, in the same order as flag_keys
+ */
+static VALUE configuration_get_assignments(VALUE self, VALUE flag_keys, VALUE expected_types, VALUE context_value) {
+  ENFORCE_TYPED_DATA(self, &configuration_data_type);
+  ENFORCE_TYPE(flag_keys, T_ARRAY);
+  const bool same_expected_type = RB_TYPE_P(expected_types, T_SYMBOL);
+  if (!same_expected_type) {
+    ENFORCE_TYPE(expected_types, T_ARRAY);
+    if (RARRAY_LEN(expected_types) != RARRAY_LEN(flag_keys)) {
+      raise_error(rb_eArgError, "Expected a single expected_type or one expected_type per flag key");
+    }
+  }
+  if (!RB_TYPE_P(context_value, T_HASH)) ENFORCE_TYPED_DATA(context_value, &evaluation_context_typed_data);
+
+  const long count = RARRAY_LEN(flag_keys);
+
+  struct assignments_state *state;
+  VALUE assignments = TypedData_Make_Struct(assignments_class, struct assignments_state, &assignments_typed_data, state);
+  state->materialized = Qnil;
+  state->results = ruby_xcalloc(count, sizeof(ddog_ffe_Handle_ResolutionDetails));
+  state->count = count;
+  state->expected_types = ruby_xcalloc(count, sizeof(ddog_ffe_ExpectedFlagType));
+
+  const ddog_ffe_ExpectedFlagType expected_ty = same_expected_type ? expected_type_from_value(expected_types) : 0;
+  long flag_keys_size = 0;
+  for (long i = 0; i < count; i++) {
+    VALUE flag_key = RARRAY_AREF(flag_keys, i);
+    ENFORCE_TYPE(flag_key, T_STRING);
+    StringValueCStr(flag_key); // Validate there's no embedded NUL bytes
+    flag_keys_size += RSTRING_LEN(flag_key) + 1;
+
+    state->expected_types[i] = same_expected_type ? expected_ty : expected_type_from_value(RARRAY_AREF(expected_types, i));
+  }
+
+  state->flag_keys = ruby_xmalloc(flag_keys_size > 0 ? flag_keys_size : 1);
+  char *next_flag_key = state->flag_keys;
+  for (long i = 0; i < count; i++) {
+    VALUE flag_key = RARRAY_AREF(flag_keys, i);
+    memcpy(next_flag_key, RSTRING_PTR(flag_key), RSTRING_LEN(flag_key));
+    next_flag_key[RSTRING_LEN(flag_key)] = '\0';
+    next_flag_key += RSTRING_LEN(flag_key) + 1;
+  }
+
+  state->configuration = (ddog_ffe_Handle_Configuration)rb_check_typeddata(self, &configuration_data_type);
+  state->owns_context = RB_TYPE_P(context_value, T_HASH);
+  state->context = state->owns_context ?
+    evaluation_context_from_hash(context_value) :
+    (ddog_ffe_Handle_EvaluationContext)rb_check_typeddata(context_value, &evaluation_context_typed_data);
+
+  while (!state->evaluate_ran) {
+    // Give the Ruby VM an opportunity to process any pending interruptions (including raising exceptions). If that
+    // happens, the inputs get released when `assignments` gets garbage collected.
+    rb_thread_check_ints();
+
+    // We use rb_thread_call_without_gvl2 here because unlike the regular _gvl variant, gvl2 does not process
+    // interruptions and thus does not raise exceptions after running our code.
+    rb_thread_call_without_gvl2(evaluate_assignments_without_gvl, state, NULL /* No interruption function needed in this case */, NULL /* Not needed */);
+  }
+
+  assignments_release_evaluation_inputs(state);
+
+  // Make sure the Configuration and EvaluationContext (and thus their handles) are not collected while we evaluate
+  RB_GC_GUARD(self);
+  RB_GC_GUARD(context_value);
+
+  return assignments;
+}
+
+static void *evaluate_assignments_without_gvl(void *state_ptr) {
+  struct assignments_state *state = (struct assignments_state *)state_ptr;
+
+  const char *flag_key = state->flag_keys;
+  for (long i = 0; i < state->count; i++) {
+    state->results[i] = ddog_ffe_get_assignment(state->configuration, flag_key, state->expected_types[i], state->context);
+    flag_key += strlen(flag_key) + 1;
+  }
+
+  state->evaluate_ran = true;
+
+  return NULL; // Unused
+}
+
+static void assignments_mark(void *ptr) {
+  struct assignments_state *state = (struct assignments_state *)ptr;
+  rb_gc_mark(state->materialized);
+}
+
+static void assignments_free(void *ptr) {
+  struct assignments_state *state = (struct assignments_state *)ptr;
+
+  assignments_release_evaluation_inputs(state);
+
+  for (long i = 0; i < state->count; i++) {
+    if (state->results[i] != NULL) ddog_ffe_assignment_drop(&state->results[i]);
+  }
+  ruby_xfree(state->results);
+
+  ruby_xfree(ptr);
+}
+
+static size_t assignments_memsize(const void *ptr) {
+  const struct assignments_state *state = (const struct assignments_state *)ptr;
+  return sizeof(struct assignments_state) + state->count * sizeof(ddog_ffe_Handle_ResolutionDetails);
+}
+
+static void assignments_release_evaluation_inputs(struct assignments_state *state) {
+  if (state->owns_context && state->context != NULL) ddog_ffe_evaluation_context_drop(&state->context);
+  state->context = NULL;
+  state->configuration = NULL;
+
+  ruby_xfree(state->flag_keys);
+  state->flag_keys = NULL;
+  ruby_xfree(state->expected_types);
+  state->expected_types = NULL;
+}
+
+/*
+ * call-seq:
+ *   assignments.size() -> Integer
+ *
+ * @return [Integer] The number of flags evaluated
+ */
+static VALUE assignments_size(VALUE self) {
+  struct assignments_state *state = rb_check_typeddata(self, &assignments_typed_data);
+  return LONG2NUM(state->count);
+}
+
+/*
+ * call-seq:
+ *   assignments[index] -> ResolutionDetails or nil
+ *
+ * Get the resolution details for the flag at `index` in the list of
+ * evaluated flag keys. Negative indexes count from the end.
+ *
+ * @return [ResolutionDetails, nil] The resolution details, or nil if index is out of range
+ */
+static VALUE assignments_aref(VALUE self, VALUE index) {
+  struct assignments_state *state = rb_check_typeddata(self, &assignments_typed_data);
+  ENFORCE_TYPE(index, T_FIXNUM);
+
+  long i = FIX2LONG(index);
+  if (i < 0) i += state->count;
+  if (i < 0 || i >= state->count) return Qnil;
+
+  if (state->materialized == Qnil) state->materialized = rb_ary_new_capa(state->count);
+
+  VALUE resolution_details = rb_ary_entry(state->materialized, i);
+  if (resolution_details != Qnil) return resolution_details;
+
+  resolution_details = TypedData_Wrap_Struct(resolution_details_class, &resolution_details_typed_data, state->results[i]);
+  state->results[i] = NULL;
+  rb_ary_store(state->materialized, i, resolution_details);
+
+  return resolution_details;
+}
+
 static void resolution_details_free(void *ptr) {
   ddog_ffe_Handle_ResolutionDetails resolution_details = (ddog_ffe_Handle_ResolutionDetails)ptr;
   ddog_ffe_assignment_drop(&resolution_details);
@@ -552,3 +912,106 @@ static VALUE resolution_details_get_flag_metadata(VALUE self) {
 
   return hash;
 }
+
+/*
+ * call-seq:
+ *   ExposureCache.new(capacity) -> ExposureCache
+ *
+ * Creates a new ExposureCache that remembers (at least) the last
+ * `capacity` exposures.
+ *
+ * @param capacity [Integer] How many exposures to remember
+ * @return [ExposureCache] The exposure cache instance
+ */
+static VALUE exposure_cache_new(VALUE klass, VALUE capacity) {
+  ENFORCE_TYPE(capacity, T_FIXNUM);
+
+  long requested_capacity = FIX2LONG(capacity);
+  if (requested_capacity < 1 || requested_capacity > EXPOSURE_CACHE_MAX_CAPACITY) {
+    raise_error(rb_eArgError, "Exposure cache capacity must be between 1 and %ld", EXPOSURE_CACHE_MAX_CAPACITY);
+  }
+
+  struct exposure_cache_state *state;
+  VALUE exposure_cache = TypedData_Make_Struct(klass, struct exposure_cache_state, &exposure_cache_typed_data, state);
+
+  // Since entries that land on the same slot evict each other, we make the table twice as big as requested
+  unsigned long table_capacity = 1;
+  while (table_capacity < (unsigned long) requested_capacity * 2) table_capacity <<= 1;
+
+  state->entries = ruby_xcalloc(table_capacity, sizeof(struct exposure_cache_entry));
+  state->capacity = table_capacity;
+
+  return exposure_cache;
+}
+
+static void exposure_cache_free(void *ptr) {
+  struct exposure_cache_state *state = (struct exposure_cache_state *)ptr;
+  ruby_xfree(state->entries);
+  ruby_xfree(ptr);
+}
+
+static size_t exposure_cache_memsize(const void *ptr) {
+  const struct exposure_cache_state *state = (const struct exposure_cache_state *)ptr;
+  return sizeof(struct exposure_cache_state) + state->capacity * sizeof(struct exposure_cache_entry);
+}
+
+/*
+ * call-seq:
+ *   exposure_cache.duplicate?(resolution_details, flag_key, targeting_key) -> Boolean
+ *
+ * Check if the same exposure (same allocation key and variant for the
+ * same flag key and targeting key) was the last one seen, and remember
+ * this exposure otherwise.
+ *
+ * @param resolution_details [ResolutionDetails] The evaluation result
+ * @param flag_key [String] The key of the evaluated feature flag
+ * @param targeting_key [String, nil] The targeting key of the evaluation context
+ * @return [Boolean] True if this exposure is a duplicate
+ */
+static VALUE exposure_cache_duplicate(VALUE self, VALUE resolution_details, VALUE flag_key, VALUE targeting_key) {
+  struct exposure_cache_state *state = rb_check_typeddata(self, &exposure_cache_typed_data);
+  ddog_ffe_Handle_ResolutionDetails details =
+    (ddog_ffe_Handle_ResolutionDetails)rb_check_typeddata(resolution_details, &resolution_details_typed_data);
+  ENFORCE_TYPE(flag_key, T_STRING);
+  if (targeting_key != Qnil) ENFORCE_TYPE(targeting_key, T_STRING);
+
+  const uint64_t fnv_offset_basis = 14695981039346656037ULL;
+
+  ddog_ffe_BorrowedStr flag_key_str = borrow_str(flag_key);
+  uint64_t key_hash = hash_bytes(fnv_offset_basis, flag_key_str.ptr, flag_key_str.len);
+  if (targeting_key != Qnil) {
+    ddog_ffe_BorrowedStr targeting_key_str = borrow_str(targeting_key);
+    key_hash = hash_bytes(key_hash, targeting_key_str.ptr, targeting_key_str.len);
+  }
+  if (key_hash == 0) key_hash = 1; // 0 is reserved for empty entries
+
+  // A missing (NULL) allocation key or variant hashes the same as an empty one
+  ddog_ffe_BorrowedStr allocation_key = ddog_ffe_assignment_get_allocation_key(details);
+  ddog_ffe_BorrowedStr variant = ddog_ffe_assignment_get_variant(details);
+  uint64_t value_hash = hash_bytes(fnv_offset_basis, allocation_key.ptr, allocation_key.ptr ? allocation_key.len : 0);
+  value_hash = hash_bytes(value_hash, variant.ptr, variant.ptr ? variant.len : 0);
+
+  struct exposure_cache_entry *entry = &state->entries[key_hash & (state->capacity - 1)];
+  if (entry->key_hash == key_hash && entry->value_hash == value_hash) return Qtrue;
+
+  entry->key_hash = key_hash;
+  entry->value_hash = value_hash;
+
+  return Qfalse;
+}
+
+// FNV-1a, followed by the length so that e.g. ("ab", "c") and ("a", "bc") don't hash the same when chained
+static inline uint64_t hash_bytes(uint64_t hash, const uint8_t *bytes, size_t length) {
+  const uint64_t fnv_prime = 1099511628211ULL;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= fnv_prime;
+  }
+  for (size_t i = 0; i < sizeof(length); i++) {
+    hash ^= (length >> (i * 8)) & 0xff;
+    hash *= fnv_prime;
+  }
+
+  return hash;
+}
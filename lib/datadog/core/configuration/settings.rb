@@ -622,6 +622,60 @@ module Datadog
               o.default 10
             end
 
+            # Experimental: Controls if the profiler also samples fibers that are suspended (e.g. waiting for I/O when
+            # using the `async` gem), rather than only the fiber that is running on each thread. Suspended fibers are
+            # sampled less often than threads, and their samples get tagged with the "fiber state" label.
+            # Only supported on Ruby 3.1 to 3.4; ignored on other Ruby versions.
+            #
+            # @warn This setting is experimental and may be removed or changed in future versions.
+            #
+            # # No config via environment variable yet
+            # @default false
+            option :experimental_fiber_profiling_enabled do |o|
+              o.type :bool
+              o.default false
+            end
+
+            # Experimental: Controls if the profiler also samples threads running on Ractors other than the main one.
+            # Only the thread that is running on each Ractor gets sampled, and its samples get tagged with the
+            # "ractor id" label. Only supported on Ruby 3.3+.
+            #
+            # @warn This setting is experimental and may be removed or changed in future versions.
+            #
+            # # No config via environment variable yet
+            # @default false
+            option :experimental_ractor_profiling_enabled do |o|
+              o.type :bool
+              o.default false
+            end
+
+            # Experimental: Reports profiles from a background native thread, reusing the same connection settings, rather
+            # than blocking the profiler's Scheduler thread on every upload. Profiles waiting to be reported are kept in a
+            # small bounded queue, and after a failed upload, reporting backs off exponentially.
+            #
+            # @warn This setting is experimental and may be removed or changed in future versions.
+            #
+            # # No config via environment variable yet
+            # @default false
+            option :experimental_async_export_enabled do |o|
+              o.type :bool
+              o.default false
+            end
+
+            # Experimental: Maximum number of profiles waiting to be reported when `experimental_async_export_enabled`
+            # is in use. While the agent is unreachable (e.g. during a deploy or an agent restart), profiles are held
+            # in memory and reported once it's back; increasing this allows longer outages to be covered, at the cost
+            # of extra memory usage.
+            #
+            # @warn This setting is experimental and may be removed or changed in future versions.
+            #
+            # # No config via environment variable yet
+            # @default 4
+            option :experimental_async_export_max_pending_profiles do |o|
+              o.type :int
+              o.default 4
+            end
+
             # Fallback to system dns instead of using libdatadog built-in resolver.
             #
             # @default `DD_PROFILING_EXPERIMENTAL_USE_SYSTEM_DNS` environment variable as a boolean, otherwise `true`
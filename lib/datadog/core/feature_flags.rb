@@ -18,6 +18,29 @@ module Datadog
       class Configuration # rubocop:disable Lint/EmptyClass
       end
 
+      # Attributes to evaluate feature flags against, built once and reusable across evaluations
+      # This class is defined in the C extension
+      class EvaluationContext # rubocop:disable Lint/EmptyClass
+      end
+
+      # Remembers the last exposure reported for each flag key and targeting key
+      # This class is defined in the C extension
+      class ExposureCache # rubocop:disable Lint/EmptyClass
+      end
+
+      # Resolution details for many feature flags evaluated at once, see `Configuration#get_assignments`
+      # Base class is defined in the C extension, with Ruby methods added here
+      class Assignments
+        include Enumerable
+
+        def each
+          return enum_for(:each) { size } unless block_given?
+
+          size.times { |index| yield self[index] }
+          self
+        end
+      end
+
       # Resolution details for a feature flag evaluation
       # Base class is defined in the C extension, with Ruby methods added here
       class ResolutionDetails
@@ -135,29 +135,22 @@ module Datadog
       # to be an absolute path), only the exactly matching path is returned.
       # Otherwise all known paths that end in the suffix are returned.
       # If no paths match, an empty array is returned.
+      #
+      # Files that were loaded before code tracking started are not in the
+      # registry; for those, the native iseq index (see +DI.iseqs_for_path+)
+      # is used instead, when available.
       def iseqs_for_path_suffix(suffix)
         registry_lock.synchronize do
-          exact = registry[suffix]
-          return [suffix, exact] if exact
-
-          suffix = suffix.dup
-          loop do
-            inexact = []
-            registry.each do |path, iseq|
-              if Utils.path_matches_suffix?(path, suffix)
-                inexact << [path, iseq]
-              end
-            end
-            if inexact.length > 1
-              raise Error::MultiplePathsMatch, "Multiple paths matched requested suffix"
-            end
-            if inexact.any?
-              return inexact.first
-            end
-            return nil unless suffix.include?('/')
-            suffix.sub!(%r{.*/+}, '')
+          if iseq = registry[suffix]
+            return [suffix, iseq]
+          end
+
+          if path = match_path_suffix(registry.each_key, suffix)
+            return [path, registry[path]]
           end
         end
+
+        iseq_loaded_before_tracking(suffix)
       end
 
       # Stops tracking code that is being loaded.
@@ -191,6 +184,46 @@ module Datadog
 
       private
 
+      # Returns the path among +paths+ that ends in +suffix+, trying
+      # shorter suffixes (dropping leading directories) when none does.
+      def match_path_suffix(paths, suffix)
+        suffix = suffix.dup
+        loop do
+          inexact = paths.select do |path|
+            Utils.path_matches_suffix?(path, suffix)
+          end
+          if inexact.length > 1
+            raise Error::MultiplePathsMatch, "Multiple paths matched requested suffix"
+          end
+          if inexact.any?
+            return inexact.first
+          end
+          return nil unless suffix.include?('/')
+          suffix.sub!(%r{.*/+}, '')
+        end
+      end
+
+      # Looks up files loaded before code tracking started in the native
+      # iseq index, which is built by walking the heap and thus also
+      # includes those files (as long as their whole-file iseq is still
+      # around).
+      #
+      # Exact paths are looked up directly; suffixes are matched against
+      # the indexed paths. Either way, only the iseq of the matching file
+      # gets a RubyVM::InstructionSequence object created for it.
+      def iseq_loaded_before_tracking(suffix)
+        return nil unless DI.respond_to?(:file_paths)
+
+        if iseq = DI.iseqs_for_path(suffix).first
+          return [suffix, iseq]
+        end
+
+        if path = match_path_suffix(DI.file_paths, suffix)
+          iseq = DI.iseqs_for_path(path).first
+          [path, iseq] if iseq
+        end
+      end
+
       # Mapping from paths of loaded files to RubyVM::InstructionSequence
       # objects representing compiled code of those files.
       attr_reader :registry
@@ -384,17 +384,32 @@ module Datadog
         # overhead of targeted trace points is minimal, don't worry about
         # this optimization just yet and create a trace point for each probe.
 
-        types = if iseq
-          # When targeting trace points we can target the 'end' line of a method.
-          # However, by adding the :return trace point we lose diagnostics
-          # for lines that contain no executable code (e.g. comments only)
-          # and thus cannot actually be instrumented.
-          [:line, :return, :b_return]
+        if iseq && defined?(DI::LineProbeHook)
+          # The native hook counts hits and applies the rate limit before
+          # calling into Ruby, so that hits dropped by the rate limiter
+          # are cheap. Hits of probes with conditions must be rate limited
+          # after the condition is evaluated, so for them the hook only
+          # counts hits and the rate limit is applied by the callback.
+          native_rate_limited = probe.condition.nil?
+          hook = DI::LineProbeHook.new(native_rate_limited ? probe.rate_limit : nil, lambda do |tp|
+            line_trace_point_callback(probe, iseq, responder, tp, native_rate_limited: native_rate_limited)
+          end)
+          # The hook uses the same events as the TracePoint below.
+          tp = hook.trace_point
         else
-          [:line]
-        end
-        tp = TracePoint.new(*types) do |tp|
-          line_trace_point_callback(probe, iseq, responder, tp)
+          hook = nil
+          types = if iseq
+            # When targeting trace points we can target the 'end' line of a method.
+            # However, by adding the :return trace point we lose diagnostics
+            # for lines that contain no executable code (e.g. comments only)
+            # and thus cannot actually be instrumented.
+            [:line, :return, :b_return]
+          else
+            [:line]
+          end
+          tp = TracePoint.new(*types) do |tp|
+            line_trace_point_callback(probe, iseq, responder, tp)
+          end
         end
 
         # Internal sanity check - untargeted trace points create a huge
@@ -411,6 +426,9 @@ module Datadog
           end
 
           probe.instrumentation_trace_point = tp
+          probe.instrumentation_line_probe_hook = hook
+          # The probe may have been disabled while we were setting up the hook
+          hook&.enabled = probe.enabled?
           # actual_path could be nil if we don't use targeted trace points.
           probe.instrumented_path = actual_path
 
@@ -433,6 +451,7 @@ module Datadog
           if tp = probe.instrumentation_trace_point
             tp.disable
             probe.instrumentation_trace_point = nil
+            probe.instrumentation_line_probe_hook = nil
 
             DI.instrumented_count_dec(:line)
           end
@@ -482,7 +501,7 @@ module Datadog
 
       attr_reader :lock
 
-      def line_trace_point_callback(probe, iseq, responder, tp)
+      def line_trace_point_callback(probe, iseq, responder, tp, native_rate_limited: false)
         di_start_time = Process.clock_gettime(Process::CLOCK_THREAD_CPUTIME_ID)
 
         # Check if probe is enabled before doing any processing
@@ -556,7 +575,9 @@ module Datadog
 
         # In practice we should always have a rate limiter, but be safe
         # and check that it is in fact set.
-        return if probe.rate_limiter && !probe.rate_limiter.allow?
+        # When the hit came through DI::LineProbeHook, the rate limit was
+        # already applied natively.
+        return if !native_rate_limited && probe.rate_limiter && !probe.rate_limiter.allow?
 
         # The context creation is relatively expensive and we don't
         # want to run it if the callback won't be executed due to the
@@ -206,6 +206,27 @@ module Datadog
       # trace point.
       attr_accessor :instrumentation_trace_point
 
+      # Native hook backing the trace point for targeted line probes,
+      # which counts hits and applies the rate limit; see DI::LineProbeHook.
+      attr_accessor :instrumentation_line_probe_hook
+
+      # Number of times the instrumented line was executed, including
+      # executions dropped by the rate limiter.
+      #
+      # Only tracked for targeted line probes; 0 for other probes.
+      def hit_count
+        instrumentation_line_probe_hook&.hits || 0
+      end
+
+      # Number of times the instrumented line was executed but the
+      # probe did not fire because of the rate limit.
+      #
+      # Only tracked for targeted line probes without a condition;
+      # 0 for other probes.
+      def drop_count
+        instrumentation_line_probe_hook&.drops || 0
+      end
+
       # Actual path to the file instrumented by the probe, for line probes,
       # when code tracking is available and line trace point is targeted.
       # For untargeted line trace points instrumented path will be nil.
@@ -234,6 +255,9 @@ module Datadog
 
       def disable!
         @enabled = false
+        # Also stop the native hook from counting hits and using up
+        # rate limiter tokens for this probe.
+        instrumentation_line_probe_hook&.enabled = false
       end
     end
   end
@@ -45,7 +45,22 @@ module Datadog
       attr_reader :settings
 
       def redact_identifier?(name)
-        redacted_identifiers.include?(normalize(name))
+        # Instance variable and keyword argument names are symbols, and
+        # the same ones get checked every time a probe captures a snapshot.
+        # Cache the result for them, to avoid normalizing (and thus
+        # allocating new strings for) the same names over and over.
+        if Symbol === name
+          redacted = redacted_symbols[name]
+          return redacted unless redacted.nil?
+
+          redacted = redacted_identifiers.include?(normalize(name))
+          # Symbols can be created dynamically (e.g. from hash keys),
+          # do not let the cache grow without bounds.
+          redacted_symbols[name] = redacted if redacted_symbols.size < MAX_CACHED_SYMBOLS
+          redacted
+        else
+          redacted_identifiers.include?(normalize(name))
+        end
       end
 
       def redact_type?(value)
@@ -59,6 +74,12 @@ module Datadog
 
       private
 
+      MAX_CACHED_SYMBOLS = 10_000
+
+      def redacted_symbols
+        @redacted_symbols ||= {}
+      end
+
       def redacted_identifiers
         @redacted_identifiers ||= begin
           names = DEFAULT_REDACTED_IDENTIFIERS + settings.dynamic_instrumentation.redacted_identifiers
@@ -314,15 +314,30 @@ module Datadog
               # does not support JRuby, we don't handle JRuby's lack of ordering
               # of #instance_variables here, but if JRuby is supported in the
               # future this may need to be addressed.
-              ivars = value.instance_variables
+              if DI.respond_to?(:capture_instance_variables)
+                # The C extension walks the instance variables without
+                # calling (possibly overridden) Ruby methods, and only
+                # retrieves as many of them as will be captured.
+                pairs = []
+                if DI.capture_instance_variables(value, attribute_count, pairs) > attribute_count
+                  serialized.update(notCapturedReason: "fieldCount")
+                end
+                while cur < pairs.length
+                  ivar = pairs[cur]
+                  fields[ivar] = serialize_value(pairs[cur + 1], name: ivar, depth: depth - 1)
+                  cur += 2
+                end
+              else
+                ivars = value.instance_variables
 
-              ivars.each do |ivar|
-                if cur >= attribute_count
-                  serialized.update(notCapturedReason: "fieldCount", fields: fields)
-                  break
+                ivars.each do |ivar|
+                  if cur >= attribute_count
+                    serialized.update(notCapturedReason: "fieldCount", fields: fields)
+                    break
+                  end
+                  cur += 1
+                  fields[ivar] = serialize_value(value.instance_variable_get(ivar), name: ivar, depth: depth - 1)
                 end
-                cur += 1
-                fields[ivar] = serialize_value(value.instance_variable_get(ivar), name: ivar, depth: depth - 1)
               end
               serialized.update(fields: fields)
             end
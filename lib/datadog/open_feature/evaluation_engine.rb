@@ -13,6 +13,7 @@ module Datadog
       ReconfigurationError = Class.new(StandardError) # steep:ignore IncompatibleAssignment
 
       ALLOWED_TYPES = %i[boolean string number float integer object].freeze
+      EMPTY_CONTEXT_FIELDS = {}.freeze
 
       def initialize(reporter, telemetry:, logger:)
         @reporter = reporter
@@ -30,7 +31,7 @@ module Datadog
           )
         end
 
-        context = evaluation_context&.fields.to_h
+        context = context_fields_for(evaluation_context)
         result = @evaluator.get_assignment(
           flag_key, default_value: default_value, context: context, expected_type: expected_type
         )
@@ -65,6 +66,25 @@ module Datadog
 
         raise ReconfigurationError, e.message
       end
+
+      private
+
+      # NOTE: The native evaluator reuses its evaluation context for as long as
+      #       it gets the same frozen hash, so we keep handing it the same frozen
+      #       copy of the fields while the same OpenFeature evaluation context
+      #       is used. OpenFeature contexts are not meant to change once built
+      #       (merging them builds a new one)
+      def context_fields_for(evaluation_context)
+        return EMPTY_CONTEXT_FIELDS if evaluation_context.nil?
+
+        cached_context, fields = @last_context_fields
+        return fields if cached_context.equal?(evaluation_context)
+
+        fields = evaluation_context.fields.to_h.dup.freeze
+        @last_context_fields = [evaluation_context, fields].freeze
+
+        fields
+      end
     end
   end
 end
@@ -2,6 +2,7 @@
 
 require_relative 'event'
 require_relative 'deduplicator'
+require_relative '../../core/feature_flags'
 
 module Datadog
   module OpenFeature
@@ -13,6 +14,9 @@ module Datadog
           @logger = logger
           @telemetry = telemetry
           @deduplicator = Deduplicator.new
+          @exposure_cache = if Core::LIBDATADOG_API_FAILURE.nil?
+            Core::FeatureFlags::ExposureCache.new(Deduplicator::DEFAULT_CACHE_LIMIT)
+          end
         end
 
         # NOTE: Reporting expects evaluation context to be always present, but it
@@ -22,9 +26,7 @@ module Datadog
           return false if context.nil?
           return false unless result.log?
 
-          key = Event.cache_key(result, flag_key: flag_key, context: context)
-          value = Event.cache_value(result, flag_key: flag_key, context: context)
-          return false if @deduplicator.duplicate?(key, value)
+          return false if duplicate?(result, flag_key: flag_key, context: context)
 
           event = Event.build(result, flag_key: flag_key, context: context)
           @worker.enqueue(event)
@@ -34,6 +36,20 @@ module Datadog
 
           false
         end
+
+        private
+
+        # NOTE: Results evaluated by `libdatadog` are deduplicated natively, which
+        #       avoids building cache keys and values for every evaluation
+        def duplicate?(result, flag_key:, context:)
+          if @exposure_cache && result.is_a?(Core::FeatureFlags::ResolutionDetails)
+            return @exposure_cache.duplicate?(result, flag_key, context.targeting_key)
+          end
+
+          key = Event.cache_key(result, flag_key: flag_key, context: context)
+          value = Event.cache_value(result, flag_key: flag_key, context: context)
+          @deduplicator.duplicate?(key, value)
+        end
       end
     end
   end
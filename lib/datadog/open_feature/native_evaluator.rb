@@ -25,7 +25,7 @@ module Datadog
       #
       # @return [Core::FeatureFlags::ResolutionDetails] The assignment for the flag
       def get_assignment(flag_key, default_value:, expected_type:, context:)
-        result = @configuration.get_assignment(flag_key, expected_type, context)
+        result = @configuration.get_assignment(flag_key, expected_type, evaluation_context_for(context))
 
         # NOTE: This is a special case when we need to fallback to the default
         #       value, even tho the evaluation itself doesn't produce an error
@@ -33,6 +33,24 @@ module Datadog
         result.value = default_value if result.variant.nil?
         result
       end
+
+      private
+
+      # NOTE: Building the native evaluation context is the most expensive part
+      #       of an evaluation, and the same context is usually used to evaluate
+      #       many flags in a row, so we keep the last one around. Only frozen
+      #       hashes are cached, as others may be changed between evaluations
+      def evaluation_context_for(context)
+        return context unless context.frozen?
+
+        cached_context, evaluation_context = @last_evaluation_context
+        return evaluation_context if cached_context.equal?(context)
+
+        evaluation_context = Core::FeatureFlags::EvaluationContext.new(context)
+        @last_evaluation_context = [context, evaluation_context].freeze
+
+        evaluation_context
+      end
     end
   end
 end
@@ -60,6 +60,33 @@ module Datadog
       nil
     end
 
+    # Attaches the given labels to all profiler samples taken while the block is running on the current fiber, so that
+    # profiles can be sliced by application-defined dimensions (e.g. tenant, or feature flag):
+    # ```
+    # Datadog::Profiling.with_labels(tenant: 'acme', checkout_v2: true) do
+    #   do_some_work()
+    # end
+    # ```
+    #
+    # Note 1: Labels are per-fiber; fibers started inside the block do not inherit them.
+    # Note 2: Up to 8 labels can be active at the same time on a fiber; further labels are ignored.
+    # Note 3: The profiler keeps a hard cap on how many distinct label keys and values it will report (1024); once it's
+    # reached, new keys are ignored and new values are reported as "other". Thus this API should not be used for
+    # labels with unbounded cardinality, such as request ids.
+    #
+    # Labels set by the profiler itself (e.g. "thread name", "span id") are reserved and can't be used.
+    #
+    # When the profiler is not available, the block still gets called, but the labels are ignored.
+    #
+    # @param labels [Hash] label keys and values; both get converted to strings
+    # @return the result of the block
+    # @public_api
+    def self.with_labels(_labels)
+      # This no-op implementation is used when profiling failed to load.
+      # It gets replaced inside #replace_noop_with_labels.
+      yield
+    end
+
     def self.enabled?
       profiler = Datadog.send(:components).profiler
       !!profiler&.enabled?
@@ -85,6 +112,15 @@ module Datadog
       end
     end
 
+    private_class_method def self.replace_noop_with_labels
+      class << self
+        remove_method :with_labels
+        def with_labels(labels, &block)
+          Datadog::Profiling::CustomLabels.with_labels(labels, &block)
+        end
+      end
+    end
+
     private_class_method def self.native_library_compilation_skipped?
       skipped_reason = try_reading_skipped_reason_file
 
@@ -144,6 +180,7 @@ module Datadog
       require_relative 'profiling/collectors/idle_sampling_helper'
       require_relative 'profiling/collectors/stack'
       require_relative 'profiling/collectors/thread_context'
+      require_relative 'profiling/custom_labels'
       require_relative 'profiling/stack_recorder'
       require_relative 'profiling/exporter'
       require_relative 'profiling/encoded_profile'
@@ -157,6 +194,7 @@ module Datadog
       require_relative 'profiling/sequence_tracker'
 
       replace_noop_allocation_count
+      replace_noop_with_labels
 
       true
     end
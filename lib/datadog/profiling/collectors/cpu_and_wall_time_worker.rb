@@ -23,6 +23,7 @@ module Datadog
           allocation_profiling_enabled:,
           allocation_counting_enabled:,
           gvl_profiling_enabled:,
+          ractor_profiling_enabled:,
           sighandler_sampling_enabled:,
           cpu_sampling_interval_ms:,
           # **NOTE**: This should only be used for testing; disabling the dynamic sampling rate will increase the
@@ -55,12 +56,15 @@ module Datadog
             allocation_profiling_enabled: allocation_profiling_enabled,
             allocation_counting_enabled: allocation_counting_enabled,
             gvl_profiling_enabled: gvl_profiling_enabled,
+            ractor_profiling_enabled: ractor_profiling_enabled,
             sighandler_sampling_enabled: sighandler_sampling_enabled,
             skip_idle_samples_for_testing: skip_idle_samples_for_testing,
             cpu_sampling_interval_ms: cpu_sampling_interval_ms,
           )
           @worker_thread = nil
           @failure_exception = nil
+          @thread_context_collector = thread_context_collector
+          @gvl_profiling_enabled = gvl_profiling_enabled
           @start_stop_mutex = Mutex.new
           @idle_sampling_helper = idle_sampling_helper
           @wait_until_running_mutex = Mutex.new
@@ -132,9 +136,16 @@ module Datadog
         def stats_and_reset_not_thread_safe
           stats = self.stats
           self.class._native_stats_reset_not_thread_safe(self)
+          stats[:gvl_contention] = @thread_context_collector.gvl_contention_stats_and_reset if @gvl_profiling_enabled
           stats
         end
 
+        # GC events get batched by the ThreadContext collector; this makes sure they're all recorded before the profile
+        # gets serialized
+        def flush_gc_events
+          self.class._native_flush_gc_events(self)
+        end
+
         # Useful for testing, to e.g. make sure the profiler is running before we start running some code we want to observe
         def wait_until_running(timeout_seconds: 5)
           @wait_until_running_mutex.synchronize do
@@ -22,7 +22,8 @@ module Datadog
           timeline_enabled:,
           waiting_for_gvl_threshold_ns:,
           otel_context_enabled:,
-          native_filenames_enabled:
+          native_filenames_enabled:,
+          fiber_profiling_enabled:
         )
           tracer_context_key = safely_extract_context_key_from(tracer)
           self.class._native_initialize(
@@ -35,6 +36,7 @@ module Datadog
             waiting_for_gvl_threshold_ns: waiting_for_gvl_threshold_ns,
             otel_context_enabled: otel_context_enabled,
             native_filenames_enabled: validate_native_filenames(native_filenames_enabled),
+            fiber_profiling_enabled: validate_fiber_profiling(fiber_profiling_enabled),
           )
         end
 
@@ -47,6 +49,7 @@ module Datadog
           waiting_for_gvl_threshold_ns: 10_000_000,
           otel_context_enabled: false,
           native_filenames_enabled: true,
+          fiber_profiling_enabled: false,
           **options
         )
           new(
@@ -58,6 +61,7 @@ module Datadog
             waiting_for_gvl_threshold_ns: waiting_for_gvl_threshold_ns,
             otel_context_enabled: otel_context_enabled,
             native_filenames_enabled: native_filenames_enabled,
+            fiber_profiling_enabled: fiber_profiling_enabled,
             **options,
           )
         end
@@ -73,6 +77,12 @@ module Datadog
           self.class._native_reset_after_fork(self)
         end
 
+        # Returns how long threads waited for/held the GVL since the last call, as percentiles both per-thread and
+        # aggregated over all threads. Only gets populated when GVL profiling is enabled.
+        def gvl_contention_stats_and_reset
+          self.class._native_gvl_contention_stats_and_reset(self)
+        end
+
         private
 
         def safely_extract_context_key_from(tracer)
@@ -96,6 +106,17 @@ module Datadog
             native_filenames_enabled
           end
         end
+
+        def validate_fiber_profiling(fiber_profiling_enabled)
+          if fiber_profiling_enabled && !self.class._native_fiber_profiling_supported?
+            Datadog.logger.debug(
+              "Fiber profiling is enabled, but it's not supported on this Ruby version. Disabling fiber profiling."
+            )
+            false
+          else
+            fiber_profiling_enabled
+          end
+        end
       end
     end
   end
@@ -68,6 +68,7 @@ module Datadog
           allocation_profiling_enabled: allocation_profiling_enabled,
           allocation_counting_enabled: settings.profiling.advanced.allocation_counting_enabled,
           gvl_profiling_enabled: enable_gvl_profiling?(settings, logger),
+          ractor_profiling_enabled: enable_ractor_profiling?(settings, logger),
           sighandler_sampling_enabled: settings.profiling.advanced.sighandler_sampling_enabled,
           cpu_sampling_interval_ms: cpu_sampling_interval_ms,
         )
@@ -112,6 +113,7 @@ module Datadog
           waiting_for_gvl_threshold_ns: settings.profiling.advanced.waiting_for_gvl_threshold_ns,
           otel_context_enabled: settings.profiling.advanced.preview_otel_context_enabled,
           native_filenames_enabled: settings.profiling.advanced.native_filenames_enabled,
+          fiber_profiling_enabled: settings.profiling.advanced.experimental_fiber_profiling_enabled,
         )
       end
 
@@ -137,6 +139,9 @@ module Datadog
             api_key: settings.api_key,
             upload_timeout_seconds: settings.profiling.upload.timeout_seconds,
             use_system_dns: settings.profiling.advanced.experimental_use_system_dns,
+            async_export_enabled: settings.profiling.advanced.experimental_async_export_enabled,
+            async_export_max_pending_profiles:
+              settings.profiling.advanced.experimental_async_export_max_pending_profiles,
           )
       end
 
@@ -478,6 +483,17 @@ module Datadog
         # useful it is -- if a customer disables timeline, there's nowhere to look for GVL profiling anyway!
         settings.profiling.advanced.timeline_enabled && settings.profiling.advanced.gvl_enabled
       end
+
+      private_class_method def self.enable_ractor_profiling?(settings, logger)
+        return false unless settings.profiling.advanced.experimental_ractor_profiling_enabled
+
+        if RUBY_VERSION < "3.3"
+          logger.warn("Ractor profiling is only supported on Ruby 3.3+; ignoring experimental_ractor_profiling_enabled setting")
+          return false
+        end
+
+        true
+      end
     end
   end
 end
@@ -0,0 +1,25 @@
+# frozen_string_literal: true
+
+module Datadog
+  module Profiling
+    # Application-defined labels that get attached to profiler samples. See `Datadog::Profiling.with_labels`.
+    #
+    # Methods prefixed with _native_ are implemented in `custom_labels.c`
+    module CustomLabels
+      def self.with_labels(labels)
+        pushed = 0
+        labels.each do |key, value|
+          pushed += 1 if _native_push(key.to_s, value.to_s)
+        end
+
+        yield
+      ensure
+        _native_pop(pushed) if pushed
+      end
+
+      def self.stats
+        _native_stats
+      end
+    end
+  end
+end
@@ -4,8 +4,18 @@ module Datadog
   module Profiling
     # This class exists to wrap a ddog_prof_EncodedProfile into a Ruby object
     #
-    # This class is not empty; all of this class is implemented as native code.
-    class EncodedProfile # rubocop:disable Lint/EmptyClass
+    # Methods prefixed with _native_ are implemented in `encoded_profile.c`
+    class EncodedProfile
+      # Writes the encoded profile to the given IO or file path, without copying it into a Ruby string first.
+      # Returns the number of bytes written.
+      def write_to(io_or_path)
+        if io_or_path.respond_to?(:fileno)
+          io_or_path.flush # Anything buffered by Ruby needs to come before the profile
+          _native_write_to_fd(io_or_path.fileno)
+        else
+          File.open(io_or_path, "wb") { |file| _native_write_to_fd(file.fileno) }
+        end
+      end
     end
   end
 end
@@ -56,6 +56,7 @@ module Datadog
       end
 
       def flush
+        @worker.flush_gc_events
         worker_stats = @worker.stats_and_reset_not_thread_safe
         serialization_result = pprof_recorder.serialize
         return if serialization_result.nil?
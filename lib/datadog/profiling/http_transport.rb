@@ -10,7 +10,15 @@ module Datadog
     class HttpTransport
       attr_reader :exporter_configuration
 
-      def initialize(agent_settings:, site:, api_key:, upload_timeout_seconds:, use_system_dns:)
+      def initialize(
+        agent_settings:,
+        site:,
+        api_key:,
+        upload_timeout_seconds:,
+        use_system_dns:,
+        async_export_enabled: false,
+        async_export_max_pending_profiles: 4
+      )
         timeout_milliseconds = (upload_timeout_seconds * 1_000).to_i
 
         # Steep: multiple issues here
@@ -26,9 +34,26 @@ module Datadog
         status, result = self.class._native_validate_exporter(exporter_configuration)
 
         raise(ArgumentError, "Failed to initialize transport: #{result}") if status == :error
+
+        @async_exporter = nil
+        if async_export_enabled
+          status, result = self.class._native_async_exporter_new(
+            exporter_configuration,
+            async_export_max_pending_profiles,
+            (agent_address(agent_settings) if exporter_configuration[0] == :agent),
+          )
+
+          raise(ArgumentError, "Failed to initialize transport: #{result}") if status == :error
+
+          @async_exporter = result
+        end
       end
 
+      # When async export is enabled, this only queues the flush for reporting in the background, and failures to report
+      # get logged on later calls to #export (or #wait_for_pending_exports).
       def export(flush)
+        return export_async(flush) if @async_exporter
+
         status, result = self.class._native_do_export(
           exporter_configuration,
           flush
@@ -55,8 +80,63 @@ module Datadog
         end
       end
 
+      # Blocks until profiles queued by #export have been reported, for up to the upload timeout.
+      # Used by the Scheduler to make sure the last profile gets reported when shutting down.
+      def wait_for_pending_exports
+        return true unless @async_exporter
+
+        drained = self.class._native_async_wait(@async_exporter, exporter_configuration[1])
+        log_async_export_failures
+        drained
+      end
+
+      # Stops the async export background thread, dropping any profiles still pending export.
+      # Used by the Scheduler when shutting down, after it has waited for the last profile to be reported.
+      def stop
+        return true unless @async_exporter
+
+        self.class._native_async_stop(@async_exporter, exporter_configuration[1])
+      end
+
       private
 
+      def export_async(flush)
+        log_async_export_failures
+
+        if self.class._native_async_export(@async_exporter, flush)
+          true
+        else
+          Datadog.logger.warn(
+            "Failed to report profiling data (#{config_without_api_key}): " \
+            "too many profiles pending export, dropping profile"
+          )
+          Datadog::Core::Telemetry::Logger.error("Failed to report profiling data: too many profiles pending export")
+          false
+        end
+      end
+
+      def log_async_export_failures
+        failures, last_failure = self.class._native_async_take_failures(@async_exporter)
+        return if failures == 0
+
+        message = "Failed to report profiling data (#{config_without_api_key}): #{last_failure}"
+        message += " (and #{failures - 1} other failures since the last report)" if failures > 1
+
+        Datadog.logger.warn(message)
+        Datadog::Core::Telemetry::Logger.error("Failed to report profiling data")
+      end
+
+      # Used by the async exporter, after a failed export, to check if the agent is up before handing it the next profile,
+      # so that profiles are held (rather than lost) while the agent is down, e.g. during a deploy
+      def agent_address(agent_settings)
+        case agent_settings.adapter
+        when Datadog::Core::Configuration::Ext::Agent::HTTP::ADAPTER
+          [:tcp, agent_settings.hostname, agent_settings.port]
+        when Datadog::Core::Configuration::Ext::Agent::UnixSocket::ADAPTER
+          [:unix, agent_settings.uds_path]
+        end
+      end
+
       def agentless?(site, api_key)
         site && api_key && %w[1 true].include?(ENV[Profiling::Ext::ENV_AGENTLESS] || '') # rubocop:disable CustomCops/EnvUsageCop
       end
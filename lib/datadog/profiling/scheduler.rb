@@ -98,6 +98,15 @@ module Datadog
         exporter.reset_after_fork
       end
 
+      def stop(force_stop = false, timeout = DEFAULT_SHUTDOWN_TIMEOUT)
+        stopped = super
+
+        # The loop reports the last profile before finishing, so once it's done, the transport is no longer needed
+        transport.stop if !running? && transport.respond_to?(:stop)
+
+        stopped
+      end
+
       private
 
       def flush_and_wait
@@ -134,6 +143,8 @@ module Datadog
 
         begin
           transport.export(flush)
+          # When stopping, make sure the last profile actually gets reported before we return
+          transport.wait_for_pending_exports if !run_loop? && transport.respond_to?(:wait_for_pending_exports)
         rescue => e
           Datadog.logger.warn(
             "Unable to report profile. Cause: #{e.class.name} #{e.message} Location: #{Array(e.backtrace).first}"
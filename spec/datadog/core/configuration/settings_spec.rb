@@ -958,6 +958,68 @@ RSpec.describe Datadog::Core::Configuration::Settings do
         end
       end
 
+      describe '#experimental_fiber_profiling_enabled' do
+        subject(:experimental_fiber_profiling_enabled) { settings.profiling.advanced.experimental_fiber_profiling_enabled }
+
+        it { is_expected.to be false }
+      end
+
+      describe '#experimental_fiber_profiling_enabled=' do
+        it 'updates the #experimental_fiber_profiling_enabled setting' do
+          expect { settings.profiling.advanced.experimental_fiber_profiling_enabled = true }
+            .to change { settings.profiling.advanced.experimental_fiber_profiling_enabled }
+            .from(false)
+            .to(true)
+        end
+      end
+
+      describe '#experimental_ractor_profiling_enabled' do
+        subject(:experimental_ractor_profiling_enabled) { settings.profiling.advanced.experimental_ractor_profiling_enabled }
+
+        it { is_expected.to be false }
+      end
+
+      describe '#experimental_ractor_profiling_enabled=' do
+        it 'updates the #experimental_ractor_profiling_enabled setting' do
+          expect { settings.profiling.advanced.experimental_ractor_profiling_enabled = true }
+            .to change { settings.profiling.advanced.experimental_ractor_profiling_enabled }
+            .from(false)
+            .to(true)
+        end
+      end
+
+      describe '#experimental_async_export_enabled' do
+        subject(:experimental_async_export_enabled) { settings.profiling.advanced.experimental_async_export_enabled }
+
+        it { is_expected.to be false }
+      end
+
+      describe '#experimental_async_export_enabled=' do
+        it 'updates the #experimental_async_export_enabled setting' do
+          expect { settings.profiling.advanced.experimental_async_export_enabled = true }
+            .to change { settings.profiling.advanced.experimental_async_export_enabled }
+            .from(false)
+            .to(true)
+        end
+      end
+
+      describe '#experimental_async_export_max_pending_profiles' do
+        subject(:experimental_async_export_max_pending_profiles) do
+          settings.profiling.advanced.experimental_async_export_max_pending_profiles
+        end
+
+        it { is_expected.to be 4 }
+      end
+
+      describe '#experimental_async_export_max_pending_profiles=' do
+        it 'updates the #experimental_async_export_max_pending_profiles setting' do
+          expect { settings.profiling.advanced.experimental_async_export_max_pending_profiles = 30 }
+            .to change { settings.profiling.advanced.experimental_async_export_max_pending_profiles }
+            .from(4)
+            .to(30)
+        end
+      end
+
       describe '#experimental_use_system_dns' do
         subject(:experimental_use_system_dns) { settings.profiling.advanced.experimental_use_system_dns }
 
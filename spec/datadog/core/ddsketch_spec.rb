@@ -1,4 +1,5 @@
 require 'datadog/core'
+require 'objspace'
 require 'datadog/core/ddsketch'
 require 'datadog/core/ddsketch_pprof/ddsketch_pb'
 
@@ -52,6 +53,191 @@ RSpec.describe Datadog::Core::DDSketch do
       end
     end
 
+    describe '#add_many' do
+      it 'adds all the points in an array to the sketch' do
+        expect { sketch.add_many([1.0, 2, 3.5]) }.to change { sketch.count }.from(0.0).to(3.0)
+      end
+
+      it 'adds all the points in a string of packed doubles to the sketch' do
+        expect { sketch.add_many([1.0, 2.0, 3.5].pack('d*')) }.to change { sketch.count }.from(0.0).to(3.0)
+      end
+
+      it 'returns the sketch' do
+        expect(sketch.add_many([1.0])).to be sketch
+      end
+
+      it 'produces the same sketch as adding the points one by one' do
+        points = [5.0, 1.0, 5.0, 2.0, 5.0, 1.0, 0.0]
+        other_sketch = described_class.new
+        points.each { |point| other_sketch.add(point) }
+
+        decoded = Test::DDSketch.decode(sketch.add_many(points).encode)
+        other_decoded = Test::DDSketch.decode(other_sketch.encode)
+
+        expect(decoded.zeroCount).to be(1.0)
+        expect(decoded.positiveValues.binCounts.to_h).to eq(other_decoded.positiveValues.binCounts.to_h)
+        expect(decoded.positiveValues.contiguousBinCounts.to_a).to eq(other_decoded.positiveValues.contiguousBinCounts.to_a)
+      end
+
+      context 'when there are no points' do
+        it 'does nothing' do
+          expect { sketch.add_many([]) }.to_not(change { sketch.count })
+        end
+      end
+
+      context 'when a point is a negative number' do
+        it 'raises an error' do
+          expect { sketch.add_many([1.0, -1.0]) }.to raise_error(::RuntimeError) do |error|
+            expect(error.message).to eq('DDSketch add_many failed: point is invalid')
+          end
+        end
+      end
+
+      context 'when the string of packed doubles has an invalid length' do
+        it 'raises an error' do
+          expect { sketch.add_many("\x00" * 9) }.to raise_error(ArgumentError, /not a multiple of 8/)
+        end
+      end
+
+      context 'when points is neither an array nor a string' do
+        it 'raises an error' do
+          expect { sketch.add_many(1.0) }.to raise_error(TypeError)
+        end
+      end
+    end
+
+    describe '#merge' do
+      let(:other) { described_class.new }
+
+      before do
+        sketch.add(1.0)
+        other.add_many([0.0, 2.0, 2.0, 300.0])
+      end
+
+      it 'adds the points from the other sketch' do
+        expect { sketch.merge(other) }.to change { sketch.count }.from(1.0).to(5.0)
+      end
+
+      it 'leaves the other sketch unchanged' do
+        expect { sketch.merge(other) }.to_not(change { [other.count, other.quantile(0.5), other.quantile(1.0)] })
+      end
+
+      it 'returns the sketch' do
+        expect(sketch.merge(other)).to be sketch
+      end
+
+      it 'produces the same sketch as adding all points to a single sketch' do
+        single_sketch = described_class.new.add_many([1.0, 0.0, 2.0, 2.0, 300.0])
+
+        merged = Test::DDSketch.decode(sketch.merge(other).encode)
+        expected = Test::DDSketch.decode(single_sketch.encode)
+
+        expect(merged.zeroCount).to eq(expected.zeroCount)
+        expect(merged.positiveValues.binCounts.to_h).to eq(expected.positiveValues.binCounts.to_h)
+        expect(merged.positiveValues.contiguousBinCounts.to_a).to eq(expected.positiveValues.contiguousBinCounts.to_a)
+      end
+
+      context 'when merging a sketch into itself' do
+        it 'doubles the counts' do
+          expect { sketch.merge(sketch) }.to change { sketch.count }.from(1.0).to(2.0)
+        end
+      end
+
+      context 'when the other sketch was encoded' do
+        before { other.encode }
+
+        it 'does not add its encoded points' do
+          expect { sketch.merge(other) }.to_not(change { sketch.count })
+        end
+      end
+
+      context 'when other is not a sketch' do
+        it 'raises an error' do
+          expect { sketch.merge(:not_a_sketch) }.to raise_error(TypeError)
+        end
+      end
+    end
+
+    describe '#quantile' do
+      context 'when sketch is empty' do
+        it 'returns nil' do
+          expect(sketch.quantile(0.5)).to be nil
+        end
+      end
+
+      context 'when sketch has points' do
+        before { sketch.add_many((1..1000).to_a) }
+
+        it 'returns an estimate within the sketch relative accuracy' do
+          expect(sketch.quantile(0.0)).to be_within(0.02).of(1.0)
+          expect(sketch.quantile(0.5)).to be_within(500 * 0.02).of(500.0)
+          expect(sketch.quantile(0.99)).to be_within(990 * 0.02).of(990.0)
+          expect(sketch.quantile(1.0)).to be_within(1000 * 0.02).of(1000.0)
+        end
+
+        it 'leaves the sketch unchanged' do
+          expect { sketch.quantile(0.5) }.to_not(change { sketch.count })
+          expect(sketch.quantile(0.5)).to eq(sketch.quantile(0.5))
+        end
+
+        it 'reflects points added since it was last called' do
+          sketch.quantile(1.0)
+          sketch.add(1_000_000.0)
+
+          expect(sketch.quantile(1.0)).to be_within(1_000_000 * 0.02).of(1_000_000.0)
+        end
+
+        it 'reflects the sketch being reset by encode' do
+          sketch.quantile(0.5)
+          sketch.encode
+
+          expect(sketch.quantile(0.5)).to be nil
+        end
+
+        it 'does not change what gets encoded' do
+          same_points = described_class.new.add_many((1..1000).to_a)
+
+          sketch.quantile(0.5)
+
+          expect(Test::DDSketch.decode(sketch.encode)).to eq(Test::DDSketch.decode(same_points.encode))
+        end
+      end
+
+      context 'when most points are zero' do
+        before { sketch.add_with_count(0.0, 9.0).add(100.0) }
+
+        it 'returns zero for the lower quantiles' do
+          expect(sketch.quantile(0.5)).to eq(0.0)
+          expect(sketch.quantile(1.0)).to be_within(100 * 0.02).of(100.0)
+        end
+      end
+
+      context 'when the quantile is out of range' do
+        it 'raises an error' do
+          expect { sketch.quantile(1.5) }.to raise_error(ArgumentError, /between 0 and 1/)
+        end
+      end
+    end
+
+    describe 'memory usage' do
+      it 'grows with the range of points in the sketch' do
+        empty_size = ObjectSpace.memsize_of(sketch)
+
+        sketch.add_many([1.0, 1_000_000.0])
+
+        expect(ObjectSpace.memsize_of(sketch)).to be > empty_size
+      end
+
+      it 'shrinks back once the points get encoded' do
+        sketch.add_many([1.0, 1_000_000.0])
+        full_size = ObjectSpace.memsize_of(sketch)
+
+        sketch.encode
+
+        expect(ObjectSpace.memsize_of(sketch)).to be < full_size
+      end
+    end
+
     describe '#count' do
       subject(:count) { sketch.count }
 
@@ -100,6 +286,28 @@ RSpec.describe Datadog::Core::DDSketch do
         # @ivoanjo: Not amazingly interesting, but just a simple sanity check that the round trip works
         expect(decoded.zeroCount).to be(42.0)
       end
+
+      it 'keeps working across multiple encodes' do
+        encode
+
+        3.times do |i|
+          sketch.add_with_count(0, i + 1)
+          expect(Test::DDSketch.decode(sketch.encode).zeroCount).to be((i + 1).to_f)
+          expect(sketch.count).to be 0.0
+        end
+      end
+
+      it 'reports every point exactly once when points get added concurrently' do
+        encode
+
+        adders = Array.new(4) { Thread.new { 1000.times { sketch.add(0) } } }
+        encoded = []
+        encoded << Test::DDSketch.decode(sketch.encode) while adders.any?(&:alive?)
+        adders.each(&:join)
+        encoded << Test::DDSketch.decode(sketch.encode)
+
+        expect(encoded.sum(&:zeroCount)).to be 4000.0
+      end
     end
   end
 end
@@ -63,6 +63,24 @@ RSpec.describe Datadog::Core::FeatureFlags do
         expect { described_class::Configuration.new('invalid json') }
           .to raise_error(described_class::Error, /Failed to create configuration from JSON/)
       end
+
+      it 'creates a new configuration from a frozen JSON string' do
+        expect { described_class::Configuration.new(flags_json.dup.freeze) }.not_to raise_error
+      end
+
+      it 'allows the JSON string to be changed after creating the configuration' do
+        json = flags_json.dup
+        described_class::Configuration.new(json)
+
+        expect { json << ' ' }.not_to raise_error
+      end
+
+      it 'allows the JSON string to be changed after failing to create the configuration' do
+        json = +'invalid json'
+        expect { described_class::Configuration.new(json) }.to raise_error(described_class::Error)
+
+        expect { json << ' ' }.not_to raise_error
+      end
     end
 
     describe '#get_assignment' do
@@ -130,6 +148,31 @@ RSpec.describe Datadog::Core::FeatureFlags do
         end
       end
 
+      context 'when context is an EvaluationContext' do
+        let(:context) do
+          described_class::EvaluationContext.new({'targeting_key' => 'test-user', 'email' => 'user@example.com'})
+        end
+
+        it 'evaluates flag successfully' do
+          result = configuration.get_assignment('test-flag', :object, context)
+
+          expect(result.variant).to eq('treatment')
+          expect(result.reason).to eq('TARGETING_MATCH')
+        end
+
+        it 'can be reused across evaluations' do
+          results = Array.new(3) { configuration.get_assignment('test-flag', :object, context) }
+
+          expect(results.map(&:variant)).to all(eq('treatment'))
+        end
+      end
+
+      context 'when context is neither a Hash nor an EvaluationContext' do
+        it 'raises an error' do
+          expect { configuration.get_assignment('test-flag', :object, 'test-user') }.to raise_error(TypeError)
+        end
+      end
+
       context 'when value lazy evaluation fails' do
         before { allow(JSON).to receive(:parse).and_raise(JSON::ParserError, 'Ooops') }
 
@@ -145,4 +188,137 @@ RSpec.describe Datadog::Core::FeatureFlags do
       end
     end
   end
+
+  describe 'Configuration#get_assignments' do
+    subject(:assignments) { configuration.get_assignments(flag_keys, expected_types, context) }
+
+    let(:configuration) { described_class::Configuration.new(flags_json) }
+    let(:flag_keys) { ['test-flag', 'non-existent-flag', 'test-flag'] }
+    let(:expected_types) { :object }
+    let(:context) { {'targeting_key' => 'test-user', 'email' => 'user@example.com'} }
+
+    it 'evaluates every flag, in order' do
+      expect(assignments.size).to be 3
+      expect(assignments.map(&:variant)).to eq(['treatment', nil, 'treatment'])
+      expect(assignments[1].error_code).to eq('FLAG_NOT_FOUND')
+    end
+
+    it 'returns the same results as evaluating flags one by one' do
+      expect(assignments[0].value).to eq(configuration.get_assignment('test-flag', :object, context).value)
+    end
+
+    it 'returns the same ResolutionDetails when accessing a result again' do
+      expect(assignments[0]).to be(assignments[0])
+    end
+
+    it 'supports negative indexes and returns nil when out of range' do
+      expect(assignments[-1].variant).to eq('treatment')
+      expect(assignments[3]).to be_nil
+      expect(assignments[-4]).to be_nil
+    end
+
+    context 'when context is an EvaluationContext' do
+      let(:context) do
+        described_class::EvaluationContext.new({'targeting_key' => 'test-user', 'email' => 'user@example.com'})
+      end
+
+      it 'evaluates every flag' do
+        expect(assignments.map(&:variant)).to eq(['treatment', nil, 'treatment'])
+      end
+    end
+
+    context 'when expected_types has one type per flag' do
+      let(:expected_types) { [:object, :object, :string] }
+
+      it 'uses the matching type for each flag' do
+        expect(assignments[0].variant).to eq('treatment')
+        expect(assignments[2].error_code).to eq('TYPE_MISMATCH')
+      end
+    end
+
+    context 'when expected_types has the wrong number of types' do
+      let(:expected_types) { [:object] }
+
+      it 'raises an error' do
+        expect { assignments }.to raise_error(ArgumentError, /one expected_type per flag key/)
+      end
+    end
+
+    context 'when there are no flags' do
+      let(:flag_keys) { [] }
+
+      it 'returns an empty result' do
+        expect(assignments.to_a).to eq([])
+      end
+    end
+
+    context 'when a flag key is not a string' do
+      let(:flag_keys) { ['test-flag', :'test-flag'] }
+
+      it 'raises an error' do
+        expect { assignments }.to raise_error(TypeError)
+      end
+    end
+  end
+
+  describe 'ExposureCache' do
+    subject(:exposure_cache) { described_class::ExposureCache.new(100) }
+
+    let(:configuration) { described_class::Configuration.new(flags_json) }
+    let(:result) do
+      configuration.get_assignment('test-flag', :object, {'targeting_key' => 'test-user', 'email' => 'user@example.com'})
+    end
+
+    describe '.new' do
+      it 'raises an error when capacity is out of range' do
+        expect { described_class::ExposureCache.new(0) }.to raise_error(ArgumentError, /capacity must be between/)
+      end
+    end
+
+    describe '#duplicate?' do
+      it 'returns false the first time an exposure is seen' do
+        expect(exposure_cache.duplicate?(result, 'test-flag', 'test-user')).to be(false)
+      end
+
+      it 'returns true when the same exposure is seen again' do
+        exposure_cache.duplicate?(result, 'test-flag', 'test-user')
+
+        expect(exposure_cache.duplicate?(result, 'test-flag', 'test-user')).to be(true)
+      end
+
+      it 'returns false for other targeting keys or flag keys' do
+        exposure_cache.duplicate?(result, 'test-flag', 'test-user')
+
+        expect(exposure_cache.duplicate?(result, 'test-flag', 'other-user')).to be(false)
+        expect(exposure_cache.duplicate?(result, 'other-flag', 'test-user')).to be(false)
+        expect(exposure_cache.duplicate?(result, 'test-flag', nil)).to be(false)
+      end
+
+      it 'returns false when the same subject gets a different variant' do
+        other_result =
+          configuration.get_assignment('test-flag', :object, {'targeting_key' => 'test-user', 'email' => 'a@b.com'})
+        exposure_cache.duplicate?(result, 'test-flag', 'test-user')
+
+        expect(exposure_cache.duplicate?(other_result, 'test-flag', 'test-user')).to be(false)
+        expect(exposure_cache.duplicate?(result, 'test-flag', 'test-user')).to be(false)
+      end
+
+      it 'raises an error when result is not a ResolutionDetails' do
+        expect { exposure_cache.duplicate?(Object.new, 'test-flag', 'test-user') }.to raise_error(TypeError)
+      end
+    end
+  end
+
+  describe 'EvaluationContext' do
+    describe '.new' do
+      it 'creates a new evaluation context from a hash' do
+        expect(described_class::EvaluationContext.new({'targeting_key' => 'test-user', 'admin' => true}))
+          .to be_a(described_class::EvaluationContext)
+      end
+
+      it 'raises an error when a key is not a string' do
+        expect { described_class::EvaluationContext.new({email: 'user@example.com'}) }.to raise_error(TypeError)
+      end
+    end
+  end
 end
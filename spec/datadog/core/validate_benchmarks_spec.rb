@@ -0,0 +1,31 @@
+require 'spec_helper'
+require 'datadog/core'
+
+RSpec.describe 'Core benchmarks', :memcheck_valgrind_skip do
+  before do
+    skip('Spec requires Ruby VM supporting fork') unless PlatformHelpers.supports_fork?
+    if Datadog::Core::LIBDATADOG_API_FAILURE
+      skip("libdatadog_api is not available: #{Datadog::Core::LIBDATADOG_API_FAILURE}")
+    end
+  end
+
+  with_env 'VALIDATE_BENCHMARK' => 'true'
+
+  benchmarks_to_validate = [
+    'core_ddsketch',
+    'core_feature_flags',
+  ].freeze
+
+  benchmarks_to_validate.each do |benchmark|
+    describe benchmark do
+      it('runs without raising errors') { expect_in_fork { load "./benchmarks/#{benchmark}.rb" } }
+    end
+  end
+
+  # This test validates that we don't forget to add new benchmarks to benchmarks_to_validate
+  it 'tests all expected benchmarks in the benchmarks folder' do
+    all_benchmarks = Dir['./benchmarks/core_*'].map { |it| it.gsub('./benchmarks/', '').gsub('.rb', '') }
+
+    expect(benchmarks_to_validate).to contain_exactly(*all_benchmarks)
+  end
+end
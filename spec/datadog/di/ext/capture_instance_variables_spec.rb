@@ -0,0 +1,105 @@
+require "datadog/di/spec_helper"
+
+RSpec.describe 'capture_instance_variables' do
+  let(:pairs) { [] }
+
+  subject(:count) do
+    Datadog::DI.capture_instance_variables(object, limit, pairs)
+  end
+
+  let(:limit) { 10 }
+
+  context 'object with instance variables' do
+    let(:object) do
+      Object.new.tap do |object|
+        object.instance_variable_set(:@a, 1)
+        object.instance_variable_set(:@b, 'two')
+      end
+    end
+
+    it 'returns the instance variables in definition order' do
+      expect(count).to eq 2
+      expect(pairs).to eq [:@a, 1, :@b, 'two']
+    end
+  end
+
+  context 'object with more instance variables than the limit' do
+    let(:limit) { 3 }
+
+    let(:object) do
+      Object.new.tap do |object|
+        1.upto(5) { |i| object.instance_variable_set(:"@v#{i}", i) }
+      end
+    end
+
+    it 'returns the first instance variables and the total count' do
+      expect(count).to eq 5
+      expect(pairs).to eq [:@v1, 1, :@v2, 2, :@v3, 3]
+    end
+  end
+
+  context 'when limit is zero' do
+    let(:limit) { 0 }
+
+    let(:object) do
+      Object.new.tap { |object| object.instance_variable_set(:@a, 1) }
+    end
+
+    it 'only returns the count' do
+      expect(count).to eq 1
+      expect(pairs).to be_empty
+    end
+  end
+
+  context 'immediate value' do
+    let(:object) { 42 }
+
+    it 'returns no instance variables' do
+      expect(count).to eq 0
+      expect(pairs).to be_empty
+    end
+  end
+
+  context 'exception' do
+    let(:object) { NameError.new('No method foo in bar') }
+
+    it 'does not return the internal message variable' do
+      expect(count).to eq 0
+      expect(pairs).to be_empty
+    end
+  end
+
+  context 'object overriding instance variable methods' do
+    let(:object_class) do
+      Class.new do
+        def initialize
+          @ivar = 'value'
+        end
+
+        def instance_variables
+          raise 'instance_variables should not be called'
+        end
+
+        def instance_variable_get(name)
+          raise 'instance_variable_get should not be called'
+        end
+      end
+    end
+
+    let(:object) { object_class.new }
+
+    it 'does not call the overridden methods' do
+      expect(count).to eq 1
+      expect(pairs).to eq [:@ivar, 'value']
+    end
+  end
+
+  context 'when pairs is frozen' do
+    let(:object) { Object.new }
+    let(:pairs) { [].freeze }
+
+    it 'raises' do
+      expect { count }.to raise_error(FrozenError)
+    end
+  end
+end
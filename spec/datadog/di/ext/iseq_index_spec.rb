@@ -0,0 +1,132 @@
+require "datadog/di/spec_helper"
+require "datadog/di/code_tracker"
+require "tmpdir"
+
+RSpec.describe 'iseq index' do
+  let(:path) { File.realpath(Datadog::DI.method(:enabled?).source_location.first) }
+  let(:enabled_line) { Datadog::DI.method(:enabled?).source_location.last }
+
+  describe 'iseqs_for_path' do
+    # This file was loaded before the index was built, so this also checks that only whole-file iseqs get indexed
+    # when walking the heap
+    it 'returns the whole-file iseq for a loaded file' do
+      iseqs = Datadog::DI.iseqs_for_path(path)
+
+      expect(iseqs.length).to be 1
+      expect(iseqs.first).to be_a(RubyVM::InstructionSequence)
+      expect(iseqs.first.absolute_path).to eq path
+      expect(iseqs.first.first_lineno).to be 0
+    end
+
+    it 'returns an empty array for unknown paths' do
+      expect(Datadog::DI.iseqs_for_path('/does/not/exist.rb')).to eq []
+    end
+  end
+
+  describe 'iseq_for_line' do
+    it 'returns the whole-file iseq containing the line' do
+      iseq = Datadog::DI.iseq_for_line(path, enabled_line + 1)
+
+      expect(iseq.absolute_path).to eq path
+      expect(iseq.first_lineno).to be 0
+    end
+
+    it 'returns nil for lines past the end of the file' do
+      expect(Datadog::DI.iseq_for_line(path, File.readlines(path).length + 100)).to be nil
+    end
+
+    it 'returns nil for unknown paths' do
+      expect(Datadog::DI.iseq_for_line('/does/not/exist.rb', 1)).to be nil
+    end
+  end
+
+  describe 'file_iseqs' do
+    it 'returns one whole-file iseq per indexed file' do
+      iseqs = Datadog::DI.file_iseqs
+
+      expect(iseqs.map(&:absolute_path)).to include(path)
+      expect(iseqs.map(&:absolute_path).uniq.length).to eq iseqs.length
+      expect(iseqs.map(&:first_lineno).uniq).to eq [0]
+    end
+  end
+
+  describe 'file_paths' do
+    it 'returns the path of every indexed file' do
+      paths = Datadog::DI.file_paths
+
+      expect(paths).to include(path)
+      expect(paths.uniq.length).to eq paths.length
+      expect(paths).to match_array(Datadog::DI.file_iseqs.map(&:absolute_path))
+    end
+  end
+
+  describe 'CodeTracker#iseqs_for_path_suffix' do
+    let(:tracker) { Datadog::DI::CodeTracker.new }
+
+    before { tracker.start }
+    after { tracker.stop }
+
+    it 'finds files loaded before code tracking started using the index' do
+      matched_path, iseq = tracker.iseqs_for_path_suffix('lib/datadog/di.rb')
+
+      expect(matched_path).to eq path
+      expect(iseq.absolute_path).to eq path
+      expect(iseq.first_lineno).to be 0
+    end
+
+    it 'only creates an iseq object for the matching file' do
+      allow(Datadog::DI).to receive(:iseqs_for_path).and_call_original
+      expect(Datadog::DI).to_not receive(:file_iseqs)
+      expect(Datadog::DI).to receive(:iseqs_for_path).with(path).and_call_original
+
+      tracker.iseqs_for_path_suffix('lib/datadog/di.rb')
+    end
+
+    it 'looks up exact paths without listing the indexed files' do
+      expect(Datadog::DI).to_not receive(:file_paths)
+
+      expect(tracker.iseqs_for_path_suffix(path).first).to eq path
+    end
+  end
+
+  context 'when a file is loaded after the index was built' do
+    around do |example|
+      Dir.mktmpdir do |dir|
+        @file_path = File.join(dir, 'iseq_index_test_file.rb')
+        example.run
+      end
+    end
+
+    let(:file_path) { File.realpath(@file_path) }
+
+    before do
+      # Build the index
+      Datadog::DI.iseqs_for_path(path)
+
+      File.write(@file_path, <<~RUBY)
+        class IseqIndexTestClass
+          def test_method
+            42
+          end
+        end
+      RUBY
+      load @file_path
+    end
+
+    after { Object.send(:remove_const, :IseqIndexTestClass) }
+
+    it 'indexes the whole-file iseq of the new file' do
+      iseqs = Datadog::DI.iseqs_for_path(file_path)
+
+      expect(iseqs.length).to be 1
+      expect(iseqs.first.absolute_path).to eq file_path
+      expect(Datadog::DI.iseq_for_line(file_path, 3).absolute_path).to eq file_path
+    end
+
+    it 'replaces the iseqs when the file is loaded again' do
+      load @file_path
+
+      expect(Datadog::DI.iseqs_for_path(file_path).length).to be 1
+    end
+  end
+end
@@ -0,0 +1,129 @@
+require "datadog/di/spec_helper"
+
+class DILineProbeHookSpecTestClass
+  def test_method
+    42
+  end
+end
+
+RSpec.describe 'Datadog::DI::LineProbeHook' do
+  di_test
+
+  let(:target) { DILineProbeHookSpecTestClass.instance_method(:test_method) }
+  let(:target_line) { target.source_location.last + 1 }
+
+  let(:observed_calls) { [] }
+  let(:callback) { proc { |tp| observed_calls << [tp.event, tp.lineno] } }
+
+  let(:rate_limit) { nil }
+
+  subject(:hook) { Datadog::DI::LineProbeHook.new(rate_limit, callback) }
+
+  let(:trace_point) { hook.trace_point }
+
+  before do
+    trace_point.enable(target: target, target_line: target_line)
+  end
+
+  after do
+    trace_point.disable
+  end
+
+  def call_target(times)
+    times.times { DILineProbeHookSpecTestClass.new.test_method }
+  end
+
+  it 'returns a trace point' do
+    expect(trace_point).to be_a(TracePoint)
+    expect(hook.trace_point).to be trace_point
+  end
+
+  context 'without a rate limit' do
+    it 'calls the callback for every hit' do
+      call_target(3)
+
+      expect(observed_calls).to eq [[:line, target_line]] * 3
+      expect(hook.hits).to eq 3
+      expect(hook.drops).to eq 0
+    end
+  end
+
+  context 'with a rate limit' do
+    let(:rate_limit) { 2 }
+
+    it 'drops the hits over the rate limit without calling the callback' do
+      call_target(10)
+
+      # The test is not fast enough for the bucket to get refilled by a whole token
+      expect(observed_calls.length).to eq 2
+      expect(hook.hits).to eq 10
+      expect(hook.drops).to eq 8
+    end
+  end
+
+  context 'with a zero rate limit' do
+    let(:rate_limit) { 0 }
+
+    it 'drops every hit' do
+      call_target(3)
+
+      expect(observed_calls).to be_empty
+      expect(hook.hits).to eq 3
+      expect(hook.drops).to eq 3
+    end
+  end
+
+  context 'with a negative rate limit' do
+    let(:rate_limit) { -1 }
+
+    it 'allows every hit' do
+      call_target(3)
+
+      expect(observed_calls.length).to eq 3
+      expect(hook.drops).to eq 0
+    end
+  end
+
+  context 'when disabled' do
+    let(:rate_limit) { 2 }
+
+    it 'ignores hits without counting them or using up the rate limit' do
+      expect(hook.enabled?).to be true
+      hook.enabled = false
+
+      call_target(3)
+
+      expect(observed_calls).to be_empty
+      expect(hook.hits).to eq 0
+      expect(hook.drops).to eq 0
+
+      hook.enabled = true
+      call_target(2)
+
+      expect(observed_calls.length).to eq 2
+    end
+  end
+
+  context 'when the hook is only referenced by its trace point' do
+    let(:trace_point) do
+      Datadog::DI::LineProbeHook.new(nil, callback).trace_point.tap { GC.start }
+    end
+
+    it 'keeps working' do
+      GC.start
+      call_target(1)
+
+      expect(observed_calls).to eq [[:line, target_line]]
+    end
+  end
+
+  describe '.new' do
+    it 'raises when callback is not a proc' do
+      expect { Datadog::DI::LineProbeHook.new(nil, :not_a_proc) }.to raise_error(ArgumentError)
+    end
+
+    it 'raises when rate_limit is not a number' do
+      expect { Datadog::DI::LineProbeHook.new('1', callback) }.to raise_error(ArgumentError)
+    end
+  end
+end
@@ -33,11 +33,11 @@ RSpec.describe 'all_iseqs' do
     paths = datadog_iseqs.map(&:absolute_path).uniq
 
     # When this test was written, there were 650+ files with
-    # iseqs in them and 5200+ iseq objects available.
-    # Allow for a margin but assume the amount of code in dd-trace-rb
-    # will generally grow over time.
+    # iseqs in them. Allow for a margin but assume the amount of code
+    # in dd-trace-rb will generally grow over time.
     expect(paths.length).to be > 500
-    expect(datadog_iseqs.length).to be > 4000
+    # file_iseqs only returns whole-file iseqs, one per file
+    expect(datadog_iseqs.length).to eq paths.length
 
     # An initial attempt at this test compared the number of iseqs
     # we got to the size of $LOADED_FEATURES. This is not a working
@@ -1267,6 +1267,25 @@ RSpec.describe Datadog::DI::Instrumenter do
         expect(observed_calls.first).to be_a(Datadog::DI::Context)
       end
 
+      context 'when hits exceed the rate limit' do
+        let(:probe) do
+          Datadog::DI::Probe.new(file: 'hook_line_targeted.rb', line_no: 13,
+            id: 1, type: :log, rate_limit: 1)
+        end
+
+        it 'counts hits and drops' do
+          hook_line(probe) do |payload|
+            observed_calls << payload
+          end
+
+          3.times { HookLineTargetedTestClass.new.test_method }
+
+          expect(observed_calls.length).to eq 1
+          expect(probe.hit_count).to eq 3
+          expect(probe.drop_count).to eq 2
+        end
+      end
+
       context 'end line of a method' do
         before do
           load File.join(File.dirname(__FILE__), 'hook_line_load.rb')
@@ -215,4 +215,24 @@ RSpec.describe Datadog::DI::Probe do
       end
     end
   end
+
+  describe "#disable!" do
+    include_context "line probe"
+
+    it "disables the probe" do
+      expect { probe.disable! }.to change { probe.enabled? }.from(true).to(false)
+    end
+
+    context "when the probe has a native line probe hook" do
+      let(:hook) { double("line probe hook") }
+
+      before { probe.instrumentation_line_probe_hook = hook }
+
+      it "disables the hook too" do
+        expect(hook).to receive(:enabled=).with(false)
+
+        probe.disable!
+      end
+    end
+  end
 end
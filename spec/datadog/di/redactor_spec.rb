@@ -68,10 +68,22 @@ RSpec.describe Datadog::DI::Redactor do
       ["uppercase", "PASSWORD", true],
       ["with removed punctiation", "pass_word", true],
       ["with non-removed punctuation", "pass/word", false],
+      ["symbol", :password, true],
+      ["instance variable symbol", :@password, true],
+      ["non-redacted symbol", :normal, false],
     ]
 
     define_cases(cases)
 
+    context "when the same symbol is checked repeatedly" do
+      it "returns the same result every time" do
+        expect(redactor.redact_identifier?(:@api_key)).to be true
+        expect(redactor.redact_identifier?(:@api_key)).to be true
+        expect(redactor.redact_identifier?(:@normal)).to be false
+        expect(redactor.redact_identifier?(:@normal)).to be false
+      end
+    end
+
     context "when user-defined redacted identifiers exist" do
       before do
         expect(di_settings).to receive(:redacted_identifiers).and_return(%w[foo пароль Ключ @var])
@@ -71,6 +71,20 @@ class DISerializerSpecFields
   end
 end
 
+class DISerializerSpecOverriddenInstanceVariables
+  def initialize
+    @ivar = 'value'
+  end
+
+  def instance_variables
+    raise 'instance_variables should not be called'
+  end
+
+  def instance_variable_get(name)
+    raise 'instance_variable_get should not be called'
+  end
+end
+
 class DISerializerBinaryTestClass
   attr_reader :data
 
@@ -151,6 +165,13 @@ RSpec.describe Datadog::DI::Serializer do
            value: 'bar', type: 'String'
          }
        }}},
+      {name: 'Object overriding instance variable methods', input: DISerializerSpecOverriddenInstanceVariables.new,
+       expected: {type: 'DISerializerSpecOverriddenInstanceVariables', fields: {
+         # Fields are retrieved without calling the overridden methods.
+         "@ivar": {
+           value: 'value', type: 'String'
+         }
+       }}},
     ]
 
     define_serialize_value_cases(cases)
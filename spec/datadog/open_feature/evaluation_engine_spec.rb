@@ -151,6 +151,49 @@ RSpec.describe Datadog::OpenFeature::EvaluationEngine do
         expect(result.value).to eq('hello')
       end
     end
+
+    context 'when the same evaluation context is used for many flags' do
+      before do
+        allow(Datadog::OpenFeature::NativeEvaluator).to receive(:new).and_call_original
+        allow(Datadog::Core::FeatureFlags::Configuration).to receive(:new).and_return(native_configuration)
+        allow(Datadog::Core::FeatureFlags::EvaluationContext).to receive(:new).and_return(native_context)
+        allow(native_configuration).to receive(:get_assignment).and_return(native_result)
+        allow(reporter).to receive(:report)
+
+        engine.reconfigure!(configuration)
+      end
+
+      let(:native_configuration) { instance_double(Datadog::Core::FeatureFlags::Configuration) }
+      let(:native_context) { instance_double(Datadog::Core::FeatureFlags::EvaluationContext) }
+      let(:native_result) { instance_double(Datadog::Core::FeatureFlags::ResolutionDetails, variant: 'control') }
+      let(:evaluation_context) { instance_double('OpenFeature::SDK::EvaluationContext', fields: {'targeting_key' => 'joe'}) }
+
+      def fetch_value(evaluation_context)
+        engine.fetch_value('test', default_value: 'bye!', expected_type: :string, evaluation_context: evaluation_context)
+      end
+
+      it 'builds the native evaluation context once' do
+        3.times { fetch_value(evaluation_context) }
+
+        expect(Datadog::Core::FeatureFlags::EvaluationContext).to have_received(:new)
+          .with({'targeting_key' => 'joe'}).once
+        expect(native_configuration).to have_received(:get_assignment)
+          .with('test', :string, native_context).exactly(3).times
+      end
+
+      it 'builds a new native evaluation context when the evaluation context changes' do
+        fetch_value(evaluation_context)
+        fetch_value(instance_double('OpenFeature::SDK::EvaluationContext', fields: {'targeting_key' => 'jane'}))
+
+        expect(Datadog::Core::FeatureFlags::EvaluationContext).to have_received(:new).twice
+      end
+
+      it 'builds the native evaluation context once when there is no evaluation context' do
+        3.times { fetch_value(nil) }
+
+        expect(Datadog::Core::FeatureFlags::EvaluationContext).to have_received(:new).with({}).once
+      end
+    end
   end
 
   describe '#reconfigure!' do
@@ -88,6 +88,33 @@ RSpec.describe Datadog::OpenFeature::Exposures::Reporter do
       end
     end
 
+    context 'when result was evaluated by libdatadog' do
+      before do
+        stub_const('Datadog::Core::LIBDATADOG_API_FAILURE', nil)
+        allow(Datadog::Core::FeatureFlags::ExposureCache).to receive(:new).and_return(exposure_cache)
+        allow(result).to receive(:is_a?).and_call_original
+        allow(result).to receive(:is_a?).with(Datadog::Core::FeatureFlags::ResolutionDetails).and_return(true)
+      end
+
+      # NOTE: Methods of this class are defined in the C extension, which may not be available
+      let(:exposure_cache) { double(Datadog::Core::FeatureFlags::ExposureCache) }
+
+      it 'deduplicates using the native exposure cache' do
+        expect(exposure_cache).to receive(:duplicate?).with(result, 'feature_flag', 'john-doe').and_return(false)
+        expect(deduplicator).not_to receive(:duplicate?)
+        expect(worker).to receive(:enqueue).and_return(true)
+
+        expect(reporter.report(result, flag_key: 'feature_flag', context: context)).to be(true)
+      end
+
+      it 'does not enqueue event again when exposure was already reported' do
+        allow(exposure_cache).to receive(:duplicate?).and_return(true)
+        expect(worker).not_to receive(:enqueue)
+
+        expect(reporter.report(result, flag_key: 'feature_flag', context: context)).to be(false)
+      end
+    end
+
     context 'when evaluation context is nil' do
       it 'skips enqueueing exposure' do
         expect(deduplicator).not_to receive(:duplicate?)
@@ -0,0 +1,64 @@
+# frozen_string_literal: true
+
+require 'spec_helper'
+require 'datadog/open_feature/native_evaluator'
+
+RSpec.describe Datadog::OpenFeature::NativeEvaluator do
+  subject(:evaluator) { described_class.new('{}') }
+
+  let(:configuration) { instance_double(Datadog::Core::FeatureFlags::Configuration) }
+  let(:result) { instance_double(Datadog::Core::FeatureFlags::ResolutionDetails, variant: 'control') }
+  let(:evaluation_context) { instance_double(Datadog::Core::FeatureFlags::EvaluationContext) }
+
+  before do
+    allow(Datadog::Core::FeatureFlags::Configuration).to receive(:new).with('{}').and_return(configuration)
+    allow(Datadog::Core::FeatureFlags::EvaluationContext).to receive(:new).and_return(evaluation_context)
+    allow(configuration).to receive(:get_assignment).and_return(result)
+  end
+
+  describe '#get_assignment' do
+    def get_assignment(context)
+      evaluator.get_assignment('flag', default_value: 'fallback', expected_type: :string, context: context)
+    end
+
+    context 'when context is frozen' do
+      let(:context) { {'targeting_key' => 'user'}.freeze }
+
+      it 'builds the evaluation context once and reuses it' do
+        3.times { get_assignment(context) }
+
+        expect(Datadog::Core::FeatureFlags::EvaluationContext).to have_received(:new).with(context).once
+        expect(configuration).to have_received(:get_assignment)
+          .with('flag', :string, evaluation_context).exactly(3).times
+      end
+
+      it 'builds a new evaluation context when the context changes' do
+        get_assignment(context)
+        get_assignment({'targeting_key' => 'other-user'}.freeze)
+
+        expect(Datadog::Core::FeatureFlags::EvaluationContext).to have_received(:new).twice
+      end
+    end
+
+    context 'when context is not frozen' do
+      let(:context) { {'targeting_key' => 'user'} }
+
+      it 'passes the context as-is' do
+        get_assignment(context)
+
+        expect(Datadog::Core::FeatureFlags::EvaluationContext).not_to have_received(:new)
+        expect(configuration).to have_received(:get_assignment).with('flag', :string, context)
+      end
+    end
+
+    context 'when the flag has no variant' do
+      let(:result) { instance_double(Datadog::Core::FeatureFlags::ResolutionDetails, variant: nil) }
+
+      it 'falls back to the default value' do
+        expect(result).to receive(:value=).with('fallback')
+
+        get_assignment({})
+      end
+    end
+  end
+end
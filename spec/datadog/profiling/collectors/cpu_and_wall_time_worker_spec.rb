@@ -23,6 +23,7 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
   let(:stack_recorder_options) { {} }
   let(:allocation_counting_enabled) { false }
   let(:gvl_profiling_enabled) { false }
+  let(:ractor_profiling_enabled) { false }
   let(:sighandler_sampling_enabled) { false }
   let(:cpu_sampling_interval_ms) { 10 }
   let(:worker_settings) do
@@ -34,6 +35,7 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
       allocation_profiling_enabled: allocation_profiling_enabled,
       allocation_counting_enabled: allocation_counting_enabled,
       gvl_profiling_enabled: gvl_profiling_enabled,
+      ractor_profiling_enabled: ractor_profiling_enabled,
       sighandler_sampling_enabled: sighandler_sampling_enabled,
       cpu_sampling_interval_ms: cpu_sampling_interval_ms,
       **options
@@ -354,6 +356,28 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
       expect(gc_sample.locations.first.path).to eq "Garbage Collection"
     end
 
+    it "records minor garbage collection cycles when gc events get flushed" do
+      start
+
+      described_class::Testing._native_trigger_sample
+
+      5.times do
+        Thread.pass
+        GC.start(full_mark: false)
+        Thread.pass
+      end
+
+      cpu_and_wall_time_worker.stop
+
+      expect(cpu_and_wall_time_worker.flush_gc_events).to be true
+
+      all_samples = samples_from_pprof(recorder.serialize!)
+
+      expect(all_samples).to include(
+        an_object_having_attributes(labels: a_hash_including("gc cause": "GC.start()", "gc type": "minor"))
+      )
+    end
+
     context "when the background thread dies without cleaning up (after Ruby forks)" do
       it "allows the CpuAndWallTimeWorker to be restarted" do
         start
@@ -550,6 +574,9 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
               gvl_sampling_time_ns_avg: be > 0,
             )
           )
+          gvl_contention = cpu_and_wall_time_worker.stats_and_reset_not_thread_safe.fetch(:gvl_contention)
+          expect(gvl_contention.dig(:all_threads, :gvl_wait, :count)).to be > 0
+          expect(gvl_contention.dig(:all_threads, :gvl_hold, :count)).to be > 0
         end
 
         context "when 'Waiting for GVL' periods are below waiting_for_gvl_threshold_ns" do
@@ -586,6 +613,9 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
                 gvl_sampling_time_ns_avg: nil,
               )
             )
+            gvl_dont_sample = cpu_and_wall_time_worker.stats.fetch(:gvl_dont_sample)
+            gvl_contention = cpu_and_wall_time_worker.stats_and_reset_not_thread_safe.fetch(:gvl_contention)
+            expect(gvl_contention.dig(:all_threads, :gvl_wait, :count)).to be >= gvl_dont_sample
           end
         end
       end
@@ -1210,6 +1240,58 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
           )
       end
 
+      context "when ractor_profiling_enabled is true" do
+        before { skip "Behavior does not apply to current Ruby version" if RUBY_VERSION < "3.3." }
+
+        let(:ractor_profiling_enabled) { true }
+
+        describe "sample_from_postponed_job" do
+          it "samples the thread running on the background ractor" do
+            cpu_and_wall_time_worker.start
+            wait_until_running
+
+            Ractor.new do
+              Thread.current.name = "background ractor"
+              Datadog::Profiling::Collectors::CpuAndWallTimeWorker::Testing._native_simulate_sample_from_postponed_job
+            end.yield_self { |r| (RUBY_VERSION < "4") ? r.take : r.value }
+
+            cpu_and_wall_time_worker.stop
+
+            samples_from_ractor =
+              samples_from_pprof(recorder.serialize!)
+                .select { |it| it.labels[:"thread name"] == "background ractor" }
+
+            expect(samples_from_ractor.size).to be 1
+            expect(samples_from_ractor.first.labels).to include(:"ractor id" => be > 1, :state => "unknown")
+            expect(samples_from_ractor.first.values).to include(:"cpu-samples" => 1)
+          end
+        end
+
+        it "does not lose samples for the main ractor while other ractors are busy" do
+          cpu_and_wall_time_worker.start
+          wait_until_running
+
+          deadline = Datadog::Core::Utils::Time.get_time + 1
+          ractors = Array.new(2) do
+            Ractor.new(deadline) do |ractor_deadline|
+              Thread.current.name = "background ractor"
+              nil while Process.clock_gettime(Process::CLOCK_MONOTONIC) < ractor_deadline
+            end
+          end
+          nil while Datadog::Core::Utils::Time.get_time < deadline
+          ractors.each { |r| (RUBY_VERSION < "4") ? r.take : r.value }
+
+          cpu_and_wall_time_worker.stop
+
+          stats = cpu_and_wall_time_worker.stats
+
+          # A sample that was enqueued right before stopping may not have been taken
+          expect(stats.fetch(:cpu_sampled) + stats.fetch(:cpu_skipped))
+            .to be >= stats.fetch(:signal_handler_enqueued_sample) - 1
+          expect(stats.fetch(:signal_handler_enqueued_sample)).to be > 0
+        end
+      end
+
       # @ivoanjo: I initially tried to also test the GC callbacks, but it gets a bit hacky to force the thread
       # context creation for the ractors, and then simulate a GC. (For instance -- how to prevent against the context
       # creation running in parallel with a regular sample?)
@@ -1354,6 +1436,8 @@ RSpec.describe Datadog::Profiling::Collectors::CpuAndWallTimeWorker do
           signal_handler_wrong_thread: 0,
           signal_handler_prepared_sample: 0,
           interrupt_thread_attempts: 0,
+          interrupt_ractor_thread_attempts: 0,
+          main_ractor_sample_retriggers: 0,
           cpu_sampled: 0,
           cpu_skipped: 0,
           cpu_effective_sample_rate: nil,
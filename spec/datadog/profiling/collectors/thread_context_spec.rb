@@ -1,5 +1,6 @@
 require "datadog/profiling/spec_helper"
 require "datadog/profiling/collectors/thread_context"
+require "socket"
 
 RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
   before do
@@ -244,6 +245,18 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
       expect(t2_sample.labels).to include("thread name": "thread t2")
     end
 
+    context "when a thread gets renamed between samples" do
+      it "includes the new thread name" do
+        t1.name = "thread t1"
+        sample
+        t1.name = "renamed t1"
+        sample
+
+        expect(samples_for_thread(samples, t1).map { |it| it.labels.fetch(:"thread name") })
+          .to contain_exactly("thread t1", "renamed t1")
+      end
+    end
+
     context "when no thread names are available" do
       # NOTE: As of this writing, the dd-trace-rb spec_helper.rb includes a monkey patch to Thread creation that we use
       # to track specs that leak threads. This means that the invoke_location of every thread will point at the
@@ -270,6 +283,109 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
       Thread.main.name = "Thread.main"
     end
 
+    context "when custom labels are active" do
+      before { require "datadog/profiling/custom_labels" }
+
+      it "includes them in the samples" do
+        Datadog::Profiling::CustomLabels.with_labels(tenant: "acme", checkout_v2: true) { sample }
+
+        expect(samples_for_thread(samples, Thread.main).first.labels).to include(tenant: "acme", checkout_v2: "true")
+      end
+
+      it "does not include them in samples taken from other fibers" do
+        Datadog::Profiling::CustomLabels.with_labels(tenant: "acme") { Fiber.new { sample }.resume }
+
+        expect(samples_for_thread(samples, Thread.main).first.labels).to_not include(:tenant)
+      end
+
+      it "does not include them in samples for other threads" do
+        Datadog::Profiling::CustomLabels.with_labels(tenant: "acme") { sample }
+
+        expect(samples_for_thread(samples, t1).first.labels).to_not include(:tenant)
+      end
+
+      context "when the same key is used in nested blocks" do
+        it "includes only the innermost value" do
+          Datadog::Profiling::CustomLabels.with_labels(tenant: "outer") do
+            Datadog::Profiling::CustomLabels.with_labels(tenant: "inner", checkout_v2: true) { sample }
+          end
+
+          expect(samples_for_thread(samples, Thread.main).first.labels).to include(tenant: "inner", checkout_v2: "true")
+        end
+
+        it "includes the outer value again once the inner block finishes" do
+          Datadog::Profiling::CustomLabels.with_labels(tenant: "outer") do
+            Datadog::Profiling::CustomLabels.with_labels(tenant: "inner") {}
+            sample
+          end
+
+          expect(samples_for_thread(samples, Thread.main).first.labels).to include(tenant: "outer")
+        end
+      end
+    end
+
+    context "when fiber profiling is enabled" do
+      let(:thread_context_collector) { described_class.for_testing(recorder: recorder, fiber_profiling_enabled: true) }
+      let(:suspended_fiber) do
+        Fiber.new do
+          def self.inside_suspended_fiber(collector)
+            described_class::Testing._native_on_fiber_switch(collector)
+            Fiber.yield
+          end
+
+          inside_suspended_fiber(thread_context_collector)
+        end
+      end
+
+      before do
+        skip "Fiber profiling is not supported on this Ruby version" unless described_class._native_fiber_profiling_supported?
+
+        # The CpuAndWallTimeWorker calls this on every fiber switch; here we simulate the ones around `resume`
+        described_class::Testing._native_on_fiber_switch(thread_context_collector)
+        suspended_fiber.resume
+        described_class::Testing._native_on_fiber_switch(thread_context_collector)
+      end
+
+      it "samples the stack of the suspended fiber" do
+        sample
+
+        fiber_sample = samples_for_thread(samples, Thread.main).find { |it| it.labels[:"fiber state"] == "suspended" }
+
+        expect(fiber_sample.locations.map(&:base_label)).to include("inside_suspended_fiber")
+        expect(stats).to include(suspended_fiber_samples: 1)
+      end
+
+      it "stops sampling the fiber once it finishes" do
+        suspended_fiber.resume
+        sample
+
+        expect(samples_for_thread(samples, Thread.main).map { |it| it.labels[:"fiber state"] }).to_not include("suspended")
+      end
+
+      it "does not keep suspended fibers from being garbage collected" do
+        require "weakref"
+
+        abandoned_fiber = suspend_abandoned_fiber
+        sample # Fiber switches only get applied at sample time; until then, the fibers involved are kept alive
+        expect(per_thread_context.fetch(Thread.main)).to include("fibers.suspended_count": 2)
+
+        3.times { GC.start }
+
+        expect(abandoned_fiber.weakref_alive?).to be_falsey
+      end
+
+      def suspend_abandoned_fiber
+        fiber = Fiber.new do
+          described_class::Testing._native_on_fiber_switch(thread_context_collector)
+          Fiber.yield
+        end
+        fiber.resume
+        described_class::Testing._native_on_fiber_switch(thread_context_collector)
+
+        WeakRef.new(fiber)
+      end
+    end
+
     it "includes the wall-time elapsed between samples" do
       sample
       wall_time_at_first_sample =
@@ -507,6 +623,30 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
             expect(t1_sample.labels).to_not include("trace endpoint": anything)
           end
 
+          context "when the active span changes between samples" do
+            it 'uses the "span id" of the span that was active for each sample' do
+              Datadog::Tracing.trace("profiler.test.current_thread") do |outer_span, trace|
+                @outer_span_id = outer_span.id
+                @local_root_span_id = trace.send(:root_span).id
+
+                sample
+                Datadog::Tracing.trace("profiler.test.current_thread.inner") do |inner_span|
+                  @inner_span_id = inner_span.id
+                  sample
+                end
+                sample
+              end
+
+              current_thread_samples = samples_for_thread(samples, Thread.current)
+
+              expect(current_thread_samples.map { |it| it.labels.fetch(:"span id") })
+                .to contain_exactly(@outer_span_id, @inner_span_id)
+              expect(current_thread_samples.map { |it| it.values.fetch(:"cpu-samples") }.reduce(:+)).to eq 3
+              expect(current_thread_samples)
+                .to all have_attributes(labels: include("local root span id": @local_root_span_id))
+            end
+          end
+
           shared_examples_for "samples with code hotspots information" do
             it 'includes the "trace endpoint" label in the samples' do
               sample
@@ -999,6 +1139,14 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
                   "span id": @t1_span_id.to_i,
                 )
               end
+
+              it 'includes the same "local root span id" and "span id" labels when sampling the same span again' do
+                3.times { sample }
+
+                expect(samples_for_thread(samples, t1)).to all have_attributes(
+                  labels: include("local root span id": @t1_local_root_span_id.to_i, "span id": @t1_span_id.to_i)
+                )
+              end
             end
 
             context "when the context storage contains spans related to multiple traces" do
@@ -1051,6 +1199,7 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
                 let(:t1) do
                   Thread.new(ready_queue, otel_tracer) do |ready_queue, otel_tracer|
                     otel_tracer.in_span("profiler.test", kind: :server) do |root_span|
+                      @t1_root_span = root_span
                       @t1_local_root_span_id = otel_span_id_to_i(root_span.context.span_id)
                       otel_tracer.in_span("profiler.test.nested.1") do
                         otel_tracer.in_span("profiler.test.nested.2") do
@@ -1070,6 +1219,15 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
 
                   expect(t1_sample.labels).to include("trace endpoint": "profiler.test")
                 end
+
+                it 'reflects changes to the root span name made after a sample was taken' do
+                  sample
+                  @t1_root_span.name = "profiler.test.renamed"
+                  sample
+
+                  expect(samples_for_thread(samples, t1))
+                    .to all have_attributes(labels: include("trace endpoint": "profiler.test.renamed"))
+                end
               end
 
               context "when endpoint_collection_enabled is false" do
@@ -1574,6 +1732,26 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
           expect(all_wall_time_at_previous_gc_ns.last).to be all_wall_time_at_previous_gc_ns.max
         end
       end
+
+      context "when a new GC cycle started since the previous on_gc_finish" do
+        before do
+          on_gc_start
+          on_gc_finish
+
+          GC.start # Only used to advance the GC count; the collector is not hooked to the actual GC in these tests
+
+          on_gc_start
+          on_gc_finish
+        end
+
+        it "queues the previous GC event to be flushed" do
+          expect(gc_tracking.fetch(:pending_gc_events)).to be 1
+        end
+
+        it "starts accumulating a new GC event" do
+          expect(gc_tracking.fetch(:wall_time_at_previous_gc_ns)).to_not be invalid_time
+        end
+      end
     end
   end
 
@@ -1581,8 +1759,11 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
     before { sample }
 
     context "when called before on_gc_start/on_gc_finish" do
-      it do
-        expect { sample_after_gc(allow_exception: true) }.to raise_error(::RuntimeError, /Unexpected call to sample_after_gc/)
+      it "does not record any gc samples" do
+        sample_after_gc
+
+        expect(stats.fetch(:gc_samples)).to be 0
+        expect(samples.select { |it| it.labels[:"thread name"] == "Garbage Collection" }).to be_empty
       end
     end
 
@@ -1597,11 +1778,34 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
       end
 
       context "when called more than once in a row" do
-        it do
+        it "only records the gc sample once" do
+          sample_after_gc
+
+          expect { sample_after_gc }.to_not(change { stats.fetch(:gc_samples) })
+        end
+      end
+
+      context "when there are multiple pending gc events" do
+        before do
+          GC.start # Only used to advance the GC count; the collector is not hooked to the actual GC in these tests
+
+          on_gc_start
+          on_gc_finish
+        end
+
+        it "records a Garbage Collection sample for each of them" do
+          sample_after_gc
+
+          gc_samples = samples.select { |it| it.labels[:"thread name"] == "Garbage Collection" }
+
+          expect(gc_samples.sum { |it| it.values.fetch(:"cpu-samples") }).to be 2
+          expect(stats.fetch(:gc_samples)).to be 2
+        end
+
+        it "leaves no pending gc events" do
           sample_after_gc
 
-          expect { sample_after_gc(allow_exception: true) }
-            .to raise_error(::RuntimeError, /Unexpected call to sample_after_gc/)
+          expect(gc_tracking).to include(pending_gc_events: 0, wall_time_at_previous_gc_ns: invalid_time)
         end
       end
 
@@ -1656,6 +1860,12 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
         expect(gc_sample.labels.keys).to_not include(:end_timestamp_ns)
       end
 
+      it "does not include the heap stats" do
+        sample_after_gc
+
+        expect(gc_sample.labels.keys).to_not include(:"gc heap live slots", :"gc heap free slots")
+      end
+
       context "when timeline is enabled" do
         let(:timeline_enabled) { true }
 
@@ -1672,6 +1882,15 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
 
           expect(gc_sample.labels.fetch(:end_timestamp_ns)).to be_between(@time_before, @time_after)
         end
+
+        it "includes the heap stats as labels" do
+          sample_after_gc
+
+          expect(gc_sample.labels).to include(
+            "gc heap live slots": be > 0,
+            "gc heap free slots": be >= 0,
+          )
+        end
       end
     end
   end
@@ -1980,6 +2199,18 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
 
     let(:timeline_enabled) { true }
 
+    context "when thread is not being tracked" do
+      it do
+        expect(sample_after_gvl_running(t1)).to be false
+      end
+
+      it "does not start tracking the thread" do
+        sample_after_gvl_running(t1)
+
+        expect(per_thread_context.keys).to_not include(t1)
+      end
+    end
+
     context "when thread is not at the end of a Waiting for GVL period" do
       before do
         expect(gvl_waiting_at_for(t1)).to be 0
@@ -2053,6 +2284,174 @@ RSpec.describe Datadog::Profiling::Collectors::ThreadContext do
     end
   end
 
+  describe "#gvl_contention_stats_and_reset" do
+    before { skip_if_gvl_profiling_not_supported(self) }
+
+    def on_gvl_acquired(thread, waiting_for_gvl_duration_ns:, now_ns:)
+      described_class::Testing._native_on_gvl_acquired(thread_context_collector, thread, waiting_for_gvl_duration_ns, now_ns)
+    end
+
+    def on_gvl_released(thread, now_ns:)
+      described_class::Testing._native_on_gvl_released(thread_context_collector, thread, now_ns)
+    end
+
+    let(:empty_histogram) { {count: 0, total_ns: 0, max_ns: 0, p50_ns: 0, p90_ns: 0, p99_ns: 0} }
+
+    it "returns empty histograms when there was no GVL activity" do
+      expect(thread_context_collector.gvl_contention_stats_and_reset).to eq(
+        all_threads: {gvl_wait: empty_histogram, gvl_hold: empty_histogram},
+        per_thread: {},
+        per_thread_omitted: 0,
+      )
+    end
+
+    context "when threads waited for and held the GVL" do
+      before do
+        sample # trigger context creation
+
+        100.times do |i|
+          on_gvl_acquired(t1, waiting_for_gvl_duration_ns: (i + 1) * 1_000_000, now_ns: 1_000_000_000)
+          on_gvl_released(t1, now_ns: 1_000_000_000 + 50_000)
+        end
+        on_gvl_acquired(t2, waiting_for_gvl_duration_ns: -1, now_ns: 1_000_000_000)
+        on_gvl_released(t2, now_ns: 1_000_000_000 + 2_000_000)
+      end
+
+      it "returns per-thread percentiles for threads with GVL activity" do
+        result = thread_context_collector.gvl_contention_stats_and_reset
+
+        t1_stats = result.fetch(:per_thread).fetch(per_thread_context.fetch(t1).fetch(:thread_id))
+
+        expect(t1_stats.fetch(:gvl_wait)).to include(count: 100, max_ns: 100_000_000)
+        expect(t1_stats.fetch(:gvl_wait).fetch(:p50_ns)).to be_within(2).percent_of(50_000_000)
+        expect(t1_stats.fetch(:gvl_wait).fetch(:p99_ns)).to be_within(2).percent_of(99_000_000)
+        expect(t1_stats.fetch(:gvl_hold)).to include(count: 100, max_ns: 50_000)
+        expect(t1_stats.fetch(:gvl_hold).fetch(:p50_ns)).to be_within(2).percent_of(50_000)
+
+        t2_stats = result.fetch(:per_thread).fetch(per_thread_context.fetch(t2).fetch(:thread_id))
+
+        expect(t2_stats.fetch(:gvl_wait)).to eq(empty_histogram)
+        expect(t2_stats.fetch(:gvl_hold)).to include(count: 1, max_ns: 2_000_000)
+      end
+
+      it "aggregates all threads" do
+        result = thread_context_collector.gvl_contention_stats_and_reset
+
+        expect(result.fetch(:all_threads).fetch(:gvl_wait)).to include(count: 100)
+        expect(result.fetch(:all_threads).fetch(:gvl_hold)).to include(count: 101, max_ns: 2_000_000)
+      end
+
+      it "resets the histograms" do
+        thread_context_collector.gvl_contention_stats_and_reset
+
+        expect(thread_context_collector.gvl_contention_stats_and_reset).to eq(
+          all_threads: {gvl_wait: empty_histogram, gvl_hold: empty_histogram},
+          per_thread: {},
+          per_thread_omitted: 0,
+        )
+      end
+    end
+
+    context "when more threads had GVL activity than get reported individually" do
+      let(:extra_threads) { Array.new(40) { Thread.new { sleep } } }
+
+      before do
+        extra_threads
+        sample # trigger context creation
+
+        extra_threads.each do |thread|
+          on_gvl_acquired(thread, waiting_for_gvl_duration_ns: 1_000_000, now_ns: 1_000_000_000)
+        end
+      end
+
+      after do
+        extra_threads.each(&:kill).each(&:join)
+      end
+
+      it "caps the per-thread stats, but still includes every thread in the aggregate" do
+        result = thread_context_collector.gvl_contention_stats_and_reset
+
+        expect(result.fetch(:per_thread).size).to be 32
+        expect(result.fetch(:per_thread_omitted)).to be 8
+        expect(result.fetch(:all_threads).fetch(:gvl_wait)).to include(count: 40)
+      end
+    end
+
+    it "does not record hold time for a release without a matching acquire" do
+      sample # trigger context creation
+
+      on_gvl_released(t1, now_ns: 1_000_000_000)
+
+      expect(thread_context_collector.gvl_contention_stats_and_reset.fetch(:all_threads).fetch(:gvl_hold)).to eq(empty_histogram)
+    end
+  end
+
+  describe "state label for threads that released the GVL" do
+    let(:timeline_enabled) { true }
+    let(:sockets) { UNIXSocket.pair }
+    let(:blocked_thread) do
+      Thread.new(ready_queue, sockets.first) do |ready_queue, socket|
+        ready_queue << true
+        socket.read(1)
+      end
+    end
+
+    before do
+      skip_if_gvl_profiling_not_supported(self)
+      skip "Test only runs on Linux" unless PlatformHelpers.linux?
+
+      blocked_thread
+      ready_queue.pop
+      sleep 0.05 # Give the thread time to block on the socket
+
+      sample # trigger context creation
+      recorder.serialize! # flush sample
+    end
+
+    after do
+      sockets.last.write("x")
+      blocked_thread.join
+      sockets.each(&:close)
+    end
+
+    def on_gvl_released(thread)
+      described_class::Testing._native_on_gvl_released(thread_context_collector, thread, invalid_time)
+    end
+
+    def on_gvl_acquired(thread)
+      described_class::Testing._native_on_gvl_acquired(thread_context_collector, thread, invalid_time, invalid_time)
+    end
+
+    it "sets the state based on what the thread is blocked on" do
+      on_gvl_released(blocked_thread)
+      sample
+
+      expect(samples_for_thread(samples, blocked_thread).last.labels).to include(state: "network")
+    end
+
+    it "only looks up what the thread is blocked on once per GVL release" do
+      on_gvl_released(blocked_thread)
+      3.times { sample }
+
+      expect(stats.fetch(:blocking_state_lookups)).to be 1
+    end
+
+    it "records how long the lookups took" do
+      on_gvl_released(blocked_thread)
+      sample
+
+      expect(stats.fetch(:blocking_state_lookup_time_ns_total)).to be > 0
+    end
+
+    it "does not look up threads that reacquired the GVL" do
+      on_gvl_released(blocked_thread)
+      on_gvl_acquired(blocked_thread)
+      sample
+
+      expect(stats.fetch(:blocking_state_lookups)).to be 0
+    end
+  end
+
   describe "#prepare_sample_inside_signal_handler" do
     let(:timeline_enabled) { true } # Not strictly needed but disables aggregation which makes it easier to analyze results
     let(:trigger_context_creation) { true }
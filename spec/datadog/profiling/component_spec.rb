@@ -98,6 +98,8 @@ RSpec.describe Datadog::Profiling::Component do
             .to receive(:waiting_for_gvl_threshold_ns).and_return(:threshold_ns_config)
           expect(settings.profiling.advanced)
             .to receive(:native_filenames_enabled).and_return(:native_filenames_enabled_config)
+          expect(settings.profiling.advanced)
+            .to receive(:experimental_fiber_profiling_enabled).and_return(:fiber_profiling_enabled_config)
 
           expect(Datadog::Profiling::Collectors::ThreadContext).to receive(:new).with(
             recorder: dummy_stack_recorder,
@@ -108,6 +110,7 @@ RSpec.describe Datadog::Profiling::Component do
             waiting_for_gvl_threshold_ns: :threshold_ns_config,
             otel_context_enabled: false,
             native_filenames_enabled: :native_filenames_enabled_config,
+            fiber_profiling_enabled: :fiber_profiling_enabled_config,
           )
 
           build_profiler_component
@@ -161,6 +164,7 @@ RSpec.describe Datadog::Profiling::Component do
             allocation_profiling_enabled: false,
             allocation_counting_enabled: :allocation_counting_enabled_config,
             gvl_profiling_enabled: :gvl_profiling_result,
+            ractor_profiling_enabled: false,
             sighandler_sampling_enabled: :sighandler_sampling_enabled_config,
             cpu_sampling_interval_ms: :cpu_sampling_interval_ms_config,
           )
@@ -560,6 +564,9 @@ RSpec.describe Datadog::Profiling::Component do
           api_key: settings.api_key,
           upload_timeout_seconds: settings.profiling.upload.timeout_seconds,
           use_system_dns: settings.profiling.advanced.experimental_use_system_dns,
+          async_export_enabled: settings.profiling.advanced.experimental_async_export_enabled,
+          async_export_max_pending_profiles:
+            settings.profiling.advanced.experimental_async_export_max_pending_profiles,
         )
 
         build_profiler_component
@@ -797,6 +804,37 @@ RSpec.describe Datadog::Profiling::Component do
           end
         end
       end
+
+      context "when Ractor profiling is requested" do
+        before do
+          settings.profiling.advanced.experimental_ractor_profiling_enabled = true
+          # This triggers a warning in some Rubies so it's easier for testing to disable it
+          settings.profiling.advanced.gc_enabled = false
+        end
+
+        context "on Ruby < 3.3" do
+          before { skip "Behavior does not apply to current Ruby version" if RUBY_VERSION >= "3.3." }
+
+          it "does not enable Ractor profiling and logs a warning" do
+            expect(logger).to receive(:warn).with(/Ractor profiling is only supported on Ruby 3.3/)
+            expect(Datadog::Profiling::Collectors::CpuAndWallTimeWorker)
+              .to receive(:new).with(hash_including(ractor_profiling_enabled: false))
+
+            build_profiler_component
+          end
+        end
+
+        context "on Ruby >= 3.3" do
+          before { skip "Behavior does not apply to current Ruby version" if RUBY_VERSION < "3.3." }
+
+          it "enables Ractor profiling" do
+            expect(Datadog::Profiling::Collectors::CpuAndWallTimeWorker)
+              .to receive(:new).with(hash_including(ractor_profiling_enabled: true))
+
+            build_profiler_component
+          end
+        end
+      end
     end
   end
 
@@ -0,0 +1,75 @@
+require "datadog/profiling/spec_helper"
+require "datadog/profiling/custom_labels"
+
+RSpec.describe Datadog::Profiling::CustomLabels do
+  before do
+    skip_if_profiling_not_supported
+    described_class::Testing._native_reset_interned_strings
+  end
+
+  after { described_class::Testing._native_reset_interned_strings if Datadog::Profiling.supported? }
+
+  describe ".with_labels" do
+    it "returns the result of the block" do
+      expect(described_class.with_labels(tenant: "acme") { :block_result }).to be :block_result
+    end
+
+    it "interns keys and values only once" do
+      3.times { described_class.with_labels(tenant: "acme") {} }
+
+      expect(described_class.stats).to include(interned_strings: 2)
+    end
+
+    it "converts keys and values to strings" do
+      described_class.with_labels(checkout_v2: true) {}
+
+      expect(described_class.stats).to include(interned_strings: 2)
+    end
+
+    it "pops the labels when the block raises" do
+      expect do
+        described_class.with_labels(tenant: "acme") { raise "oops" }
+      end.to raise_error(RuntimeError, "oops")
+
+      # One of these would have been dropped if the label above was still active
+      described_class.with_labels((1..8).map { |i| ["key#{i}", "value"] }.to_h) {}
+
+      expect(described_class.stats).to include(dropped_labels: 0)
+    end
+
+    context "when more than 8 labels are active at the same time" do
+      it "drops the extra labels" do
+        described_class.with_labels((1..10).map { |i| ["key#{i}", "value"] }.to_h) {}
+
+        expect(described_class.stats).to include(dropped_labels: 2)
+      end
+    end
+
+    context "when too many distinct keys and values are used" do
+      before do
+        # Fill up the table with 1024 strings
+        512.times { |i| described_class.with_labels("key#{i}" => "value#{i}") {} }
+      end
+
+      it "reports new values as overflowed" do
+        described_class.with_labels("key0" => "new value") {}
+
+        expect(described_class.stats).to include(interned_strings: 1024, overflowed_values: 1, dropped_labels: 0)
+      end
+
+      it "drops labels with new keys" do
+        described_class.with_labels("new key" => "value0") {}
+
+        expect(described_class.stats).to include(interned_strings: 1024, dropped_labels: 1)
+      end
+    end
+
+    it "raises when using a key reserved by the profiler" do
+      expect { described_class.with_labels("thread name" => "foo") {} }.to raise_error(ArgumentError, /reserved/)
+    end
+
+    it "raises when using a key or value that is too long" do
+      expect { described_class.with_labels("tenant" => "a" * 129) {} }.to raise_error(ArgumentError, /at most 128/)
+    end
+  end
+end
@@ -0,0 +1,59 @@
+require "datadog/profiling/spec_helper"
+
+require "datadog/profiling/encoded_profile"
+
+require "tempfile"
+require "tmpdir"
+
+RSpec.describe Datadog::Profiling::EncodedProfile do
+  before { skip_if_profiling_not_supported }
+
+  subject(:encoded_profile) { Datadog::Profiling::StackRecorder.for_testing.serialize[2] }
+
+  let(:expected_bytes) { encoded_profile._native_bytes }
+
+  describe "#write_to" do
+    context "when given a path" do
+      it "writes the profile to the file at that path" do
+        Dir.mktmpdir do |directory|
+          path = File.join(directory, "profile.pprof")
+
+          expect(encoded_profile.write_to(path)).to be expected_bytes.bytesize
+          expect(File.binread(path)).to eq expected_bytes
+        end
+      end
+    end
+
+    context "when given an IO" do
+      it "writes the profile after anything already written to the IO" do
+        Tempfile.create("profile") do |file|
+          file.binmode
+          file.write("header:")
+
+          encoded_profile.write_to(file)
+
+          expect(File.binread(file.path)).to eq "header:".b + expected_bytes
+        end
+      end
+
+      it "supports non-blocking IOs" do
+        reader, writer = IO.pipe
+        reader_thread = Thread.new { reader.read }
+
+        encoded_profile.write_to(writer)
+        writer.close
+
+        expect(reader_thread.value.b).to eq expected_bytes
+      ensure
+        reader&.close
+        writer&.close unless writer&.closed?
+      end
+    end
+
+    it "does not consume the profile" do
+      Tempfile.create("profile") { |file| encoded_profile.write_to(file) }
+
+      expect(encoded_profile._native_bytes).to eq expected_bytes
+    end
+  end
+end
@@ -26,6 +26,8 @@ RSpec.describe Datadog::Profiling::HttpTransport do
       api_key: api_key,
       upload_timeout_seconds: upload_timeout_seconds,
       use_system_dns: use_system_dns,
+      async_export_enabled: async_export_enabled,
+      async_export_max_pending_profiles: async_export_max_pending_profiles,
     )
   end
 
@@ -48,6 +50,8 @@ RSpec.describe Datadog::Profiling::HttpTransport do
   let(:api_key) { nil }
   let(:upload_timeout_seconds) { 10 }
   let(:use_system_dns) { false }
+  let(:async_export_enabled) { false }
+  let(:async_export_max_pending_profiles) { 4 }
 
   let(:flush) do
     Datadog::Profiling::Flush.new(
@@ -211,6 +215,60 @@ RSpec.describe Datadog::Profiling::HttpTransport do
         expect { http_transport }.to raise_error(ArgumentError, /Failed to initialize transport/)
       end
     end
+
+    context "when async_export_enabled is true" do
+      let(:async_export_enabled) { true }
+
+      it "creates the async exporter with the same exporter configuration, and the agent address to check" do
+        expect(described_class)
+          .to receive(:_native_async_exporter_new)
+          .with(
+            [:agent, upload_timeout_milliseconds, false, "http://192.168.0.1:12345/"],
+            4,
+            [:tcp, "192.168.0.1", 12345],
+          )
+          .and_return([:ok, instance_double(described_class::AsyncExporter)])
+
+        http_transport
+      end
+
+      context "when agent_settings requests a unix domain socket" do
+        let(:adapter) { Datadog::Core::Transport::Ext::UnixSocket::ADAPTER }
+        let(:uds_path) { "/var/run/datadog/apm.socket" }
+
+        it "checks the agent address using the unix domain socket" do
+          expect(described_class)
+            .to receive(:_native_async_exporter_new)
+            .with(anything, 4, [:unix, "/var/run/datadog/apm.socket"])
+            .and_return([:ok, instance_double(described_class::AsyncExporter)])
+
+          http_transport
+        end
+      end
+
+      context "when async_export_max_pending_profiles is provided" do
+        let(:async_export_max_pending_profiles) { 30 }
+
+        it "passes it to the async exporter" do
+          expect(described_class)
+            .to receive(:_native_async_exporter_new)
+            .with(anything, 30, anything)
+            .and_return([:ok, instance_double(described_class::AsyncExporter)])
+
+          http_transport
+        end
+      end
+
+      context "when the async exporter cannot be created" do
+        before do
+          expect(described_class).to receive(:_native_async_exporter_new).and_return([:error, "Some error message"])
+        end
+
+        it do
+          expect { http_transport }.to raise_error(ArgumentError, /Failed to initialize transport: Some error message/)
+        end
+      end
+    end
   end
 
   describe "#export" do
@@ -293,6 +351,115 @@ RSpec.describe Datadog::Profiling::HttpTransport do
         it { is_expected.to be false }
       end
     end
+
+    context "when async_export_enabled is true" do
+      let(:async_export_enabled) { true }
+      let(:async_exporter) { instance_double(described_class::AsyncExporter) }
+      let(:failures) { [0, nil] }
+
+      before do
+        allow(described_class).to receive(:_native_async_exporter_new).and_return([:ok, async_exporter])
+        allow(described_class).to receive(:_native_async_take_failures).with(async_exporter).and_return(failures)
+        allow(Datadog.logger).to receive(:warn)
+        allow(Datadog::Core::Telemetry::Logger).to receive(:error)
+      end
+
+      it "queues the flush for export in the background" do
+        expect(described_class).to receive(:_native_async_export).with(async_exporter, flush).and_return(true)
+        expect(described_class).to_not receive(:_native_do_export)
+
+        expect(export).to be true
+      end
+
+      context "when the queue is full" do
+        before { allow(described_class).to receive(:_native_async_export).and_return(false) }
+
+        it "logs an error message" do
+          expect(Datadog.logger).to receive(:warn).with(
+            "Failed to report profiling data (agent: http://192.168.0.1:12345/): " \
+            "too many profiles pending export, dropping profile"
+          )
+
+          export
+        end
+
+        it "sends a telemetry log" do
+          expect(Datadog::Core::Telemetry::Logger).to receive(:error).with(
+            "Failed to report profiling data: too many profiles pending export"
+          )
+
+          export
+        end
+
+        it { is_expected.to be false }
+      end
+
+      context "when previous exports failed" do
+        let(:failures) { [3, "server returned unexpected HTTP 503 status code"] }
+
+        before { allow(described_class).to receive(:_native_async_export).and_return(true) }
+
+        it "logs an error message" do
+          expect(Datadog.logger).to receive(:warn).with(
+            "Failed to report profiling data (agent: http://192.168.0.1:12345/): " \
+            "server returned unexpected HTTP 503 status code (and 2 other failures since the last report)"
+          )
+
+          export
+        end
+
+        it "sends a telemetry log" do
+          expect(Datadog::Core::Telemetry::Logger).to receive(:error).with("Failed to report profiling data")
+
+          export
+        end
+      end
+    end
+  end
+
+  describe "#wait_for_pending_exports" do
+    subject(:wait_for_pending_exports) { http_transport.wait_for_pending_exports }
+
+    it { is_expected.to be true }
+
+    context "when async_export_enabled is true" do
+      let(:async_export_enabled) { true }
+      let(:async_exporter) { instance_double(described_class::AsyncExporter) }
+
+      before do
+        allow(described_class).to receive(:_native_async_exporter_new).and_return([:ok, async_exporter])
+        allow(described_class).to receive(:_native_async_take_failures).with(async_exporter).and_return([0, nil])
+      end
+
+      it "waits for up to the upload timeout for pending exports" do
+        expect(described_class)
+          .to receive(:_native_async_wait).with(async_exporter, upload_timeout_seconds * 1_000).and_return(false)
+
+        expect(wait_for_pending_exports).to be false
+      end
+    end
+  end
+
+  describe "#stop" do
+    subject(:stop) { http_transport.stop }
+
+    it { is_expected.to be true }
+
+    context "when async_export_enabled is true" do
+      let(:async_export_enabled) { true }
+      let(:async_exporter) { instance_double(described_class::AsyncExporter) }
+
+      before do
+        allow(described_class).to receive(:_native_async_exporter_new).and_return([:ok, async_exporter])
+      end
+
+      it "stops the async exporter, waiting for up to the upload timeout" do
+        expect(described_class)
+          .to receive(:_native_async_stop).with(async_exporter, upload_timeout_seconds * 1_000).and_return(true)
+
+        expect(stop).to be true
+      end
+    end
   end
 
   describe "#exporter_configuration" do
@@ -516,6 +683,80 @@ RSpec.describe Datadog::Profiling::HttpTransport do
       end
     end
 
+    context "when async_export_enabled is true" do
+      let(:async_export_enabled) { true }
+
+      it "reports profiling data in the background" do
+        expect(http_transport.export(flush)).to be true
+        expect(http_transport.wait_for_pending_exports).to be true
+
+        expect(request.request_uri.to_s).to eq "http://127.0.0.1:#{port}/profiling/v1/input"
+
+        boundary = request["content-type"][%r{^multipart/form-data; boundary=(.+)}, 1]
+        body = WEBrick::HTTPUtils.parse_form_data(StringIO.new(request.body), boundary)
+        event_data = JSON.parse(body.fetch("event"))
+
+        expect(event_data["tags_profiler"]).to start_with("tag_a:value_a,tag_b:value_b,runtime_platform:")
+        expect(body.fetch(pprof_file_name)).to eq encoded_profile_bytes
+      end
+
+      it "stops the background thread" do
+        expect(http_transport.stop).to be true
+
+        allow(Datadog.logger).to receive(:warn)
+        allow(Datadog::Core::Telemetry::Logger).to receive(:error)
+
+        expect(http_transport.export(flush)).to be false
+        expect(request).to be nil
+      end
+
+      context "when agent is down" do
+        let(:upload_timeout_seconds) { 1 }
+        let(:another_flush) do
+          Datadog::Profiling::Flush.new(
+            start: start,
+            finish: finish,
+            encoded_profile: Datadog::Profiling::StackRecorder.for_testing.serialize[2],
+            code_provenance_file_name: code_provenance_file_name,
+            code_provenance_data: code_provenance_data,
+            tags_as_array: tags_as_array,
+            process_tags: process_tags,
+            internal_metadata: {no_signals_workaround_enabled: true},
+            info_json: info_json,
+          )
+        end
+
+        before do
+          http_server.shutdown
+          @server_thread.join
+          allow(Datadog::Core::Telemetry::Logger).to receive(:error).with("Failed to report profiling data")
+        end
+
+        it "holds profiles after a failed export instead of trying to report them" do
+          expect(Datadog.logger).to receive(:warn).with(/Failed to report profiling data/).ordered
+          expect(Datadog.logger).to receive(:warn).with(/agent is not reachable.*holding profiles until it is/).ordered
+
+          expect(http_transport.export(flush)).to be true
+          expect(http_transport.wait_for_pending_exports).to be true
+
+          expect(http_transport.export(another_flush)).to be true
+          expect(http_transport.wait_for_pending_exports).to be false
+        end
+      end
+
+      context "when server returns a 5xx failure" do
+        let(:server_proc) { proc { |_req, res| res.status = 503 } }
+
+        it "logs an error once the export finishes" do
+          expect(Datadog.logger).to receive(:warn).with(/unexpected HTTP 503/)
+          expect(Datadog::Core::Telemetry::Logger).to receive(:error).with("Failed to report profiling data")
+
+          http_transport.export(flush)
+          http_transport.wait_for_pending_exports
+        end
+      end
+    end
+
     describe "cancellation behavior" do
       let!(:request_received_queue) { Queue.new }
       let!(:request_finish_queue) { Queue.new }
@@ -12,6 +12,8 @@ RSpec.describe Datadog::Profiling::Scheduler do
 
   subject(:scheduler) { described_class.new(exporter: exporter, transport: transport, interval: interval, **options) }
 
+  before { allow(transport).to receive(:stop) }
+
   describe ".new" do
     describe "default settings" do
       it do
@@ -172,7 +174,10 @@ RSpec.describe Datadog::Profiling::Scheduler do
 
     let(:flush) { instance_double(Datadog::Profiling::Flush) }
 
-    before { expect(exporter).to receive(:flush).and_return(flush) }
+    before do
+      expect(exporter).to receive(:flush).and_return(flush)
+      allow(transport).to receive(:wait_for_pending_exports)
+    end
 
     it "exports the profiling data" do
       expect(transport).to receive(:export).with(flush)
@@ -207,6 +212,14 @@ RSpec.describe Datadog::Profiling::Scheduler do
     context "when being run in a loop" do
       before { allow(scheduler).to receive(:run_loop?).and_return(true) }
 
+      it "does not wait for pending exports" do
+        allow(scheduler).to receive(:sleep)
+        expect(transport).to receive(:export)
+        expect(transport).to_not receive(:wait_for_pending_exports)
+
+        flush_events
+      end
+
       it "sleeps for up to DEFAULT_FLUSH_JITTER_MAXIMUM_SECONDS seconds before reporting" do
         expect(scheduler).to receive(:sleep) do |sleep_amount|
           expect(sleep_amount).to be < described_class.const_get(:DEFAULT_FLUSH_JITTER_MAXIMUM_SECONDS)
@@ -228,6 +241,13 @@ RSpec.describe Datadog::Profiling::Scheduler do
 
         flush_events
       end
+
+      it "waits for pending exports after reporting" do
+        expect(transport).to receive(:export).ordered
+        expect(transport).to receive(:wait_for_pending_exports).ordered
+
+        flush_events
+      end
     end
   end
 
@@ -276,7 +296,10 @@ RSpec.describe Datadog::Profiling::Scheduler do
     let(:flush) { instance_double(Datadog::Profiling::Flush) }
     let(:interval) { 1 }
 
-    before { allow(transport).to receive(:export) }
+    before do
+      allow(transport).to receive(:export)
+      allow(transport).to receive(:wait_for_pending_exports)
+    end
 
     context "when exporter has data to flush" do
       before do
@@ -304,6 +327,18 @@ RSpec.describe Datadog::Profiling::Scheduler do
         expect(scheduler.stop(false, 10)).to be true
         @stopped = true
       end
+
+      it "stops the transport after the last flush" do
+        expect(transport).to receive(:export).with(flush).ordered
+        expect(transport).to receive(:stop).ordered
+
+        scheduler.start
+        wait_for { scheduler.run_loop? }.to be true
+
+        @stopped = false
+        scheduler.stop(false, 10)
+        @stopped = true
+      end
     end
   end
 end
@@ -382,6 +382,43 @@ RSpec.describe Datadog::Profiling::StackRecorder do
           end
         ).to have(2).items
       end
+
+      context "when the endpoint is recorded together with the sample" do
+        def sample_with_endpoint(endpoint, local_root_span_id: 123)
+          Datadog::Profiling::Collectors::Stack::Testing._native_sample(
+            Thread.current,
+            stack_recorder,
+            metric_values,
+            {"state" => "unknown"}.to_a,
+            {"local root span id" => local_root_span_id}.to_a,
+            endpoint_local_root_span_id: local_root_span_id,
+            endpoint: endpoint,
+          )
+        end
+
+        it "includes the most recent endpoint in all matching samples" do
+          sample_with_endpoint("first-endpoint")
+          sample_with_endpoint("second-endpoint")
+
+          expect(samples).to all have_attributes(labels: include("trace endpoint": "second-endpoint"))
+        end
+
+        it "only records the endpoint again when it changes" do
+          3.times { sample_with_endpoint("same-endpoint") }
+          sample_with_endpoint("changed-endpoint")
+
+          expect(profile_stats).to include(recorded_endpoints: 2)
+        end
+
+        it "records the endpoint again in the next profile" do
+          sample_with_endpoint("same-endpoint")
+          stack_recorder.serialize
+          sample_with_endpoint("same-endpoint")
+
+          expect(samples).to all have_attributes(labels: include("trace endpoint": "same-endpoint"))
+          expect(profile_stats).to include(recorded_endpoints: 1)
+        end
+      end
     end
 
     describe "heap samples and sizes" do
@@ -1008,6 +1045,9 @@ RSpec.describe Datadog::Profiling::StackRecorder do
           serialization_time_ns_avg: be > 0,
           serialization_time_ns_total: be > 0,
 
+          queued_samples_recorded: 0,
+          queued_samples_dropped: 0,
+
           heap_recorder_snapshot: nil,
         )
       )
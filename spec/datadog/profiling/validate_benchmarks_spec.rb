@@ -39,6 +39,7 @@ RSpec.describe "Profiling benchmarks", :memcheck_valgrind_skip do
     "profiling_sample_serialize",
     "profiling_sample_gvl",
     "profiling_string_storage_intern",
+    "profiling_thread_cpu_time",
   ].freeze
 
   benchmarks_to_validate.each do |benchmark|
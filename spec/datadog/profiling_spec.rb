@@ -58,6 +58,31 @@ RSpec.describe Datadog::Profiling do
     end
   end
 
+  describe '.with_labels' do
+    context 'when profiling is supported' do
+      before do
+        skip('Test only runs on setups where profiling is supported') unless described_class.supported?
+      end
+
+      it 'delegates to CustomLabels' do
+        expect(Datadog::Profiling::CustomLabels)
+          .to receive(:with_labels).with({tenant: 'acme'}).and_yield.and_return(:block_result)
+
+        expect(described_class.with_labels(tenant: 'acme') { :block_result }).to be :block_result
+      end
+    end
+
+    context 'when profiling is not supported' do
+      before do
+        skip('Test only runs on setups where profiling is not supported') if described_class.supported?
+      end
+
+      it 'calls the block and returns its result' do
+        expect(described_class.with_labels(tenant: 'acme') { :block_result }).to be :block_result
+      end
+    end
+  end
+
   describe '.enabled?' do
     subject(:enabled?) { described_class.enabled? }
 